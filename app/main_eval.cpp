@@ -0,0 +1,88 @@
+/**
+ * @file main_eval.cpp
+ * @author Apoorv Thapliyal
+ * @brief C++ source file for the trajectory evaluation
+ * @version 0.1
+ * @date 2024-11-26
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "camera_calibration.hpp"
+#include "text_parser.hpp"
+#include "trajectory_evaluation.hpp"
+
+int main(int argc, char** argv) {
+  // Usage: app_eval <estimate> [groundtruth] [sim3|se3|none]
+  //                 [camera_calibration|identity] [max_time_difference]
+  //                 [segment lengths...]
+  const char* usage =
+      "Usage: app_eval <estimate> [groundtruth] [sim3|se3|none] "
+      "[camera_calibration|identity] [max_time_difference] "
+      "[segment lengths...]";
+  if (argc < 2) {
+    std::cerr << usage << std::endl;
+    return 1;
+  }
+  std::string groundtruth_path =
+      argc > 2 ? argv[2]
+               : "indoor_forward_9_davis_with_gt/groundtruth.txt";
+
+  ev::EvaluationConfig config;
+  if (argc > 3) {
+    std::string alignment = argv[3];
+    if (alignment == "se3") {
+      config.alignment = ev::Alignment::kSE3;
+    } else if (alignment == "none") {
+      config.alignment = ev::Alignment::kNone;
+    } else if (alignment != "sim3") {
+      std::cerr << "Unknown alignment " << alignment << "\n"
+                << usage << std::endl;
+      return 1;
+    }
+  }
+  // The estimate is a camera trajectory and the ground truth an IMU body
+  // trajectory; the extrinsic moves the estimate onto the body
+  if (argc > 4 && std::string(argv[4]) != "identity" &&
+      !dl::load_camera_extrinsic(argv[4], config.R_body_camera,
+                                 config.t_body_camera))
+    return 1;
+  if (argc > 5) config.max_time_difference = std::stod(argv[5]);
+  if (argc > 6) {
+    config.segment_lengths.clear();
+    for (int i = 6; i < argc; i++)
+      config.segment_lengths.push_back(std::stod(argv[i]));
+  }
+
+  dl::GroundTruthLog estimate, groundtruth;
+  if (!dl::parse_gt_file(argv[1], estimate)) return 1;
+  if (!dl::parse_gt_file(groundtruth_path, groundtruth)) return 1;
+
+  ev::EvaluationReport report;
+  if (!ev::evaluate(estimate, groundtruth, config, report)) return 1;
+
+  // One key per line, so regression scripts can grep for them
+  std::cout << std::fixed << std::setprecision(6);
+  std::cout << "matched: " << report.matched << " / " << estimate.size()
+            << std::endl;
+  std::cout << "scale: " << report.alignment.scale << std::endl;
+  std::cout << "ate_rmse: " << report.ate.rmse << std::endl;
+  std::cout << "ate_mean: " << report.ate.mean << std::endl;
+  std::cout << "ate_median: " << report.ate.median << std::endl;
+  std::cout << "ate_max: " << report.ate.max << std::endl;
+  for (const ev::RelativeError& rpe : report.rpe) {
+    std::cout << "rpe_" << std::defaultfloat << rpe.segment_length
+              << std::fixed << "m_translation_rmse: " << rpe.translation.rmse
+              << std::endl;
+    std::cout << "rpe_" << std::defaultfloat << rpe.segment_length
+              << std::fixed << "m_rotation_rmse_deg: " << rpe.rotation.rmse
+              << std::endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,39 @@
+/**
+ * @file main_pack.cpp
+ * @author Apoorv Thapliyal
+ * @brief C++ source file for the packed dataset converter
+ * @version 0.1
+ * @date 2024-11-14
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <iostream>
+#include <string>
+
+#include "packed_dataset.hpp"
+
+int main(int argc, char** argv) {
+  // Usage: app_pack [dataset_dir] [output_file] [gray|color]
+  std::string dataset_path =
+      argc > 1 ? argv[1] : "indoor_forward_9_davis_with_gt";
+  std::string pack_path =
+      argc > 2 ? argv[2] : "indoor_forward_9_davis_with_gt.pack";
+  dl::ImageColor color = dl::ImageColor::kGrayscale;
+  if (argc > 3 && std::string(argv[3]) == "color")
+    color = dl::ImageColor::kColor;
+
+  if (!dl::PackedDataset::write(dataset_path, pack_path, color)) return 1;
+
+  // Report what was packed
+  dl::PackedDataset packed_dataset;
+  if (!packed_dataset.open(pack_path)) return 1;
+
+  std::cout << "Images: " << packed_dataset.image_count() << std::endl;
+  std::cout << "IMU samples: " << packed_dataset.imu_count() << std::endl;
+  std::cout << "Ground truth poses: " << packed_dataset.gt_count()
+            << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,145 @@
+/**
+ * @file main_vio.cpp
+ * @author Kshitij Aggarwal
+ * @brief C++ source file for the fused visual-inertial executable
+ * @version 0.1
+ * @date 2024-11-19
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "camera_calibration.hpp"
+#include "data_loader.hpp"
+#include "error_state_ekf.hpp"
+#include "visual_odometry.hpp"
+#include "vo_pipeline.hpp"
+
+int main(int argc, char** argv) {
+  // Set precision for displaying floating point values
+  std::cout << std::fixed << std::setprecision(6);
+
+  // The camera to IMU body rotation is required: VO measures camera motion,
+  // the filter estimates body motion. "identity" states that the frames
+  // coincide.
+  // app_vio decode_threads extract_threads dataset camera_calibration
+  if (argc < 5) {
+    std::cerr << "Usage: " << argv[0]
+              << " decode_threads extract_threads dataset"
+                 " camera_calibration|identity"
+              << std::endl;
+    return 1;
+  }
+  Eigen::Matrix3d R_body_camera = Eigen::Matrix3d::Identity();
+  if (std::string(argv[4]) != "identity" &&
+      !dl::load_camera_rotation(argv[4], R_body_camera))
+    return 1;
+
+  // Create DataLoader object
+  dl::DataLoader data_loader(argv[3]);
+  data_loader.set_image_color(dl::ImageColor::kGrayscale);
+
+  // Create VisualOdometry object
+  vo::VisualOdometry visual_odometry(Eigen::Matrix4d::Identity());
+
+  // Create the fusion filter
+  vio::ErrorStateEkf filter(Eigen::Matrix4d::Identity());
+  filter.set_camera_rotation(R_body_camera);
+
+  // Stage thread counts
+  pl::PipelineConfig config;
+  config.decode_threads = std::stoul(argv[1]);
+  config.extract_threads = std::stoul(argv[2]);
+
+  // Only process images inside the ground truth time window
+  config.start_time = data_loader.start_gt_time;
+  config.finish_time = data_loader.finish_gt_time;
+
+  const bool has_imu =
+      data_loader.get_imu_span(config.start_time, config.finish_time).size > 0;
+  if (!has_imu)
+    std::cerr << "No IMU data, the fused orientation follows visual odometry"
+                 " and the position holds"
+              << std::endl;
+
+  // The gyroscope rotation since the previous image leaves only the
+  // translation direction to RANSAC
+  visual_odometry.set_prior_ransac(has_imu);
+
+  pl::VoPipeline pipeline(data_loader, visual_odometry, config);
+
+  int counter = 0;
+  double imu_time = config.start_time;
+  Eigen::Matrix4d previous_vo_pose = Eigen::Matrix4d::Identity();
+  std::chrono::steady_clock::duration fusion_time(0);
+
+  // Propagate with the IMU samples up to the image before VO estimates it,
+  // and hand VO the predicted camera rotation
+  auto before_pose = [&](size_t index, double timestamp) {
+    auto propagation_start = std::chrono::steady_clock::now();
+
+    filter.propagate(data_loader.get_imu_span(imu_time, timestamp));
+    imu_time = timestamp;
+    if (has_imu && index > 0)
+      visual_odometry.set_rotation_prior(
+          filter.get_camera_rotation_since_clone());
+
+    fusion_time += std::chrono::steady_clock::now() - propagation_start;
+  };
+
+  auto on_pose = [&](const pl::PoseResult& result) {
+    auto fusion_start = std::chrono::steady_clock::now();
+
+    // Fuse the camera motion since the previous image. When VO could not
+    // estimate it, the unchanged pose is no measurement of standstill: only
+    // the IMU propagates, and the next motion is measured from this image.
+    if (counter == 0 || !result.motion_estimated)
+      filter.clone_pose();
+    else
+      filter.update_relative_pose(previous_vo_pose.inverse() * result.pose);
+    previous_vo_pose = result.pose;
+
+    fusion_time += std::chrono::steady_clock::now() - fusion_start;
+
+    // Get fused pose
+    Eigen::Matrix4d vio_pose = filter.get_pose();
+
+    // Convert rotation matrix to Euler angles
+    Eigen::Matrix3d R = vio_pose.block<3, 3>(0, 0);
+    Eigen::Vector3d vio_euler_angles = R.eulerAngles(0, 1, 2);
+    vio_euler_angles = vio_euler_angles * 180 / M_PI;
+
+    // Display fused data
+    std::cout << "x: " << vio_pose(0, 3) << std::endl;
+    std::cout << "y: " << vio_pose(1, 3) << std::endl;
+    std::cout << "z: " << vio_pose(2, 3) << std::endl;
+    std::cout << "roll: " << vio_euler_angles(0) << std::endl;
+    std::cout << "pitch: " << vio_euler_angles(1) << std::endl;
+    std::cout << "yaw: " << vio_euler_angles(2) << std::endl;
+    std::cout << "\n";
+
+    counter++;
+  };
+
+  pl::PipelineStats stats = pipeline.run(on_pose, before_pose);
+
+  std::cout << "Total Images: " << counter << std::endl;
+
+  // Timing goes to stderr so stdout stays a clean trajectory dump
+  std::cerr << "Throughput: " << stats.frames_per_second << " frames/s"
+            << std::endl;
+  if (counter > 0)
+    std::cerr << "Fusion: "
+              << std::chrono::duration<double, std::micro>(fusion_time)
+                         .count() /
+                     counter
+              << " us/frame" << std::endl;
+
+  return 0;
+}
@@ -12,49 +12,83 @@
 #include <cmath>
 #include <iomanip>
 #include <iostream>
+#include <memory>
+#include <string>
 
 #include "data_loader.hpp"
 #include "inertial_odometry.hpp"
+#include "trajectory_evaluation.hpp"
+#include "tracer.hpp"
 #include "visual_odometry.hpp"
+#include "vo_pipeline.hpp"
 
-int main() {
+int main(int argc, char** argv) {
   // Set precision for displaying floating point values
   std::cout << std::fixed << std::setprecision(6);
 
-  // Create DataLoader object
-  dl::DataLoader data_loader("indoor_forward_9_davis_with_gt");
+  // Keyframe selection is opt-in and may be given anywhere on the command
+  // line; the remaining arguments are positional
+  bool keyframe_selection = false;
+  int positional = 1;
+  for (int i = 1; i < argc; i++) {
+    if (std::string(argv[i]) == "--keyframes")
+      keyframe_selection = true;
+    else
+      argv[positional++] = argv[i];
+  }
+  argc = positional;
+
+  // Create DataLoader object, from a packed dataset if one is given:
+  // app_vo [--keyframes] [decode_threads] [extract_threads] [dataset]
+  //        [vocabulary] [trajectory] [trace]
+  dl::DataLoader data_loader(argc > 3 ? argv[3]
+                                      : "indoor_forward_9_davis_with_gt");
+
+  // ORB works on intensity only, so skip the color conversion
+  data_loader.set_image_color(dl::ImageColor::kGrayscale);
 
   // Create VisualOdometry object
   vo::VisualOdometry visual_odometry(Eigen::Matrix4d::Identity());
 
-  int counter = 0;
+  // Only estimate the motion once the camera moved enough, the frames in
+  // between are just tracked
+  if (keyframe_selection) visual_odometry.set_keyframe_selection(true);
 
-  // Display VO data
-  while (true) {
-    // Get Image data
-    auto image_data = data_loader.get_image_data();
+  // Close loops against the keyframes seen so far when a vocabulary trained
+  // with app_vocabulary is given
+  if (argc > 4 && std::string(argv[4]) != "-") {
+    auto vocabulary = std::make_shared<lc::Vocabulary>();
+    if (vocabulary->load(argv[4]))
+      visual_odometry.set_loop_closure(true, vocabulary);
+  }
 
-    // Check if end of file is reached
-    if (std::get<0>(image_data) == -1.0) break;
+  // Stage thread counts. Images are decoded by the loader's prefetcher, which
+  // the pipeline reads through read_image, so its decode stage only passes
+  // them on.
+  pl::PipelineConfig config;
+  const size_t decode_threads = argc > 1 ? std::stoul(argv[1]) : 1;
+  if (argc > 2) config.extract_threads = std::stoul(argv[2]);
 
-    // Get data timestamp
-    double timestamp = std::get<0>(image_data);
+  // Only process images inside the ground truth time window, the earlier
+  // ones are not even decoded
+  config.start_time = data_loader.start_gt_time;
+  config.finish_time = data_loader.finish_gt_time;
+  data_loader.set_image_start_time(config.start_time);
+  data_loader.enable_prefetch(config.queue_capacity, decode_threads);
 
-    // If timestamp is less than start time, continue
-    if (timestamp < data_loader.start_gt_time) continue;
-    // If timestamp is greater than finish time, break
-    else if (timestamp > data_loader.finish_gt_time)
-      break;
+  pl::VoPipeline pipeline(data_loader, visual_odometry, config);
 
-    // Extract Image data
-    cv::Mat image = std::get<1>(image_data);
-    std::string image_path = std::get<2>(image_data);
+  int counter = 0;
+  int keyframes = 0;
 
-    // Update pose using Visual Odometry
-    visual_odometry.update_pose(image);
+  // Poses to write for app_eval, skipped when the path is "-"
+  dl::GroundTruthLog trajectory;
+  const bool save_trajectory = argc > 5 && std::string(argv[5]) != "-";
 
+  // Display VO data
+  pl::PipelineStats stats = pipeline.run([&](const pl::PoseResult& result) {
     // Get VO pose
-    Eigen::Matrix4d vo_pose = visual_odometry.get_pose();
+    const Eigen::Matrix4d& vo_pose = result.pose;
 
     // Extract orientation from pose
     Eigen::Matrix3d R = vo_pose.block<3, 3>(0, 0);
@@ -74,9 +108,30 @@ int main() {
     std::cout << "\n";
 
     counter++;
-  }
+    if (result.keyframe) keyframes++;
+    if (save_trajectory) ev::append_pose(trajectory, result.timestamp, vo_pose);
+  });
 
   std::cout << "Total Images: " << counter << std::endl;
+  if (save_trajectory && !ev::write_trajectory(argv[5], trajectory)) return 1;
+
+  // Throughput goes to stderr so stdout stays a clean trajectory dump
+  std::cerr << "Throughput: " << stats.frames_per_second << " frames/s"
+            << std::endl;
+  if (keyframe_selection)
+    std::cerr << "Keyframes: " << keyframes << std::endl;
+  std::cerr << "Loops: " << visual_odometry.get_loop_closure().get_loop_count()
+            << std::endl;
+
+  // Per-stage latencies, only recorded when built with -D ENABLE_TRACING=ON
+  if (pf::kTracingEnabled) {
+    pf::Tracer::instance().print_summary(std::cerr);
+    if (argc > 6 && !pf::Tracer::instance().write_chrome_trace(argv[6]))
+      return 1;
+  } else if (argc > 6) {
+    std::cerr << "Built without tracing, no trace written to " << argv[6]
+              << std::endl;
+  }
 
   return 0;
 }
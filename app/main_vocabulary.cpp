@@ -0,0 +1,55 @@
+/**
+ * @file main_vocabulary.cpp
+ * @author Apoorv Thapliyal
+ * @brief C++ source file for the loop closure vocabulary trainer
+ * @version 0.1
+ * @date 2024-11-24
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "data_loader.hpp"
+#include "visual_odometry.hpp"
+#include "vocabulary.hpp"
+
+int main(int argc, char** argv) {
+  // Usage: app_vocabulary [dataset] [output_file] [image_stride]
+  dl::DataLoader data_loader(argc > 1 ? argv[1]
+                                      : "indoor_forward_9_davis_with_gt");
+  std::string vocabulary_path = argc > 2 ? argv[2] : "vocabulary.bin";
+  const int stride = argc > 3 ? std::max(std::stoi(argv[3]), 1) : 10;
+
+  data_loader.set_image_color(dl::ImageColor::kGrayscale);
+
+  // Describe the images the way the odometry will
+  vo::VisualOdometry visual_odometry(Eigen::Matrix4d::Identity());
+  cv::Ptr<cv::ORB> detector = visual_odometry.create_feature_detector();
+  vo::FrameFeatures features;
+
+  std::vector<cv::Mat> descriptors;
+  double timestamp;
+  std::string image_path;
+  for (int index = 0; data_loader.read_image_entry(timestamp, image_path);
+       index++) {
+    if (index % stride != 0) continue;
+    cv::Mat image = data_loader.load_image(image_path);
+    if (image.empty()) continue;
+    visual_odometry.extract_features(image, detector, features);
+    if (!features.descriptors.empty())
+      descriptors.push_back(features.descriptors.clone());
+  }
+  std::cout << "Training images: " << descriptors.size() << std::endl;
+
+  lc::Vocabulary vocabulary;
+  if (!vocabulary.train(descriptors)) return 1;
+  if (!vocabulary.save(vocabulary_path)) return 1;
+  std::cout << "Words: " << vocabulary.size() << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,120 @@
+/**
+ * @file data_loader_benchmark.cpp
+ * @author Apoorv Thapliyal
+ * @brief Benchmark of the ground truth and image reads of the DataLoader
+ * @version 0.1
+ * @date 2024-11-27
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <tuple>
+
+#include "data_loader.hpp"
+#include "synthetic_dataset.hpp"
+
+namespace {
+
+/**
+ * @brief Parsing and normalization of the dataset's ground truth (14400
+ * poses)
+ *
+ * @param state
+ */
+void BM_ParseGtData(benchmark::State& state) {
+  dl::DataLoader data_loader(bench::kDatasetPath);
+  if (data_loader.x_gt.empty()) {
+    state.SkipWithError("Dataset ground truth not found");
+    return;
+  }
+  for (auto _ : state) {
+    data_loader.parse_gt_data();
+    benchmark::DoNotOptimize(data_loader.x_gt.data());
+  }
+  state.SetItemsProcessed(state.iterations() * data_loader.x_gt.size());
+}
+BENCHMARK(BM_ParseGtData)->Unit(benchmark::kMillisecond);
+
+/**
+ * @brief Decoding of one dataset image, in color or grayscale
+ *
+ * @param state
+ */
+void BM_LoadImage(benchmark::State& state) {
+  dl::DataLoader data_loader(bench::kDatasetPath);
+  data_loader.set_image_color(state.range(0) ? dl::ImageColor::kGrayscale
+                                             : dl::ImageColor::kColor);
+  const std::string path = "img/image_0_1101.png";
+  cv::Mat image;
+  if (!data_loader.load_image(path, image)) {
+    state.SkipWithError("Dataset images not found");
+    return;
+  }
+  for (auto _ : state) {
+    data_loader.load_image(path, image);
+    benchmark::DoNotOptimize(image.data);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LoadImage)->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+
+/**
+ * @brief Reads of a 200 frame image list through get_image_data, which
+ * returns a freshly decoded image per call
+ *
+ * @param state
+ */
+void BM_GetImageData(benchmark::State& state) {
+  const size_t frames = 200;
+  if (!bench::write_synthetic_dataset(frames, 1)) {
+    state.SkipWithError("Dataset images not found");
+    return;
+  }
+  for (auto _ : state) {
+    state.PauseTiming();
+    dl::DataLoader data_loader(bench::kSyntheticPath);
+    data_loader.set_image_color(state.range(0) ? dl::ImageColor::kGrayscale
+                                               : dl::ImageColor::kColor);
+    state.ResumeTiming();
+    while (std::get<0>(data_loader.get_image_data()) != -1.0) {
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * frames);
+  bench::remove_synthetic_dataset();
+}
+BENCHMARK(BM_GetImageData)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+/**
+ * @brief Reads of the same image list through read_image, which decodes
+ * into the buffer of a reused frame
+ *
+ * @param state
+ */
+void BM_ReadImage(benchmark::State& state) {
+  const size_t frames = 200;
+  if (!bench::write_synthetic_dataset(frames, 1)) {
+    state.SkipWithError("Dataset images not found");
+    return;
+  }
+  for (auto _ : state) {
+    state.PauseTiming();
+    dl::DataLoader data_loader(bench::kSyntheticPath);
+    data_loader.set_image_color(dl::ImageColor::kGrayscale);
+    dl::ImageFrame frame;
+    state.ResumeTiming();
+    while (data_loader.read_image(frame))
+      benchmark::DoNotOptimize(frame.image.data);
+  }
+  state.SetItemsProcessed(state.iterations() * frames);
+  bench::remove_synthetic_dataset();
+}
+BENCHMARK(BM_ReadImage)->Unit(benchmark::kMillisecond);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,163 @@
+/**
+ * @file end_to_end_benchmark.cpp
+ * @author Apoorv Thapliyal
+ * @brief End-to-end throughput of the odometry front-ends, in frames and IMU
+ * samples per second
+ * @version 0.1
+ * @date 2024-11-27
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <eigen3/Eigen/Dense>
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+#include "data_loader.hpp"
+#include "error_state_ekf.hpp"
+#include "inertial_odometry.hpp"
+#include "synthetic_dataset.hpp"
+#include "visual_odometry.hpp"
+#include "vo_pipeline.hpp"
+
+namespace {
+
+/**
+ * @brief Number of frames of a run, 5 seconds at 40 Hz
+ *
+ */
+const size_t kFrames = 200;
+
+/**
+ * @brief Number of IMU samples of a run, 5 seconds at 500 Hz
+ *
+ */
+const size_t kImuSamples = 2500;
+
+/**
+ * @brief Visual-inertial run as app_vio does it: the pipeline reads,
+ * undistorts and matches the frames, and the filter propagates the IMU
+ * samples up to every frame, hands VO the rotation prior and fuses the
+ * estimated motion. The argument is the number of extraction threads.
+ *
+ * @param state
+ */
+void BM_VioEndToEnd(benchmark::State& state) {
+  if (!bench::write_synthetic_dataset(kFrames, kImuSamples)) {
+    state.SkipWithError("Dataset images not found");
+    return;
+  }
+  size_t frames = 0, imu_samples = 0;
+  for (auto _ : state) {
+    state.PauseTiming();
+    dl::DataLoader data_loader(bench::kSyntheticPath);
+    data_loader.set_image_color(dl::ImageColor::kGrayscale);
+    vo::VisualOdometry visual_odometry(Eigen::Matrix4d::Identity());
+    visual_odometry.set_prior_ransac(true);
+    vio::ErrorStateEkf filter(Eigen::Matrix4d::Identity());
+    pl::PipelineConfig config;
+    config.extract_threads = state.range(0);
+    pl::VoPipeline pipeline(data_loader, visual_odometry, config);
+    double imu_time = data_loader.start_gt_time;
+    Eigen::Matrix4d previous_vo_pose = Eigen::Matrix4d::Identity();
+    state.ResumeTiming();
+
+    auto before_pose = [&](size_t index, double timestamp) {
+      io::ImuSpan samples = data_loader.get_imu_span(imu_time, timestamp);
+      filter.propagate(samples);
+      imu_samples += samples.size;
+      imu_time = timestamp;
+      if (index > 0)
+        visual_odometry.set_rotation_prior(
+            filter.get_camera_rotation_since_clone());
+    };
+
+    pipeline.run(
+        [&](const pl::PoseResult& result) {
+          if (result.index == 0 || !result.motion_estimated)
+            filter.clone_pose();
+          else
+            filter.update_relative_pose(previous_vo_pose.inverse() *
+                                        result.pose);
+          previous_vo_pose = result.pose;
+          frames++;
+        },
+        before_pose);
+  }
+  state.counters["frames_per_second"] =
+      benchmark::Counter(frames, benchmark::Counter::kIsRate);
+  state.counters["imu_samples_per_second"] =
+      benchmark::Counter(imu_samples, benchmark::Counter::kIsRate);
+  bench::remove_synthetic_dataset();
+}
+BENCHMARK(BM_VioEndToEnd)
+    ->Arg(1)
+    ->Arg(2)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+/**
+ * @brief Visual odometry alone, one update_pose call per decoded frame
+ *
+ * @param state
+ */
+void BM_VoSerial(benchmark::State& state) {
+  if (!bench::write_synthetic_dataset(kFrames, 1)) {
+    state.SkipWithError("Dataset images not found");
+    return;
+  }
+  std::vector<cv::Mat> images;
+  std::vector<double> timestamps;
+  dl::DataLoader data_loader(bench::kSyntheticPath);
+  data_loader.set_image_color(dl::ImageColor::kGrayscale);
+  dl::ImageFrame frame;
+  while (data_loader.read_image(frame)) {
+    images.push_back(frame.image.clone());
+    timestamps.push_back(frame.timestamp);
+  }
+  bench::remove_synthetic_dataset();
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    vo::VisualOdometry visual_odometry(Eigen::Matrix4d::Identity());
+    state.ResumeTiming();
+    for (size_t i = 0; i < images.size(); i++)
+      visual_odometry.update_pose(images[i], timestamps[i]);
+    benchmark::DoNotOptimize(visual_odometry.get_pose());
+  }
+  state.counters["frames_per_second"] = benchmark::Counter(
+      state.iterations() * images.size(), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_VoSerial)->Unit(benchmark::kMillisecond);
+
+/**
+ * @brief Inertial odometry over every sample of the ground truth window, as
+ * app_io integrates it
+ *
+ * @param state
+ */
+void BM_ImuOdometry(benchmark::State& state) {
+  const size_t count = state.range(0);
+  if (!bench::write_synthetic_dataset(1, count)) {
+    state.SkipWithError("Dataset images not found");
+    return;
+  }
+  dl::DataLoader data_loader(bench::kSyntheticPath);
+  const io::ImuSpan samples = data_loader.get_imu_span(
+      data_loader.start_gt_time, data_loader.finish_gt_time);
+  for (auto _ : state) {
+    io::InertialOdometry odometry(Eigen::Matrix4d::Identity());
+    benchmark::DoNotOptimize(odometry.integrate(samples));
+  }
+  state.counters["imu_samples_per_second"] = benchmark::Counter(
+      state.iterations() * samples.size, benchmark::Counter::kIsRate);
+  bench::remove_synthetic_dataset();
+}
+BENCHMARK(BM_ImuOdometry)->Arg(100000)->Unit(benchmark::kMillisecond);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,198 @@
+/**
+ * @file inertial_benchmark.cpp
+ * @author Apoorv Thapliyal
+ * @brief Benchmark of the inertial odometry propagation and the IMU reads of
+ * the DataLoader
+ * @version 0.1
+ * @date 2024-11-27
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <eigen3/Eigen/Dense>
+#include <random>
+#include <tuple>
+#include <vector>
+
+#include "data_loader.hpp"
+#include "inertial_odometry.hpp"
+#include "synthetic_dataset.hpp"
+
+namespace {
+
+/**
+ * @brief Column-wise IMU samples around gravity, owning the arrays an
+ * io::ImuSpan points to
+ *
+ */
+struct ImuSamples {
+  std::vector<double> timestamp, gyro_x, gyro_y, gyro_z, accel_x, accel_y,
+      accel_z;
+
+  /**
+   * @brief Construct a new ImuSamples object with samples at 500 Hz
+   *
+   * @param count: number of samples
+   */
+  explicit ImuSamples(size_t count) {
+    std::mt19937 generator(42);
+    std::normal_distribution<double> noise(0.0, 0.05);
+    for (size_t i = 0; i < count; i++) {
+      timestamp.push_back(i * 0.002);
+      gyro_x.push_back(noise(generator));
+      gyro_y.push_back(noise(generator));
+      gyro_z.push_back(noise(generator));
+      accel_x.push_back(noise(generator));
+      accel_y.push_back(noise(generator));
+      accel_z.push_back(9.81 + noise(generator));
+    }
+  }
+
+  /**
+   * @brief Function to get a view of all samples
+   *
+   * @return io::ImuSpan
+   */
+  io::ImuSpan span() const {
+    io::ImuSpan samples;
+    samples.timestamp = timestamp.data();
+    samples.gyro_x = gyro_x.data();
+    samples.gyro_y = gyro_y.data();
+    samples.gyro_z = gyro_z.data();
+    samples.accel_x = accel_x.data();
+    samples.accel_y = accel_y.data();
+    samples.accel_z = accel_z.data();
+    samples.size = timestamp.size();
+    return samples;
+  }
+};
+
+/**
+ * @brief Rotation matrix of one gyroscope sample
+ *
+ * @param state
+ */
+void BM_RodriguesFormula(benchmark::State& state) {
+  io::InertialOdometry odometry(Eigen::Matrix4d::Identity());
+  Eigen::Vector3d w(0.01, -0.02, 0.03);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(w);
+    Eigen::Matrix3d R = odometry.rodrigues_formula(w);
+    benchmark::DoNotOptimize(R);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_RodriguesFormula);
+
+/**
+ * @brief Pose update at the nominal sampling time, one sample per call
+ *
+ * @param state
+ */
+void BM_UpdatePose(benchmark::State& state) {
+  const ImuSamples samples(state.range(0));
+  for (auto _ : state) {
+    io::InertialOdometry odometry(Eigen::Matrix4d::Identity());
+    for (size_t i = 0; i < samples.timestamp.size(); i++)
+      odometry.update_pose(
+          Eigen::Vector3d(samples.accel_x[i], samples.accel_y[i],
+                          samples.accel_z[i]),
+          Eigen::Vector3d(samples.gyro_x[i], samples.gyro_y[i],
+                          samples.gyro_z[i]));
+    benchmark::DoNotOptimize(odometry.get_pose());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_UpdatePose)->Arg(10000)->Unit(benchmark::kMicrosecond);
+
+/**
+ * @brief Pose update with the sampling time taken from the timestamps
+ *
+ * @param state
+ */
+void BM_UpdatePoseTimestamped(benchmark::State& state) {
+  const ImuSamples samples(state.range(0));
+  for (auto _ : state) {
+    io::InertialOdometry odometry(Eigen::Matrix4d::Identity());
+    for (size_t i = 0; i < samples.timestamp.size(); i++)
+      odometry.update_pose(
+          samples.timestamp[i],
+          Eigen::Vector3d(samples.accel_x[i], samples.accel_y[i],
+                          samples.accel_z[i]),
+          Eigen::Vector3d(samples.gyro_x[i], samples.gyro_y[i],
+                          samples.gyro_z[i]));
+    benchmark::DoNotOptimize(odometry.get_pose());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_UpdatePoseTimestamped)->Arg(10000)->Unit(benchmark::kMicrosecond);
+
+/**
+ * @brief Integration of a whole block of samples in one call
+ *
+ * @param state
+ */
+void BM_IntegrateBlock(benchmark::State& state) {
+  const ImuSamples samples(state.range(0));
+  const io::ImuSpan span = samples.span();
+  for (auto _ : state) {
+    io::InertialOdometry odometry(Eigen::Matrix4d::Identity());
+    benchmark::DoNotOptimize(odometry.integrate(span));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_IntegrateBlock)->Arg(10000)->Unit(benchmark::kMicrosecond);
+
+/**
+ * @brief Sample by sample reads of the IMU log through get_imu_data. The
+ * loader is built outside the timed region, so only the reads are measured.
+ *
+ * @param state
+ */
+void BM_GetImuData(benchmark::State& state) {
+  const size_t count = state.range(0);
+  if (!bench::write_synthetic_dataset(1, count)) {
+    state.SkipWithError("Dataset images not found");
+    return;
+  }
+  for (auto _ : state) {
+    state.PauseTiming();
+    dl::DataLoader data_loader(bench::kSyntheticPath);
+    state.ResumeTiming();
+    for (size_t i = 0; i < count; i++)
+      benchmark::DoNotOptimize(data_loader.get_imu_data());
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+  bench::remove_synthetic_dataset();
+}
+BENCHMARK(BM_GetImuData)->Arg(100000)->Unit(benchmark::kMillisecond);
+
+/**
+ * @brief Block reads of the IMU log through get_imu_block
+ *
+ * @param state
+ */
+void BM_GetImuBlock(benchmark::State& state) {
+  const size_t count = 100000;
+  if (!bench::write_synthetic_dataset(1, count)) {
+    state.SkipWithError("Dataset images not found");
+    return;
+  }
+  for (auto _ : state) {
+    state.PauseTiming();
+    dl::DataLoader data_loader(bench::kSyntheticPath);
+    state.ResumeTiming();
+    while (data_loader.get_imu_block(state.range(0)).size > 0) {
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+  bench::remove_synthetic_dataset();
+}
+BENCHMARK(BM_GetImuBlock)->Arg(10)->Arg(200)->Unit(benchmark::kMicrosecond);
+
+}  // namespace
+
+BENCHMARK_MAIN();
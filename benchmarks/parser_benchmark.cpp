@@ -0,0 +1,115 @@
+/**
+ * @file parser_benchmark.cpp
+ * @author Apoorv Thapliyal
+ * @brief Benchmark of the IMU and ground truth text parsers
+ * @version 0.1
+ * @date 2024-11-15
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "text_parser.hpp"
+
+namespace {
+
+/**
+ * @brief Synthetic IMU log, shaped like the dataset's imu.txt
+ *
+ */
+const char* kImuPath = "bench_imu.txt";
+
+/**
+ * @brief Function to write a synthetic IMU log
+ *
+ * @param lines: number of samples
+ */
+void write_imu_file(size_t lines) {
+  std::ofstream file(kImuPath);
+  file << "# id timestamp ang_vel_x ang_vel_y ang_vel_z lin_acc_x lin_acc_y "
+          "lin_acc_z\n";
+  file << std::fixed << std::setprecision(12);
+
+  std::mt19937 generator(42);
+  std::normal_distribution<double> noise(0.0, 1.0);
+  for (size_t i = 0; i < lines; i++) {
+    file << i << " " << 1540822844.0 + i * 0.002;
+    for (int c = 0; c < 6; c++) file << " " << noise(generator);
+    file << "\n";
+  }
+}
+
+/**
+ * @brief Baseline: the line-by-line istringstream parser the DataLoader used
+ *
+ * @param state
+ */
+void BM_ImuIstringstream(benchmark::State& state) {
+  write_imu_file(state.range(0));
+  for (auto _ : state) {
+    std::ifstream file(kImuPath);
+    std::vector<long double> timestamps, values;
+    std::string line;
+    std::getline(file, line);
+    while (std::getline(file, line)) {
+      std::istringstream iss(line);
+      long double id, timestamp, wx, wy, wz, ax, ay, az;
+      if (iss >> id >> timestamp >> wx >> wy >> wz >> ax >> ay >> az) {
+        timestamps.push_back(timestamp);
+        values.push_back(az);
+      }
+    }
+    benchmark::DoNotOptimize(timestamps.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  std::remove(kImuPath);
+}
+BENCHMARK(BM_ImuIstringstream)->Arg(100000)->Unit(benchmark::kMillisecond);
+
+/**
+ * @brief Memory-mapped parser filling preallocated columns
+ *
+ * @param state
+ */
+void BM_ImuMappedParser(benchmark::State& state) {
+  write_imu_file(state.range(0));
+  dl::ImuLog log;
+  for (auto _ : state) {
+    dl::parse_imu_file(kImuPath, log);
+    benchmark::DoNotOptimize(log.timestamp.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  std::remove(kImuPath);
+}
+BENCHMARK(BM_ImuMappedParser)->Arg(100000)->Unit(benchmark::kMillisecond);
+
+/**
+ * @brief Number scanning alone, on a dataset-like timestamp
+ *
+ * @param state
+ */
+void BM_ParseNumber(benchmark::State& state) {
+  const std::string text = "1540822844.517587661743";
+  for (auto _ : state) {
+    const char* cursor = text.data();
+    double value;
+    dl::parse_number(cursor, text.data() + text.size(), value);
+    benchmark::DoNotOptimize(value);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ParseNumber);
+
+}  // namespace
+
+BENCHMARK_MAIN();
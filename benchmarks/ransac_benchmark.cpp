@@ -0,0 +1,150 @@
+/**
+ * @file ransac_benchmark.cpp
+ * @author Apoorv Thapliyal
+ * @brief Benchmark of the OpenCV and in-house five-point RANSAC on matches
+ * from the dataset
+ * @version 0.1
+ * @date 2024-11-21
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <eigen3/Eigen/Core>
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+
+#include "five_point_ransac.hpp"
+
+namespace {
+
+/**
+ * @brief Matches between two dataset frames, in pixels and normalized
+ * coordinates
+ *
+ */
+struct Matches {
+  std::vector<cv::Point2f> pixels_prev, pixels_curr;
+  std::vector<Eigen::Vector3d> normalized_prev, normalized_curr;
+  cv::Mat camera_intrinsics;
+};
+
+/**
+ * @brief Function to extract ORB matches between two frames of the dataset,
+ * computed once and shared by all benchmarks
+ *
+ * @return const Matches&: empty when the dataset is missing
+ */
+const Matches& dataset_matches() {
+  static Matches matches = [] {
+    Matches result;
+    // Same intrinsics as the VisualOdometry class (taken from dataset)
+    result.camera_intrinsics =
+        (cv::Mat_<double>(3, 3) << 172.98992850734132, 0, 163.33639726024606,
+         0, 172.98303181090185, 134.99537889030861, 0, 0, 1);
+
+    const std::string path = "../../indoor_forward_9_davis_with_gt/img/";
+    cv::Mat image_prev =
+        cv::imread(path + "image_0_1101.png", cv::IMREAD_GRAYSCALE);
+    cv::Mat image_curr =
+        cv::imread(path + "image_0_1104.png", cv::IMREAD_GRAYSCALE);
+    if (image_prev.empty() || image_curr.empty()) return result;
+
+    cv::Ptr<cv::ORB> orb = cv::ORB::create(2000);
+    std::vector<cv::KeyPoint> keypoints_prev, keypoints_curr;
+    cv::Mat descriptors_prev, descriptors_curr;
+    orb->detectAndCompute(image_prev, cv::noArray(), keypoints_prev,
+                          descriptors_prev);
+    orb->detectAndCompute(image_curr, cv::noArray(), keypoints_curr,
+                          descriptors_curr);
+
+    // Lowe's ratio test, as in the VisualOdometry class
+    cv::BFMatcher matcher(cv::NORM_HAMMING);
+    std::vector<std::vector<cv::DMatch>> knn_matches;
+    matcher.knnMatch(descriptors_prev, descriptors_curr, knn_matches, 2);
+
+    const double fx = result.camera_intrinsics.at<double>(0, 0);
+    const double fy = result.camera_intrinsics.at<double>(1, 1);
+    const double cx = result.camera_intrinsics.at<double>(0, 2);
+    const double cy = result.camera_intrinsics.at<double>(1, 2);
+    for (const auto& knn : knn_matches) {
+      if (knn.size() < 2 || knn[0].distance >= 0.78 * knn[1].distance)
+        continue;
+      const cv::Point2f& p = keypoints_prev[knn[0].queryIdx].pt;
+      const cv::Point2f& c = keypoints_curr[knn[0].trainIdx].pt;
+      result.pixels_prev.push_back(p);
+      result.pixels_curr.push_back(c);
+      result.normalized_prev.emplace_back((p.x - cx) / fx, (p.y - cy) / fy,
+                                          1.0);
+      result.normalized_curr.emplace_back((c.x - cx) / fx, (c.y - cy) / fy,
+                                          1.0);
+    }
+    return result;
+  }();
+  return matches;
+}
+
+/**
+ * @brief Baseline: OpenCV's findEssentialMat followed by recoverPose
+ *
+ * @param state
+ */
+void BM_OpenCvEssential(benchmark::State& state) {
+  const Matches& matches = dataset_matches();
+  if (matches.pixels_curr.size() < 5) {
+    state.SkipWithError("Dataset images not found");
+    return;
+  }
+
+  for (auto _ : state) {
+    cv::Mat mask;
+    cv::Mat E = cv::findEssentialMat(
+        matches.pixels_curr, matches.pixels_prev, matches.camera_intrinsics,
+        cv::RANSAC, 0.999, 1.0, mask);
+    cv::Mat R, t;
+    cv::recoverPose(E, matches.pixels_curr, matches.pixels_prev,
+                    matches.camera_intrinsics, R, t, mask);
+    benchmark::DoNotOptimize(R.data);
+  }
+  state.SetItemsProcessed(state.iterations() * matches.pixels_curr.size());
+}
+BENCHMARK(BM_OpenCvEssential)->Unit(benchmark::kMillisecond);
+
+/**
+ * @brief In-house five-point RANSAC and pose recovery, with the SPRT early
+ * rejection on (1) or off (0)
+ *
+ * @param state
+ */
+void BM_FivePointRansac(benchmark::State& state) {
+  const Matches& matches = dataset_matches();
+  if (matches.normalized_curr.size() < 5) {
+    state.SkipWithError("Dataset images not found");
+    return;
+  }
+
+  vo::FivePointRansac ransac;
+  ransac.set_sprt(state.range(0) != 0);
+  const double threshold = 1.0 / matches.camera_intrinsics.at<double>(0, 0);
+  for (auto _ : state) {
+    Eigen::Matrix3d E, R;
+    Eigen::Vector3d t;
+    std::vector<unsigned char> mask;
+    if (ransac.estimate(matches.normalized_prev, matches.normalized_curr,
+                        threshold, E, mask) > 0)
+      vo::FivePointRansac::recover_pose(E, matches.normalized_prev,
+                                        matches.normalized_curr, mask, R, t);
+    benchmark::DoNotOptimize(R.data());
+  }
+  state.counters["hypotheses"] = ransac.get_last_iterations();
+  state.counters["rejected"] = ransac.get_last_rejected();
+  state.SetItemsProcessed(state.iterations() * matches.normalized_curr.size());
+}
+BENCHMARK(BM_FivePointRansac)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,117 @@
+/**
+ * @file synthetic_dataset.hpp
+ * @author Apoorv Thapliyal
+ * @brief Synthetic dataset shared by the benchmarks
+ * @version 0.1
+ * @date 2024-11-27
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <limits.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <string>
+
+namespace bench {
+
+/**
+ * @brief Dataset bundled with the repository, relative to build/benchmarks
+ *
+ */
+const char* const kDatasetPath = "../../indoor_forward_9_davis_with_gt";
+
+/**
+ * @brief Directory of the synthetic dataset, in the working directory
+ *
+ */
+const char* const kSyntheticPath = "bench_dataset";
+
+/**
+ * @brief Frames bundled with the repository, replayed in a loop by the
+ * synthetic image list
+ *
+ */
+const int kBundledFrames[] = {1101, 1102, 1103, 1104, 1105};
+
+/**
+ * @brief Function to write a dataset in the layout of the bundled one: a
+ * 500 Hz IMU log, a 200 Hz ground truth, and an image list at 40 Hz cycling
+ * through the bundled frames. The frames are reached through a symbolic link
+ * to the bundled image directory.
+ *
+ * @param frames: number of images in the list
+ * @param imu_samples: number of IMU samples
+ * @return true if the bundled images were found
+ */
+inline bool write_synthetic_dataset(size_t frames, size_t imu_samples) {
+  char image_directory[PATH_MAX];
+  if (!realpath((std::string(kDatasetPath) + "/img").c_str(),
+                image_directory))
+    return false;
+
+  const std::string root = kSyntheticPath;
+  mkdir(root.c_str(), 0755);
+  unlink((root + "/img").c_str());
+  if (symlink(image_directory, (root + "/img").c_str()) != 0) return false;
+
+  const double start = 1540822844.0;
+  std::mt19937 generator(42);
+  std::normal_distribution<double> noise(0.0, 0.05);
+
+  std::ofstream imu_file(root + "/imu.txt");
+  imu_file << "# id timestamp ang_vel_x ang_vel_y ang_vel_z lin_acc_x "
+              "lin_acc_y lin_acc_z\n"
+           << std::fixed << std::setprecision(9);
+  for (size_t i = 0; i < imu_samples; i++) {
+    imu_file << i << " " << start + i * 0.002;
+    for (int c = 0; c < 5; c++) imu_file << " " << noise(generator);
+    imu_file << " " << 9.81 + noise(generator) << "\n";
+  }
+
+  // The ground truth spans the IMU log and the image list
+  const double duration = std::max(imu_samples * 0.002, frames * 0.025);
+  std::ofstream gt_file(root + "/groundtruth.txt");
+  gt_file << "# timestamp tx ty tz qx qy qz qw\n"
+          << std::fixed << std::setprecision(9);
+  for (size_t i = 0; i * 0.005 <= duration; i++) {
+    const double angle = 0.1 * i * 0.005;
+    gt_file << start + i * 0.005 << " " << std::cos(angle) << " "
+            << std::sin(angle) << " 1 0 0 " << std::sin(0.5 * angle) << " "
+            << std::cos(0.5 * angle) << "\n";
+  }
+
+  std::ofstream image_file(root + "/images.txt");
+  image_file << "# id timestamp image_name\n" << std::fixed
+             << std::setprecision(9);
+  const size_t bundled = sizeof(kBundledFrames) / sizeof(kBundledFrames[0]);
+  for (size_t i = 0; i < frames; i++)
+    image_file << i << " " << start + i * 0.025 << " img/image_0_"
+               << kBundledFrames[i % bundled] << ".png\n";
+  return true;
+}
+
+/**
+ * @brief Function to remove the synthetic dataset
+ *
+ */
+inline void remove_synthetic_dataset() {
+  const std::string root = kSyntheticPath;
+  for (const char* file :
+       {"/img", "/imu.txt", "/groundtruth.txt", "/images.txt"})
+    std::remove((root + file).c_str());
+  rmdir(root.c_str());
+}
+
+}  // namespace bench
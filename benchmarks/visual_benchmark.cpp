@@ -0,0 +1,225 @@
+/**
+ * @file visual_benchmark.cpp
+ * @author Apoorv Thapliyal
+ * @brief Benchmark of the undistortion, feature extraction and descriptor
+ * matching stages of the visual odometry on frames of the dataset
+ * @version 0.1
+ * @date 2024-11-27
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <eigen3/Eigen/Dense>
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+
+#include "binary_matcher.hpp"
+#include "synthetic_dataset.hpp"
+#include "undistort_map_cache.hpp"
+#include "visual_odometry.hpp"
+
+namespace {
+
+/**
+ * @brief Camera of the dataset and two of its frames, loaded once and shared
+ * by all benchmarks
+ *
+ */
+struct Frames {
+  cv::Mat camera_intrinsics, distortion_coefficients, new_camera_matrix;
+  cv::Mat image_prev, image_curr;
+  std::vector<cv::KeyPoint> keypoints_prev, keypoints_curr;
+  cv::Mat descriptors_prev, descriptors_curr;
+};
+
+/**
+ * @brief Function to load the frames, with the camera of the VisualOdometry
+ * class (taken from dataset)
+ *
+ * @return const Frames&: images are empty when the dataset is missing
+ */
+const Frames& dataset_frames() {
+  static Frames frames = [] {
+    Frames result;
+    result.camera_intrinsics =
+        (cv::Mat_<double>(3, 3) << 172.98992850734132, 0, 163.33639726024606,
+         0, 172.98303181090185, 134.99537889030861, 0, 0, 1);
+    result.distortion_coefficients =
+        (cv::Mat_<double>(1, 4) << -0.027576733308582076,
+         -0.006593578674675004, 0.0008566938165177085,
+         -0.00030899587045247486);
+    const cv::Size size(346, 260);
+    result.new_camera_matrix = cv::getOptimalNewCameraMatrix(
+        result.camera_intrinsics, result.distortion_coefficients, size, 1,
+        size, 0);
+
+    const std::string path = std::string(bench::kDatasetPath) + "/img/";
+    result.image_prev =
+        cv::imread(path + "image_0_1101.png", cv::IMREAD_GRAYSCALE);
+    result.image_curr =
+        cv::imread(path + "image_0_1104.png", cv::IMREAD_GRAYSCALE);
+    if (result.image_prev.empty() || result.image_curr.empty()) return result;
+
+    cv::Ptr<cv::ORB> orb = cv::ORB::create(2000);
+    orb->detectAndCompute(result.image_prev, cv::noArray(),
+                          result.keypoints_prev, result.descriptors_prev);
+    orb->detectAndCompute(result.image_curr, cv::noArray(),
+                          result.keypoints_curr, result.descriptors_curr);
+    return result;
+  }();
+  return frames;
+}
+
+/**
+ * @brief Remap of a whole frame with the cached fixed-point maps
+ *
+ * @param state
+ */
+void BM_UndistortImage(benchmark::State& state) {
+  const Frames& frames = dataset_frames();
+  if (frames.image_prev.empty()) {
+    state.SkipWithError("Dataset images not found");
+    return;
+  }
+  std::shared_ptr<const vo::UndistortMaps> maps =
+      vo::UndistortMapCache::instance().get(
+          frames.camera_intrinsics, frames.distortion_coefficients,
+          frames.new_camera_matrix, frames.image_prev.size());
+  cv::Mat undistorted;
+  for (auto _ : state) {
+    cv::remap(frames.image_prev, undistorted, maps->map1, maps->map2,
+              cv::INTER_LINEAR);
+    benchmark::DoNotOptimize(undistorted.data);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_UndistortImage)->Unit(benchmark::kMicrosecond);
+
+/**
+ * @brief Undistortion of the keypoints of a frame only
+ *
+ * @param state
+ */
+void BM_UndistortKeypoints(benchmark::State& state) {
+  const Frames& frames = dataset_frames();
+  if (frames.image_prev.empty()) {
+    state.SkipWithError("Dataset images not found");
+    return;
+  }
+  std::vector<cv::Point2f> points, undistorted;
+  cv::KeyPoint::convert(frames.keypoints_prev, points);
+  for (auto _ : state) {
+    cv::undistortPoints(points, undistorted, frames.camera_intrinsics,
+                        frames.distortion_coefficients, cv::noArray(),
+                        frames.new_camera_matrix);
+    benchmark::DoNotOptimize(undistorted.data());
+  }
+  state.SetItemsProcessed(state.iterations() * points.size());
+}
+BENCHMARK(BM_UndistortKeypoints)->Unit(benchmark::kMicrosecond);
+
+/**
+ * @brief ORB detection and description on a frame, with the settings of the
+ * visual odometry
+ *
+ * @param state
+ */
+void BM_OrbExtraction(benchmark::State& state) {
+  const Frames& frames = dataset_frames();
+  if (frames.image_prev.empty()) {
+    state.SkipWithError("Dataset images not found");
+    return;
+  }
+  vo::VisualOdometry visual_odometry(Eigen::Matrix4d::Identity());
+  cv::Ptr<cv::ORB> detector = visual_odometry.create_feature_detector();
+  std::vector<cv::KeyPoint> keypoints;
+  cv::Mat descriptors;
+  for (auto _ : state) {
+    detector->detectAndCompute(frames.image_prev, cv::noArray(), keypoints,
+                               descriptors);
+    benchmark::DoNotOptimize(descriptors.data);
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.counters["keypoints"] = keypoints.size();
+}
+BENCHMARK(BM_OrbExtraction)->Unit(benchmark::kMicrosecond);
+
+/**
+ * @brief Undistortion and extraction as the visual odometry runs them, on
+ * the whole image (0) or on the keypoints only (1)
+ *
+ * @param state
+ */
+void BM_ExtractFeatures(benchmark::State& state) {
+  const Frames& frames = dataset_frames();
+  if (frames.image_prev.empty()) {
+    state.SkipWithError("Dataset images not found");
+    return;
+  }
+  vo::VisualOdometry visual_odometry(Eigen::Matrix4d::Identity());
+  visual_odometry.set_undistortion_mode(
+      state.range(0) ? vo::UndistortionMode::kSparseKeypoints
+                     : vo::UndistortionMode::kFullImage);
+  cv::Ptr<cv::ORB> detector = visual_odometry.create_feature_detector();
+  vo::FrameFeatures features;
+  for (auto _ : state) {
+    visual_odometry.extract_features(frames.image_prev, detector, features);
+    benchmark::DoNotOptimize(features.descriptors.data);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ExtractFeatures)->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+
+/**
+ * @brief Baseline: OpenCV's brute-force Hamming KNN matcher
+ *
+ * @param state
+ */
+void BM_OpenCvMatcher(benchmark::State& state) {
+  const Frames& frames = dataset_frames();
+  if (frames.image_prev.empty()) {
+    state.SkipWithError("Dataset images not found");
+    return;
+  }
+  cv::BFMatcher matcher(cv::NORM_HAMMING);
+  std::vector<std::vector<cv::DMatch>> matches;
+  for (auto _ : state) {
+    matcher.knnMatch(frames.descriptors_prev, frames.descriptors_curr,
+                     matches, 2);
+    benchmark::DoNotOptimize(matches.data());
+  }
+  state.SetItemsProcessed(state.iterations() * frames.descriptors_prev.rows);
+}
+BENCHMARK(BM_OpenCvMatcher)->Unit(benchmark::kMicrosecond);
+
+/**
+ * @brief In-house KNN matcher, brute force (0) or LSH (1), training
+ * included as the visual odometry does every frame
+ *
+ * @param state
+ */
+void BM_BinaryMatcher(benchmark::State& state) {
+  const Frames& frames = dataset_frames();
+  if (frames.image_prev.empty()) {
+    state.SkipWithError("Dataset images not found");
+    return;
+  }
+  vo::BinaryMatcher matcher(state.range(0) ? vo::MatcherIndex::kLsh
+                                           : vo::MatcherIndex::kBruteForce);
+  std::vector<std::vector<cv::DMatch>> matches;
+  for (auto _ : state) {
+    matcher.knn_match(frames.descriptors_prev, frames.descriptors_curr,
+                      matches, 2);
+    benchmark::DoNotOptimize(matches.data());
+  }
+  state.SetItemsProcessed(state.iterations() * frames.descriptors_prev.rows);
+}
+BENCHMARK(BM_BinaryMatcher)->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+
+}  // namespace
+
+BENCHMARK_MAIN();
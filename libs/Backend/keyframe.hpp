@@ -0,0 +1,97 @@
+/**
+ * @file keyframe.hpp
+ * @author Apoorv Thapliyal
+ * @brief C++ header file for the keyframes and landmarks of the back-end
+ * @version 0.1
+ * @date 2024-11-23
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <eigen3/Eigen/Core>
+#include <vector>
+
+/**
+ * @brief Back-end optimization namespace
+ *
+ */
+namespace ba {
+
+/**
+ * @brief Observation of a landmark in a keyframe, in normalized image
+ * coordinates
+ *
+ */
+struct Observation {
+  /**
+   * @brief Track id of the landmark
+   *
+   */
+  uint64_t landmark;
+
+  /**
+   * @brief Normalized image x coordinate
+   *
+   */
+  double x;
+
+  /**
+   * @brief Normalized image y coordinate
+   *
+   */
+  double y;
+};
+
+/**
+ * @brief Keyframe of the window
+ *
+ */
+struct Keyframe {
+  /**
+   * @brief Camera to world rotation
+   *
+   */
+  Eigen::Matrix3d R;
+
+  /**
+   * @brief Camera position in the world frame
+   *
+   */
+  Eigen::Vector3d p;
+
+  /**
+   * @brief Landmarks seen by the keyframe
+   *
+   */
+  std::vector<Observation> observations;
+};
+
+/**
+ * @brief Landmark of the window
+ *
+ */
+struct Landmark {
+  /**
+   * @brief Position in the world frame
+   *
+   */
+  Eigen::Vector3d position;
+
+  /**
+   * @brief Flag set once the landmark has been triangulated
+   *
+   */
+  bool triangulated = false;
+
+  /**
+   * @brief Number of keyframes of the window that see the landmark
+   *
+   */
+  int observations = 0;
+};
+
+}  // namespace ba
@@ -0,0 +1,113 @@
+/**
+ * @file marginalization_prior.cpp
+ * @author Apoorv Thapliyal
+ * @brief C++ source file for the prior left by marginalized keyframes
+ * @version 0.1
+ * @date 2024-11-23
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "marginalization_prior.hpp"
+
+/**
+ * @brief Function to replace the prior
+ *
+ * @param hessian
+ * @param gradient
+ * @param keyframes
+ * @param first
+ */
+void ba::MarginalizationPrior::set(const Eigen::MatrixXd& hessian,
+                                   const Eigen::VectorXd& gradient,
+                                   const std::vector<Keyframe>& keyframes,
+                                   size_t first) {
+  H = hessian;
+  b = gradient;
+
+  const size_t count = static_cast<size_t>(b.size()) / 6;
+  R0.resize(count);
+  p0.resize(count);
+  for (size_t k = 0; k < count; k++) {
+    R0[k] = keyframes[first + k].R;
+    p0[k] = keyframes[first + k].p;
+  }
+}
+
+/**
+ * @brief Function to clear the prior
+ *
+ */
+void ba::MarginalizationPrior::reset() {
+  H.resize(0, 0);
+  b.resize(0);
+  R0.clear();
+  p0.clear();
+}
+
+/**
+ * @brief Function to get the number of keyframes the prior covers
+ *
+ * @return size_t
+ */
+size_t ba::MarginalizationPrior::size() const { return R0.size(); }
+
+/**
+ * @brief Function to get the deviation of the oldest keyframes from the
+ * linearization poses
+ *
+ * @param keyframes
+ * @return Eigen::VectorXd
+ */
+Eigen::VectorXd ba::MarginalizationPrior::error(
+    const std::vector<Keyframe>& keyframes) const {
+  Eigen::VectorXd dx(b.size());
+  for (size_t k = 0; k < R0.size(); k++) {
+    dx.segment<3>(6 * k) = keyframes[k].p - p0[k];
+    Eigen::AngleAxisd rotation(R0[k].transpose() * keyframes[k].R);
+    dx.segment<3>(6 * k + 3) = rotation.angle() * rotation.axis();
+  }
+  return dx;
+}
+
+/**
+ * @brief Function to evaluate the prior, in the units of the reprojection
+ * cost
+ *
+ * @param keyframes
+ * @return double
+ */
+double ba::MarginalizationPrior::cost(
+    const std::vector<Keyframe>& keyframes) const {
+  if (R0.empty()) return 0.0;
+  Eigen::VectorXd dx = error(keyframes);
+  return 2.0 * b.dot(dx) + dx.dot(H * dx);
+}
+
+/**
+ * @brief Function to add the prior to a normal equation system over the
+ * window keyframes
+ *
+ * @param keyframes
+ * @param first_free
+ * @param S
+ * @param gradient
+ * @param diagonal
+ */
+void ba::MarginalizationPrior::add_to(const std::vector<Keyframe>& keyframes,
+                                      size_t first_free, Eigen::MatrixXd& S,
+                                      Eigen::VectorXd& gradient,
+                                      Eigen::VectorXd& diagonal) const {
+  if (R0.size() <= first_free) return;
+
+  // Gradient at the current poses: b + H * dx
+  Eigen::VectorXd g = b + H * error(keyframes);
+
+  const int skip = 6 * static_cast<int>(first_free);
+  const int n = static_cast<int>(b.size()) - skip;
+  S.topLeftCorner(n, n).triangularView<Eigen::Lower>() +=
+      H.bottomRightCorner(n, n);
+  gradient.head(n) += g.tail(n);
+  diagonal.head(n) += H.diagonal().tail(n);
+}
@@ -0,0 +1,118 @@
+/**
+ * @file marginalization_prior.hpp
+ * @author Apoorv Thapliyal
+ * @brief C++ header file for the prior left by marginalized keyframes
+ * @version 0.1
+ * @date 2024-11-23
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <eigen3/Eigen/Core>
+#include <eigen3/Eigen/Dense>
+#include <vector>
+
+#include "keyframe.hpp"
+
+namespace ba {
+
+/**
+ * @brief Dense Gaussian prior on the keyframes of the window, left behind by
+ * marginalizing keyframes and landmarks. It is stored as the
+ * Hessian H and gradient b of the cost at the linearization poses (R0, p0):
+ * cost = 2 * b^T * dx + dx^T * H * dx, with dx = (p - p0, log(R0^T * R)) for
+ * every keyframe it covers. Its size is bounded by the window, not by the
+ * length of the trajectory.
+ *
+ */
+class MarginalizationPrior {
+ private:
+  /**
+   * @brief Hessian, 6 rows per keyframe
+   *
+   */
+  Eigen::MatrixXd H;
+
+  /**
+   * @brief Gradient at the linearization poses
+   *
+   */
+  Eigen::VectorXd b;
+
+  /**
+   * @brief Linearization rotations
+   *
+   */
+  std::vector<Eigen::Matrix3d> R0;
+
+  /**
+   * @brief Linearization positions
+   *
+   */
+  std::vector<Eigen::Vector3d> p0;
+
+ public:
+  /**
+   * @brief Function to replace the prior
+   *
+   * @param hessian
+   * @param gradient
+   * @param keyframes: window keyframes, their current poses become the
+   * linearization poses
+   * @param first: window index of the first keyframe the prior covers; after
+   * the keyframes before it are removed, the prior covers the oldest ones
+   */
+  void set(const Eigen::MatrixXd& hessian, const Eigen::VectorXd& gradient,
+           const std::vector<Keyframe>& keyframes, size_t first);
+
+  /**
+   * @brief Function to clear the prior
+   *
+   */
+  void reset();
+
+  /**
+   * @brief Function to get the number of keyframes the prior covers
+   *
+   * @return size_t
+   */
+  size_t size() const;
+
+  /**
+   * @brief Function to get the deviation of the oldest keyframes from the
+   * linearization poses
+   *
+   * @param keyframes
+   * @return Eigen::VectorXd: dx, 6 rows per keyframe
+   */
+  Eigen::VectorXd error(const std::vector<Keyframe>& keyframes) const;
+
+  /**
+   * @brief Function to evaluate the prior, in the units of the reprojection
+   * cost
+   *
+   * @param keyframes
+   * @return double
+   */
+  double cost(const std::vector<Keyframe>& keyframes) const;
+
+  /**
+   * @brief Function to add the prior to a normal equation system over the
+   * window keyframes. Only the lower triangle of S is written.
+   *
+   * @param keyframes
+   * @param first_free: window index of the first keyframe in the system,
+   * the ones before it are held fixed
+   * @param S: Hessian of the system, 6 rows per free keyframe
+   * @param gradient: gradient of the system
+   * @param diagonal: Hessian diagonal used for the damping
+   */
+  void add_to(const std::vector<Keyframe>& keyframes, size_t first_free,
+              Eigen::MatrixXd& S, Eigen::VectorXd& gradient,
+              Eigen::VectorXd& diagonal) const;
+};
+
+}  // namespace ba
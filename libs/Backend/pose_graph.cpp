@@ -0,0 +1,353 @@
+/**
+ * @file pose_graph.cpp
+ * @author Apoorv Thapliyal
+ * @brief C++ source file for the pose-graph optimizer
+ * @version 0.1
+ * @date 2024-11-25
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "pose_graph.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace {
+
+using Matrix6d = Eigen::Matrix<double, 6, 6>;
+using Vector6d = Eigen::Matrix<double, 6, 1>;
+
+/**
+ * @brief Function to get the skew-symmetric matrix of a vector
+ *
+ * @param v
+ * @return Eigen::Matrix3d
+ */
+Eigen::Matrix3d skew(const Eigen::Vector3d& v) {
+  Eigen::Matrix3d m;
+  m << 0.0, -v(2), v(1), v(2), 0.0, -v(0), -v(1), v(0), 0.0;
+  return m;
+}
+
+/**
+ * @brief Function to map a rotation vector to a rotation matrix
+ *
+ * @param phi
+ * @return Eigen::Matrix3d
+ */
+Eigen::Matrix3d exp_so3(const Eigen::Vector3d& phi) {
+  const double angle = phi.norm();
+  if (angle < 1e-12) return Eigen::Matrix3d::Identity() + skew(phi);
+  return Eigen::AngleAxisd(angle, phi / angle).toRotationMatrix();
+}
+
+/**
+ * @brief Function to map a rotation matrix to its rotation vector
+ *
+ * @param R
+ * @return Eigen::Vector3d
+ */
+Eigen::Vector3d log_so3(const Eigen::Matrix3d& R) {
+  Eigen::AngleAxisd angle_axis(R);
+  return angle_axis.angle() * angle_axis.axis();
+}
+
+/**
+ * @brief Function to compute the inverse right Jacobian of the exponential
+ * map, log(exp(phi) exp(d)) ~ phi + Jr^-1(phi) d for small d
+ *
+ * @param phi
+ * @return Eigen::Matrix3d
+ */
+Eigen::Matrix3d inverse_right_jacobian(const Eigen::Vector3d& phi) {
+  const double angle_squared = phi.squaredNorm();
+  const Eigen::Matrix3d K = skew(phi);
+  if (angle_squared < 1e-10)
+    return Eigen::Matrix3d::Identity() + 0.5 * K + K * K / 12.0;
+
+  const double angle = std::sqrt(angle_squared);
+  return Eigen::Matrix3d::Identity() + 0.5 * K +
+         (1.0 / angle_squared -
+          (1.0 + std::cos(angle)) / (2.0 * angle * std::sin(angle))) *
+             K * K;
+}
+
+/**
+ * @brief Function to compute the error of an edge and its Jacobians with
+ * respect to the (p + dp, R * exp(dtheta)) perturbation of both nodes
+ *
+ * @param R_i: rotation of the first node
+ * @param p_i: position of the first node
+ * @param R_j: rotation of the second node
+ * @param p_j: position of the second node
+ * @param edge
+ * @param error: output (translation, rotation) error
+ * @param J_i: optional output Jacobian of the first node
+ * @param J_j: optional output Jacobian of the second node
+ */
+void edge_error(const Eigen::Matrix3d& R_i, const Eigen::Vector3d& p_i,
+                const Eigen::Matrix3d& R_j, const Eigen::Vector3d& p_j,
+                const ba::PoseGraphEdge& edge, Vector6d& error,
+                Matrix6d* J_i = nullptr, Matrix6d* J_j = nullptr) {
+  const Eigen::Vector3d t_ij = R_i.transpose() * (p_j - p_i);
+  const Eigen::Vector3d phi =
+      log_so3(edge.R.transpose() * R_i.transpose() * R_j);
+  error.head<3>() = t_ij - edge.p;
+  error.tail<3>() = phi;
+  if (!J_i || !J_j) return;
+
+  const Eigen::Matrix3d J_r_inverse = inverse_right_jacobian(phi);
+  J_i->setZero();
+  J_j->setZero();
+  J_i->block<3, 3>(0, 0) = -R_i.transpose();
+  J_i->block<3, 3>(0, 3) = skew(t_ij);
+  J_i->block<3, 3>(3, 3) = -J_r_inverse * R_j.transpose() * R_i;
+  J_j->block<3, 3>(0, 0) = R_i.transpose();
+  J_j->block<3, 3>(3, 3) = J_r_inverse;
+}
+
+}  // namespace
+
+/**
+ * @brief Function to compute the weighted squared error of the edges that
+ * touch a free node
+ *
+ * @param first_free
+ * @return double
+ */
+double ba::PoseGraph::cost(size_t first_free) const {
+  double total = 0.0;
+  Vector6d error;
+  for (const PoseGraphEdge& edge : edges) {
+    if (std::max(edge.from, edge.to) < first_free) continue;
+    const Node& a = nodes[edge.from];
+    const Node& b = nodes[edge.to];
+    edge_error(a.R, a.p, b.R, b.p, edge, error);
+    total += error.dot(edge.information * error);
+  }
+  return total;
+}
+
+/**
+ * @brief Function to run Levenberg-Marquardt over the nodes from first_free
+ * on
+ *
+ * @param first_free
+ * @param max_iterations
+ * @return int: iterations run
+ */
+int ba::PoseGraph::solve(size_t first_free, int max_iterations) {
+  if (first_free >= nodes.size()) return 0;
+  const int unknowns = 6 * static_cast<int>(nodes.size() - first_free);
+
+  // Edges between two fixed nodes carry no information about the free ones
+  std::vector<const PoseGraphEdge*> active;
+  for (const PoseGraphEdge& edge : edges)
+    if (std::max(edge.from, edge.to) >= first_free) active.push_back(&edge);
+  if (active.empty()) return 0;
+
+  Eigen::SparseMatrix<double> H(unknowns, unknowns);
+  Eigen::VectorXd g(unknowns);
+  std::vector<Eigen::Triplet<double>> triplets;
+  triplets.reserve(active.size() * 4 * 36 + unknowns);
+  std::vector<Node> saved(nodes.begin() + first_free, nodes.end());
+
+  double current_cost = cost(first_free);
+  double lambda = 1e-4;
+  Eigen::VectorXd diagonal(unknowns);
+  int iteration = 0;
+  while (iteration < max_iterations) {
+    iteration++;
+
+    // Normal equations, one 6x6 block per pair of free nodes an edge links
+    triplets.clear();
+    g.setZero();
+    diagonal.setZero();
+    Vector6d error;
+    Matrix6d J[2];
+    for (const PoseGraphEdge* edge : active) {
+      const Node& a = nodes[edge->from];
+      const Node& b = nodes[edge->to];
+      edge_error(a.R, a.p, b.R, b.p, *edge, error, &J[0], &J[1]);
+
+      const size_t index[2] = {edge->from, edge->to};
+      for (int u = 0; u < 2; u++) {
+        if (index[u] < first_free) continue;
+        const int row = 6 * static_cast<int>(index[u] - first_free);
+        const Eigen::Matrix<double, 6, 6> JtW =
+            J[u].transpose() * edge->information;
+        g.segment<6>(row) += JtW * error;
+        for (int v = 0; v < 2; v++) {
+          if (index[v] < first_free) continue;
+          const int col = 6 * static_cast<int>(index[v] - first_free);
+          const Matrix6d block = JtW * J[v];
+          for (int r = 0; r < 6; r++)
+            for (int c = 0; c < 6; c++)
+              triplets.emplace_back(row + r, col + c, block(r, c));
+          if (u == v) diagonal.segment<6>(row) += block.diagonal();
+        }
+      }
+    }
+
+    // Levenberg-Marquardt damping scaled by the diagonal, so rotations and
+    // translations are damped alike
+    for (int i = 0; i < unknowns; i++)
+      triplets.emplace_back(i, i, lambda * diagonal(i) + 1e-12);
+    H.setFromTriplets(triplets.begin(), triplets.end());
+
+    // The pattern only changes with the structure of the graph
+    if (analyzed_first != first_free || analyzed_nodes != nodes.size() ||
+        analyzed_edges != edges.size()) {
+      solver.analyzePattern(H);
+      analyzed_first = first_free;
+      analyzed_nodes = nodes.size();
+      analyzed_edges = edges.size();
+    }
+    solver.factorize(H);
+    if (solver.info() != Eigen::Success) {
+      std::cerr << "Pose graph factorization failed" << std::endl;
+      break;
+    }
+    Eigen::VectorXd dx = solver.solve(-g);
+    if (!dx.allFinite() || dx.lpNorm<Eigen::Infinity>() < 1e-10) break;
+
+    std::copy(nodes.begin() + first_free, nodes.end(), saved.begin());
+    for (size_t k = first_free; k < nodes.size(); k++) {
+      const int o = 6 * static_cast<int>(k - first_free);
+      nodes[k].p += dx.segment<3>(o);
+      nodes[k].R = nodes[k].R * exp_so3(dx.segment<3>(o + 3));
+    }
+
+    const double new_cost = cost(first_free);
+    if (new_cost > current_cost) {
+      // Reject the step and move towards gradient descent
+      std::copy(saved.begin(), saved.end(), nodes.begin() + first_free);
+      lambda *= 10.0;
+      if (lambda > 1e4) break;
+      continue;
+    }
+    const bool converged = current_cost - new_cost <= 1e-9 * current_cost;
+    current_cost = new_cost;
+    lambda = std::max(lambda * 0.1, 1e-10);
+    if (converged) break;
+  }
+
+  last_cost = current_cost;
+  return iteration;
+}
+
+/**
+ * @brief Function to add a node
+ *
+ * @param pose
+ * @return size_t
+ */
+size_t ba::PoseGraph::add_node(const Eigen::Matrix4d& pose) {
+  nodes.push_back({pose.block<3, 3>(0, 0), pose.block<3, 1>(0, 3)});
+  return nodes.size() - 1;
+}
+
+/**
+ * @brief Function to add a relative pose measurement
+ *
+ * @param from
+ * @param to
+ * @param relative
+ * @param information
+ * @param type
+ * @return true if the edge was added
+ */
+bool ba::PoseGraph::add_edge(size_t from, size_t to,
+                             const Eigen::Matrix4d& relative,
+                             const Eigen::Matrix<double, 6, 6>& information,
+                             EdgeType type) {
+  if (from == to || from >= nodes.size() || to >= nodes.size()) {
+    std::cerr << "Edge " << from << " -> " << to << " does not fit "
+              << nodes.size() << " nodes" << std::endl;
+    return false;
+  }
+  edges.push_back({from, to, relative.block<3, 3>(0, 0),
+                   relative.block<3, 1>(0, 3), information, type});
+  return true;
+}
+
+/**
+ * @brief Function to absorb the edges added since the last call
+ *
+ * @param max_iterations
+ * @return int: iterations run, 0 if there was nothing to optimize
+ */
+int ba::PoseGraph::update(int max_iterations) {
+  if (solved_edges == edges.size()) return 0;
+
+  // Nodes older than every new edge keep their estimate
+  size_t first_free = nodes.size();
+  for (size_t e = solved_edges; e < edges.size(); e++)
+    first_free = std::min(first_free, std::min(edges[e].from, edges[e].to));
+  solved_edges = edges.size();
+  return solve(std::max<size_t>(first_free, 1), max_iterations);
+}
+
+/**
+ * @brief Function to optimize every node but the first
+ *
+ * @param max_iterations
+ * @return int: iterations run, 0 if there was nothing to optimize
+ */
+int ba::PoseGraph::optimize(int max_iterations) {
+  solved_edges = edges.size();
+  return solve(1, max_iterations);
+}
+
+/**
+ * @brief Function to get the pose of a node
+ *
+ * @param index
+ * @return Eigen::Matrix4d
+ */
+Eigen::Matrix4d ba::PoseGraph::get_pose(size_t index) const {
+  Eigen::Matrix4d pose = Eigen::Matrix4d::Identity();
+  if (index >= nodes.size()) {
+    std::cerr << "Node " << index << " is not in the graph" << std::endl;
+    return pose;
+  }
+  pose.block<3, 3>(0, 0) = nodes[index].R;
+  pose.block<3, 1>(0, 3) = nodes[index].p;
+  return pose;
+}
+
+/**
+ * @brief Function to get the number of nodes
+ *
+ * @return size_t
+ */
+size_t ba::PoseGraph::size() const { return nodes.size(); }
+
+/**
+ * @brief Function to get the number of edges
+ *
+ * @return size_t
+ */
+size_t ba::PoseGraph::edge_count() const { return edges.size(); }
+
+/**
+ * @brief Function to get the cost after the last update or optimize call
+ *
+ * @return double
+ */
+double ba::PoseGraph::get_last_cost() const { return last_cost; }
+
+/**
+ * @brief Function to drop all nodes and edges
+ *
+ */
+void ba::PoseGraph::reset() {
+  nodes.clear();
+  edges.clear();
+  solved_edges = 0;
+  analyzed_first = analyzed_nodes = analyzed_edges = 0;
+  last_cost = 0.0;
+}
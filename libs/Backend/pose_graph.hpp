@@ -0,0 +1,238 @@
+/**
+ * @file pose_graph.hpp
+ * @author Apoorv Thapliyal
+ * @brief C++ header file for the pose-graph optimizer
+ * @version 0.1
+ * @date 2024-11-25
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <eigen3/Eigen/Core>
+#include <eigen3/Eigen/Dense>
+#include <eigen3/Eigen/Sparse>
+#include <eigen3/Eigen/SparseCholesky>
+#include <vector>
+
+namespace ba {
+
+/**
+ * @brief Source of a relative pose measurement
+ *
+ */
+enum class EdgeType {
+  kOdometry,  // consecutive keyframes of the visual odometry
+  kInertial,  // IMU preintegration between two keyframes
+  kLoop       // place recognition
+};
+
+/**
+ * @brief Relative pose measurement between two nodes. With the poses of the
+ * nodes (R_i, p_i) and (R_j, p_j), camera to world, the measured transform
+ * from j to i is (R, p) = (R_i^T * R_j, R_i^T * (p_j - p_i)).
+ *
+ */
+struct PoseGraphEdge {
+  /**
+   * @brief Index of the first node
+   *
+   */
+  size_t from;
+
+  /**
+   * @brief Index of the second node
+   *
+   */
+  size_t to;
+
+  /**
+   * @brief Measured relative rotation
+   *
+   */
+  Eigen::Matrix3d R;
+
+  /**
+   * @brief Measured relative translation
+   *
+   */
+  Eigen::Vector3d p;
+
+  /**
+   * @brief Inverse covariance of the (translation, rotation) error
+   *
+   */
+  Eigen::Matrix<double, 6, 6> information;
+
+  /**
+   * @brief Source of the measurement
+   *
+   */
+  EdgeType type;
+};
+
+/**
+ * @brief Pose graph over the keyframes of a run, refined with
+ * Levenberg-Marquardt. Every iteration solves the damped sparse normal
+ * equations with a Cholesky (LDLT) factorization whose symbolic analysis is
+ * reused while the graph structure does not change. The first node anchors
+ * the gauge and is held fixed. Relative measurements are in SE(3): every
+ * edge fixes the length of its translation, so the graph can bend a
+ * trajectory but not rescale it. Over monocular odometry, whose translations
+ * come at unit or drifting scale, a loop corrects the rotation and the
+ * direction of the drift while the scale drift stays in the odometry edges.
+ *
+ */
+class PoseGraph {
+ private:
+  /**
+   * @brief Camera to world pose of a node
+   *
+   */
+  struct Node {
+    Eigen::Matrix3d R;
+    Eigen::Vector3d p;
+  };
+
+  /**
+   * @brief Nodes, in insertion order
+   *
+   */
+  std::vector<Node> nodes;
+
+  /**
+   * @brief Relative pose measurements
+   *
+   */
+  std::vector<PoseGraphEdge> edges;
+
+  /**
+   * @brief Number of edges already absorbed by the last update or optimize
+   * call
+   *
+   */
+  size_t solved_edges = 0;
+
+  /**
+   * @brief Sparse LDLT solver, holding the symbolic factorization of the
+   * last analyzed pattern
+   *
+   */
+  Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>> solver;
+
+  /**
+   * @brief Structure the symbolic factorization was computed for: first
+   * free node, number of nodes and number of edges
+   *
+   */
+  size_t analyzed_first = 0, analyzed_nodes = 0, analyzed_edges = 0;
+
+  /**
+   * @brief Cost after the last update or optimize call
+   *
+   */
+  double last_cost = 0.0;
+
+  /**
+   * @brief Function to compute the weighted squared error of the edges that
+   * touch a free node
+   *
+   * @param first_free: nodes below it are held fixed
+   * @return double
+   */
+  double cost(size_t first_free) const;
+
+  /**
+   * @brief Function to run Levenberg-Marquardt over the nodes from
+   * first_free on, holding the older ones fixed
+   *
+   * @param first_free
+   * @param max_iterations
+   * @return int: iterations run
+   */
+  int solve(size_t first_free, int max_iterations);
+
+ public:
+  /**
+   * @brief Function to add a node
+   *
+   * @param pose: camera to world pose, the initial estimate
+   * @return size_t: index of the node
+   */
+  size_t add_node(const Eigen::Matrix4d& pose);
+
+  /**
+   * @brief Function to add a relative pose measurement
+   *
+   * @param from: index of the first node
+   * @param to: index of the second node
+   * @param relative: transform from the second node to the first, i.e.
+   * pose_from^-1 * pose_to
+   * @param information: inverse covariance of the (translation, rotation)
+   * error
+   * @param type: source of the measurement
+   * @return true if the edge was added
+   */
+  bool add_edge(size_t from, size_t to, const Eigen::Matrix4d& relative,
+                const Eigen::Matrix<double, 6, 6>& information =
+                    Eigen::Matrix<double, 6, 6>::Identity(),
+                EdgeType type = EdgeType::kOdometry);
+
+  /**
+   * @brief Function to absorb the edges added since the last call. Only the
+   * nodes from the oldest one these edges touch on are optimized, starting
+   * from the current estimates, so a new loop re-solves its own part of the
+   * graph rather than the whole trajectory.
+   *
+   * @param max_iterations
+   * @return int: iterations run, 0 if there was nothing to optimize
+   */
+  int update(int max_iterations = 5);
+
+  /**
+   * @brief Function to optimize every node but the first
+   *
+   * @param max_iterations
+   * @return int: iterations run, 0 if there was nothing to optimize
+   */
+  int optimize(int max_iterations = 10);
+
+  /**
+   * @brief Function to get the pose of a node
+   *
+   * @param index: 0 is the first node
+   * @return Eigen::Matrix4d
+   */
+  Eigen::Matrix4d get_pose(size_t index) const;
+
+  /**
+   * @brief Function to get the number of nodes
+   *
+   * @return size_t
+   */
+  size_t size() const;
+
+  /**
+   * @brief Function to get the number of edges
+   *
+   * @return size_t
+   */
+  size_t edge_count() const;
+
+  /**
+   * @brief Function to get the cost after the last update or optimize call
+   *
+   * @return double
+   */
+  double get_last_cost() const;
+
+  /**
+   * @brief Function to drop all nodes and edges
+   *
+   */
+  void reset();
+};
+
+}  // namespace ba
@@ -0,0 +1,730 @@
+/**
+ * @file sliding_window_ba.cpp
+ * @author Apoorv Thapliyal
+ * @brief C++ source file for the sliding-window bundle adjustment
+ * @version 0.1
+ * @date 2024-11-22
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "sliding_window_ba.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <unordered_set>
+
+namespace {
+
+/**
+ * @brief Observation of a triangulated landmark, the unit of the least
+ * squares problem
+ *
+ */
+struct Residual {
+  /**
+   * @brief Keyframe index in the window
+   *
+   */
+  int keyframe;
+
+  /**
+   * @brief Index of the landmark among the optimized ones
+   *
+   */
+  int landmark;
+
+  /**
+   * @brief Normalized image x coordinate
+   *
+   */
+  double x;
+
+  /**
+   * @brief Normalized image y coordinate
+   *
+   */
+  double y;
+};
+
+/**
+ * @brief Landmarks closer than this to the image plane are not used
+ *
+ */
+constexpr double kMinDepth = 1e-6;
+
+/**
+ * @brief Weight of the relative error of the baseline that fixes the scale,
+ * stiff against the reprojection errors in normalized units
+ *
+ */
+constexpr double kScaleWeight = 1e6;
+
+/**
+ * @brief Baselines shorter than this cannot fix the scale
+ *
+ */
+constexpr double kMinBaseline = 1e-9;
+
+/**
+ * @brief Function to get the skew-symmetric matrix of a vector
+ *
+ * @param v
+ * @return Eigen::Matrix3d
+ */
+Eigen::Matrix3d skew(const Eigen::Vector3d& v) {
+  Eigen::Matrix3d m;
+  m << 0.0, -v(2), v(1), v(2), 0.0, -v(0), -v(1), v(0), 0.0;
+  return m;
+}
+
+/**
+ * @brief Function to map a rotation vector to a rotation matrix
+ *
+ * @param phi
+ * @return Eigen::Matrix3d
+ */
+Eigen::Matrix3d exp_so3(const Eigen::Vector3d& phi) {
+  const double angle = phi.norm();
+  if (angle < 1e-12) return Eigen::Matrix3d::Identity() + skew(phi);
+  return Eigen::AngleAxisd(angle, phi / angle).toRotationMatrix();
+}
+
+/**
+ * @brief Function to get the Huber cost and IRLS weight of a squared error
+ *
+ * @param squared: squared reprojection error
+ * @param threshold: error beyond which the cost grows linearly
+ * @param weight: output
+ * @return double: cost
+ */
+double huber(double squared, double threshold, double& weight) {
+  const double threshold_sq = threshold * threshold;
+  if (squared <= threshold_sq) {
+    weight = 1.0;
+    return squared;
+  }
+  const double norm = std::sqrt(squared);
+  weight = threshold / norm;
+  return 2.0 * threshold * norm - threshold_sq;
+}
+
+/**
+ * @brief Linearized system of the window with the landmarks eliminated, plus
+ * what the back-substitution of the landmarks needs
+ *
+ */
+struct ReducedSystem {
+  /**
+   * @brief Schur complement on the free keyframes, lower triangle only
+   *
+   */
+  Eigen::MatrixXd S;
+
+  /**
+   * @brief Reduced gradient of the free keyframes
+   *
+   */
+  Eigen::VectorXd b;
+
+  /**
+   * @brief Diagonal of the pose Hessian before the elimination, for the
+   * damping
+   *
+   */
+  Eigen::VectorXd diagonal;
+
+  /**
+   * @brief Pose-landmark Hessian block of every residual
+   *
+   */
+  std::vector<Eigen::Matrix<double, 6, 3>,
+              Eigen::aligned_allocator<Eigen::Matrix<double, 6, 3>>>
+      W;
+
+  /**
+   * @brief Flag set for the residuals that couple a free keyframe
+   *
+   */
+  std::vector<unsigned char> used;
+
+  /**
+   * @brief Inverse of the damped Hessian block of every landmark
+   *
+   */
+  std::vector<Eigen::Matrix3d> landmark_inverse;
+
+  /**
+   * @brief Gradient of every landmark
+   *
+   */
+  std::vector<Eigen::Vector3d> landmark_gradient;
+};
+
+/**
+ * @brief Function to group the observations of the given landmarks by
+ * landmark, so each landmark is eliminated from a contiguous range
+ *
+ * @param keyframes
+ * @param landmark_index: dense index of every landmark to include
+ * @param residuals: output, sorted by landmark then keyframe
+ * @param start: output, first residual of every landmark plus the end
+ */
+void group_residuals(const std::vector<ba::Keyframe>& keyframes,
+                     const std::unordered_map<uint64_t, int>& landmark_index,
+                     std::vector<Residual>& residuals,
+                     std::vector<int>& start) {
+  start.assign(landmark_index.size() + 1, 0);
+  std::vector<Residual> unsorted;
+  for (size_t k = 0; k < keyframes.size(); k++) {
+    for (const ba::Observation& observation : keyframes[k].observations) {
+      auto it = landmark_index.find(observation.landmark);
+      if (it == landmark_index.end()) continue;
+      unsorted.push_back(
+          {static_cast<int>(k), it->second, observation.x, observation.y});
+      start[it->second + 1]++;
+    }
+  }
+  for (size_t l = 0; l + 1 < start.size(); l++) start[l + 1] += start[l];
+
+  residuals.resize(unsorted.size());
+  std::vector<int> fill(start.begin(), start.end() - 1);
+  for (const Residual& residual : unsorted)
+    residuals[fill[residual.landmark]++] = residual;
+}
+
+/**
+ * @brief Function to evaluate the robust reprojection cost of residuals
+ *
+ * @param keyframes
+ * @param active: landmark of every dense index
+ * @param residuals
+ * @param huber_threshold
+ * @return double
+ */
+double reprojection_cost(const std::vector<ba::Keyframe>& keyframes,
+                         const std::vector<ba::Landmark*>& active,
+                         const std::vector<Residual>& residuals,
+                         double huber_threshold) {
+  double total = 0.0, weight;
+  for (const Residual& residual : residuals) {
+    const ba::Keyframe& keyframe = keyframes[residual.keyframe];
+    Eigen::Vector3d X = keyframe.R.transpose() *
+                        (active[residual.landmark]->position - keyframe.p);
+    if (X(2) < kMinDepth) continue;
+    double ex = X(0) / X(2) - residual.x, ey = X(1) / X(2) - residual.y;
+    total += huber(ex * ex + ey * ey, huber_threshold, weight);
+  }
+  return total;
+}
+
+/**
+ * @brief Function to linearize the residuals and eliminate the landmarks
+ *
+ * @param keyframes
+ * @param first_free: window index of the first keyframe in the system, the
+ * ones before it are held fixed
+ * @param active: landmark of every dense index
+ * @param residuals: grouped by landmark
+ * @param start: first residual of every landmark plus the end
+ * @param huber_threshold
+ * @param lambda: Levenberg-Marquardt damping of the landmark blocks
+ * @param system: output, buffers are reused across iterations
+ */
+void build_reduced_system(const std::vector<ba::Keyframe>& keyframes,
+                          int first_free,
+                          const std::vector<ba::Landmark*>& active,
+                          const std::vector<Residual>& residuals,
+                          const std::vector<int>& start,
+                          double huber_threshold, double lambda,
+                          ReducedSystem& system) {
+  const int dim = 6 * (static_cast<int>(keyframes.size()) - first_free);
+  const int count = static_cast<int>(active.size());
+  system.S.setZero(dim, dim);
+  system.b.setZero(dim);
+  system.diagonal.setZero(dim);
+  system.W.resize(residuals.size());
+  system.used.resize(residuals.size());
+  system.landmark_inverse.resize(count);
+  system.landmark_gradient.resize(count);
+
+  for (int l = 0; l < count; l++) {
+    const Eigen::Vector3d& position = active[l]->position;
+    Eigen::Matrix3d H_ll = Eigen::Matrix3d::Zero();
+    Eigen::Vector3d b_l = Eigen::Vector3d::Zero();
+
+    for (int r = start[l]; r < start[l + 1]; r++) {
+      const Residual& residual = residuals[r];
+      const ba::Keyframe& keyframe = keyframes[residual.keyframe];
+      Eigen::Vector3d X = keyframe.R.transpose() * (position - keyframe.p);
+      system.used[r] = X(2) >= kMinDepth;
+      if (!system.used[r]) continue;
+
+      const double inverse_z = 1.0 / X(2);
+      Eigen::Vector2d error(X(0) * inverse_z - residual.x,
+                            X(1) * inverse_z - residual.y);
+      double weight;
+      huber(error.squaredNorm(), huber_threshold, weight);
+
+      Eigen::Matrix<double, 2, 3> J_projection;
+      J_projection << inverse_z, 0.0, -X(0) * inverse_z * inverse_z, 0.0,
+          inverse_z, -X(1) * inverse_z * inverse_z;
+      Eigen::Matrix<double, 2, 3> J_l = J_projection * keyframe.R.transpose();
+      H_ll.noalias() += weight * J_l.transpose() * J_l;
+      b_l.noalias() += weight * J_l.transpose() * error;
+
+      if (residual.keyframe < first_free) {
+        system.used[r] = 0;
+        continue;
+      }
+
+      // Pose perturbation: p + dp, R * exp(dtheta)
+      Eigen::Matrix<double, 2, 6> J_p;
+      J_p.leftCols<3>() = -J_l;
+      J_p.rightCols<3>() = J_projection * skew(X);
+
+      const int o = 6 * (residual.keyframe - first_free);
+      Eigen::Matrix<double, 6, 6> H_pp = weight * J_p.transpose() * J_p;
+      system.S.block<6, 6>(o, o) += H_pp;
+      system.diagonal.segment<6>(o) += H_pp.diagonal();
+      system.b.segment<6>(o).noalias() += weight * J_p.transpose() * error;
+      system.W[r].noalias() = weight * J_p.transpose() * J_l;
+    }
+
+    // Eliminate the landmark: S -= W * H_ll^-1 * W^T. Residuals are sorted
+    // by keyframe, so the blocks from c >= a fill the lower triangle, which
+    // is all the LDLT reads.
+    H_ll.diagonal() += lambda * H_ll.diagonal();
+    H_ll.diagonal().array() += 1e-12;
+    system.landmark_inverse[l] = H_ll.inverse();
+    system.landmark_gradient[l] = b_l;
+
+    for (int a = start[l]; a < start[l + 1]; a++) {
+      if (!system.used[a]) continue;
+      const int oa = 6 * (residuals[a].keyframe - first_free);
+      Eigen::Matrix<double, 3, 6> HW =
+          system.landmark_inverse[l] * system.W[a].transpose();
+      system.b.segment<6>(oa).noalias() -= HW.transpose() * b_l;
+      for (int c = a; c < start[l + 1]; c++) {
+        if (!system.used[c]) continue;
+        const int oc = 6 * (residuals[c].keyframe - first_free);
+        system.S.block<6, 6>(oc, oa).noalias() -= system.W[c] * HW;
+      }
+    }
+  }
+}
+
+}  // namespace
+
+/**
+ * @brief Construct a new ba::Sliding Window Ba::Sliding Window Ba object
+ *
+ * @param window_keyframes
+ * @param huber
+ */
+ba::SlidingWindowBa::SlidingWindowBa(size_t window_keyframes, double huber)
+    : window_size(std::max<size_t>(window_keyframes, 2)),
+      huber_threshold(huber) {}
+
+/**
+ * @brief Function to add a keyframe, dropping the oldest one when the window
+ * is full
+ *
+ * @param pose
+ * @param ids
+ * @param points
+ * @return true if the keyframe was added
+ */
+bool ba::SlidingWindowBa::add_keyframe(
+    const Eigen::Matrix4d& pose, const std::vector<uint64_t>& ids,
+    const std::vector<Eigen::Vector3d>& points) {
+  if (ids.size() != points.size()) {
+    std::cerr << "Keyframe has " << ids.size() << " ids for " << points.size()
+              << " points" << std::endl;
+    return false;
+  }
+
+  Keyframe keyframe;
+  keyframe.R = pose.block<3, 3>(0, 0);
+  keyframe.p = pose.block<3, 1>(0, 3);
+  keyframe.observations.reserve(ids.size());
+  for (size_t i = 0; i < ids.size(); i++) {
+    keyframe.observations.push_back(
+        {ids[i], points[i](0) / points[i](2), points[i](1) / points[i](2)});
+    landmarks[ids[i]].observations++;
+  }
+  keyframes.push_back(std::move(keyframe));
+
+  // A new anchor holds the scale of its own baseline
+  while (keyframes.size() > window_size) {
+    if (marginalization)
+      marginalize_oldest_keyframe();
+    else
+      drop_oldest_keyframe();
+    scale_baseline = 0.0;
+  }
+
+  triangulate_landmarks();
+  return true;
+}
+
+/**
+ * @brief Function to drop the oldest keyframe and the landmarks only it saw
+ *
+ */
+void ba::SlidingWindowBa::drop_oldest_keyframe() {
+  for (const Observation& observation : keyframes.front().observations) {
+    auto it = landmarks.find(observation.landmark);
+    if (it != landmarks.end() && --it->second.observations <= 0)
+      landmarks.erase(it);
+  }
+  keyframes.erase(keyframes.begin());
+}
+
+/**
+ * @brief Function to marginalize the oldest keyframe and the landmarks it
+ * sees that the newest keyframe lost into the prior on the remaining
+ * keyframes
+ *
+ */
+void ba::SlidingWindowBa::marginalize_oldest_keyframe() {
+  // Landmarks still tracked by the newest keyframe stay in the window and
+  // only lose their oldest observation. The other triangulated landmarks of
+  // the oldest keyframe that the rest of the window sees carry information on
+  // it and are marginalized with it.
+  std::unordered_set<uint64_t> tracked;
+  for (const Observation& observation : keyframes.back().observations)
+    tracked.insert(observation.landmark);
+
+  std::unordered_map<uint64_t, int> landmark_index;
+  std::vector<Landmark*> active;
+  for (const Observation& observation : keyframes.front().observations) {
+    auto it = landmarks.find(observation.landmark);
+    if (it == landmarks.end() || !it->second.triangulated ||
+        it->second.observations < 2 || tracked.count(it->first) > 0)
+      continue;
+    landmark_index.emplace(it->first, static_cast<int>(active.size()));
+    active.push_back(&it->second);
+  }
+
+  std::vector<Residual> residuals;
+  std::vector<int> start;
+  group_residuals(keyframes, landmark_index, residuals, start);
+
+  // Linearize at the current estimate without damping and fold in the old
+  // prior. The oldest keyframe is the fixed anchor, so nothing is left to
+  // eliminate once the landmarks are.
+  ReducedSystem system;
+  build_reduced_system(keyframes, 1, active, residuals, start,
+                       huber_threshold, 0.0, system);
+  prior.add_to(keyframes, 1, system.S, system.b, system.diagonal);
+  Eigen::MatrixXd H = system.S.selfadjointView<Eigen::Lower>();
+  prior.set(H, system.b, keyframes, 1);
+
+  // The marginalized landmarks leave the window with all their observations
+  for (Keyframe& keyframe : keyframes) {
+    std::vector<Observation>& observations = keyframe.observations;
+    observations.erase(
+        std::remove_if(observations.begin(), observations.end(),
+                       [&](const Observation& observation) {
+                         return landmark_index.count(observation.landmark) >
+                                0;
+                       }),
+        observations.end());
+  }
+  for (const auto& entry : landmark_index) landmarks.erase(entry.first);
+
+  drop_oldest_keyframe();
+}
+
+/**
+ * @brief Function to triangulate the landmarks of the newest keyframe that
+ * are seen with enough parallax
+ *
+ */
+void ba::SlidingWindowBa::triangulate_landmarks() {
+  if (keyframes.size() < 2) return;
+  const Keyframe& newest = keyframes.back();
+
+  // Pair every new landmark with its oldest observation, for the widest
+  // baseline
+  const size_t none = std::numeric_limits<size_t>::max();
+  std::unordered_map<uint64_t, std::pair<size_t, size_t>> oldest;
+  for (const Observation& observation : newest.observations)
+    if (!landmarks[observation.landmark].triangulated)
+      oldest.emplace(observation.landmark, std::make_pair(none, none));
+  if (oldest.empty()) return;
+
+  for (size_t k = 0; k + 1 < keyframes.size(); k++) {
+    const std::vector<Observation>& observations = keyframes[k].observations;
+    for (size_t j = 0; j < observations.size(); j++) {
+      auto it = oldest.find(observations[j].landmark);
+      if (it != oldest.end() && it->second.first == none)
+        it->second = std::make_pair(k, j);
+    }
+  }
+
+  const double max_cos = std::cos(min_parallax);
+  for (const Observation& observation : newest.observations) {
+    auto it = oldest.find(observation.landmark);
+    if (it == oldest.end() || it->second.first == none) continue;
+
+    const Keyframe& first = keyframes[it->second.first];
+    const Observation& first_observation =
+        first.observations[it->second.second];
+
+    // Rays in the world frame, scaled to unit depth in their camera
+    Eigen::Vector3d d1 =
+        first.R * Eigen::Vector3d(first_observation.x, first_observation.y, 1);
+    Eigen::Vector3d d2 =
+        newest.R * Eigen::Vector3d(observation.x, observation.y, 1);
+    if (d1.dot(d2) > max_cos * d1.norm() * d2.norm()) continue;
+
+    // Closest points of the rays p1 + s1 * d1 and p2 + s2 * d2
+    Eigen::Matrix2d A;
+    A << d1.dot(d1), -d1.dot(d2), d1.dot(d2), -d2.dot(d2);
+    Eigen::Vector3d baseline = newest.p - first.p;
+    Eigen::Vector2d depths =
+        A.inverse() * Eigen::Vector2d(d1.dot(baseline), d2.dot(baseline));
+    if (depths(0) <= kMinDepth || depths(1) <= kMinDepth) continue;
+
+    Landmark& landmark = landmarks[observation.landmark];
+    landmark.position =
+        0.5 * (first.p + depths(0) * d1 + newest.p + depths(1) * d2);
+    landmark.triangulated = true;
+  }
+}
+
+/**
+ * @brief Function to refine the keyframe poses and landmarks with
+ * Levenberg-Marquardt
+ *
+ * @param max_iterations
+ * @return int: iterations run, 0 if there was nothing to optimize
+ */
+int ba::SlidingWindowBa::optimize(int max_iterations) {
+  if (keyframes.size() < 2) return 0;
+
+  // Landmarks seen twice constrain the poses; a single ray leaves the depth
+  // free
+  std::unordered_map<uint64_t, int> landmark_index;
+  std::vector<Landmark*> active;
+  for (auto& entry : landmarks) {
+    if (!entry.second.triangulated || entry.second.observations < 2) continue;
+    landmark_index.emplace(entry.first, static_cast<int>(active.size()));
+    active.push_back(&entry.second);
+  }
+  if (active.empty()) return 0;
+
+  std::vector<Residual> residuals;
+  std::vector<int> start;
+  group_residuals(keyframes, landmark_index, residuals, start);
+
+  // The oldest keyframe anchors the gauge, the prior is conditioned on it
+  const int first_free = 1;
+  const int count = static_cast<int>(active.size());
+
+  // Reprojections leave the scale free too. It is held by a stiff prior on
+  // the baseline from the anchor to the first keyframe away from it, which
+  // keeps the length it had when the anchor first got optimized. The prior
+  // acts on the component along the baseline of this call, which is linear
+  // in the position and does not fight the steps that turn the baseline.
+  size_t scale_keyframe = first_free;
+  while (scale_keyframe < keyframes.size() &&
+         (keyframes[scale_keyframe].p - keyframes[0].p).norm() <= kMinBaseline)
+    scale_keyframe++;
+  const bool fix_scale = scale_keyframe < keyframes.size();
+  Eigen::Vector3d scale_direction = Eigen::Vector3d::Zero();
+  if (fix_scale) {
+    scale_direction = keyframes[scale_keyframe].p - keyframes[0].p;
+    if (scale_baseline <= 0.0) scale_baseline = scale_direction.norm();
+    scale_direction.normalize();
+  }
+  auto scale_error = [&]() {
+    return scale_direction.dot(keyframes[scale_keyframe].p - keyframes[0].p) /
+               scale_baseline -
+           1.0;
+  };
+
+  auto cost_of = [&]() {
+    double cost =
+        reprojection_cost(keyframes, active, residuals, huber_threshold) +
+        prior.cost(keyframes);
+    if (fix_scale) cost += kScaleWeight * scale_error() * scale_error();
+    return cost;
+  };
+
+  ReducedSystem system;
+  std::vector<Eigen::Matrix3d> saved_R(keyframes.size());
+  std::vector<Eigen::Vector3d> saved_p(keyframes.size());
+  std::vector<Eigen::Vector3d> saved_landmarks(count);
+
+  double cost = cost_of();
+  initial_cost = cost;
+  double lambda = 1e-4;
+  int iteration = 0;
+  while (iteration < max_iterations) {
+    iteration++;
+    build_reduced_system(keyframes, first_free, active, residuals, start,
+                         huber_threshold, lambda, system);
+    prior.add_to(keyframes, first_free, system.S, system.b, system.diagonal);
+    if (fix_scale) {
+      const Eigen::Vector3d J = scale_direction / scale_baseline;
+      const int o = 6 * (static_cast<int>(scale_keyframe) - first_free);
+      system.S.block<3, 3>(o, o) += kScaleWeight * J * J.transpose();
+      system.b.segment<3>(o) += kScaleWeight * scale_error() * J;
+    }
+
+    system.S.diagonal() += lambda * system.diagonal;
+    system.S.diagonal().array() += 1e-12;
+    Eigen::VectorXd dp = system.S.ldlt().solve(-system.b);
+    if (!dp.allFinite()) break;
+
+    // Save the state, then apply the step
+    for (size_t k = 0; k < keyframes.size(); k++) {
+      saved_R[k] = keyframes[k].R;
+      saved_p[k] = keyframes[k].p;
+    }
+    for (size_t k = first_free; k < keyframes.size(); k++) {
+      const int o = 6 * (static_cast<int>(k) - first_free);
+      keyframes[k].p += dp.segment<3>(o);
+      keyframes[k].R = keyframes[k].R * exp_so3(dp.segment<3>(o + 3));
+    }
+
+    // Back-substitute the landmarks: dl = -H_ll^-1 * (b_l + W^T * dp)
+    for (int l = 0; l < count; l++) {
+      Eigen::Vector3d rhs = system.landmark_gradient[l];
+      for (int r = start[l]; r < start[l + 1]; r++)
+        if (system.used[r])
+          rhs.noalias() += system.W[r].transpose() *
+                           dp.segment<6>(6 * (residuals[r].keyframe -
+                                              first_free));
+      saved_landmarks[l] = active[l]->position;
+      active[l]->position -= system.landmark_inverse[l] * rhs;
+    }
+
+    double new_cost = cost_of();
+    if (new_cost < cost) {
+      bool converged = cost - new_cost < 1e-6 * std::abs(cost);
+      cost = new_cost;
+      lambda = std::max(lambda * 0.1, 1e-10);
+      if (converged) break;
+    } else {
+      // Reject the step and move towards gradient descent
+      for (size_t k = 0; k < keyframes.size(); k++) {
+        keyframes[k].R = saved_R[k];
+        keyframes[k].p = saved_p[k];
+      }
+      for (int l = 0; l < count; l++) active[l]->position = saved_landmarks[l];
+      lambda *= 10.0;
+      if (lambda > 1e4) break;
+    }
+  }
+
+  // Landmarks that ended up behind a camera are triangulated again later
+  for (const Residual& residual : residuals) {
+    const Keyframe& keyframe = keyframes[residual.keyframe];
+    Landmark& landmark = *active[residual.landmark];
+    if ((keyframe.R.transpose() * (landmark.position - keyframe.p))(2) <
+        kMinDepth)
+      landmark.triangulated = false;
+  }
+
+  last_cost = cost;
+  return iteration;
+}
+
+/**
+ * @brief Function to drop all keyframes and landmarks
+ *
+ */
+void ba::SlidingWindowBa::reset() {
+  keyframes.clear();
+  landmarks.clear();
+  prior.reset();
+  scale_baseline = 0.0;
+  last_cost = 0.0;
+  initial_cost = 0.0;
+}
+
+/**
+ * @brief Function to get the pose of a keyframe
+ *
+ * @param index
+ * @return Eigen::Matrix4d
+ */
+Eigen::Matrix4d ba::SlidingWindowBa::get_pose(size_t index) const {
+  Eigen::Matrix4d pose = Eigen::Matrix4d::Identity();
+  if (index >= keyframes.size()) {
+    std::cerr << "Keyframe " << index << " is not in the window" << std::endl;
+    return pose;
+  }
+  pose.block<3, 3>(0, 0) = keyframes[index].R;
+  pose.block<3, 1>(0, 3) = keyframes[index].p;
+  return pose;
+}
+
+/**
+ * @brief Function to get the pose of the newest keyframe
+ *
+ * @return Eigen::Matrix4d
+ */
+Eigen::Matrix4d ba::SlidingWindowBa::get_latest_pose() const {
+  return get_pose(keyframes.empty() ? 0 : keyframes.size() - 1);
+}
+
+/**
+ * @brief Function to get the number of keyframes in the window
+ *
+ * @return size_t
+ */
+size_t ba::SlidingWindowBa::size() const { return keyframes.size(); }
+
+/**
+ * @brief Function to get the number of triangulated landmarks
+ *
+ * @return size_t
+ */
+size_t ba::SlidingWindowBa::landmark_count() const {
+  size_t count = 0;
+  for (const auto& entry : landmarks)
+    if (entry.second.triangulated) count++;
+  return count;
+}
+
+/**
+ * @brief Function to get the robust cost after the last optimize call
+ *
+ * @return double
+ */
+double ba::SlidingWindowBa::get_last_cost() const { return last_cost; }
+
+/**
+ * @brief Function to get the robust cost of the poses and landmarks the last
+ * optimize call started from
+ *
+ * @return double
+ */
+double ba::SlidingWindowBa::get_initial_cost() const { return initial_cost; }
+
+/**
+ * @brief Function to fold the keyframes leaving the window into a prior
+ * instead of dropping them
+ *
+ * @param enabled
+ */
+void ba::SlidingWindowBa::set_marginalization(bool enabled) {
+  marginalization = enabled;
+  if (!enabled) prior.reset();
+}
+
+/**
+ * @brief Function to get the number of keyframes the marginalization prior
+ * covers
+ *
+ * @return size_t
+ */
+size_t ba::SlidingWindowBa::get_prior_size() const { return prior.size(); }
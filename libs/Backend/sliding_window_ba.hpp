@@ -0,0 +1,224 @@
+/**
+ * @file sliding_window_ba.hpp
+ * @author Apoorv Thapliyal
+ * @brief C++ header file for the sliding-window bundle adjustment
+ * @version 0.1
+ * @date 2024-11-22
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <eigen3/Eigen/Core>
+#include <eigen3/Eigen/Dense>
+#include <unordered_map>
+#include <vector>
+
+#include "keyframe.hpp"
+#include "marginalization_prior.hpp"
+
+namespace ba {
+
+/**
+ * @brief Bundle adjustment of the last keyframes and the landmarks they see.
+ * Poses follow the VO convention: camera to world, so a landmark X is seen at
+ * R^T * (X - p). The oldest keyframe anchors the gauge and is held fixed,
+ * and a stiff prior holds the length of the baseline from it to the next
+ * keyframe, which fixes the scale monocular observations leave free.
+ * Landmarks are eliminated with a Schur complement, so every iteration
+ * solves a dense system of 6 unknowns per keyframe only.
+ *
+ */
+class SlidingWindowBa {
+ private:
+  /**
+   * @brief Maximum number of keyframes kept
+   *
+   */
+  size_t window_size;
+
+  /**
+   * @brief Reprojection error in normalized units beyond which the Huber
+   * loss grows linearly
+   *
+   */
+  double huber_threshold;
+
+  /**
+   * @brief Minimum angle in radians between two rays to triangulate them
+   *
+   */
+  double min_parallax = 0.02;
+
+  /**
+   * @brief Keyframes, oldest first
+   *
+   */
+  std::vector<Keyframe> keyframes;
+
+  /**
+   * @brief Landmarks by track id
+   *
+   */
+  std::unordered_map<uint64_t, Landmark> landmarks;
+
+  /**
+   * @brief Length the baseline from the anchor to the next keyframe away from
+   * it is held at, 0 until an optimize call with this anchor sets it
+   *
+   */
+  double scale_baseline = 0.0;
+
+  /**
+   * @brief Robust cost after the last optimize call
+   *
+   */
+  double last_cost = 0.0;
+
+  /**
+   * @brief Robust cost of the starting poses and landmarks of the last
+   * optimize call
+   *
+   */
+  double initial_cost = 0.0;
+
+  /**
+   * @brief Flag to marginalize the keyframes leaving the window instead of
+   * dropping them
+   *
+   */
+  bool marginalization = false;
+
+  /**
+   * @brief Prior left by the marginalized keyframes and landmarks
+   *
+   */
+  MarginalizationPrior prior;
+
+  /**
+   * @brief Function to triangulate the landmarks of the newest keyframe that
+   * are seen with enough parallax
+   *
+   */
+  void triangulate_landmarks();
+
+  /**
+   * @brief Function to drop the oldest keyframe and the landmarks only it
+   * saw
+   *
+   */
+  void drop_oldest_keyframe();
+
+  /**
+   * @brief Function to marginalize the oldest keyframe and the landmarks it
+   * sees that the newest keyframe lost into the prior on the remaining
+   * keyframes
+   *
+   */
+  void marginalize_oldest_keyframe();
+
+ public:
+  /**
+   * @brief Construct a new Sliding Window Ba object
+   *
+   * @param window_keyframes: maximum number of keyframes kept
+   * @param huber: reprojection error in normalized units beyond which the
+   * loss grows linearly, e.g. pixels divided by the focal length
+   */
+  SlidingWindowBa(size_t window_keyframes = 7, double huber = 0.01);
+
+  /**
+   * @brief Function to add a keyframe, dropping the oldest one when the
+   * window is full
+   *
+   * @param pose: camera to world pose
+   * @param ids: track id of every observation
+   * @param points: normalized image points (z = 1), one per id
+   * @return true if the keyframe was added
+   */
+  bool add_keyframe(const Eigen::Matrix4d& pose,
+                    const std::vector<uint64_t>& ids,
+                    const std::vector<Eigen::Vector3d>& points);
+
+  /**
+   * @brief Function to refine the keyframe poses and landmarks with
+   * Levenberg-Marquardt
+   *
+   * @param max_iterations
+   * @return int: iterations run, 0 if there was nothing to optimize
+   */
+  int optimize(int max_iterations = 5);
+
+  /**
+   * @brief Function to drop all keyframes and landmarks
+   *
+   */
+  void reset();
+
+  /**
+   * @brief Function to get the pose of a keyframe
+   *
+   * @param index: 0 is the oldest keyframe of the window
+   * @return Eigen::Matrix4d
+   */
+  Eigen::Matrix4d get_pose(size_t index) const;
+
+  /**
+   * @brief Function to get the pose of the newest keyframe
+   *
+   * @return Eigen::Matrix4d
+   */
+  Eigen::Matrix4d get_latest_pose() const;
+
+  /**
+   * @brief Function to get the number of keyframes in the window
+   *
+   * @return size_t
+   */
+  size_t size() const;
+
+  /**
+   * @brief Function to get the number of triangulated landmarks
+   *
+   * @return size_t
+   */
+  size_t landmark_count() const;
+
+  /**
+   * @brief Function to get the robust cost after the last optimize call
+   *
+   * @return double
+   */
+  double get_last_cost() const;
+
+  /**
+   * @brief Function to get the robust cost of the poses and landmarks the
+   * last optimize call started from
+   *
+   * @return double
+   */
+  double get_initial_cost() const;
+
+  /**
+   * @brief Function to fold the keyframes leaving the window into a dense
+   * prior on the remaining ones instead of dropping them. The landmarks the
+   * newest keyframe still tracks only lose their oldest observation, the
+   * other ones the marginalized keyframe sees leave the window with it.
+   *
+   * @param enabled
+   */
+  void set_marginalization(bool enabled);
+
+  /**
+   * @brief Function to get the number of keyframes the marginalization prior
+   * covers
+   *
+   * @return size_t
+   */
+  size_t get_prior_size() const;
+};
+
+}  // namespace ba
@@ -0,0 +1,85 @@
+/**
+ * @file camera_calibration.cpp
+ * @author Apoorv Thapliyal
+ * @brief C++ source file for reading the camera to IMU body extrinsic
+ * @version 0.1
+ * @date 2024-11-26
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "camera_calibration.hpp"
+
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+/**
+ * @brief Function to read the camera to IMU body rotation and translation
+ * from a text file
+ *
+ * @param path
+ * @param R_body_camera
+ * @param t_body_camera
+ * @return true if the file held a valid rotation
+ */
+bool dl::load_camera_extrinsic(const std::string& path,
+                                Eigen::Matrix3d& R_body_camera,
+                                Eigen::Vector3d& t_body_camera) {
+  std::ifstream file(path);
+  if (!file) {
+    std::cerr << "Could not open camera calibration " << path << std::endl;
+    return false;
+  }
+
+  std::vector<double> values;
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.empty() || line[0] == '#') continue;
+    std::istringstream iss(line);
+    double value;
+    while (iss >> value) values.push_back(value);
+  }
+
+  if (values.size() != 9 && values.size() != 16) {
+    std::cerr << "Camera calibration " << path << " holds " << values.size()
+              << " values, expected 9 or 16" << std::endl;
+    return false;
+  }
+
+  // A 3x3 rotation, or the top rows of a 4x4 transform
+  const size_t columns = values.size() == 16 ? 4 : 3;
+  Eigen::Matrix3d R;
+  Eigen::Vector3d t = Eigen::Vector3d::Zero();
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) R(i, j) = values[i * columns + j];
+    if (columns == 4) t(i) = values[i * columns + 3];
+  }
+
+  if (!R.allFinite() || !t.allFinite() ||
+      (R.transpose() * R - Eigen::Matrix3d::Identity()).norm() > 1e-3 ||
+      std::abs(R.determinant() - 1.0) > 1e-3) {
+    std::cerr << "Camera calibration " << path << " is not a rotation"
+              << std::endl;
+    return false;
+  }
+  R_body_camera = R;
+  t_body_camera = t;
+  return true;
+}
+
+/**
+ * @brief Function to read the camera to IMU body rotation from a text file
+ *
+ * @param path
+ * @param R_body_camera
+ * @return true if the file held a valid rotation
+ */
+bool dl::load_camera_rotation(const std::string& path,
+                               Eigen::Matrix3d& R_body_camera) {
+  Eigen::Vector3d t_body_camera;
+  return load_camera_extrinsic(path, R_body_camera, t_body_camera);
+}
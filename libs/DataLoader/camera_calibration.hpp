@@ -0,0 +1,45 @@
+/**
+ * @file camera_calibration.hpp
+ * @author Apoorv Thapliyal
+ * @brief C++ header file for reading the camera to IMU body extrinsic
+ * @version 0.1
+ * @date 2024-11-26
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <eigen3/Eigen/Dense>
+#include <string>
+
+namespace dl {
+
+/**
+ * @brief Function to read the camera to IMU body rotation and translation
+ * from a text file holding either the 3x3 rotation R_body_camera, with a zero
+ * translation, or the 4x4 transform T_body_camera, row by row. Lines starting
+ * with '#' are skipped.
+ *
+ * @param path
+ * @param R_body_camera: output
+ * @param t_body_camera: output, camera position in the body frame
+ * @return true if the file held a valid rotation
+ */
+bool load_camera_extrinsic(const std::string& path,
+                           Eigen::Matrix3d& R_body_camera,
+                           Eigen::Vector3d& t_body_camera);
+
+/**
+ * @brief Function to read the camera to IMU body rotation from a text file,
+ * see load_camera_extrinsic
+ *
+ * @param path
+ * @param R_body_camera: output
+ * @return true if the file held a valid rotation
+ */
+bool load_camera_rotation(const std::string& path,
+                          Eigen::Matrix3d& R_body_camera);
+
+}  // namespace dl
@@ -10,8 +10,12 @@
  */
 
 #include "data_loader.hpp"
+#include <algorithm>
+#include <limits>
 #include <tuple>
 
+#include "tracer.hpp"
+
 /**
  * @brief Construct a new dl::Data Loader::Data Loader object
  *
@@ -30,24 +34,36 @@ dl::DataLoader::DataLoader(const std::string& dataset_location) {
   // Initialize the first valid timestamp
   first_valid_timestamp = 0.0;
 
-  // Open the IMU file
-  std::string imu_file_path = dataset_location + "/imu.txt";
-  imu_file.open(imu_file_path);
-  if (!imu_file.is_open()) {
-    std::cerr << "Error opening file: " << imu_file_path << std::endl;
+  // Images are decoded synchronously until prefetch is enabled
+  image_list_done = false;
+
+  // Decode to BGR unless grayscale is requested
+  image_color = ImageColor::kColor;
+
+  // Every image is read until a start time is set
+  image_start_time = std::numeric_limits<double>::lowest();
+
+  // IMU samples are served from the parsed log
+  imu_index = 0;
+  imu_loaded = false;
+
+  // Stream a packed dataset straight from the mapping when one is given
+  packed_image_index = 0;
+  if (PackedDataset::is_pack_file(dataset_location)) {
+    packed_dataset.reset(new PackedDataset());
+    if (packed_dataset->open(dataset_location)) {
+      load_packed_imu_data();
+      load_packed_gt_data();
+      return;
+    }
+    packed_dataset.reset();
   }
-  // Skip the header line
-  std::string header;
-  std::getline(imu_file, header);
 
-  // Open the ground truth file
-  std::string gt_file_path = dataset_location + "/groundtruth.txt";
-  gt_file.open(gt_file_path);
-  if (!gt_file.is_open()) {
-    std::cerr << "Error opening file: " << gt_file_path << std::endl;
+  // Parse the IMU file
+  {
+    PF_TRACE_SCOPE("dl.parse_imu");
+    imu_loaded = parse_imu_file(dataset_location + "/imu.txt", imu_log);
   }
-  // Skip the header line
-  std::getline(gt_file, header);
 
   // Add this in your constructor along with the other file openings:
   std::string image_file_path = dataset_location + "/images.txt";
@@ -56,6 +72,7 @@ dl::DataLoader::DataLoader(const std::string& dataset_location) {
     std::cerr << "Error opening file: " << image_file_path << std::endl;
   }
   // Skip the header line if needed
+  std::string header;
   std::getline(image_file, header);
 
   // Parse the ground truth data
@@ -67,10 +84,6 @@ dl::DataLoader::DataLoader(const std::string& dataset_location) {
  *
  */
 dl::DataLoader::~DataLoader() {
-  if (imu_file.is_open()) imu_file.close();
-
-  if (gt_file.is_open()) gt_file.close();
-
   if (image_file.is_open()) image_file.close();
 }
 
@@ -81,34 +94,21 @@ dl::DataLoader::~DataLoader() {
  */
 std::tuple<long double, Eigen::Vector3d, Eigen::Vector3d>
 dl::DataLoader::get_imu_data() {
-
-  // Check if the file was successfully opened
-  if (!imu_file.is_open()) {
+  // Check if the file was successfully read
+  if (!imu_loaded) {
     std::cerr << "IMU file not open. Returning default error tuple.\n";
     return {-1.0, Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero()};
   }
 
-  if (imu_file.eof())
+  if (imu_index == imu_log.size())
     return {-1.0, Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero()};
 
-  std::string line;
-  if (std::getline(imu_file, line)) {
-    std::istringstream iss(line);
-    long double id;  // To capture the ID value but not use it
-    long double timestamp;
-    long double ang_vel_x, ang_vel_y, ang_vel_z;
-    long double lin_acc_x, lin_acc_y, lin_acc_z;
-
-    // Read ID and timestamp, then the rest of the values
-    if (iss >> id >> timestamp >> ang_vel_x >> ang_vel_y >> ang_vel_z >>
-        lin_acc_x >> lin_acc_y >> lin_acc_z) {
-      Eigen::Vector3d angular_velocity(ang_vel_x, ang_vel_y, ang_vel_z);
-      Eigen::Vector3d linear_acceleration(lin_acc_x, lin_acc_y, lin_acc_z);
-      return {timestamp, angular_velocity, linear_acceleration};
-    }
-  }
-
-  return {-1.0, Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero()};
+  size_t i = imu_index++;
+  Eigen::Vector3d angular_velocity(imu_log.gyro_x[i], imu_log.gyro_y[i],
+                                   imu_log.gyro_z[i]);
+  Eigen::Vector3d linear_acceleration(imu_log.accel_x[i], imu_log.accel_y[i],
+                                      imu_log.accel_z[i]);
+  return {imu_log.timestamp[i], angular_velocity, linear_acceleration};
 }
 
 /**
@@ -116,33 +116,120 @@ dl::DataLoader::get_imu_data() {
  *
  */
 void dl::DataLoader::parse_gt_data() {
-  std::string line;
-  bool first_line = true;
-
-  while (std::getline(gt_file, line)) {
-    if (line[0] == '#') continue;  // Skip comments
-
-    std::istringstream iss(line);
-    long double timestamp, tx, ty, tz, qx, qy, qz, qw;
-
-    if (iss >> timestamp >> tx >> ty >> tz >> qx >> qy >> qz >> qw) {
-      // Store the values in respective vectors
-      if (first_line) {
-        start_gt_time = timestamp;
-        first_line = false;
-      }
-      finish_gt_time = timestamp;
-
-      x_gt.push_back(tx);
-      y_gt.push_back(ty);
-      z_gt.push_back(tz);
-      qx_gt.push_back(qx);
-      qy_gt.push_back(qy);
-      qz_gt.push_back(qz);
-      qw_gt.push_back(qw);
-    }
+  PF_TRACE_SCOPE("dl.parse_gt");
+  GroundTruthLog gt_log;
+  if (!parse_gt_file(dataset_path + "/groundtruth.txt", gt_log) ||
+      gt_log.size() == 0)
+    return;
+
+  start_gt_time = gt_log.timestamp.front();
+  finish_gt_time = gt_log.timestamp.back();
+
+  // Store the values in respective vectors
+  x_gt.assign(gt_log.x.begin(), gt_log.x.end());
+  y_gt.assign(gt_log.y.begin(), gt_log.y.end());
+  z_gt.assign(gt_log.z.begin(), gt_log.z.end());
+  qx_gt.assign(gt_log.qx.begin(), gt_log.qx.end());
+  qy_gt.assign(gt_log.qy.begin(), gt_log.qy.end());
+  qz_gt.assign(gt_log.qz.begin(), gt_log.qz.end());
+  qw_gt.assign(gt_log.qw.begin(), gt_log.qw.end());
+
+  normalize_gt_data();
+}
+
+/**
+ * @brief Function to get the next block of IMU samples
+ *
+ * @param max_samples
+ * @return io::ImuSpan
+ */
+io::ImuSpan dl::DataLoader::get_imu_block(size_t max_samples) {
+  PF_TRACE_SCOPE("dl.imu_block");
+  io::ImuSpan block = imu_log.span().subspan(imu_index, max_samples);
+  imu_index += block.size;
+  return block;
+}
+
+/**
+ * @brief Function to get all IMU samples within a time window
+ *
+ * @param start_time
+ * @param finish_time
+ * @return io::ImuSpan
+ */
+io::ImuSpan dl::DataLoader::get_imu_span(double start_time,
+                                         double finish_time) const {
+  PF_TRACE_SCOPE("dl.imu_span");
+  // Timestamps are sorted, so the window is found by binary search
+  auto first = std::lower_bound(imu_log.timestamp.begin(),
+                                imu_log.timestamp.end(), start_time);
+  auto last = std::upper_bound(first, imu_log.timestamp.end(), finish_time);
+
+  return imu_log.span().subspan(first - imu_log.timestamp.begin(),
+                                last - first);
+}
+
+/**
+ * @brief Function to fill the IMU columns from the packed dataset
+ *
+ */
+void dl::DataLoader::load_packed_imu_data() {
+  size_t count = packed_dataset->imu_count();
+  imu_log.timestamp.resize(count);
+  imu_log.gyro_x.resize(count);
+  imu_log.gyro_y.resize(count);
+  imu_log.gyro_z.resize(count);
+  imu_log.accel_x.resize(count);
+  imu_log.accel_y.resize(count);
+  imu_log.accel_z.resize(count);
+
+  for (size_t i = 0; i < count; ++i) {
+    const PackedImuRecord& record = packed_dataset->imu_record(i);
+    imu_log.timestamp[i] = record.timestamp;
+    imu_log.gyro_x[i] = record.angular_velocity[0];
+    imu_log.gyro_y[i] = record.angular_velocity[1];
+    imu_log.gyro_z[i] = record.angular_velocity[2];
+    imu_log.accel_x[i] = record.linear_acceleration[0];
+    imu_log.accel_y[i] = record.linear_acceleration[1];
+    imu_log.accel_z[i] = record.linear_acceleration[2];
   }
 
+  imu_loaded = true;
+}
+
+/**
+ * @brief Function to fill the ground truth vectors from the packed dataset
+ *
+ */
+void dl::DataLoader::load_packed_gt_data() {
+  size_t count = packed_dataset->gt_count();
+  if (count == 0) return;
+
+  start_gt_time = packed_dataset->gt_record(0).timestamp;
+  finish_gt_time = packed_dataset->gt_record(count - 1).timestamp;
+
+  for (size_t i = 0; i < count; ++i) {
+    const PackedGtRecord& record = packed_dataset->gt_record(i);
+    x_gt.push_back(record.position[0]);
+    y_gt.push_back(record.position[1]);
+    z_gt.push_back(record.position[2]);
+    qx_gt.push_back(record.orientation[0]);
+    qy_gt.push_back(record.orientation[1]);
+    qz_gt.push_back(record.orientation[2]);
+    qw_gt.push_back(record.orientation[3]);
+  }
+
+  normalize_gt_data();
+}
+
+/**
+ * @brief Function to move the ground truth to start at the origin with
+ * identity orientation
+ *
+ */
+void dl::DataLoader::normalize_gt_data() {
+  if (x_gt.empty()) return;
+
   // Shift x, y, z to start at origin
   long double x_offset = x_gt[0];
   long double y_offset = y_gt[0];
@@ -191,33 +278,240 @@ void dl::DataLoader::parse_gt_data() {
     qz_gt[i] = unrotated_quaternion.z();
     qw_gt[i] = unrotated_quaternion.w();
   }
-
-  gt_file.close();
 }
 
 /**
- * @brief Function to get the image data from the dataset
+ * @brief Function to read the next entry of the image list
  *
+ * @param timestamp
+ * @param image_path
+ * @return true if an entry was read
  */
-std::tuple<double, cv::Mat, std::string> dl::DataLoader::get_image_data() {
+bool dl::DataLoader::read_image_entry(double& timestamp,
+                                      std::string& image_path) {
+  // Entries drained from the prefetcher come before the rest of the list
+  if (!drained_frames.empty()) {
+    timestamp = drained_frames.front().timestamp;
+    image_path = std::move(drained_frames.front().image_path);
+    drained_frames.pop_front();
+    return true;
+  }
+
+  if (packed_dataset) {
+    if (packed_image_index == packed_dataset->image_count()) return false;
+
+    timestamp = packed_dataset->image_record(packed_image_index).timestamp;
+    image_path = packed_dataset->image_path(packed_image_index++);
+    return true;
+  }
+
   std::string line;
-  if (std::getline(image_file, line)) {
-    std::istringstream iss(line);
-    int id;
-    double timestamp;
-    std::string image_path;
-
-    // If parsing fails, return an empty image
-    if (!(iss >> id >> timestamp >> image_path)) {
-      return std::make_tuple(-1.0, cv::Mat(), image_path);
+  if (!std::getline(image_file, line)) return false;
+
+  std::istringstream iss(line);
+  int id;
+
+  // If parsing fails, report an invalid timestamp
+  if (!(iss >> id >> timestamp >> image_path)) timestamp = -1.0;
+
+  return true;
+}
+
+/**
+ * @brief Function to decode an image of the dataset
+ *
+ * @param image_path
+ * @return cv::Mat
+ */
+cv::Mat dl::DataLoader::load_image(const std::string& image_path) const {
+  cv::Mat image;
+  load_image(image_path, image);
+  return image;
+}
+
+/**
+ * @brief Function to decode an image of the dataset into a reusable buffer
+ *
+ * @param image_path
+ * @param image
+ * @return true if the image was decoded
+ */
+bool dl::DataLoader::load_image(const std::string& image_path,
+                                cv::Mat& image) const {
+  if (packed_dataset) {
+    size_t index;
+    cv::Mat packed_image;
+    if (packed_dataset->find_image(image_path, index))
+      packed_image = packed_dataset->image(index);
+    if (packed_image.empty()) {
+      image.release();
+      return false;
     }
 
-    // If this is the first valid image, store the timestamp
+    // Copy out of the read-only mapping, converting if the pack was written
+    // in the other color format
+    int channels = image_color == ImageColor::kGrayscale ? 1 : 3;
+    if (packed_image.channels() == channels)
+      packed_image.copyTo(image);
+    else if (channels == 1)
+      cv::cvtColor(packed_image, image, cv::COLOR_BGR2GRAY);
+    else
+      cv::cvtColor(packed_image, image, cv::COLOR_GRAY2BGR);
+    return true;
+  }
+
+  // Encoded bytes are staged in a per-thread buffer that is reused
+  thread_local std::vector<uchar> file_buffer;
+
+  {
+    PF_TRACE_SCOPE("dl.read_file");
     std::string full_image_path = dataset_path + "/" + image_path;
-    cv::Mat image = cv::imread(full_image_path, cv::IMREAD_COLOR);
-    return std::make_tuple(timestamp, image, image_path);
+    std::ifstream file(full_image_path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+      image.release();
+      return false;
+    }
+
+    std::streamsize size = file.tellg();
+    file.seekg(0, std::ios::beg);
+    file_buffer.resize(static_cast<size_t>(size));
+    if (size <= 0 ||
+        !file.read(reinterpret_cast<char*>(file_buffer.data()), size)) {
+      image.release();
+      return false;
+    }
+  }
+
+  // Decode straight into the caller's buffer
+  PF_TRACE_SCOPE("dl.decode");
+  int flags = image_color == ImageColor::kGrayscale ? cv::IMREAD_GRAYSCALE
+                                                    : cv::IMREAD_COLOR;
+  cv::imdecode(file_buffer, flags, &image);
+  return !image.empty();
+}
+
+/**
+ * @brief Function to choose the color format images are decoded to
+ *
+ * @param color
+ */
+void dl::DataLoader::set_image_color(ImageColor color) { image_color = color; }
+
+/**
+ * @brief Function to get the color format images are decoded to
+ *
+ * @return ImageColor
+ */
+dl::ImageColor dl::DataLoader::get_image_color() const { return image_color; }
+
+/**
+ * @brief Function to skip the images before a timestamp
+ *
+ * @param start_time
+ */
+void dl::DataLoader::set_image_start_time(double start_time) {
+  image_start_time = start_time;
+}
+
+/**
+ * @brief Function to decode upcoming images in the background
+ *
+ * @param window
+ * @param workers
+ */
+void dl::DataLoader::enable_prefetch(size_t window, size_t workers) {
+  image_prefetcher.reset(new ImagePrefetcher(
+      window, workers,
+      [this](const std::string& image_path, cv::Mat& image) {
+        return load_image(image_path, image);
+      }));
+}
+
+/**
+ * @brief Function to go back to synchronous decoding
+ *
+ */
+void dl::DataLoader::disable_prefetch() {
+  if (!image_prefetcher) return;
+
+  // The submitted entries are already gone from the image list
+  for (;;) {
+    ImageFrame frame;
+    if (!image_prefetcher->pop(frame)) break;
+    drained_frames.push_back(std::move(frame));
   }
+  image_prefetcher.reset();
+}
+
+/**
+ * @brief Function to check whether upcoming images are decoded in the
+ * background
+ *
+ * @return true if prefetch is on
+ */
+bool dl::DataLoader::is_prefetching() const {
+  return image_prefetcher != nullptr;
+}
+
+/**
+ * @brief Function to get the image data from the dataset
+ *
+ */
+std::tuple<double, cv::Mat, std::string> dl::DataLoader::get_image_data() {
+  ImageFrame frame;
 
   // No more images to read
-  return std::make_tuple(-1.0, cv::Mat(), "none");
+  if (!read_image(frame)) return std::make_tuple(-1.0, cv::Mat(), "none");
+
+  return std::make_tuple(frame.timestamp, frame.image, frame.image_path);
+}
+
+/**
+ * @brief Function to read the next image of the dataset into a reusable frame
+ *
+ * @param frame
+ * @return true if an entry was read
+ */
+bool dl::DataLoader::read_image(ImageFrame& frame) {
+  PF_TRACE_SCOPE("dl.read_image");
+  if (!drained_frames.empty()) {
+    frame = std::move(drained_frames.front());
+    drained_frames.pop_front();
+    return true;
+  }
+
+  if (image_prefetcher) {
+    // Hand out the oldest entry, decoded in the background
+    fill_prefetch_window();
+    return image_prefetcher->pop(frame);
+  }
+
+  do {
+    if (!read_image_entry(frame.timestamp, frame.image_path)) return false;
+  } while (frame.timestamp != -1.0 && frame.timestamp < image_start_time);
+
+  // If parsing fails, return an empty image
+  if (frame.timestamp == -1.0)
+    frame.image.release();
+  else
+    load_image(frame.image_path, frame.image);
+
+  return true;
+}
+
+/**
+ * @brief Function to top up the prefetch window from the image list
+ *
+ */
+void dl::DataLoader::fill_prefetch_window() {
+  double timestamp;
+  std::string image_path;
+  while (!image_list_done && image_prefetcher->has_free_slot()) {
+    if (!read_image_entry(timestamp, image_path)) {
+      image_list_done = true;
+      break;
+    }
+    if (timestamp != -1.0 && timestamp < image_start_time) continue;
+    image_prefetcher->submit(timestamp, image_path);
+  }
 }
@@ -13,15 +13,22 @@
 
 // #include <eigen3/Eigen/src/Core/Matrix.h>
 
+#include <deque>
 #include <eigen3/Eigen/Dense>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <opencv2/core/mat.hpp>
 #include <opencv2/opencv.hpp>
 #include <sstream>
 #include <string>
 #include <vector>
 
+#include "image_frame.hpp"
+#include "image_prefetcher.hpp"
+#include "packed_dataset.hpp"
+#include "text_parser.hpp"
+
 /**
  * @brief Namespace for DataLoader class
  *
@@ -35,16 +42,22 @@ namespace dl {
 class DataLoader {
  private:
   /**
-   * @brief File stream object for IMU data
+   * @brief IMU samples parsed from imu.txt
    *
    */
-  std::ifstream imu_file;
+  ImuLog imu_log;
 
   /**
-   * @brief File stream object for ground truth data
+   * @brief Next IMU sample returned by get_imu_data
    *
    */
-  std::ifstream gt_file;
+  size_t imu_index;
+
+  /**
+   * @brief Flag to track if imu.txt could be read
+   *
+   */
+  bool imu_loaded;
 
   /**
    * @brief File stream object for image data
@@ -76,6 +89,76 @@ class DataLoader {
    */
   double first_valid_timestamp;
 
+  /**
+   * @brief Background decoder of upcoming images, null when prefetch is off
+   *
+   */
+  std::unique_ptr<ImagePrefetcher> image_prefetcher;
+
+  /**
+   * @brief Entries the prefetcher had taken from the image list when it was
+   * disabled, handed out before the list continues
+   *
+   */
+  std::deque<ImageFrame> drained_frames;
+
+  /**
+   * @brief Flag to track if the image list has been read to the end
+   *
+   */
+  bool image_list_done;
+
+  /**
+   * @brief Color format images are decoded to
+   *
+   */
+  ImageColor image_color;
+
+  /**
+   * @brief Images before this timestamp are skipped by read_image and the
+   * prefetcher without being decoded
+   *
+   */
+  double image_start_time;
+
+  /**
+   * @brief Packed dataset backend, null when reading the text dataset
+   *
+   */
+  std::unique_ptr<PackedDataset> packed_dataset;
+
+  /**
+   * @brief Next image table entry of the packed dataset
+   *
+   */
+  size_t packed_image_index;
+
+
+  /**
+   * @brief Function to top up the prefetch window from the image list
+   *
+   */
+  void fill_prefetch_window();
+
+  /**
+   * @brief Function to fill the ground truth vectors from the packed dataset
+   *
+   */
+  void load_packed_gt_data();
+
+  /**
+   * @brief Function to fill the IMU columns from the packed dataset
+   *
+   */
+  void load_packed_imu_data();
+
+  /**
+   * @brief Function to move the ground truth to start at the origin with
+   * identity orientation
+   *
+   */
+  void normalize_gt_data();
+
  public:
   /**
    * @brief Ground truth position vectors
@@ -104,7 +187,8 @@ class DataLoader {
   /**
    * @brief Construct a new DataLoader object
    *
-   * @param dataset_location Path to the dataset
+   * @param dataset_location Path to the dataset directory, or to a packed
+   * dataset file written by PackedDataset::write
    */
   DataLoader(const std::string& dataset_location);
 
@@ -122,6 +206,26 @@ class DataLoader {
    */
   std::tuple<long double, Eigen::Vector3d, Eigen::Vector3d> get_imu_data();
 
+  /**
+   * @brief Function to get the next block of IMU samples. Shares its read
+   * position with get_imu_data.
+   *
+   * @param max_samples: maximum number of samples in the block
+   * @return io::ImuSpan: view valid for the lifetime of the loader, empty at
+   * the end of the data
+   */
+  io::ImuSpan get_imu_block(size_t max_samples);
+
+  /**
+   * @brief Function to get all IMU samples within a time window, independent
+   * of the read position
+   *
+   * @param start_time: first timestamp included
+   * @param finish_time: last timestamp included
+   * @return io::ImuSpan: view valid for the lifetime of the loader
+   */
+  io::ImuSpan get_imu_span(double start_time, double finish_time) const;
+
   /**
    * @brief Function to parse the ground truth data
    *
@@ -129,10 +233,100 @@ class DataLoader {
   void parse_gt_data();
 
   /**
-   * @brief Function to get the image data from the dataset
+   * @brief Function to get the image data from the dataset. Wraps read_image
+   * with a fresh frame per call, prefer read_image on hot paths.
    *
    */
   std::tuple<double, cv::Mat, std::string> get_image_data();
+
+  /**
+   * @brief Function to read the next image of the dataset into a reusable
+   * frame. The image is decoded into the frame's existing buffer when its
+   * size and type match, so clone images that must outlive the next call.
+   *
+   * @param frame: output frame, timestamp -1 if the entry could not be parsed
+   * @return true if an entry was read, false at the end of the list
+   */
+  bool read_image(ImageFrame& frame);
+
+  /**
+   * @brief Function to read the next entry of the image list without
+   * decoding the image
+   *
+   * @param timestamp: image timestamp, -1 if the line could not be parsed
+   * @param image_path: image path relative to the dataset
+   * @return true if an entry was read, false at the end of the list
+   */
+  bool read_image_entry(double& timestamp, std::string& image_path);
+
+  /**
+   * @brief Function to decode an image of the dataset. Does not touch the
+   * loader's file streams, so it may be called from several threads.
+   *
+   * @param image_path: image path relative to the dataset
+   * @return cv::Mat
+   */
+  cv::Mat load_image(const std::string& image_path) const;
+
+  /**
+   * @brief Function to decode an image of the dataset into a reusable
+   * buffer. Thread-safe like the overload above.
+   *
+   * @param image_path: image path relative to the dataset
+   * @param image: output image, reallocated only if its size or type differ;
+   * released if decoding fails
+   * @return true if the image was decoded
+   */
+  bool load_image(const std::string& image_path, cv::Mat& image) const;
+
+  /**
+   * @brief Function to choose the color format images are decoded to. Call
+   * before reading images.
+   *
+   * @param color
+   */
+  void set_image_color(ImageColor color);
+
+  /**
+   * @brief Function to get the color format images are decoded to
+   *
+   * @return ImageColor
+   */
+  ImageColor get_image_color() const;
+
+  /**
+   * @brief Function to skip the images before a timestamp in read_image and
+   * the prefetcher, without decoding them. Call before reading images.
+   *
+   * @param start_time
+   */
+  void set_image_start_time(double start_time);
+
+  /**
+   * @brief Function to decode upcoming images in the background, so that
+   * get_image_data returns already-decoded frames
+   *
+   * @param window: number of images decoded ahead of the consumer
+   * @param workers: number of decoding threads
+   */
+  void enable_prefetch(size_t window, size_t workers);
+
+  /**
+   * @brief Function to go back to synchronous decoding. Entries already
+   * submitted are decoded to the end and still handed out first, so reading
+   * continues with the next image the consumer has not seen.
+   *
+   */
+  void disable_prefetch();
+
+  /**
+   * @brief Function to check whether upcoming images are decoded in the
+   * background. The image list is then read ahead by the prefetcher, so
+   * consumers must go through read_image instead of read_image_entry.
+   *
+   * @return true if prefetch is on
+   */
+  bool is_prefetching() const;
 };
 
 };  // namespace dl
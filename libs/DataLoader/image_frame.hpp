@@ -0,0 +1,62 @@
+/**
+ * @file image_frame.hpp
+ * @author Apoorv Thapliyal
+ * @brief C++ header file for the image frame returned by the DataLoader
+ * @version 0.1
+ * @date 2024-11-13
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <opencv2/core/mat.hpp>
+#include <string>
+
+namespace dl {
+
+/**
+ * @brief Color format images are decoded to
+ *
+ */
+enum class ImageColor {
+  /**
+   * @brief 3-channel BGR image
+   *
+   */
+  kColor,
+
+  /**
+   * @brief Single-channel grayscale image, decoded without a color pass
+   *
+   */
+  kGrayscale
+};
+
+/**
+ * @brief One entry of the image list with its decoded image. Reusing the
+ * same object across reads recycles its image and path buffers.
+ *
+ */
+struct ImageFrame {
+  /**
+   * @brief Image timestamp, -1 if the list entry could not be parsed
+   *
+   */
+  double timestamp = -1.0;
+
+  /**
+   * @brief Decoded image, empty if decoding failed
+   *
+   */
+  cv::Mat image;
+
+  /**
+   * @brief Image path relative to the dataset
+   *
+   */
+  std::string image_path;
+};
+
+}  // namespace dl
@@ -0,0 +1,144 @@
+/**
+ * @file image_prefetcher.cpp
+ * @author Apoorv Thapliyal
+ * @brief C++ source file for the asynchronous image prefetcher
+ * @version 0.1
+ * @date 2024-11-12
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "image_prefetcher.hpp"
+
+#include <algorithm>
+
+/**
+ * @brief Construct a new dl::Image Prefetcher::Image Prefetcher object
+ *
+ * @param window
+ * @param worker_count
+ * @param decode
+ */
+dl::ImagePrefetcher::ImagePrefetcher(
+    size_t window, size_t worker_count,
+    std::function<bool(const std::string&, cv::Mat&)> decode)
+    : slots(std::max<size_t>(1, window)),
+      head(0),
+      in_flight(0),
+      decode(std::move(decode)),
+      stopping(false) {
+  worker_count = std::max<size_t>(1, worker_count);
+  for (size_t i = 0; i < worker_count; i++)
+    workers.emplace_back(&ImagePrefetcher::worker_loop, this);
+}
+
+/**
+ * @brief Destroy the dl::Image Prefetcher::Image Prefetcher object
+ *
+ */
+dl::ImagePrefetcher::~ImagePrefetcher() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  work_available.notify_all();
+  for (std::thread& worker : workers) worker.join();
+}
+
+/**
+ * @brief Function run by every decoding thread
+ *
+ */
+void dl::ImagePrefetcher::worker_loop() {
+  std::unique_lock<std::mutex> lock(mutex);
+  for (;;) {
+    work_available.wait(lock, [this]() { return stopping || !pending.empty(); });
+    if (stopping) return;
+
+    size_t index = pending.front();
+    pending.pop_front();
+
+    // A pending slot is only touched by the worker that took it, so it is
+    // decoded in place without holding the lock
+    ImageFrame& frame = slots[index].frame;
+    lock.unlock();
+    decode(frame.image_path, frame.image);
+    lock.lock();
+
+    slots[index].ready = true;
+    slot_ready.notify_all();
+  }
+}
+
+/**
+ * @brief Function to check if another entry can be submitted
+ *
+ * @return true if a slot is free
+ */
+bool dl::ImagePrefetcher::has_free_slot() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return in_flight < slots.size();
+}
+
+/**
+ * @brief Function to check if no entries are in flight
+ *
+ * @return true if nothing is left to pop
+ */
+bool dl::ImagePrefetcher::empty() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return in_flight == 0;
+}
+
+/**
+ * @brief Function to queue an image list entry for decoding
+ *
+ * @param timestamp
+ * @param image_path
+ */
+void dl::ImagePrefetcher::submit(double timestamp,
+                                 const std::string& image_path) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (in_flight == slots.size()) return;
+
+    size_t index = (head + in_flight) % slots.size();
+    Slot& slot = slots[index];
+    slot.frame.timestamp = timestamp;
+    slot.frame.image_path = image_path;
+    slot.ready = timestamp == -1.0;
+    in_flight++;
+
+    // Unparsable entries are passed through without an image
+    if (slot.ready) {
+      slot.frame.image.release();
+      return;
+    }
+    pending.push_back(index);
+  }
+  work_available.notify_one();
+}
+
+/**
+ * @brief Function to take the oldest entry, waiting for its decode
+ *
+ * @param frame
+ * @return true if an entry was popped
+ */
+bool dl::ImagePrefetcher::pop(ImageFrame& frame) {
+  std::unique_lock<std::mutex> lock(mutex);
+  if (in_flight == 0) return false;
+
+  Slot& slot = slots[head];
+  slot_ready.wait(lock, [&slot]() { return slot.ready; });
+
+  // Exchange buffers, the caller's previous ones are reused by the slot
+  frame.timestamp = slot.frame.timestamp;
+  frame.image_path.swap(slot.frame.image_path);
+  cv::swap(frame.image, slot.frame.image);
+
+  head = (head + 1) % slots.size();
+  in_flight--;
+  return true;
+}
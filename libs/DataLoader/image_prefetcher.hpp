@@ -0,0 +1,166 @@
+/**
+ * @file image_prefetcher.hpp
+ * @author Apoorv Thapliyal
+ * @brief C++ header file for the asynchronous image prefetcher
+ * @version 0.1
+ * @date 2024-11-12
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <opencv2/core/mat.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "image_frame.hpp"
+
+namespace dl {
+
+/**
+ * @brief Decodes upcoming images on a worker pool into a ring buffer of
+ * look-ahead slots. Entries are submitted and popped in order from a single
+ * consumer thread; only decoding runs in the background. Popping exchanges
+ * image buffers with the caller, so decodes reuse recycled allocations.
+ *
+ */
+class ImagePrefetcher {
+ private:
+  /**
+   * @brief One look-ahead slot of the ring buffer
+   *
+   */
+  struct Slot {
+    ImageFrame frame;
+    bool ready = false;
+  };
+
+  /**
+   * @brief Ring buffer of look-ahead slots
+   *
+   */
+  std::vector<Slot> slots;
+
+  /**
+   * @brief Ring index of the oldest slot in flight
+   *
+   */
+  size_t head;
+
+  /**
+   * @brief Number of slots in flight
+   *
+   */
+  size_t in_flight;
+
+  /**
+   * @brief Slots waiting for a worker
+   *
+   */
+  std::deque<size_t> pending;
+
+  /**
+   * @brief Function decoding an image path, called from the workers
+   *
+   */
+  std::function<bool(const std::string&, cv::Mat&)> decode;
+
+  /**
+   * @brief Mutex guarding the slots and the pending list
+   *
+   */
+  std::mutex mutex;
+
+  /**
+   * @brief Signals workers that a slot is pending or the pool is stopping
+   *
+   */
+  std::condition_variable work_available;
+
+  /**
+   * @brief Signals the consumer that a slot finished decoding
+   *
+   */
+  std::condition_variable slot_ready;
+
+  /**
+   * @brief Flag telling the workers to exit
+   *
+   */
+  bool stopping;
+
+  /**
+   * @brief Decoding threads
+   *
+   */
+  std::vector<std::thread> workers;
+
+  /**
+   * @brief Function run by every decoding thread
+   *
+   */
+  void worker_loop();
+
+ public:
+  /**
+   * @brief Construct a new Image Prefetcher object
+   *
+   * @param window: number of look-ahead slots
+   * @param worker_count: number of decoding threads
+   * @param decode: thread-safe function decoding an image path into a
+   * reusable buffer
+   */
+  ImagePrefetcher(size_t window, size_t worker_count,
+                  std::function<bool(const std::string&, cv::Mat&)> decode);
+
+  /**
+   * @brief Destroy the Image Prefetcher object, abandoning pending decodes
+   *
+   */
+  ~ImagePrefetcher();
+
+  ImagePrefetcher(const ImagePrefetcher&) = delete;
+  ImagePrefetcher& operator=(const ImagePrefetcher&) = delete;
+
+  /**
+   * @brief Function to check if another entry can be submitted
+   *
+   * @return true if a slot is free
+   */
+  bool has_free_slot();
+
+  /**
+   * @brief Function to check if no entries are in flight
+   *
+   * @return true if nothing is left to pop
+   */
+  bool empty();
+
+  /**
+   * @brief Function to queue an image list entry for decoding
+   *
+   * @param timestamp: image timestamp, -1 for an unparsable entry that is
+   * passed through without decoding
+   * @param image_path: image path relative to the dataset
+   */
+  void submit(double timestamp, const std::string& image_path);
+
+  /**
+   * @brief Function to take the oldest entry, waiting for its decode. The
+   * frame's previous image buffer is handed back to the ring for reuse, so
+   * no other references to it may be kept.
+   *
+   * @param frame: output frame
+   * @return true if an entry was popped, false if nothing was in flight
+   */
+  bool pop(ImageFrame& frame);
+};
+
+}  // namespace dl
@@ -0,0 +1,99 @@
+/**
+ * @file mapped_file.cpp
+ * @author Apoorv Thapliyal
+ * @brief C++ source file for read-only memory-mapped files
+ * @version 0.1
+ * @date 2024-11-15
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "mapped_file.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * @brief Construct a closed dl::Mapped File::Mapped File object
+ *
+ */
+dl::MappedFile::MappedFile()
+    : mapping(nullptr), mapping_size(0), opened(false) {}
+
+/**
+ * @brief Destroy the dl::Mapped File::Mapped File object
+ *
+ */
+dl::MappedFile::~MappedFile() { close(); }
+
+/**
+ * @brief Function to map a file
+ *
+ * @param path
+ * @param sequential
+ * @return true if the file was mapped
+ */
+bool dl::MappedFile::open(const std::string& path, bool sequential) {
+  close();
+
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode)) {
+    ::close(fd);
+    return false;
+  }
+
+  // Empty files cannot be mapped, but are valid
+  size_t file_size = static_cast<size_t>(file_stat.st_size);
+  if (file_size > 0) {
+    void* address = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (address == MAP_FAILED) {
+      ::close(fd);
+      return false;
+    }
+    madvise(address, file_size, sequential ? MADV_SEQUENTIAL : MADV_NORMAL);
+    mapping = static_cast<const char*>(address);
+  }
+  ::close(fd);
+
+  mapping_size = file_size;
+  opened = true;
+  return true;
+}
+
+/**
+ * @brief Function to unmap the file
+ *
+ */
+void dl::MappedFile::close() {
+  if (mapping) munmap(const_cast<char*>(mapping), mapping_size);
+  mapping = nullptr;
+  mapping_size = 0;
+  opened = false;
+}
+
+/**
+ * @brief Function to check if a file is mapped
+ *
+ * @return true if open
+ */
+bool dl::MappedFile::is_open() const { return opened; }
+
+/**
+ * @brief Function to get the start of the mapping
+ *
+ * @return const char*
+ */
+const char* dl::MappedFile::data() const { return mapping; }
+
+/**
+ * @brief Function to get the size of the mapping in bytes
+ *
+ * @return size_t
+ */
+size_t dl::MappedFile::size() const { return mapping_size; }
@@ -0,0 +1,96 @@
+/**
+ * @file mapped_file.hpp
+ * @author Apoorv Thapliyal
+ * @brief C++ header file for read-only memory-mapped files
+ * @version 0.1
+ * @date 2024-11-15
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace dl {
+
+/**
+ * @brief Read-only memory mapping of a whole file
+ *
+ */
+class MappedFile {
+ private:
+  /**
+   * @brief Start of the mapping, null when closed or empty
+   *
+   */
+  const char* mapping;
+
+  /**
+   * @brief Size of the mapping in bytes
+   *
+   */
+  size_t mapping_size;
+
+  /**
+   * @brief Flag to track if a file is open
+   *
+   */
+  bool opened;
+
+ public:
+  /**
+   * @brief Construct a closed Mapped File object
+   *
+   */
+  MappedFile();
+
+  /**
+   * @brief Destroy the Mapped File object, unmapping the file
+   *
+   */
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  /**
+   * @brief Function to map a file
+   *
+   * @param path
+   * @param sequential: hint that the file is read front to back
+   * @return true if the file was mapped
+   */
+  bool open(const std::string& path, bool sequential = true);
+
+  /**
+   * @brief Function to unmap the file
+   *
+   */
+  void close();
+
+  /**
+   * @brief Function to check if a file is mapped
+   *
+   * @return true if open
+   */
+  bool is_open() const;
+
+  /**
+   * @brief Function to get the start of the mapping
+   *
+   * @return const char*
+   */
+  const char* data() const;
+
+  /**
+   * @brief Function to get the size of the mapping in bytes
+   *
+   * @return size_t
+   */
+  size_t size() const;
+};
+
+}  // namespace dl
@@ -0,0 +1,417 @@
+/**
+ * @file packed_dataset.cpp
+ * @author Apoorv Thapliyal
+ * @brief C++ source file for the packed binary dataset format
+ * @version 0.1
+ * @date 2024-11-14
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "packed_dataset.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "data_loader.hpp"
+#include "text_parser.hpp"
+
+namespace {
+
+/**
+ * @brief Alignment of every section of the file
+ *
+ */
+const uint64_t kSectionAlignment = 64;
+
+/**
+ * @brief Function to round an offset up to the section alignment
+ *
+ * @param offset
+ * @return uint64_t
+ */
+uint64_t align_offset(uint64_t offset) {
+  return (offset + kSectionAlignment - 1) / kSectionAlignment *
+         kSectionAlignment;
+}
+
+/**
+ * @brief Function to pad the file up to the section alignment
+ *
+ * @param file
+ */
+void write_padding(std::ofstream& file) {
+  static const char zeros[kSectionAlignment] = {};
+  uint64_t offset = static_cast<uint64_t>(file.tellp());
+  file.write(zeros, align_offset(offset) - offset);
+}
+
+/**
+ * @brief Function to write a table of fixed-width records
+ *
+ * @tparam T: record type
+ * @param file
+ * @param records
+ * @return uint64_t: offset of the table
+ */
+template <typename T>
+uint64_t write_table(std::ofstream& file, const std::vector<T>& records) {
+  write_padding(file);
+  uint64_t offset = static_cast<uint64_t>(file.tellp());
+  file.write(reinterpret_cast<const char*>(records.data()),
+             records.size() * sizeof(T));
+  return offset;
+}
+
+/**
+ * @brief Function to check that a table of records lies in the file and is
+ * aligned for direct access
+ *
+ * @param offset
+ * @param count
+ * @param record_size
+ * @param file_size
+ * @return true if the table is valid
+ */
+bool table_in_file(uint64_t offset, uint64_t count, size_t record_size,
+                   size_t file_size) {
+  if (offset % alignof(double) != 0 || offset > file_size) return false;
+  return count <= (file_size - offset) / record_size;
+}
+
+}  // namespace
+
+const char dl::PackedDataset::kMagic[8] = {'V', 'I', 'O', 'P', 'A', 'C', 'K', 0};
+
+/**
+ * @brief Construct a closed dl::Packed Dataset::Packed Dataset object
+ *
+ */
+dl::PackedDataset::PackedDataset() : data(nullptr), size(0), header(nullptr) {}
+
+/**
+ * @brief Destroy the dl::Packed Dataset::Packed Dataset object
+ *
+ */
+dl::PackedDataset::~PackedDataset() { close(); }
+
+/**
+ * @brief Function to map a packed dataset
+ *
+ * @param pack_path
+ * @return true if the file was mapped and is consistent
+ */
+bool dl::PackedDataset::open(const std::string& pack_path) {
+  close();
+
+  if (!file.open(pack_path) || file.size() < sizeof(PackHeader)) {
+    std::cerr << "Error opening packed dataset: " << pack_path << std::endl;
+    file.close();
+    return false;
+  }
+
+  data = reinterpret_cast<const uint8_t*>(file.data());
+  size = file.size();
+  header = reinterpret_cast<const PackHeader*>(data);
+
+  if (std::memcmp(header->magic, kMagic, sizeof(kMagic)) != 0 ||
+      header->version != kVersion) {
+    std::cerr << "Unsupported packed dataset: " << pack_path << std::endl;
+    close();
+    return false;
+  }
+
+  if (!validate()) {
+    std::cerr << "Corrupt packed dataset: " << pack_path << std::endl;
+    close();
+    return false;
+  }
+
+  path_index.reserve(image_count());
+  for (size_t i = 0; i < image_count(); i++) path_index[image_path(i)] = i;
+
+  return true;
+}
+
+/**
+ * @brief Function to check that every table and frame lies in the file
+ *
+ * @return true if the file is consistent
+ */
+bool dl::PackedDataset::validate() const {
+  if (!table_in_file(header->image_table_offset, header->image_count,
+                     sizeof(PackedImageRecord), size) ||
+      !table_in_file(header->imu_offset, header->imu_count,
+                     sizeof(PackedImuRecord), size) ||
+      !table_in_file(header->gt_offset, header->gt_count,
+                     sizeof(PackedGtRecord), size))
+    return false;
+
+  for (size_t i = 0; i < image_count(); i++) {
+    const PackedImageRecord& record = image_record(i);
+    if (record.path_offset > size ||
+        record.path_length > size - record.path_offset)
+      return false;
+
+    if (record.rows == 0) continue;
+    if (record.channels != 1 && record.channels != 3) return false;
+
+    uint64_t bytes = static_cast<uint64_t>(record.rows) * record.cols *
+                     record.channels;
+    if (record.data_offset > size || bytes > size - record.data_offset)
+      return false;
+  }
+
+  return true;
+}
+
+/**
+ * @brief Function to unmap the file
+ *
+ */
+void dl::PackedDataset::close() {
+  file.close();
+  data = nullptr;
+  size = 0;
+  header = nullptr;
+  path_index.clear();
+}
+
+/**
+ * @brief Function to check if a file is mapped
+ *
+ * @return true if open
+ */
+bool dl::PackedDataset::is_open() const { return data != nullptr; }
+
+/**
+ * @brief Function to check if a path is a packed dataset file
+ *
+ * @param path
+ * @return true if the file starts with the pack magic
+ */
+bool dl::PackedDataset::is_pack_file(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  char magic[sizeof(kMagic)];
+  if (!file.read(magic, sizeof(magic))) return false;
+  return std::memcmp(magic, kMagic, sizeof(kMagic)) == 0;
+}
+
+/**
+ * @brief Function to get the number of image list entries
+ *
+ * @return size_t
+ */
+size_t dl::PackedDataset::image_count() const {
+  return header ? header->image_count : 0;
+}
+
+/**
+ * @brief Function to get the number of IMU samples
+ *
+ * @return size_t
+ */
+size_t dl::PackedDataset::imu_count() const {
+  return header ? header->imu_count : 0;
+}
+
+/**
+ * @brief Function to get the number of ground truth poses
+ *
+ * @return size_t
+ */
+size_t dl::PackedDataset::gt_count() const {
+  return header ? header->gt_count : 0;
+}
+
+/**
+ * @brief Function to get the index table entry of an image
+ *
+ * @param index
+ * @return const dl::PackedImageRecord&
+ */
+const dl::PackedImageRecord& dl::PackedDataset::image_record(
+    size_t index) const {
+  return reinterpret_cast<const PackedImageRecord*>(
+      data + header->image_table_offset)[index];
+}
+
+/**
+ * @brief Function to get the path of an image relative to the dataset
+ *
+ * @param index
+ * @return std::string
+ */
+std::string dl::PackedDataset::image_path(size_t index) const {
+  const PackedImageRecord& record = image_record(index);
+  return std::string(reinterpret_cast<const char*>(data + record.path_offset),
+                     record.path_length);
+}
+
+/**
+ * @brief Function to get an image without copying
+ *
+ * @param index
+ * @return cv::Mat
+ */
+cv::Mat dl::PackedDataset::image(size_t index) const {
+  const PackedImageRecord& record = image_record(index);
+  if (record.rows == 0) return cv::Mat();
+
+  int type = record.channels == 1 ? CV_8UC1 : CV_8UC3;
+  return cv::Mat(static_cast<int>(record.rows), static_cast<int>(record.cols),
+                 type, const_cast<uint8_t*>(data + record.data_offset));
+}
+
+/**
+ * @brief Function to look up an image by path
+ *
+ * @param image_path
+ * @param index
+ * @return true if the path was found
+ */
+bool dl::PackedDataset::find_image(const std::string& image_path,
+                                   size_t& index) const {
+  auto it = path_index.find(image_path);
+  if (it == path_index.end()) return false;
+  index = it->second;
+  return true;
+}
+
+/**
+ * @brief Function to get an IMU sample
+ *
+ * @param index
+ * @return const dl::PackedImuRecord&
+ */
+const dl::PackedImuRecord& dl::PackedDataset::imu_record(size_t index) const {
+  return reinterpret_cast<const PackedImuRecord*>(data +
+                                                  header->imu_offset)[index];
+}
+
+/**
+ * @brief Function to get a ground truth pose
+ *
+ * @param index
+ * @return const dl::PackedGtRecord&
+ */
+const dl::PackedGtRecord& dl::PackedDataset::gt_record(size_t index) const {
+  return reinterpret_cast<const PackedGtRecord*>(data +
+                                                 header->gt_offset)[index];
+}
+
+/**
+ * @brief Function to convert a text dataset into a packed dataset
+ *
+ * @param dataset_path
+ * @param pack_path
+ * @param color
+ * @return true if the file was written
+ */
+bool dl::PackedDataset::write(const std::string& dataset_path,
+                              const std::string& pack_path,
+                              ImageColor color) {
+  std::ofstream file(pack_path, std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    std::cerr << "Error opening file: " << pack_path << std::endl;
+    return false;
+  }
+
+  // The header is rewritten once the section offsets are known
+  PackHeader header = {};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.image_channels = color == ImageColor::kGrayscale ? 1 : 3;
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+  // Frames, stored raw in list order
+  DataLoader data_loader(dataset_path);
+  data_loader.set_image_color(color);
+
+  std::vector<PackedImageRecord> image_records;
+  std::string paths;
+  ImageFrame frame;
+  while (data_loader.read_image(frame)) {
+    if (frame.timestamp == -1.0) continue;
+
+    PackedImageRecord record = {};
+    record.timestamp = frame.timestamp;
+    record.path_offset = paths.size();
+    record.path_length = static_cast<uint32_t>(frame.image_path.size());
+    paths += frame.image_path;
+
+    if (!frame.image.empty()) {
+      write_padding(file);
+      record.data_offset = static_cast<uint64_t>(file.tellp());
+      record.rows = static_cast<uint32_t>(frame.image.rows);
+      record.cols = static_cast<uint32_t>(frame.image.cols);
+      record.channels = static_cast<uint32_t>(frame.image.channels());
+
+      size_t row_bytes = frame.image.cols * frame.image.elemSize();
+      for (int row = 0; row < frame.image.rows; row++)
+        file.write(reinterpret_cast<const char*>(frame.image.ptr(row)),
+                   row_bytes);
+    }
+    image_records.push_back(record);
+  }
+
+  // Index table followed by the path strings it points to
+  write_padding(file);
+  header.image_table_offset = static_cast<uint64_t>(file.tellp());
+  header.image_count = image_records.size();
+  uint64_t path_table_offset =
+      align_offset(header.image_table_offset +
+                   image_records.size() * sizeof(PackedImageRecord));
+  for (PackedImageRecord& record : image_records)
+    record.path_offset += path_table_offset;
+  write_table(file, image_records);
+  write_padding(file);
+  file.write(paths.data(), paths.size());
+
+  // IMU samples, the file is optional
+  ImuLog imu_log;
+  parse_imu_file(dataset_path + "/imu.txt", imu_log);
+  std::vector<PackedImuRecord> imu_records(imu_log.size());
+  for (size_t i = 0; i < imu_log.size(); i++) {
+    PackedImuRecord& record = imu_records[i];
+    record.timestamp = imu_log.timestamp[i];
+    record.angular_velocity[0] = imu_log.gyro_x[i];
+    record.angular_velocity[1] = imu_log.gyro_y[i];
+    record.angular_velocity[2] = imu_log.gyro_z[i];
+    record.linear_acceleration[0] = imu_log.accel_x[i];
+    record.linear_acceleration[1] = imu_log.accel_y[i];
+    record.linear_acceleration[2] = imu_log.accel_z[i];
+  }
+  header.imu_offset = write_table(file, imu_records);
+  header.imu_count = imu_records.size();
+
+  // Ground truth poses, stored as recorded
+  GroundTruthLog gt_log;
+  parse_gt_file(dataset_path + "/groundtruth.txt", gt_log);
+  std::vector<PackedGtRecord> gt_records(gt_log.size());
+  for (size_t i = 0; i < gt_log.size(); i++) {
+    PackedGtRecord& record = gt_records[i];
+    record.timestamp = gt_log.timestamp[i];
+    record.position[0] = gt_log.x[i];
+    record.position[1] = gt_log.y[i];
+    record.position[2] = gt_log.z[i];
+    record.orientation[0] = gt_log.qx[i];
+    record.orientation[1] = gt_log.qy[i];
+    record.orientation[2] = gt_log.qz[i];
+    record.orientation[3] = gt_log.qw[i];
+  }
+  header.gt_offset = write_table(file, gt_records);
+  header.gt_count = gt_records.size();
+
+  file.seekp(0);
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+  if (!file.good()) {
+    std::cerr << "Error writing file: " << pack_path << std::endl;
+    return false;
+  }
+  return true;
+}
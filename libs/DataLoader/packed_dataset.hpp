@@ -0,0 +1,264 @@
+/**
+ * @file packed_dataset.hpp
+ * @author Apoorv Thapliyal
+ * @brief C++ header file for the packed binary dataset format
+ * @version 0.1
+ * @date 2024-11-14
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <opencv2/core/mat.hpp>
+#include <string>
+#include <unordered_map>
+
+#include "image_frame.hpp"
+#include "mapped_file.hpp"
+
+namespace dl {
+
+/**
+ * @brief Fixed-width header at the start of a packed dataset. All offsets are
+ * in bytes from the start of the file, all values are little-endian.
+ *
+ * File layout: header, raw 8-bit frames, image index table, image path
+ * strings, IMU records, ground truth records. Sections start on 64-byte
+ * boundaries.
+ *
+ */
+struct PackHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t image_channels;
+  uint64_t image_count;
+  uint64_t imu_count;
+  uint64_t gt_count;
+  uint64_t image_table_offset;
+  uint64_t imu_offset;
+  uint64_t gt_offset;
+};
+
+/**
+ * @brief Index table entry of one image list entry
+ *
+ */
+struct PackedImageRecord {
+  double timestamp;
+  uint64_t data_offset;
+  uint64_t path_offset;
+  uint32_t path_length;
+  uint32_t rows;
+  uint32_t cols;
+  uint32_t channels;
+};
+
+/**
+ * @brief Timestamped IMU sample
+ *
+ */
+struct PackedImuRecord {
+  double timestamp;
+  double angular_velocity[3];
+  double linear_acceleration[3];
+};
+
+/**
+ * @brief Timestamped ground truth pose, as stored in groundtruth.txt
+ *
+ */
+struct PackedGtRecord {
+  double timestamp;
+  double position[3];
+  double orientation[4];
+};
+
+/**
+ * @brief Read-only, memory-mapped view of a packed dataset
+ *
+ */
+class PackedDataset {
+ private:
+  /**
+   * @brief Mapping of the packed file
+   *
+   */
+  MappedFile file;
+
+  /**
+   * @brief Start of the mapping, null when closed
+   *
+   */
+  const uint8_t* data;
+
+  /**
+   * @brief Size of the mapping in bytes
+   *
+   */
+  size_t size;
+
+  /**
+   * @brief Header of the mapped file
+   *
+   */
+  const PackHeader* header;
+
+  /**
+   * @brief Image table index of every image path
+   *
+   */
+  std::unordered_map<std::string, size_t> path_index;
+
+  /**
+   * @brief Function to check that every table and frame lies in the file
+   *
+   * @return true if the file is consistent
+   */
+  bool validate() const;
+
+ public:
+  /**
+   * @brief Magic bytes identifying a packed dataset
+   *
+   */
+  static const char kMagic[8];
+
+  /**
+   * @brief Format version written and accepted by this class
+   *
+   */
+  static const uint32_t kVersion = 1;
+
+  /**
+   * @brief Construct a closed Packed Dataset object
+   *
+   */
+  PackedDataset();
+
+  /**
+   * @brief Destroy the Packed Dataset object, unmapping the file
+   *
+   */
+  ~PackedDataset();
+
+  PackedDataset(const PackedDataset&) = delete;
+  PackedDataset& operator=(const PackedDataset&) = delete;
+
+  /**
+   * @brief Function to map a packed dataset
+   *
+   * @param pack_path: path of the packed file
+   * @return true if the file was mapped and is consistent
+   */
+  bool open(const std::string& pack_path);
+
+  /**
+   * @brief Function to unmap the file
+   *
+   */
+  void close();
+
+  /**
+   * @brief Function to check if a file is mapped
+   *
+   * @return true if open
+   */
+  bool is_open() const;
+
+  /**
+   * @brief Function to check if a path is a packed dataset file
+   *
+   * @param path
+   * @return true if the file starts with the pack magic
+   */
+  static bool is_pack_file(const std::string& path);
+
+  /**
+   * @brief Function to convert a text dataset into a packed dataset
+   *
+   * @param dataset_path: directory with images.txt, groundtruth.txt and
+   * optionally imu.txt
+   * @param pack_path: output file
+   * @param color: color format the frames are stored in
+   * @return true if the file was written
+   */
+  static bool write(const std::string& dataset_path,
+                    const std::string& pack_path,
+                    ImageColor color = ImageColor::kGrayscale);
+
+  /**
+   * @brief Function to get the number of image list entries
+   *
+   * @return size_t
+   */
+  size_t image_count() const;
+
+  /**
+   * @brief Function to get the number of IMU samples
+   *
+   * @return size_t
+   */
+  size_t imu_count() const;
+
+  /**
+   * @brief Function to get the number of ground truth poses
+   *
+   * @return size_t
+   */
+  size_t gt_count() const;
+
+  /**
+   * @brief Function to get the index table entry of an image
+   *
+   * @param index
+   * @return const PackedImageRecord&
+   */
+  const PackedImageRecord& image_record(size_t index) const;
+
+  /**
+   * @brief Function to get the path of an image relative to the dataset
+   *
+   * @param index
+   * @return std::string
+   */
+  std::string image_path(size_t index) const;
+
+  /**
+   * @brief Function to get an image without copying. The returned header
+   * points into the read-only mapping and must not be written to.
+   *
+   * @param index
+   * @return cv::Mat, empty if the image could not be decoded on conversion
+   */
+  cv::Mat image(size_t index) const;
+
+  /**
+   * @brief Function to look up an image by path
+   *
+   * @param image_path: image path relative to the dataset
+   * @param index: output image table index
+   * @return true if the path was found
+   */
+  bool find_image(const std::string& image_path, size_t& index) const;
+
+  /**
+   * @brief Function to get an IMU sample
+   *
+   * @param index
+   * @return const PackedImuRecord&
+   */
+  const PackedImuRecord& imu_record(size_t index) const;
+
+  /**
+   * @brief Function to get a ground truth pose
+   *
+   * @param index
+   * @return const PackedGtRecord&
+   */
+  const PackedGtRecord& gt_record(size_t index) const;
+};
+
+}  // namespace dl
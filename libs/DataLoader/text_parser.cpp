@@ -0,0 +1,216 @@
+/**
+ * @file text_parser.cpp
+ * @author Apoorv Thapliyal
+ * @brief C++ source file for the allocation-free IMU and ground truth parser
+ * @version 0.1
+ * @date 2024-11-15
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "text_parser.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+#include "mapped_file.hpp"
+
+namespace {
+
+/**
+ * @brief Powers of ten that are exact in double precision
+ *
+ */
+const double kPowersOfTen[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                               1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                               1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                               1e18, 1e19, 1e20, 1e21, 1e22};
+
+/**
+ * @brief Most significant digits kept in the 64-bit mantissa
+ *
+ */
+const int kMaxMantissaDigits = 19;
+
+/**
+ * @brief Function to check for a decimal digit
+ *
+ * @param c
+ * @return true if c is a digit
+ */
+inline bool is_digit(char c) {
+  return static_cast<unsigned char>(c - '0') < 10;
+}
+
+/**
+ * @brief Function to parse every line of a numeric table into columns. The
+ * columns are sized for the line count up front, so no allocation happens
+ * while scanning.
+ *
+ * @param path
+ * @param columns: output column of every field, null to skip a field
+ * @param column_count
+ * @return true if the file could be read
+ */
+bool parse_table(const std::string& path, std::vector<double>* const* columns,
+                 size_t column_count) {
+  dl::MappedFile file;
+  if (!file.open(path)) {
+    std::cerr << "Error opening file: " << path << std::endl;
+    return false;
+  }
+
+  const char* begin = file.data();
+  const char* end = begin + file.size();
+
+  // Upper bound of the row count; memchr scans the buffer vectorized
+  size_t line_count = 0;
+  for (const char* p = begin; p < end; ++line_count) {
+    const char* newline =
+        static_cast<const char*>(std::memchr(p, '\n', end - p));
+    p = newline ? newline + 1 : end;
+  }
+  for (size_t c = 0; c < column_count; c++)
+    if (columns[c]) columns[c]->resize(line_count);
+
+  double values[16];
+  size_t rows = 0;
+  for (const char* line = begin; line < end;) {
+    const char* newline =
+        static_cast<const char*>(std::memchr(line, '\n', end - line));
+    const char* line_end = newline ? newline : end;
+
+    const char* cursor = line;
+    while (cursor < line_end && (*cursor == ' ' || *cursor == '\t')) ++cursor;
+
+    // Skip comments, blank lines and lines with missing columns
+    bool valid = cursor < line_end && *cursor != '#';
+    for (size_t c = 0; valid && c < column_count; c++)
+      valid = dl::parse_number(cursor, line_end, values[c]);
+
+    if (valid) {
+      for (size_t c = 0; c < column_count; c++)
+        if (columns[c]) (*columns[c])[rows] = values[c];
+      rows++;
+    }
+
+    line = line_end + 1;
+  }
+
+  for (size_t c = 0; c < column_count; c++)
+    if (columns[c]) columns[c]->resize(rows);
+
+  return true;
+}
+
+}  // namespace
+
+/**
+ * @brief Function to scan a decimal number, skipping leading blanks
+ *
+ * @param cursor
+ * @param end
+ * @param value
+ * @return true if a number was scanned
+ */
+bool dl::parse_number(const char*& cursor, const char* end, double& value) {
+  const char* p = cursor;
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) ++p;
+
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    ++p;
+  }
+
+  // Accumulate up to 19 significant digits, the rest only shift the exponent
+  uint64_t mantissa = 0;
+  int digits = 0;
+  int exponent = 0;
+  bool any_digit = false;
+
+  for (; p < end && is_digit(*p); ++p) {
+    any_digit = true;
+    if (digits < kMaxMantissaDigits) {
+      mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+      if (mantissa != 0) digits++;
+    } else {
+      exponent++;
+    }
+  }
+
+  if (p < end && *p == '.') {
+    for (++p; p < end && is_digit(*p); ++p) {
+      any_digit = true;
+      if (digits < kMaxMantissaDigits) {
+        mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+        if (mantissa != 0) digits++;
+        exponent--;
+      }
+    }
+  }
+
+  if (!any_digit) return false;
+
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    const char* q = p + 1;
+    bool negative_exponent = false;
+    if (q < end && (*q == '-' || *q == '+')) {
+      negative_exponent = *q == '-';
+      ++q;
+    }
+    if (q == end || !is_digit(*q)) return false;
+
+    int explicit_exponent = 0;
+    for (; q < end && is_digit(*q); ++q)
+      if (explicit_exponent < 10000)
+        explicit_exponent = explicit_exponent * 10 + (*q - '0');
+    exponent += negative_exponent ? -explicit_exponent : explicit_exponent;
+    p = q;
+  }
+
+  double result = static_cast<double>(mantissa);
+  if (mantissa != 0 && exponent != 0) {
+    if (exponent < 0 && -exponent <= 22)
+      result /= kPowersOfTen[-exponent];
+    else if (exponent > 0 && exponent <= 22)
+      result *= kPowersOfTen[exponent];
+    else
+      result *= std::pow(10.0, exponent);
+  }
+
+  value = negative ? -result : result;
+  cursor = p;
+  return true;
+}
+
+/**
+ * @brief Function to parse imu.txt
+ *
+ * @param path
+ * @param log
+ * @return true if the file could be read
+ */
+bool dl::parse_imu_file(const std::string& path, ImuLog& log) {
+  std::vector<double>* const columns[] = {
+      nullptr,      &log.timestamp, &log.gyro_x,  &log.gyro_y,
+      &log.gyro_z, &log.accel_x,   &log.accel_y, &log.accel_z};
+  return parse_table(path, columns, 8);
+}
+
+/**
+ * @brief Function to parse groundtruth.txt
+ *
+ * @param path
+ * @param log
+ * @return true if the file could be read
+ */
+bool dl::parse_gt_file(const std::string& path, GroundTruthLog& log) {
+  std::vector<double>* const columns[] = {&log.timestamp, &log.x,  &log.y,
+                                          &log.z,         &log.qx, &log.qy,
+                                          &log.qz,        &log.qw};
+  return parse_table(path, columns, 8);
+}
@@ -0,0 +1,112 @@
+/**
+ * @file text_parser.hpp
+ * @author Apoorv Thapliyal
+ * @brief C++ header file for the allocation-free IMU and ground truth parser
+ * @version 0.1
+ * @date 2024-11-15
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "imu_span.hpp"
+
+namespace dl {
+
+/**
+ * @brief IMU samples of imu.txt, one array per column. Timestamps are seconds
+ * in double precision, which resolves about 0.24 us at the current epoch
+ * instead of the nanoseconds written in the file. That is far below the IMU
+ * period and any association tolerance, and every consumer works in double.
+ *
+ */
+struct ImuLog {
+  std::vector<double> timestamp;
+  std::vector<double> gyro_x, gyro_y, gyro_z;
+  std::vector<double> accel_x, accel_y, accel_z;
+
+  /**
+   * @brief Function to get the number of samples
+   *
+   * @return size_t
+   */
+  size_t size() const { return timestamp.size(); }
+
+  /**
+   * @brief Function to get a view of all samples, valid until the log is
+   * modified
+   *
+   * @return io::ImuSpan
+   */
+  io::ImuSpan span() const {
+    io::ImuSpan samples;
+    if (timestamp.empty()) return samples;
+
+    samples.timestamp = timestamp.data();
+    samples.gyro_x = gyro_x.data();
+    samples.gyro_y = gyro_y.data();
+    samples.gyro_z = gyro_z.data();
+    samples.accel_x = accel_x.data();
+    samples.accel_y = accel_y.data();
+    samples.accel_z = accel_z.data();
+    samples.size = timestamp.size();
+    return samples;
+  }
+};
+
+/**
+ * @brief Poses of groundtruth.txt, one array per column. Timestamps have the
+ * precision of ImuLog::timestamp.
+ *
+ */
+struct GroundTruthLog {
+  std::vector<double> timestamp;
+  std::vector<double> x, y, z;
+  std::vector<double> qx, qy, qz, qw;
+
+  /**
+   * @brief Function to get the number of poses
+   *
+   * @return size_t
+   */
+  size_t size() const { return timestamp.size(); }
+};
+
+/**
+ * @brief Function to scan a decimal number, skipping leading blanks. The
+ * result is within one unit in the last place of the correctly rounded value.
+ *
+ * @param cursor: scan position, advanced past the number on success
+ * @param end: end of the buffer
+ * @param value: output value
+ * @return true if a number was scanned
+ */
+bool parse_number(const char*& cursor, const char* end, double& value);
+
+/**
+ * @brief Function to parse imu.txt (id, timestamp, angular velocity, linear
+ * acceleration). Comment lines and lines with missing columns are skipped.
+ *
+ * @param path
+ * @param log: output, previous contents are replaced
+ * @return true if the file could be read
+ */
+bool parse_imu_file(const std::string& path, ImuLog& log);
+
+/**
+ * @brief Function to parse groundtruth.txt (timestamp, position, orientation
+ * quaternion x y z w). Comment lines and lines with missing columns are
+ * skipped.
+ *
+ * @param path
+ * @param log: output, previous contents are replaced
+ * @return true if the file could be read
+ */
+bool parse_gt_file(const std::string& path, GroundTruthLog& log);
+
+}  // namespace dl
@@ -0,0 +1,309 @@
+/**
+ * @file trajectory_evaluation.cpp
+ * @author Apoorv Thapliyal
+ * @brief C++ source file for the trajectory accuracy evaluation
+ * @version 0.1
+ * @date 2024-11-26
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "trajectory_evaluation.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <eigen3/Eigen/Geometry>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+namespace {
+
+/**
+ * @brief Function to get the rotation of a trajectory pose
+ *
+ * @param trajectory
+ * @param index
+ * @return Eigen::Matrix3d
+ */
+Eigen::Matrix3d rotation_of(const dl::GroundTruthLog& trajectory,
+                            size_t index) {
+  return Eigen::Quaterniond(trajectory.qw[index], trajectory.qx[index],
+                            trajectory.qy[index], trajectory.qz[index])
+      .normalized()
+      .toRotationMatrix();
+}
+
+/**
+ * @brief Function to get the position of a trajectory pose
+ *
+ * @param trajectory
+ * @param index
+ * @return Eigen::Vector3d
+ */
+Eigen::Vector3d position_of(const dl::GroundTruthLog& trajectory,
+                            size_t index) {
+  return Eigen::Vector3d(trajectory.x[index], trajectory.y[index],
+                         trajectory.z[index]);
+}
+
+}  // namespace
+
+/**
+ * @brief Function to pair every estimated pose with the closest ground truth
+ * pose in time
+ *
+ * @param estimate_times
+ * @param groundtruth_times
+ * @param max_difference
+ * @param matches
+ * @return size_t: number of pairs
+ */
+size_t ev::associate(const std::vector<double>& estimate_times,
+                     const std::vector<double>& groundtruth_times,
+                     double max_difference,
+                     std::vector<std::pair<size_t, size_t>>& matches) {
+  matches.clear();
+  if (!std::is_sorted(groundtruth_times.begin(), groundtruth_times.end())) {
+    std::cerr << "Ground truth times are not sorted" << std::endl;
+    return 0;
+  }
+  if (!std::is_sorted(estimate_times.begin(), estimate_times.end())) {
+    std::cerr << "Estimate times are not sorted" << std::endl;
+    return 0;
+  }
+  matches.reserve(std::min(estimate_times.size(), groundtruth_times.size()));
+
+  // Estimates are sorted too, so every search starts where the last one
+  // ended
+  auto first = groundtruth_times.begin();
+  for (size_t i = 0; i < estimate_times.size(); i++) {
+    const double time = estimate_times[i];
+    first = std::lower_bound(first, groundtruth_times.end(), time);
+
+    // The closest time is the first one not before, or the one before it
+    auto best = groundtruth_times.end();
+    double difference = max_difference;
+    if (first != groundtruth_times.end() && *first - time <= difference) {
+      best = first;
+      difference = *first - time;
+    }
+    if (first != groundtruth_times.begin() &&
+        time - *(first - 1) <= difference)
+      best = first - 1;
+
+    if (best != groundtruth_times.end())
+      matches.emplace_back(i, best - groundtruth_times.begin());
+  }
+  return matches.size();
+}
+
+/**
+ * @brief Function to fit the transform from estimated to ground truth
+ * positions
+ *
+ * @param estimate
+ * @param groundtruth
+ * @param alignment
+ * @param transform
+ * @return true if there were enough positions
+ */
+bool ev::align(const std::vector<Eigen::Vector3d>& estimate,
+               const std::vector<Eigen::Vector3d>& groundtruth,
+               Alignment alignment, Similarity& transform) {
+  transform = Similarity();
+  if (estimate.size() != groundtruth.size() || estimate.size() < 3) {
+    std::cerr << "Alignment needs at least 3 position pairs, got "
+              << estimate.size() << " and " << groundtruth.size()
+              << std::endl;
+    return false;
+  }
+  if (alignment == Alignment::kNone) return true;
+
+  // Positions are contiguous, so they map to 3xN matrices without a copy
+  const Eigen::Index count = static_cast<Eigen::Index>(estimate.size());
+  Eigen::Map<const Eigen::Matrix3Xd> source(estimate[0].data(), 3, count);
+  Eigen::Map<const Eigen::Matrix3Xd> target(groundtruth[0].data(), 3, count);
+  const Eigen::Matrix4d T =
+      Eigen::umeyama(source, target, alignment == Alignment::kSim3);
+
+  transform.scale = T.block<3, 1>(0, 0).norm();
+  transform.R = T.block<3, 3>(0, 0) / transform.scale;
+  transform.t = T.block<3, 1>(0, 3);
+  return std::isfinite(transform.scale) && transform.scale > 0.0;
+}
+
+/**
+ * @brief Function to summarize a set of errors
+ *
+ * @param errors
+ * @return ErrorStatistics
+ */
+ev::ErrorStatistics ev::compute_statistics(std::vector<double>& errors) {
+  ErrorStatistics statistics;
+  statistics.count = errors.size();
+  if (errors.empty()) return statistics;
+
+  double sum = 0.0, squared_sum = 0.0;
+  statistics.min = errors[0];
+  statistics.max = errors[0];
+  for (double error : errors) {
+    sum += error;
+    squared_sum += error * error;
+    statistics.min = std::min(statistics.min, error);
+    statistics.max = std::max(statistics.max, error);
+  }
+  const double count = static_cast<double>(errors.size());
+  statistics.mean = sum / count;
+  statistics.rmse = std::sqrt(squared_sum / count);
+  statistics.std = std::sqrt(
+      std::max(squared_sum / count - statistics.mean * statistics.mean, 0.0));
+
+  // Upper median, without sorting the whole set
+  auto middle = errors.begin() + errors.size() / 2;
+  std::nth_element(errors.begin(), middle, errors.end());
+  statistics.median = *middle;
+  return statistics;
+}
+
+/**
+ * @brief Function to compare an estimated trajectory to the ground truth
+ *
+ * @param estimate
+ * @param groundtruth
+ * @param config
+ * @param report
+ * @return true if enough poses could be associated and aligned
+ */
+bool ev::evaluate(const dl::GroundTruthLog& estimate,
+                  const dl::GroundTruthLog& groundtruth,
+                  const EvaluationConfig& config, EvaluationReport& report) {
+  report = EvaluationReport();
+  std::vector<std::pair<size_t, size_t>> matches;
+  report.matched = associate(estimate.timestamp, groundtruth.timestamp,
+                             config.max_time_difference, matches);
+
+  // The estimate is aligned on the ground truth positions of the estimated
+  // frame. The extrinsic is metric, so it is applied on the ground truth side,
+  // whose scale is known.
+  const size_t count = matches.size();
+  std::vector<Eigen::Vector3d> estimated_positions(count);
+  std::vector<Eigen::Vector3d> true_positions(count);
+  std::vector<Eigen::Vector3d> true_camera_positions(count);
+  std::vector<Eigen::Matrix3d> true_rotations(count);
+  for (size_t k = 0; k < count; k++) {
+    estimated_positions[k] = position_of(estimate, matches[k].first);
+    true_positions[k] = position_of(groundtruth, matches[k].second);
+    true_rotations[k] = rotation_of(groundtruth, matches[k].second);
+    true_camera_positions[k] =
+        true_positions[k] + true_rotations[k] * config.t_body_camera;
+  }
+  if (!align(estimated_positions, true_camera_positions, config.alignment,
+             report.alignment))
+    return false;
+
+  // Move the estimate into the ground truth frame, now metric, then from the
+  // estimated frame onto the body
+  const Similarity& transform = report.alignment;
+  std::vector<Eigen::Matrix3d> estimated_rotations(count);
+  std::vector<double> errors(count);
+  for (size_t k = 0; k < count; k++) {
+    estimated_rotations[k] = transform.R *
+                             rotation_of(estimate, matches[k].first) *
+                             config.R_body_camera.transpose();
+    estimated_positions[k] =
+        transform.scale * transform.R * estimated_positions[k] + transform.t -
+        estimated_rotations[k] * config.t_body_camera;
+    errors[k] = (estimated_positions[k] - true_positions[k]).norm();
+  }
+  report.ate = compute_statistics(errors);
+
+  // Distance travelled along the ground truth, non-decreasing, so the end of
+  // every segment is found with a binary search
+  std::vector<double> travelled(count, 0.0);
+  for (size_t k = 1; k < count; k++)
+    travelled[k] =
+        travelled[k - 1] + (true_positions[k] - true_positions[k - 1]).norm();
+
+  const size_t stride = std::max<size_t>(config.segment_stride, 1);
+  std::vector<double> rotation_errors;
+  for (double length : config.segment_lengths) {
+    errors.clear();
+    rotation_errors.clear();
+    for (size_t i = 0; i < count; i += stride) {
+      auto end = std::lower_bound(travelled.begin() + i, travelled.end(),
+                                  travelled[i] + length);
+      if (end == travelled.end()) break;
+      const size_t j = end - travelled.begin();
+
+      // Error of the estimated motion from i to j, in the frame of i
+      const Eigen::Matrix3d R_true =
+          true_rotations[i].transpose() * true_rotations[j];
+      const Eigen::Vector3d p_true =
+          true_rotations[i].transpose() * (true_positions[j] - true_positions[i]);
+      const Eigen::Matrix3d R_estimated =
+          estimated_rotations[i].transpose() * estimated_rotations[j];
+      const Eigen::Vector3d p_estimated =
+          estimated_rotations[i].transpose() *
+          (estimated_positions[j] - estimated_positions[i]);
+
+      errors.push_back((p_estimated - p_true).norm());
+      rotation_errors.push_back(
+          Eigen::AngleAxisd(R_true.transpose() * R_estimated).angle() * 180.0 /
+          M_PI);
+    }
+    if (errors.empty()) continue;
+
+    RelativeError relative;
+    relative.segment_length = length;
+    relative.translation = compute_statistics(errors);
+    relative.rotation = compute_statistics(rotation_errors);
+    report.rpe.push_back(relative);
+  }
+  return true;
+}
+
+/**
+ * @brief Function to append a pose to a trajectory
+ *
+ * @param trajectory
+ * @param timestamp
+ * @param pose
+ */
+void ev::append_pose(dl::GroundTruthLog& trajectory, double timestamp,
+                     const Eigen::Matrix4d& pose) {
+  const Eigen::Quaterniond q(Eigen::Matrix3d(pose.block<3, 3>(0, 0)));
+  trajectory.timestamp.push_back(timestamp);
+  trajectory.x.push_back(pose(0, 3));
+  trajectory.y.push_back(pose(1, 3));
+  trajectory.z.push_back(pose(2, 3));
+  trajectory.qx.push_back(q.x());
+  trajectory.qy.push_back(q.y());
+  trajectory.qz.push_back(q.z());
+  trajectory.qw.push_back(q.w());
+}
+
+/**
+ * @brief Function to write a trajectory in the format of groundtruth.txt
+ *
+ * @param path
+ * @param trajectory
+ * @return true if the file was written
+ */
+bool ev::write_trajectory(const std::string& path,
+                          const dl::GroundTruthLog& trajectory) {
+  std::ofstream file(path);
+  if (!file) {
+    std::cerr << "Could not open trajectory file " << path << std::endl;
+    return false;
+  }
+  file << "# timestamp tx ty tz qx qy qz qw\n" << std::fixed
+       << std::setprecision(9);
+  for (size_t k = 0; k < trajectory.size(); k++)
+    file << trajectory.timestamp[k] << ' ' << trajectory.x[k] << ' '
+         << trajectory.y[k] << ' ' << trajectory.z[k] << ' '
+         << trajectory.qx[k] << ' ' << trajectory.qy[k] << ' '
+         << trajectory.qz[k] << ' ' << trajectory.qw[k] << '\n';
+  return static_cast<bool>(file);
+}
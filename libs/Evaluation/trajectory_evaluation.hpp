@@ -0,0 +1,239 @@
+/**
+ * @file trajectory_evaluation.hpp
+ * @author Apoorv Thapliyal
+ * @brief C++ header file for the trajectory accuracy evaluation
+ * @version 0.1
+ * @date 2024-11-26
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <eigen3/Eigen/Core>
+#include <eigen3/Eigen/Dense>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "text_parser.hpp"
+
+namespace ev {
+
+/**
+ * @brief Transform fitted between the estimated and the ground truth
+ * positions before measuring the errors
+ *
+ */
+enum class Alignment {
+  kNone,  // compare the trajectories as they are
+  kSE3,   // rotation and translation, e.g. stereo or visual-inertial runs
+  kSim3   // rotation, translation and scale, for monocular runs
+};
+
+/**
+ * @brief Similarity transform taking an estimated position p to
+ * scale * R * p + t in the ground truth frame
+ *
+ */
+struct Similarity {
+  Eigen::Matrix3d R = Eigen::Matrix3d::Identity();
+  Eigen::Vector3d t = Eigen::Vector3d::Zero();
+  double scale = 1.0;
+};
+
+/**
+ * @brief Summary of a set of errors
+ *
+ */
+struct ErrorStatistics {
+  size_t count = 0;
+  double rmse = 0.0;
+  double mean = 0.0;
+  double median = 0.0;
+  double std = 0.0;
+  double min = 0.0;
+  double max = 0.0;
+};
+
+/**
+ * @brief Relative pose error over the pairs of poses a fixed distance apart
+ *
+ */
+struct RelativeError {
+  /**
+   * @brief Distance travelled along the ground truth between the two poses
+   * of a pair, in meters
+   *
+   */
+  double segment_length = 0.0;
+
+  /**
+   * @brief Translation error in meters
+   *
+   */
+  ErrorStatistics translation;
+
+  /**
+   * @brief Rotation error in degrees
+   *
+   */
+  ErrorStatistics rotation;
+};
+
+/**
+ * @brief Settings of an evaluation
+ *
+ */
+struct EvaluationConfig {
+  /**
+   * @brief Maximum time in seconds between an estimated pose and the ground
+   * truth pose it is compared to
+   *
+   */
+  double max_time_difference = 0.02;
+
+  /**
+   * @brief Transform fitted before measuring the errors
+   *
+   */
+  Alignment alignment = Alignment::kSim3;
+
+  /**
+   * @brief Segment lengths in meters the relative error is reported for
+   *
+   */
+  std::vector<double> segment_lengths = {1.0, 2.0, 5.0, 10.0};
+
+  /**
+   * @brief Number of poses between the first poses of consecutive segments
+   *
+   */
+  size_t segment_stride = 1;
+
+  /**
+   * @brief Rotation of the estimated frame, e.g. the camera, in the ground
+   * truth body frame, e.g. the IMU
+   *
+   */
+  Eigen::Matrix3d R_body_camera = Eigen::Matrix3d::Identity();
+
+  /**
+   * @brief Position of the estimated frame in the ground truth body frame,
+   * in meters
+   *
+   */
+  Eigen::Vector3d t_body_camera = Eigen::Vector3d::Zero();
+};
+
+/**
+ * @brief Outcome of an evaluation
+ *
+ */
+struct EvaluationReport {
+  /**
+   * @brief Number of estimated poses with a ground truth pose close enough
+   * in time
+   *
+   */
+  size_t matched = 0;
+
+  /**
+   * @brief Transform fitted from the estimate to the ground truth
+   *
+   */
+  Similarity alignment;
+
+  /**
+   * @brief Absolute trajectory error: position error in meters after the
+   * alignment
+   *
+   */
+  ErrorStatistics ate;
+
+  /**
+   * @brief Relative pose error of every segment length the ground truth is
+   * long enough for
+   *
+   */
+  std::vector<RelativeError> rpe;
+};
+
+/**
+ * @brief Function to pair every estimated pose with the closest ground truth
+ * pose in time, with a binary search over the sorted ground truth times
+ *
+ * @param estimate_times: times of the estimated poses, in increasing order
+ * @param groundtruth_times: times of the ground truth poses, in increasing
+ * order
+ * @param max_difference: pairs further apart in time are dropped
+ * @param matches: output (estimate index, ground truth index) pairs
+ * @return size_t: number of pairs, 0 if either times are not sorted
+ */
+size_t associate(const std::vector<double>& estimate_times,
+                 const std::vector<double>& groundtruth_times,
+                 double max_difference,
+                 std::vector<std::pair<size_t, size_t>>& matches);
+
+/**
+ * @brief Function to fit the transform from estimated to ground truth
+ * positions with the closed-form least squares method of Umeyama
+ *
+ * @param estimate: estimated positions
+ * @param groundtruth: ground truth positions, one per estimated position
+ * @param alignment: transform to fit
+ * @param transform: output
+ * @return true if there were enough positions, at least 3
+ */
+bool align(const std::vector<Eigen::Vector3d>& estimate,
+           const std::vector<Eigen::Vector3d>& groundtruth,
+           Alignment alignment, Similarity& transform);
+
+/**
+ * @brief Function to summarize a set of errors
+ *
+ * @param errors: reordered to find the median
+ * @return ErrorStatistics
+ */
+ErrorStatistics compute_statistics(std::vector<double>& errors);
+
+/**
+ * @brief Function to compare an estimated trajectory to the ground truth.
+ * The estimate is aligned on the ground truth poses of its own frame (the
+ * body poses moved by the extrinsic in the config), then moved onto the body
+ * so the absolute and relative errors compare body poses.
+ *
+ * @param estimate: estimated poses, in increasing time order
+ * @param groundtruth: ground truth poses, in increasing time order
+ * @param config: settings of the evaluation
+ * @param report: output
+ * @return true if enough poses could be associated and aligned
+ */
+bool evaluate(const dl::GroundTruthLog& estimate,
+              const dl::GroundTruthLog& groundtruth,
+              const EvaluationConfig& config, EvaluationReport& report);
+
+/**
+ * @brief Function to append a pose to a trajectory
+ *
+ * @param trajectory
+ * @param timestamp
+ * @param pose: body to world pose
+ */
+void append_pose(dl::GroundTruthLog& trajectory, double timestamp,
+                 const Eigen::Matrix4d& pose);
+
+/**
+ * @brief Function to write a trajectory in the format of groundtruth.txt
+ * (timestamp, position, orientation quaternion x y z w), so it can be read
+ * back with dl::parse_gt_file
+ *
+ * @param path
+ * @param trajectory
+ * @return true if the file was written
+ */
+bool write_trajectory(const std::string& path,
+                      const dl::GroundTruthLog& trajectory);
+
+}  // namespace ev
@@ -0,0 +1,402 @@
+/**
+ * @file error_state_ekf.cpp
+ * @author Kshitij Aggarwal
+ * @brief C++ source file for the visual-inertial error-state EKF
+ * @version 0.1
+ * @date 2024-11-19
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "error_state_ekf.hpp"
+
+#include "so3.hpp"
+
+namespace {
+
+/**
+ * @brief Offsets of the error state blocks
+ *
+ */
+const int kPosition = 0;
+const int kVelocity = 3;
+const int kRotation = 6;
+const int kGyroBias = 9;
+const int kAccelBias = 12;
+const int kClonePosition = 15;
+const int kCloneRotation = 18;
+
+/**
+ * @brief Size of the error state without the clone
+ *
+ */
+const int kCoreSize = 15;
+
+/**
+ * @brief Chi-square gates at 99% for 3 and 6 degrees of freedom
+ *
+ */
+const double kGate3 = 11.34;
+const double kGate6 = 16.81;
+
+}  // namespace
+
+/**
+ * @brief Construct a new vio::Error State Ekf::Error State Ekf object
+ *
+ * @param initial_pose
+ * @param filter_noise
+ */
+vio::ErrorStateEkf::ErrorStateEkf(const Eigen::Matrix4d& initial_pose,
+                                  const FilterNoise& filter_noise)
+    : noise(filter_noise) {
+  rotation = initial_pose.block<3, 3>(0, 0);
+  position = initial_pose.block<3, 1>(0, 3);
+  velocity.setZero();
+  gyro_bias.setZero();
+  accel_bias.setZero();
+  clone_rotation = rotation;
+  clone_position = position;
+  gravity.setZero();
+  camera_rotation.setIdentity();
+  last_accel.setZero();
+  last_gyro.setZero();
+  last_timestamp = 0.0;
+  has_last_sample = false;
+  gravity_initialized = false;
+  has_clone = false;
+  intervals_since_clone = 0;
+
+  // The initial pose defines the world frame, velocity and biases start
+  // uncertain
+  covariance.setZero();
+  covariance.block<3, 3>(kVelocity, kVelocity).diagonal().setConstant(0.1);
+  covariance.block<3, 3>(kGyroBias, kGyroBias).diagonal().setConstant(1e-4);
+  covariance.block<3, 3>(kAccelBias, kAccelBias).diagonal().setConstant(1e-2);
+}
+
+/**
+ * @brief Function to set gravity in the world frame
+ *
+ * @param g
+ */
+void vio::ErrorStateEkf::set_gravity(const Eigen::Vector3d& g) {
+  gravity = g;
+  gravity_initialized = true;
+}
+
+/**
+ * @brief Function to set the rotation from the camera to the body frame
+ *
+ * @param R_body_camera
+ */
+void vio::ErrorStateEkf::set_camera_rotation(
+    const Eigen::Matrix3d& R_body_camera) {
+  camera_rotation = R_body_camera;
+}
+
+/**
+ * @brief Function to propagate the state over an interval
+ *
+ * @param a
+ * @param w
+ * @param dt
+ */
+void vio::ErrorStateEkf::propagate_interval(const Eigen::Vector3d& a,
+                                            const Eigen::Vector3d& w,
+                                            double dt) {
+  const Eigen::Vector3d a_corrected = a - accel_bias;
+  const Eigen::Matrix3d increment = io::so3::exp((w - gyro_bias) * dt);
+  const Eigen::Vector3d acceleration = rotation * a_corrected + gravity;
+  const Eigen::Matrix3d I = Eigen::Matrix3d::Identity();
+
+  // Error transition of the core state; the clone does not move
+  Eigen::Matrix<double, kCoreSize, kCoreSize> F =
+      Eigen::Matrix<double, kCoreSize, kCoreSize>::Identity();
+  F.block<3, 3>(kPosition, kVelocity) = I * dt;
+  F.block<3, 3>(kVelocity, kRotation) =
+      -rotation * io::so3::hat(a_corrected) * dt;
+  F.block<3, 3>(kVelocity, kAccelBias) = -rotation * dt;
+  F.block<3, 3>(kRotation, kRotation) = increment.transpose();
+  F.block<3, 3>(kRotation, kGyroBias) = -I * dt;
+
+  Eigen::Matrix<double, kCoreSize, 1> Q;
+  Q.setZero();
+  Q.segment<3>(kVelocity).setConstant(noise.accel_noise_density *
+                                      noise.accel_noise_density * dt);
+  Q.segment<3>(kRotation).setConstant(noise.gyro_noise_density *
+                                      noise.gyro_noise_density * dt);
+  Q.segment<3>(kGyroBias).setConstant(noise.gyro_random_walk *
+                                      noise.gyro_random_walk * dt);
+  Q.segment<3>(kAccelBias).setConstant(noise.accel_random_walk *
+                                       noise.accel_random_walk * dt);
+
+  // Only the core block and its correlation with the clone change
+  Eigen::Matrix<double, kCoreSize, kCoreSize> core =
+      F * covariance.topLeftCorner<kCoreSize, kCoreSize>() * F.transpose();
+  core.diagonal() += Q;
+  covariance.topLeftCorner<kCoreSize, kCoreSize>() = core;
+  covariance.topRightCorner<kCoreSize, 6>() =
+      F * covariance.topRightCorner<kCoreSize, 6>();
+  covariance.bottomLeftCorner<6, kCoreSize>() =
+      covariance.topRightCorner<kCoreSize, 6>().transpose();
+
+  // Nominal state
+  position += velocity * dt + 0.5 * acceleration * dt * dt;
+  velocity += acceleration * dt;
+  rotation = rotation * increment;
+
+  intervals_since_clone++;
+}
+
+/**
+ * @brief Function to propagate with a timestamped IMU sample
+ *
+ * @param timestamp
+ * @param a
+ * @param w
+ */
+void vio::ErrorStateEkf::propagate(double timestamp, const Eigen::Vector3d& a,
+                                   const Eigen::Vector3d& w) {
+  // At rest the accelerometer measures the reaction to gravity
+  if (!gravity_initialized) set_gravity(-(rotation * (a - accel_bias)));
+
+  if (has_last_sample) {
+    double dt = timestamp - last_timestamp;
+    if (dt > 0.0 && dt <= max_dt) propagate_interval(last_accel, last_gyro, dt);
+  }
+
+  last_timestamp = timestamp;
+  last_accel = a;
+  last_gyro = w;
+  has_last_sample = true;
+}
+
+/**
+ * @brief Function to propagate with a block of timestamped IMU samples
+ *
+ * @param samples
+ */
+void vio::ErrorStateEkf::propagate(const io::ImuSpan& samples) {
+  for (size_t i = 0; i < samples.size; i++)
+    propagate(samples.timestamp[i],
+              Eigen::Vector3d(samples.accel_x[i], samples.accel_y[i],
+                              samples.accel_z[i]),
+              Eigen::Vector3d(samples.gyro_x[i], samples.gyro_y[i],
+                              samples.gyro_z[i]));
+}
+
+/**
+ * @brief Function to mark the current state as the previous image
+ *
+ */
+void vio::ErrorStateEkf::clone_pose() {
+  clone_position = position;
+  clone_rotation = rotation;
+
+  // The clone error equals the current position and rotation error
+  Eigen::Matrix<double, kStateSize, 3> position_columns =
+      covariance.block<kStateSize, 3>(0, kPosition);
+  Eigen::Matrix<double, kStateSize, 3> rotation_columns =
+      covariance.block<kStateSize, 3>(0, kRotation);
+  covariance.block<kStateSize, 3>(0, kClonePosition) = position_columns;
+  covariance.block<kStateSize, 3>(0, kCloneRotation) = rotation_columns;
+  covariance.block<3, kStateSize>(kClonePosition, 0) =
+      position_columns.transpose();
+  covariance.block<3, kStateSize>(kCloneRotation, 0) =
+      rotation_columns.transpose();
+  covariance.block<3, 3>(kClonePosition, kClonePosition) =
+      covariance.block<3, 3>(kPosition, kPosition);
+  covariance.block<3, 3>(kClonePosition, kCloneRotation) =
+      covariance.block<3, 3>(kPosition, kRotation);
+  covariance.block<3, 3>(kCloneRotation, kClonePosition) =
+      covariance.block<3, 3>(kRotation, kPosition);
+  covariance.block<3, 3>(kCloneRotation, kCloneRotation) =
+      covariance.block<3, 3>(kRotation, kRotation);
+
+  has_clone = true;
+  intervals_since_clone = 0;
+}
+
+/**
+ * @brief Function to apply a measurement update
+ *
+ * @tparam N
+ * @param H
+ * @param residual
+ * @param measurement_noise
+ * @param gate
+ * @return true if the update passed the gate
+ */
+template <int N>
+bool vio::ErrorStateEkf::apply_update(
+    const Eigen::Matrix<double, N, kStateSize>& H,
+    const Eigen::Matrix<double, N, 1>& residual,
+    const Eigen::Matrix<double, N, N>& measurement_noise, double gate) {
+  const Eigen::Matrix<double, kStateSize, N> PHt =
+      covariance * H.transpose();
+  const Eigen::Matrix<double, N, N> S = H * PHt + measurement_noise;
+  const Eigen::LDLT<Eigen::Matrix<double, N, N>> S_ldlt(S);
+
+  // Reject outliers by the Mahalanobis distance of the innovation
+  if (residual.dot(S_ldlt.solve(residual)) > gate) return false;
+
+  const Eigen::Matrix<double, kStateSize, N> K =
+      S_ldlt.solve(PHt.transpose()).transpose();
+  const Eigen::Matrix<double, kStateSize, 1> dx = K * residual;
+
+  // Joseph form keeps the covariance positive semi-definite
+  const Covariance I_KH = Covariance::Identity() - K * H;
+  covariance = I_KH * covariance * I_KH.transpose() +
+               K * measurement_noise * K.transpose();
+  covariance = 0.5 * (covariance + covariance.transpose()).eval();
+
+  // Inject the error into the nominal state
+  position += dx.template segment<3>(kPosition);
+  velocity += dx.template segment<3>(kVelocity);
+  rotation = rotation * io::so3::exp(dx.template segment<3>(kRotation));
+  gyro_bias += dx.template segment<3>(kGyroBias);
+  accel_bias += dx.template segment<3>(kAccelBias);
+  clone_position += dx.template segment<3>(kClonePosition);
+  clone_rotation =
+      clone_rotation * io::so3::exp(dx.template segment<3>(kCloneRotation));
+
+  return true;
+}
+
+/**
+ * @brief Function to fuse the camera motion from the previous image
+ *
+ * @param T_prev_curr
+ * @return true if the measurement was fused
+ */
+bool vio::ErrorStateEkf::update_relative_pose(
+    const Eigen::Matrix4d& T_prev_curr) {
+  if (!has_clone) {
+    clone_pose();
+    return false;
+  }
+
+  // Measured body motion
+  const Eigen::Matrix3d measured_rotation =
+      camera_rotation * T_prev_curr.block<3, 3>(0, 0) *
+      camera_rotation.transpose();
+  const Eigen::Vector3d measured_translation =
+      camera_rotation * T_prev_curr.block<3, 1>(0, 3);
+
+  // Without IMU data there is nothing to fuse with. Only the VO rotation is
+  // followed: its translation has unit length, and adding it to the metric
+  // position would mix the two scales. Position and velocity keep their last
+  // metric estimates until the IMU resumes.
+  if (intervals_since_clone == 0) {
+    rotation = clone_rotation * measured_rotation;
+    clone_pose();
+    return false;
+  }
+
+  // Predicted body motion
+  const Eigen::Matrix3d relative_rotation =
+      clone_rotation.transpose() * rotation;
+  const Eigen::Vector3d relative_translation =
+      clone_rotation.transpose() * (position - clone_position);
+
+  const double sigma_r = noise.vo_rotation_sigma;
+  const double sigma_d = noise.vo_direction_sigma;
+
+  Eigen::Matrix<double, 3, kStateSize> H_rotation;
+  H_rotation.setZero();
+  H_rotation.block<3, 3>(0, kRotation).setIdentity();
+  H_rotation.block<3, 3>(0, kCloneRotation) = -relative_rotation.transpose();
+  const Eigen::Vector3d rotation_residual =
+      io::so3::log(relative_rotation.transpose() * measured_rotation);
+
+  bool fused;
+  double predicted_norm = relative_translation.norm();
+  double measured_norm = measured_translation.norm();
+  if (predicted_norm > min_translation && measured_norm > 0.0) {
+    // Translation direction: u = t / |t|, du/dt = (I - u u^T) / |t|
+    const Eigen::Vector3d u = relative_translation / predicted_norm;
+    const Eigen::Matrix3d D =
+        (Eigen::Matrix3d::Identity() - u * u.transpose()) / predicted_norm;
+    const Eigen::Matrix3d D_Rt = D * clone_rotation.transpose();
+
+    Eigen::Matrix<double, 6, kStateSize> H;
+    H.setZero();
+    H.topRows<3>() = H_rotation;
+    H.block<3, 3>(3, kPosition) = D_Rt;
+    H.block<3, 3>(3, kClonePosition) = -D_Rt;
+    H.block<3, 3>(3, kCloneRotation) = D * io::so3::hat(relative_translation);
+
+    Eigen::Matrix<double, 6, 1> residual;
+    residual << rotation_residual, measured_translation / measured_norm - u;
+
+    Eigen::Matrix<double, 6, 1> variances;
+    variances << Eigen::Vector3d::Constant(sigma_r * sigma_r),
+        Eigen::Vector3d::Constant(sigma_d * sigma_d);
+    Eigen::Matrix<double, 6, 6> R = variances.asDiagonal();
+
+    fused = apply_update<6>(H, residual, R, kGate6);
+  } else {
+    Eigen::Matrix3d R = Eigen::Matrix3d::Identity() * sigma_r * sigma_r;
+    fused = apply_update<3>(H_rotation, rotation_residual, R, kGate3);
+  }
+
+  clone_pose();
+  return fused;
+}
+
+/**
+ * @brief Function to get the camera rotation since the previous image
+ *
+ * @return Eigen::Matrix3d
+ */
+Eigen::Matrix3d vio::ErrorStateEkf::get_camera_rotation_since_clone() const {
+  return camera_rotation.transpose() * clone_rotation.transpose() * rotation *
+         camera_rotation;
+}
+
+/**
+ * @brief Function to get the fused pose
+ *
+ * @return Eigen::Matrix4d
+ */
+Eigen::Matrix4d vio::ErrorStateEkf::get_pose() const {
+  Eigen::Matrix4d pose = Eigen::Matrix4d::Identity();
+  pose.block<3, 3>(0, 0) = rotation;
+  pose.block<3, 1>(0, 3) = position;
+  return pose;
+}
+
+/**
+ * @brief Function to get the fused velocity
+ *
+ * @return Eigen::Vector3d
+ */
+Eigen::Vector3d vio::ErrorStateEkf::get_velocity() const { return velocity; }
+
+/**
+ * @brief Function to get the estimated gyroscope bias
+ *
+ * @return Eigen::Vector3d
+ */
+Eigen::Vector3d vio::ErrorStateEkf::get_gyro_bias() const { return gyro_bias; }
+
+/**
+ * @brief Function to get the estimated accelerometer bias
+ *
+ * @return Eigen::Vector3d
+ */
+Eigen::Vector3d vio::ErrorStateEkf::get_accel_bias() const {
+  return accel_bias;
+}
+
+/**
+ * @brief Function to get the covariance of the error state
+ *
+ * @return const vio::ErrorStateEkf::Covariance&
+ */
+const vio::ErrorStateEkf::Covariance& vio::ErrorStateEkf::get_covariance()
+    const {
+  return covariance;
+}
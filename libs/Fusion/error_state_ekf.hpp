@@ -0,0 +1,340 @@
+/**
+ * @file error_state_ekf.hpp
+ * @author Kshitij Aggarwal
+ * @brief C++ header file for the visual-inertial error-state EKF
+ * @version 0.1
+ * @date 2024-11-19
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <eigen3/Eigen/Core>
+#include <eigen3/Eigen/Dense>
+
+#include "imu_span.hpp"
+
+/**
+ * @brief Visual-inertial fusion namespace
+ *
+ */
+namespace vio {
+
+/**
+ * @brief Noise parameters of the filter
+ *
+ */
+struct FilterNoise {
+  /**
+   * @brief Gyroscope white noise density [rad/s/sqrt(Hz)]
+   *
+   */
+  double gyro_noise_density = 1.7e-4;
+
+  /**
+   * @brief Accelerometer white noise density [m/s^2/sqrt(Hz)]
+   *
+   */
+  double accel_noise_density = 2.0e-3;
+
+  /**
+   * @brief Gyroscope bias random walk [rad/s^2/sqrt(Hz)]
+   *
+   */
+  double gyro_random_walk = 2.0e-5;
+
+  /**
+   * @brief Accelerometer bias random walk [m/s^3/sqrt(Hz)]
+   *
+   */
+  double accel_random_walk = 3.0e-3;
+
+  /**
+   * @brief Standard deviation of the VO relative rotation [rad]
+   *
+   */
+  double vo_rotation_sigma = 0.01;
+
+  /**
+   * @brief Standard deviation of the VO translation direction (unit vector)
+   *
+   */
+  double vo_direction_sigma = 0.1;
+};
+
+/**
+ * @brief Loosely-coupled error-state EKF. Propagates position, velocity,
+ * orientation and IMU biases on IMU samples and corrects them with relative
+ * camera poses from visual odometry. The pose at the previous image is kept
+ * as a stochastic clone, so relative measurements are fused with their
+ * correlation to the current state. Monocular VO has no metric scale, so only
+ * the relative rotation and the direction of the translation are used.
+ *
+ */
+class ErrorStateEkf {
+ public:
+  /**
+   * @brief Size of the error state: position, velocity, rotation, gyroscope
+   * bias, accelerometer bias, cloned position, cloned rotation
+   *
+   */
+  static const int kStateSize = 21;
+
+  /**
+   * @brief Covariance of the error state
+   *
+   */
+  typedef Eigen::Matrix<double, kStateSize, kStateSize> Covariance;
+
+ private:
+  /**
+   * @brief Nominal position in the world frame
+   *
+   */
+  Eigen::Vector3d position;
+
+  /**
+   * @brief Nominal velocity in the world frame
+   *
+   */
+  Eigen::Vector3d velocity;
+
+  /**
+   * @brief Nominal orientation, body to world
+   *
+   */
+  Eigen::Matrix3d rotation;
+
+  /**
+   * @brief Gyroscope bias
+   *
+   */
+  Eigen::Vector3d gyro_bias;
+
+  /**
+   * @brief Accelerometer bias
+   *
+   */
+  Eigen::Vector3d accel_bias;
+
+  /**
+   * @brief Position at the previous image
+   *
+   */
+  Eigen::Vector3d clone_position;
+
+  /**
+   * @brief Orientation at the previous image
+   *
+   */
+  Eigen::Matrix3d clone_rotation;
+
+  /**
+   * @brief Covariance of the error state
+   *
+   */
+  Covariance covariance;
+
+  /**
+   * @brief Gravity in the world frame
+   *
+   */
+  Eigen::Vector3d gravity;
+
+  /**
+   * @brief Camera to body rotation
+   *
+   */
+  Eigen::Matrix3d camera_rotation;
+
+  /**
+   * @brief Noise parameters
+   *
+   */
+  FilterNoise noise;
+
+  /**
+   * @brief Last IMU sample, held until the next one
+   *
+   */
+  Eigen::Vector3d last_accel, last_gyro;
+
+  /**
+   * @brief Timestamp of the last IMU sample
+   *
+   */
+  double last_timestamp;
+
+  /**
+   * @brief Flag to track if an IMU sample was received
+   *
+   */
+  bool has_last_sample;
+
+  /**
+   * @brief Flag to track if gravity was set or initialized
+   *
+   */
+  bool gravity_initialized;
+
+  /**
+   * @brief Flag to track if a pose was cloned
+   *
+   */
+  bool has_clone;
+
+  /**
+   * @brief IMU intervals integrated since the clone
+   *
+   */
+  size_t intervals_since_clone;
+
+  /**
+   * @brief IMU samples further apart than this are not integrated across
+   *
+   */
+  double max_dt = 0.1;
+
+  /**
+   * @brief Predicted translations shorter than this carry no direction
+   *
+   */
+  double min_translation = 1e-3;
+
+  /**
+   * @brief Function to propagate the state over an interval, holding the
+   * sample constant
+   *
+   * @param a: accelerometer sample in the body frame
+   * @param w: gyroscope sample in the body frame
+   * @param dt: interval length in seconds
+   */
+  void propagate_interval(const Eigen::Vector3d& a, const Eigen::Vector3d& w,
+                          double dt);
+
+  /**
+   * @brief Function to apply a measurement update
+   *
+   * @tparam N: measurement dimension
+   * @param H: measurement Jacobian
+   * @param residual: measurement minus prediction
+   * @param measurement_noise
+   * @param gate: chi-square threshold of the innovation
+   * @return true if the update passed the gate
+   */
+  template <int N>
+  bool apply_update(const Eigen::Matrix<double, N, kStateSize>& H,
+                    const Eigen::Matrix<double, N, 1>& residual,
+                    const Eigen::Matrix<double, N, N>& measurement_noise,
+                    double gate);
+
+ public:
+  /**
+   * @brief Construct a new Error State Ekf object
+   *
+   * @param initial_pose: body to world
+   * @param filter_noise
+   */
+  ErrorStateEkf(const Eigen::Matrix4d& initial_pose = Eigen::Matrix4d::Identity(),
+                const FilterNoise& filter_noise = FilterNoise());
+
+  /**
+   * @brief Function to set gravity in the world frame. Without it, gravity is
+   * taken from the first IMU sample, which assumes the device starts at rest.
+   *
+   * @param g
+   */
+  void set_gravity(const Eigen::Vector3d& g);
+
+  /**
+   * @brief Function to set the rotation from the camera to the IMU body frame
+   *
+   * @param R_body_camera
+   */
+  void set_camera_rotation(const Eigen::Matrix3d& R_body_camera);
+
+  /**
+   * @brief Function to propagate with a timestamped IMU sample. The interval
+   * since the previous sample is integrated with the previous sample's values.
+   *
+   * @param timestamp: sample time in seconds
+   * @param a: accelerometer sample in the body frame
+   * @param w: gyroscope sample in the body frame
+   */
+  void propagate(double timestamp, const Eigen::Vector3d& a,
+                 const Eigen::Vector3d& w);
+
+  /**
+   * @brief Function to propagate with a block of timestamped IMU samples
+   *
+   * @param samples
+   */
+  void propagate(const io::ImuSpan& samples);
+
+  /**
+   * @brief Function to mark the current state as the previous image
+   *
+   */
+  void clone_pose();
+
+  /**
+   * @brief Function to fuse the camera motion from the previous image to the
+   * current one, then clone the current pose. Without IMU data since the
+   * previous image, only the VO rotation is followed; the unit-length VO
+   * translation never enters the metric position.
+   *
+   * @param T_prev_curr: pose of the current camera in the previous camera
+   * frame, as accumulated by VisualOdometry (translation scale is ignored)
+   * @return true if the measurement was fused
+   */
+  bool update_relative_pose(const Eigen::Matrix4d& T_prev_curr);
+
+  /**
+   * @brief Function to get the camera rotation since the previous image
+   * predicted from the IMU, e.g. as a rotation prior for VisualOdometry
+   *
+   * @return Eigen::Matrix3d: R such that X_prev = R * X_curr
+   */
+  Eigen::Matrix3d get_camera_rotation_since_clone() const;
+
+  /**
+   * @brief Function to get the fused pose
+   *
+   * @return Eigen::Matrix4d: body to world
+   */
+  Eigen::Matrix4d get_pose() const;
+
+  /**
+   * @brief Function to get the fused velocity in the world frame
+   *
+   * @return Eigen::Vector3d
+   */
+  Eigen::Vector3d get_velocity() const;
+
+  /**
+   * @brief Function to get the estimated gyroscope bias
+   *
+   * @return Eigen::Vector3d
+   */
+  Eigen::Vector3d get_gyro_bias() const;
+
+  /**
+   * @brief Function to get the estimated accelerometer bias
+   *
+   * @return Eigen::Vector3d
+   */
+  Eigen::Vector3d get_accel_bias() const;
+
+  /**
+   * @brief Function to get the covariance of the error state
+   *
+   * @return const Covariance&
+   */
+  const Covariance& get_covariance() const;
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+}  // namespace vio
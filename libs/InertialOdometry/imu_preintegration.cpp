@@ -0,0 +1,279 @@
+/**
+ * @file imu_preintegration.cpp
+ * @author Kshitij Aggarwal
+ * @brief C++ source file for IMU preintegration between keyframes
+ * @version 0.1
+ * @date 2024-11-18
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "imu_preintegration.hpp"
+
+#include "so3.hpp"
+
+/**
+ * @brief Construct an empty io::Imu Preintegration::Imu Preintegration object
+ *
+ * @param gyro_bias
+ * @param accel_bias
+ * @param noise
+ */
+io::ImuPreintegration::ImuPreintegration(const Eigen::Vector3d& gyro_bias,
+                                         const Eigen::Vector3d& accel_bias,
+                                         const ImuNoise& noise) {
+  noise_covariance.setZero();
+  noise_covariance.topLeftCorner<3, 3>().diagonal().setConstant(
+      noise.gyro_noise_density * noise.gyro_noise_density);
+  noise_covariance.bottomRightCorner<3, 3>().diagonal().setConstant(
+      noise.accel_noise_density * noise.accel_noise_density);
+
+  reset(gyro_bias, accel_bias);
+}
+
+/**
+ * @brief Function to start a new interval with new linearization biases
+ *
+ * @param new_gyro_bias
+ * @param new_accel_bias
+ */
+void io::ImuPreintegration::reset(const Eigen::Vector3d& new_gyro_bias,
+                                  const Eigen::Vector3d& new_accel_bias) {
+  delta_R.setIdentity();
+  delta_v.setZero();
+  delta_p.setZero();
+  delta_t = 0.0;
+  covariance.setZero();
+  dR_dbg.setZero();
+  dv_dbg.setZero();
+  dv_dba.setZero();
+  dp_dbg.setZero();
+  dp_dba.setZero();
+  gyro_bias = new_gyro_bias;
+  accel_bias = new_accel_bias;
+}
+
+/**
+ * @brief Function to add one sample held over an interval
+ *
+ * @param a
+ * @param w
+ * @param dt
+ */
+void io::ImuPreintegration::integrate(const Eigen::Vector3d& a,
+                                      const Eigen::Vector3d& w, double dt) {
+  if (!(dt > 0.0)) return;
+
+  const Eigen::Vector3d acceleration = a - accel_bias;
+  const Eigen::Vector3d rotation_vector = (w - gyro_bias) * dt;
+  const Eigen::Matrix3d increment = so3::exp(rotation_vector);
+  const Eigen::Matrix3d Jr = so3::right_jacobian(rotation_vector);
+  const Eigen::Matrix3d R_hat_a = delta_R * so3::hat(acceleration);
+  const double dt2 = dt * dt;
+
+  // Covariance: the error evolves as x' = A x + B n, with fixed-size
+  // matrices so nothing is allocated per sample
+  Eigen::Matrix<double, 9, 9> A = Eigen::Matrix<double, 9, 9>::Identity();
+  A.block<3, 3>(0, 0) = increment.transpose();
+  A.block<3, 3>(3, 0) = -R_hat_a * dt;
+  A.block<3, 3>(6, 0) = -0.5 * R_hat_a * dt2;
+  A.block<3, 3>(6, 3) = Eigen::Matrix3d::Identity() * dt;
+
+  Eigen::Matrix<double, 9, 6> B = Eigen::Matrix<double, 9, 6>::Zero();
+  B.block<3, 3>(0, 0) = Jr * dt;
+  B.block<3, 3>(3, 3) = delta_R * dt;
+  B.block<3, 3>(6, 3) = 0.5 * delta_R * dt2;
+
+  // Discrete noise covariance is the density squared over the interval
+  covariance = A * covariance * A.transpose() +
+               B * (noise_covariance / dt) * B.transpose();
+
+  // Bias Jacobians, using the rotation before this sample
+  dp_dba += dv_dba * dt - 0.5 * delta_R * dt2;
+  dp_dbg += dv_dbg * dt - 0.5 * R_hat_a * dR_dbg * dt2;
+  dv_dba -= delta_R * dt;
+  dv_dbg -= R_hat_a * dR_dbg * dt;
+  dR_dbg = increment.transpose() * dR_dbg - Jr * dt;
+
+  // Deltas
+  delta_p += delta_v * dt + 0.5 * delta_R * acceleration * dt2;
+  delta_v += delta_R * acceleration * dt;
+  delta_R = delta_R * increment;
+  delta_t += dt;
+}
+
+/**
+ * @brief Function to add the intervals between consecutive samples of a block
+ *
+ * @param samples
+ */
+void io::ImuPreintegration::integrate(const ImuSpan& samples) {
+  for (size_t i = 1; i < samples.size; i++) {
+    integrate(Eigen::Vector3d(samples.accel_x[i - 1], samples.accel_y[i - 1],
+                              samples.accel_z[i - 1]),
+              Eigen::Vector3d(samples.gyro_x[i - 1], samples.gyro_y[i - 1],
+                              samples.gyro_z[i - 1]),
+              samples.timestamp[i] - samples.timestamp[i - 1]);
+  }
+}
+
+/**
+ * @brief Function to get the rotation corrected to new biases
+ *
+ * @param new_gyro_bias
+ * @return Eigen::Matrix3d
+ */
+Eigen::Matrix3d io::ImuPreintegration::corrected_delta_R(
+    const Eigen::Vector3d& new_gyro_bias) const {
+  return delta_R * so3::exp(dR_dbg * (new_gyro_bias - gyro_bias));
+}
+
+/**
+ * @brief Function to get the velocity corrected to new biases
+ *
+ * @param new_gyro_bias
+ * @param new_accel_bias
+ * @return Eigen::Vector3d
+ */
+Eigen::Vector3d io::ImuPreintegration::corrected_delta_v(
+    const Eigen::Vector3d& new_gyro_bias,
+    const Eigen::Vector3d& new_accel_bias) const {
+  return delta_v + dv_dbg * (new_gyro_bias - gyro_bias) +
+         dv_dba * (new_accel_bias - accel_bias);
+}
+
+/**
+ * @brief Function to get the position corrected to new biases
+ *
+ * @param new_gyro_bias
+ * @param new_accel_bias
+ * @return Eigen::Vector3d
+ */
+Eigen::Vector3d io::ImuPreintegration::corrected_delta_p(
+    const Eigen::Vector3d& new_gyro_bias,
+    const Eigen::Vector3d& new_accel_bias) const {
+  return delta_p + dp_dbg * (new_gyro_bias - gyro_bias) +
+         dp_dba * (new_accel_bias - accel_bias);
+}
+
+/**
+ * @brief Function to predict the state at the end of the interval
+ *
+ * @param pose_i
+ * @param velocity_i
+ * @param gravity
+ * @param pose_j
+ * @param velocity_j
+ */
+void io::ImuPreintegration::predict(const Eigen::Matrix4d& pose_i,
+                                    const Eigen::Vector3d& velocity_i,
+                                    const Eigen::Vector3d& gravity,
+                                    Eigen::Matrix4d& pose_j,
+                                    Eigen::Vector3d& velocity_j) const {
+  predict(pose_i, velocity_i, gravity, gyro_bias, accel_bias, pose_j,
+          velocity_j);
+}
+
+/**
+ * @brief Function to predict the state at the end of the interval with
+ * deltas corrected to new biases
+ *
+ * @param pose_i
+ * @param velocity_i
+ * @param gravity
+ * @param new_gyro_bias
+ * @param new_accel_bias
+ * @param pose_j
+ * @param velocity_j
+ */
+void io::ImuPreintegration::predict(const Eigen::Matrix4d& pose_i,
+                                    const Eigen::Vector3d& velocity_i,
+                                    const Eigen::Vector3d& gravity,
+                                    const Eigen::Vector3d& new_gyro_bias,
+                                    const Eigen::Vector3d& new_accel_bias,
+                                    Eigen::Matrix4d& pose_j,
+                                    Eigen::Vector3d& velocity_j) const {
+  const Eigen::Matrix3d R_i = pose_i.block<3, 3>(0, 0);
+  const Eigen::Vector3d p_i = pose_i.block<3, 1>(0, 3);
+
+  pose_j = Eigen::Matrix4d::Identity();
+  pose_j.block<3, 3>(0, 0) = R_i * corrected_delta_R(new_gyro_bias);
+  pose_j.block<3, 1>(0, 3) =
+      p_i + velocity_i * delta_t + 0.5 * gravity * delta_t * delta_t +
+      R_i * corrected_delta_p(new_gyro_bias, new_accel_bias);
+  velocity_j = velocity_i + gravity * delta_t +
+               R_i * corrected_delta_v(new_gyro_bias, new_accel_bias);
+}
+
+/**
+ * @brief Function to get the preintegrated rotation
+ *
+ * @return const Eigen::Matrix3d&
+ */
+const Eigen::Matrix3d& io::ImuPreintegration::get_delta_R() const {
+  return delta_R;
+}
+
+/**
+ * @brief Function to get the preintegrated velocity
+ *
+ * @return const Eigen::Vector3d&
+ */
+const Eigen::Vector3d& io::ImuPreintegration::get_delta_v() const {
+  return delta_v;
+}
+
+/**
+ * @brief Function to get the preintegrated position
+ *
+ * @return const Eigen::Vector3d&
+ */
+const Eigen::Vector3d& io::ImuPreintegration::get_delta_p() const {
+  return delta_p;
+}
+
+/**
+ * @brief Function to get the integrated time span
+ *
+ * @return double
+ */
+double io::ImuPreintegration::get_delta_t() const { return delta_t; }
+
+/**
+ * @brief Function to get the covariance of the deltas
+ *
+ * @return const io::ImuPreintegration::Covariance&
+ */
+const io::ImuPreintegration::Covariance&
+io::ImuPreintegration::get_covariance() const {
+  return covariance;
+}
+
+/**
+ * @brief Function to get the gyroscope bias used for integration
+ *
+ * @return const Eigen::Vector3d&
+ */
+const Eigen::Vector3d& io::ImuPreintegration::get_gyro_bias() const {
+  return gyro_bias;
+}
+
+/**
+ * @brief Function to get the accelerometer bias used for integration
+ *
+ * @return const Eigen::Vector3d&
+ */
+const Eigen::Vector3d& io::ImuPreintegration::get_accel_bias() const {
+  return accel_bias;
+}
+
+/**
+ * @brief Function to get the Jacobian of the rotation with respect to the
+ * gyroscope bias
+ *
+ * @return const Eigen::Matrix3d&
+ */
+const Eigen::Matrix3d& io::ImuPreintegration::get_dR_dbg() const {
+  return dR_dbg;
+}
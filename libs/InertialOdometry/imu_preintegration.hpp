@@ -0,0 +1,265 @@
+/**
+ * @file imu_preintegration.hpp
+ * @author Kshitij Aggarwal
+ * @brief C++ header file for IMU preintegration between keyframes
+ * @version 0.1
+ * @date 2024-11-18
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <eigen3/Eigen/Core>
+#include <eigen3/Eigen/Dense>
+
+#include "imu_span.hpp"
+
+namespace io {
+
+/**
+ * @brief Continuous-time IMU noise densities
+ *
+ */
+struct ImuNoise {
+  /**
+   * @brief Gyroscope white noise density [rad/s/sqrt(Hz)]
+   *
+   */
+  double gyro_noise_density = 1.7e-4;
+
+  /**
+   * @brief Accelerometer white noise density [m/s^2/sqrt(Hz)]
+   *
+   */
+  double accel_noise_density = 2.0e-3;
+};
+
+/**
+ * @brief Summarizes the IMU samples between two keyframes into one relative
+ * motion (delta rotation, velocity and position) with its covariance and
+ * first-order bias Jacobians, so that bias updates do not require
+ * re-integration. Deltas are expressed in the body frame of the first
+ * keyframe and do not contain gravity.
+ *
+ */
+class ImuPreintegration {
+ public:
+  /**
+   * @brief 9x9 covariance of the deltas, ordered rotation, velocity, position
+   *
+   */
+  typedef Eigen::Matrix<double, 9, 9> Covariance;
+
+ private:
+  /**
+   * @brief Preintegrated rotation
+   *
+   */
+  Eigen::Matrix3d delta_R;
+
+  /**
+   * @brief Preintegrated velocity
+   *
+   */
+  Eigen::Vector3d delta_v;
+
+  /**
+   * @brief Preintegrated position
+   *
+   */
+  Eigen::Vector3d delta_p;
+
+  /**
+   * @brief Integrated time span in seconds
+   *
+   */
+  double delta_t;
+
+  /**
+   * @brief Covariance of the deltas
+   *
+   */
+  Covariance covariance;
+
+  /**
+   * @brief Jacobians of the deltas with respect to the biases
+   *
+   */
+  Eigen::Matrix3d dR_dbg, dv_dbg, dv_dba, dp_dbg, dp_dba;
+
+  /**
+   * @brief Biases the samples were integrated with
+   *
+   */
+  Eigen::Vector3d gyro_bias, accel_bias;
+
+  /**
+   * @brief Discrete noise covariance per second, diag(gyro^2, accel^2)
+   *
+   */
+  Eigen::Matrix<double, 6, 6> noise_covariance;
+
+ public:
+  /**
+   * @brief Construct an empty Imu Preintegration object
+   *
+   * @param gyro_bias: gyroscope bias to integrate with
+   * @param accel_bias: accelerometer bias to integrate with
+   * @param noise: IMU noise densities
+   */
+  ImuPreintegration(const Eigen::Vector3d& gyro_bias = Eigen::Vector3d::Zero(),
+                    const Eigen::Vector3d& accel_bias = Eigen::Vector3d::Zero(),
+                    const ImuNoise& noise = ImuNoise());
+
+  /**
+   * @brief Function to start a new interval with new linearization biases
+   *
+   * @param new_gyro_bias
+   * @param new_accel_bias
+   */
+  void reset(const Eigen::Vector3d& new_gyro_bias,
+             const Eigen::Vector3d& new_accel_bias);
+
+  /**
+   * @brief Function to add one sample held over an interval
+   *
+   * @param a: accelerometer sample in the imu frame
+   * @param w: gyroscope sample in the imu frame
+   * @param dt: interval length in seconds
+   */
+  void integrate(const Eigen::Vector3d& a, const Eigen::Vector3d& w,
+                 double dt);
+
+  /**
+   * @brief Function to add the intervals between consecutive samples of a
+   * block, each held at the earlier sample
+   *
+   * @param samples: consecutive IMU samples
+   */
+  void integrate(const ImuSpan& samples);
+
+  /**
+   * @brief Function to get the rotation corrected to new biases to first
+   * order
+   *
+   * @param new_gyro_bias
+   * @return Eigen::Matrix3d
+   */
+  Eigen::Matrix3d corrected_delta_R(const Eigen::Vector3d& new_gyro_bias) const;
+
+  /**
+   * @brief Function to get the velocity corrected to new biases to first
+   * order
+   *
+   * @param new_gyro_bias
+   * @param new_accel_bias
+   * @return Eigen::Vector3d
+   */
+  Eigen::Vector3d corrected_delta_v(const Eigen::Vector3d& new_gyro_bias,
+                                    const Eigen::Vector3d& new_accel_bias) const;
+
+  /**
+   * @brief Function to get the position corrected to new biases to first
+   * order
+   *
+   * @param new_gyro_bias
+   * @param new_accel_bias
+   * @return Eigen::Vector3d
+   */
+  Eigen::Vector3d corrected_delta_p(const Eigen::Vector3d& new_gyro_bias,
+                                    const Eigen::Vector3d& new_accel_bias) const;
+
+  /**
+   * @brief Function to predict the state at the end of the interval
+   *
+   * @param pose_i: pose at the start, body to world
+   * @param velocity_i: world velocity at the start
+   * @param gravity: gravity in the world frame
+   * @param pose_j: output pose at the end
+   * @param velocity_j: output world velocity at the end
+   */
+  void predict(const Eigen::Matrix4d& pose_i, const Eigen::Vector3d& velocity_i,
+               const Eigen::Vector3d& gravity, Eigen::Matrix4d& pose_j,
+               Eigen::Vector3d& velocity_j) const;
+
+  /**
+   * @brief Function to predict the state at the end of the interval with
+   * deltas corrected to new biases
+   *
+   * @param pose_i: pose at the start, body to world
+   * @param velocity_i: world velocity at the start
+   * @param gravity: gravity in the world frame
+   * @param new_gyro_bias
+   * @param new_accel_bias
+   * @param pose_j: output pose at the end
+   * @param velocity_j: output world velocity at the end
+   */
+  void predict(const Eigen::Matrix4d& pose_i, const Eigen::Vector3d& velocity_i,
+               const Eigen::Vector3d& gravity,
+               const Eigen::Vector3d& new_gyro_bias,
+               const Eigen::Vector3d& new_accel_bias, Eigen::Matrix4d& pose_j,
+               Eigen::Vector3d& velocity_j) const;
+
+  /**
+   * @brief Function to get the preintegrated rotation
+   *
+   * @return const Eigen::Matrix3d&
+   */
+  const Eigen::Matrix3d& get_delta_R() const;
+
+  /**
+   * @brief Function to get the preintegrated velocity
+   *
+   * @return const Eigen::Vector3d&
+   */
+  const Eigen::Vector3d& get_delta_v() const;
+
+  /**
+   * @brief Function to get the preintegrated position
+   *
+   * @return const Eigen::Vector3d&
+   */
+  const Eigen::Vector3d& get_delta_p() const;
+
+  /**
+   * @brief Function to get the integrated time span
+   *
+   * @return double
+   */
+  double get_delta_t() const;
+
+  /**
+   * @brief Function to get the covariance of the deltas
+   *
+   * @return const Covariance&
+   */
+  const Covariance& get_covariance() const;
+
+  /**
+   * @brief Function to get the gyroscope bias used for integration
+   *
+   * @return const Eigen::Vector3d&
+   */
+  const Eigen::Vector3d& get_gyro_bias() const;
+
+  /**
+   * @brief Function to get the accelerometer bias used for integration
+   *
+   * @return const Eigen::Vector3d&
+   */
+  const Eigen::Vector3d& get_accel_bias() const;
+
+  /**
+   * @brief Function to get the Jacobian of the rotation with respect to the
+   * gyroscope bias
+   *
+   * @return const Eigen::Matrix3d&
+   */
+  const Eigen::Matrix3d& get_dR_dbg() const;
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+}  // namespace io
@@ -0,0 +1,78 @@
+/**
+ * @file imu_span.hpp
+ * @author Kshitij Aggarwal
+ * @brief C++ header file for contiguous blocks of IMU samples
+ * @version 0.1
+ * @date 2024-11-16
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <cstddef>
+
+namespace io {
+
+/**
+ * @brief Non-owning view of consecutive IMU samples stored column by column
+ * (one contiguous array per quantity)
+ *
+ */
+struct ImuSpan {
+  /**
+   * @brief Sample timestamps in seconds
+   *
+   */
+  const double* timestamp = nullptr;
+
+  /**
+   * @brief Angular velocity in the IMU frame [rad/s]
+   *
+   */
+  const double* gyro_x = nullptr;
+  const double* gyro_y = nullptr;
+  const double* gyro_z = nullptr;
+
+  /**
+   * @brief Linear acceleration in the IMU frame [m/s^2]
+   *
+   */
+  const double* accel_x = nullptr;
+  const double* accel_y = nullptr;
+  const double* accel_z = nullptr;
+
+  /**
+   * @brief Number of samples
+   *
+   */
+  size_t size = 0;
+
+  /**
+   * @brief Function to get a view of part of the samples
+   *
+   * @param offset: first sample, clamped to the span
+   * @param count: number of samples, clamped to the span
+   * @return ImuSpan
+   */
+  ImuSpan subspan(size_t offset, size_t count) const {
+    if (offset > size) offset = size;
+    if (count > size - offset) count = size - offset;
+
+    ImuSpan span;
+    if (count == 0) return span;
+
+    span.timestamp = timestamp + offset;
+    span.gyro_x = gyro_x + offset;
+    span.gyro_y = gyro_y + offset;
+    span.gyro_z = gyro_z + offset;
+    span.accel_x = accel_x + offset;
+    span.accel_y = accel_y + offset;
+    span.accel_z = accel_z + offset;
+    span.size = count;
+    return span;
+  }
+};
+
+}  // namespace io
@@ -13,8 +13,22 @@
 
 #include <eigen3/Eigen/src/Core/Matrix.h>
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 
+#include "so3.hpp"
+
+namespace {
+
+/**
+ * @brief Number of samples whose rotation increments are computed together
+ *
+ */
+const size_t kIntegrationChunk = 256;
+
+}  // namespace
+
 /**
  * @brief Function to implement rodrigues formula for rotation matrix
  * calculation
@@ -32,8 +46,7 @@ Eigen::Matrix3d io::InertialOdometry::rodrigues_formula(Eigen::Vector3d w) {
   Eigen::Vector3d n_hat = w.normalized();
 
   // Calculate the skew symmetric matrix
-  Eigen::Matrix3d K;
-  K << 0, -n_hat(2), n_hat(1), n_hat(2), 0, -n_hat(0), -n_hat(1), n_hat(0), 0;
+  Eigen::Matrix3d K = so3::hat(n_hat);
 
   Eigen::Matrix3d R =
       Eigen::Matrix3d::Identity() + sin(angle) * K + (1 - cos(angle)) * K * K;
@@ -48,6 +61,41 @@ Eigen::Matrix3d io::InertialOdometry::rodrigues_formula(Eigen::Vector3d w) {
  */
 Eigen::Matrix4d io::InertialOdometry::get_pose() { return io_pose; }
 
+/**
+ * @brief Function to take gravity from an accelerometer sample
+ *
+ * @param a
+ */
+void io::InertialOdometry::initialize_gravity(const Eigen::Vector3d& a) {
+  // At rest the accelerometer measures the reaction to gravity
+  gravity = -(io_pose.block<3, 3>(0, 0) * (a - accel_bias));
+  gravity_initialized = true;
+}
+
+/**
+ * @brief Function to propagate the state over an interval
+ *
+ * @param a
+ * @param w
+ * @param step
+ */
+void io::InertialOdometry::propagate(const Eigen::Vector3d& a,
+                                     const Eigen::Vector3d& w, double step) {
+  Eigen::Matrix3d R = io_pose.block<3, 3>(0, 0);
+
+  // Acceleration in the world frame, gravity compensated
+  Eigen::Vector3d acceleration = R * (a - accel_bias) + gravity;
+
+  io_pose.block<3, 1>(0, 3) +=
+      velocity * step + 0.5 * acceleration * step * step;
+  velocity += acceleration * step;
+
+  // Rotating the gyro sample into the world frame and updating on the left
+  // equals applying the body-frame increment on the right:
+  // exp(R w dt) R = R exp(w dt)
+  io_pose.block<3, 3>(0, 0) = R * so3::exp((w - gyro_bias) * step);
+}
+
 /**
  * @brief Function to update the pose using accelerometer and gyroscope data
  *
@@ -55,22 +103,224 @@ Eigen::Matrix4d io::InertialOdometry::get_pose() { return io_pose; }
  * @param w
  */
 void io::InertialOdometry::update_pose(Eigen::Vector3d a, Eigen::Vector3d w) {
-  // Convert IMU data to local frame
+  if (!gravity_initialized) initialize_gravity(a);
+
+  propagate(a, w, dt);
+
+  accelerometer_data = a;
+  gyroscope_data = w;
+}
+
+/**
+ * @brief Function to integrate a timestamped IMU sample
+ *
+ * @param timestamp
+ * @param a
+ * @param w
+ */
+void io::InertialOdometry::update_pose(double timestamp,
+                                       const Eigen::Vector3d& a,
+                                       const Eigen::Vector3d& w) {
+  if (!gravity_initialized) initialize_gravity(a);
+
+  // Hold the previous sample over the interval; skip gaps and reordering
+  if (has_last_sample) {
+    double step = timestamp - last_timestamp;
+    if (step > 0.0 && step <= max_dt)
+      propagate(accelerometer_data, gyroscope_data, step);
+  }
+
+  last_timestamp = timestamp;
+  has_last_sample = true;
+  accelerometer_data = a;
+  gyroscope_data = w;
+}
+
+/**
+ * @brief Function to integrate a block of IMU samples in one pass
+ *
+ * @param samples
+ * @return Eigen::Matrix4d
+ */
+Eigen::Matrix4d io::InertialOdometry::integrate(const ImuSpan& samples) {
+  std::vector<Eigen::Matrix4d> no_trajectory;
+  return integrate(samples, 0, no_trajectory);
+}
+
+/**
+ * @brief Function to integrate a block of IMU samples in one pass
+ *
+ * @param samples
+ * @param stride
+ * @param trajectory
+ * @return Eigen::Matrix4d
+ */
+Eigen::Matrix4d io::InertialOdometry::integrate(
+    const ImuSpan& samples, size_t stride,
+    std::vector<Eigen::Matrix4d>& trajectory) {
+  if (samples.size == 0) return io_pose;
+
+  if (!gravity_initialized)
+    initialize_gravity(Eigen::Vector3d(samples.accel_x[0], samples.accel_y[0],
+                                       samples.accel_z[0]));
+
   Eigen::Matrix3d R = io_pose.block<3, 3>(0, 0);
-  // std::cout << "rotation matrix: \n" << R << std::endl;
-  a = R * a;
-  w = R * w;
+  Eigen::Vector3d p = io_pose.block<3, 1>(0, 3);
+  Eigen::Vector3d v = velocity;
+
+  // Sample held over the interval ending at the current sample
+  Eigen::Vector3d a_held = accelerometer_data - accel_bias;
+  Eigen::Vector3d w_held = gyroscope_data - gyro_bias;
+  double t_held = last_timestamp;
+  bool holding = has_last_sample;
+
+  double step[kIntegrationChunk];
+  double rx[kIntegrationChunk], ry[kIntegrationChunk], rz[kIntegrationChunk];
+  double sin_term[kIntegrationChunk], cos_term[kIntegrationChunk];
+
+  if (stride > 0) trajectory.reserve(trajectory.size() + samples.size / stride);
+
+  for (size_t begin = 0; begin < samples.size; begin += kIntegrationChunk) {
+    size_t count = std::min(kIntegrationChunk, samples.size - begin);
+    const double* t = samples.timestamp + begin;
+    const double* wx = samples.gyro_x + begin;
+    const double* wy = samples.gyro_y + begin;
+    const double* wz = samples.gyro_z + begin;
+
+    // Interval lengths and rotation increments, independent per sample. The
+    // increment ending at sample i uses the gyro sample i - 1.
+    step[0] = holding ? t[0] - t_held : 0.0;
+    rx[0] = w_held(0);
+    ry[0] = w_held(1);
+    rz[0] = w_held(2);
+    for (size_t i = 1; i < count; i++) {
+      step[i] = t[i] - t[i - 1];
+      rx[i] = wx[i - 1] - gyro_bias(0);
+      ry[i] = wy[i - 1] - gyro_bias(1);
+      rz[i] = wz[i - 1] - gyro_bias(2);
+    }
+    for (size_t i = 0; i < count; i++) {
+      if (!(step[i] > 0.0 && step[i] <= max_dt)) step[i] = 0.0;
+      rx[i] *= step[i];
+      ry[i] *= step[i];
+      rz[i] *= step[i];
+      so3::rodrigues_coefficients(rx[i] * rx[i] + ry[i] * ry[i] + rz[i] * rz[i],
+                                  sin_term[i], cos_term[i]);
+    }
+
+    // Chain the increments
+    for (size_t i = 0; i < count; i++) {
+      size_t k = begin + i;
+      if (step[i] > 0.0) {
+        Eigen::Vector3d acceleration = R * a_held + gravity;
+        p += v * step[i] + 0.5 * acceleration * step[i] * step[i];
+        v += acceleration * step[i];
+        R = R * so3::exp(Eigen::Vector3d(rx[i], ry[i], rz[i]), sin_term[i],
+                         cos_term[i]);
+      }
+
+      a_held = Eigen::Vector3d(samples.accel_x[k], samples.accel_y[k],
+                               samples.accel_z[k]) -
+               accel_bias;
+
+      if (stride > 0 && (k + 1) % stride == 0) {
+        io_pose.block<3, 3>(0, 0) = R;
+        io_pose.block<3, 1>(0, 3) = p;
+        trajectory.push_back(io_pose);
+      }
+    }
+
+    w_held = Eigen::Vector3d(wx[count - 1], wy[count - 1], wz[count - 1]) -
+             gyro_bias;
+    t_held = t[count - 1];
+    holding = true;
+  }
+
+  io_pose.block<3, 3>(0, 0) = R;
+  io_pose.block<3, 1>(0, 3) = p;
+  velocity = v;
+
+  size_t last = samples.size - 1;
+  last_timestamp = samples.timestamp[last];
+  has_last_sample = true;
+  accelerometer_data = Eigen::Vector3d(samples.accel_x[last],
+                                       samples.accel_y[last],
+                                       samples.accel_z[last]);
+  gyroscope_data = Eigen::Vector3d(samples.gyro_x[last], samples.gyro_y[last],
+                                   samples.gyro_z[last]);
+  return io_pose;
+}
+
+/**
+ * @brief Function to get the velocity in the world frame
+ *
+ * @return Eigen::Vector3d
+ */
+Eigen::Vector3d io::InertialOdometry::get_velocity() const { return velocity; }
+
+/**
+ * @brief Function to set the velocity in the world frame
+ *
+ * @param v
+ */
+void io::InertialOdometry::set_velocity(const Eigen::Vector3d& v) {
+  velocity = v;
+}
+
+/**
+ * @brief Function to set the sensor biases
+ *
+ * @param gyro
+ * @param accel
+ */
+void io::InertialOdometry::set_biases(const Eigen::Vector3d& gyro,
+                                      const Eigen::Vector3d& accel) {
+  gyro_bias = gyro;
+  accel_bias = accel;
+}
 
-  // std::cout << "angular velocity in local frame: " << w.transpose() <<
-  // std::endl;
+/**
+ * @brief Function to get the gyroscope bias
+ *
+ * @return Eigen::Vector3d
+ */
+Eigen::Vector3d io::InertialOdometry::get_gyro_bias() const {
+  return gyro_bias;
+}
 
-  // Calculate rate of change of rotation matrix using rodrigues formula
-  Eigen::Matrix3d r_dot = rodrigues_formula(w);
+/**
+ * @brief Function to get the accelerometer bias
+ *
+ * @return Eigen::Vector3d
+ */
+Eigen::Vector3d io::InertialOdometry::get_accel_bias() const {
+  return accel_bias;
+}
 
-  // std::cout << "R_dot: \n" << r_dot << std::endl;
+/**
+ * @brief Function to set gravity in the world frame
+ *
+ * @param g
+ */
+void io::InertialOdometry::set_gravity(const Eigen::Vector3d& g) {
+  gravity = g;
+  gravity_initialized = true;
+}
 
-  // Update the rotation matrix io_pose directly
-  io_pose.block<3, 3>(0, 0) = r_dot * io_pose.block<3, 3>(0, 0);
+/**
+ * @brief Function to get gravity in the world frame
+ *
+ * @return Eigen::Vector3d
+ */
+Eigen::Vector3d io::InertialOdometry::get_gravity() const { return gravity; }
+
+/**
+ * @brief Function to set the nominal sampling time
+ *
+ * @param sampling_time
+ */
+void io::InertialOdometry::set_sampling_time(double sampling_time) {
+  dt = sampling_time;
 }
 
 /**
@@ -79,6 +329,8 @@ void io::InertialOdometry::update_pose(Eigen::Vector3d a, Eigen::Vector3d w) {
  */
 io::InertialOdometry::InertialOdometry(Eigen::Matrix4d initial_pose) {
   io_pose = initial_pose;
+  accelerometer_data.setZero();
+  gyroscope_data.setZero();
 }
 
 /**
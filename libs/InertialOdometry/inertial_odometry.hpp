@@ -17,6 +17,8 @@
 #include <opencv2/opencv.hpp>
 #include <vector>
 
+#include "imu_span.hpp"
+
 /**
  * @brief Inertial Odometry namespace
  *
@@ -24,19 +26,20 @@
 namespace io {
 
 /**
- * @brief Inertial Odometry class
+ * @brief Inertial Odometry class. Integrates IMU samples into orientation,
+ * velocity and position (strapdown mechanization) with bias compensation.
  *
  */
 class InertialOdometry {
  private:
   /**
-   * @brief Vector to store accelerometer data [ax, ay, az]
+   * @brief Vector to store the last accelerometer sample [ax, ay, az]
    *
    */
   Eigen::Vector3d accelerometer_data;
 
   /**
-   * @brief Vector to store gyroscope data [wx, wy, wz]
+   * @brief Vector to store the last gyroscope sample [wx, wy, wz]
    *
    */
   Eigen::Vector3d gyroscope_data;
@@ -48,10 +51,77 @@ class InertialOdometry {
   Eigen::Matrix4d io_pose;
 
   /**
-   * @brief Sampling time for the IMU data
+   * @brief Velocity in the world frame
+   *
+   */
+  Eigen::Vector3d velocity = Eigen::Vector3d::Zero();
+
+  /**
+   * @brief Gyroscope bias, subtracted from every sample
+   *
+   */
+  Eigen::Vector3d gyro_bias = Eigen::Vector3d::Zero();
+
+  /**
+   * @brief Accelerometer bias, subtracted from every sample
+   *
+   */
+  Eigen::Vector3d accel_bias = Eigen::Vector3d::Zero();
+
+  /**
+   * @brief Gravity in the world frame
+   *
+   */
+  Eigen::Vector3d gravity = Eigen::Vector3d::Zero();
+
+  /**
+   * @brief Flag to track if gravity was set or initialized
+   *
+   */
+  bool gravity_initialized = false;
+
+  /**
+   * @brief Timestamp of the last sample
+   *
+   */
+  double last_timestamp = 0.0;
+
+  /**
+   * @brief Flag to track if a timestamped sample was received
+   *
+   */
+  bool has_last_sample = false;
+
+  /**
+   * @brief Nominal sampling time, used for samples without timestamps
+   *
+   */
+  double dt = 0.001;
+
+  /**
+   * @brief Samples further apart than this are not integrated across
    *
    */
-  float dt = 0.001;
+  double max_dt = 0.1;
+
+  /**
+   * @brief Function to take gravity from an accelerometer sample, assuming
+   * the device is at rest
+   *
+   * @param a: accelerometer sample in the imu frame
+   */
+  void initialize_gravity(const Eigen::Vector3d& a);
+
+  /**
+   * @brief Function to propagate the state over an interval, holding the
+   * sample constant
+   *
+   * @param a: accelerometer sample in the imu frame
+   * @param w: gyroscope sample in the imu frame
+   * @param step: interval length in seconds
+   */
+  void propagate(const Eigen::Vector3d& a, const Eigen::Vector3d& w,
+                 double step);
 
  public:
   /**
@@ -68,13 +138,46 @@ class InertialOdometry {
   ~InertialOdometry();
 
   /**
-   * @brief Function to integrate the IMU data
+   * @brief Function to integrate the IMU data over the nominal sampling time
    *
    * @param a: accelerometer data in the imu frame
    * @param w: gyroscope data in the imu frame
    */
   void update_pose(Eigen::Vector3d a, Eigen::Vector3d w);
 
+  /**
+   * @brief Function to integrate a timestamped IMU sample. The interval since
+   * the previous sample is integrated with the previous sample's values; the
+   * first sample only starts the integration.
+   *
+   * @param timestamp: sample time in seconds
+   * @param a: accelerometer data in the imu frame
+   * @param w: gyroscope data in the imu frame
+   */
+  void update_pose(double timestamp, const Eigen::Vector3d& a,
+                   const Eigen::Vector3d& w);
+
+  /**
+   * @brief Function to integrate a block of timestamped IMU samples in one
+   * pass, equivalent to calling the timestamped update_pose on each
+   *
+   * @param samples: consecutive IMU samples
+   * @return Eigen::Matrix4d: pose after the last sample
+   */
+  Eigen::Matrix4d integrate(const ImuSpan& samples);
+
+  /**
+   * @brief Function to integrate a block of timestamped IMU samples in one
+   * pass, keeping every stride-th pose
+   *
+   * @param samples: consecutive IMU samples
+   * @param stride: a pose is appended after every stride-th sample
+   * @param trajectory: poses are appended to it
+   * @return Eigen::Matrix4d: pose after the last sample
+   */
+  Eigen::Matrix4d integrate(const ImuSpan& samples, size_t stride,
+                            std::vector<Eigen::Matrix4d>& trajectory);
+
   /**
    * @brief Function to calculate the rate of change of rotation matrix using
    * rodrigues formula
@@ -90,6 +193,65 @@ class InertialOdometry {
    * @param pose
    */
   Eigen::Matrix4d get_pose();
+
+  /**
+   * @brief Function to get the velocity in the world frame
+   *
+   * @return Eigen::Vector3d
+   */
+  Eigen::Vector3d get_velocity() const;
+
+  /**
+   * @brief Function to set the velocity in the world frame
+   *
+   * @param v
+   */
+  void set_velocity(const Eigen::Vector3d& v);
+
+  /**
+   * @brief Function to set the sensor biases subtracted from every sample
+   *
+   * @param gyro: gyroscope bias [rad/s]
+   * @param accel: accelerometer bias [m/s^2]
+   */
+  void set_biases(const Eigen::Vector3d& gyro, const Eigen::Vector3d& accel);
+
+  /**
+   * @brief Function to get the gyroscope bias
+   *
+   * @return Eigen::Vector3d
+   */
+  Eigen::Vector3d get_gyro_bias() const;
+
+  /**
+   * @brief Function to get the accelerometer bias
+   *
+   * @return Eigen::Vector3d
+   */
+  Eigen::Vector3d get_accel_bias() const;
+
+  /**
+   * @brief Function to set gravity in the world frame. Without it, gravity is
+   * taken from the first sample, which assumes the device starts at rest.
+   *
+   * @param g: e.g. (0, 0, -9.81) for a z-up world
+   */
+  void set_gravity(const Eigen::Vector3d& g);
+
+  /**
+   * @brief Function to get gravity in the world frame
+   *
+   * @return Eigen::Vector3d
+   */
+  Eigen::Vector3d get_gravity() const;
+
+  /**
+   * @brief Function to set the nominal sampling time used by the untimed
+   * update_pose and rodrigues_formula
+   *
+   * @param sampling_time
+   */
+  void set_sampling_time(double sampling_time);
 };
 
-}  // namespace io
\ No newline at end of file
+}  // namespace io
@@ -0,0 +1,113 @@
+/**
+ * @file so3.hpp
+ * @author Kshitij Aggarwal
+ * @brief C++ header file for rotation group helpers
+ * @version 0.1
+ * @date 2024-11-17
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <cmath>
+#include <eigen3/Eigen/Core>
+#include <eigen3/Eigen/Geometry>
+
+namespace io {
+namespace so3 {
+
+/**
+ * @brief Function to build the skew symmetric matrix of a vector
+ *
+ * @param v
+ * @return Eigen::Matrix3d: [v]x such that [v]x * u = v x u
+ */
+inline Eigen::Matrix3d hat(const Eigen::Vector3d& v) {
+  Eigen::Matrix3d K;
+  K << 0, -v(2), v(1), v(2), 0, -v(0), -v(1), v(0), 0;
+  return K;
+}
+
+/**
+ * @brief Function to compute the Rodrigues coefficients sin(t)/t and
+ * (1 - cos(t))/t^2 of a rotation angle t, with a Taylor expansion near zero
+ *
+ * @param angle_squared: squared rotation angle
+ * @param a: output sin(t)/t
+ * @param b: output (1 - cos(t))/t^2
+ */
+inline void rodrigues_coefficients(double angle_squared, double& a,
+                                   double& b) {
+  if (angle_squared < 1e-10) {
+    a = 1.0 - angle_squared / 6.0;
+    b = 0.5 - angle_squared / 24.0;
+    return;
+  }
+  double angle = std::sqrt(angle_squared);
+  a = std::sin(angle) / angle;
+  b = (1.0 - std::cos(angle)) / angle_squared;
+}
+
+/**
+ * @brief Function to build a rotation matrix from Rodrigues coefficients
+ *
+ * @param phi: rotation vector
+ * @param a: sin(t)/t
+ * @param b: (1 - cos(t))/t^2
+ * @return Eigen::Matrix3d: I + a [phi]x + b [phi]x^2
+ */
+inline Eigen::Matrix3d exp(const Eigen::Vector3d& phi, double a, double b) {
+  double x = phi(0), y = phi(1), z = phi(2);
+  Eigen::Matrix3d R;
+  R << 1.0 - b * (y * y + z * z), -a * z + b * x * y, a * y + b * x * z,
+      a * z + b * x * y, 1.0 - b * (x * x + z * z), -a * x + b * y * z,
+      -a * y + b * x * z, a * x + b * y * z, 1.0 - b * (x * x + y * y);
+  return R;
+}
+
+/**
+ * @brief Function to map a rotation vector to a rotation matrix
+ *
+ * @param phi: rotation vector (axis times angle)
+ * @return Eigen::Matrix3d
+ */
+inline Eigen::Matrix3d exp(const Eigen::Vector3d& phi) {
+  double a, b;
+  rodrigues_coefficients(phi.squaredNorm(), a, b);
+  return exp(phi, a, b);
+}
+
+/**
+ * @brief Function to map a rotation matrix to its rotation vector
+ *
+ * @param R: rotation matrix
+ * @return Eigen::Vector3d: rotation vector (axis times angle)
+ */
+inline Eigen::Vector3d log(const Eigen::Matrix3d& R) {
+  Eigen::AngleAxisd angle_axis(R);
+  return angle_axis.angle() * angle_axis.axis();
+}
+
+/**
+ * @brief Function to compute the right Jacobian of the exponential map,
+ * exp(phi + d) ~ exp(phi) exp(Jr(phi) d) for small d
+ *
+ * @param phi: rotation vector
+ * @return Eigen::Matrix3d
+ */
+inline Eigen::Matrix3d right_jacobian(const Eigen::Vector3d& phi) {
+  double angle_squared = phi.squaredNorm();
+  Eigen::Matrix3d K = hat(phi);
+  if (angle_squared < 1e-10)
+    return Eigen::Matrix3d::Identity() - 0.5 * K + K * K / 6.0;
+
+  double angle = std::sqrt(angle_squared);
+  return Eigen::Matrix3d::Identity() -
+         (1.0 - std::cos(angle)) / angle_squared * K +
+         (angle - std::sin(angle)) / (angle_squared * angle) * K * K;
+}
+
+}  // namespace so3
+}  // namespace io
@@ -0,0 +1,103 @@
+/**
+ * @file keyframe_database.cpp
+ * @author Apoorv Thapliyal
+ * @brief C++ source file for the inverted-file keyframe database
+ * @version 0.1
+ * @date 2024-11-24
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "keyframe_database.hpp"
+
+#include <algorithm>
+
+/**
+ * @brief Construct a new lc::Keyframe Database::Keyframe Database object
+ *
+ * @param max_word_postings
+ */
+lc::KeyframeDatabase::KeyframeDatabase(size_t max_word_postings)
+    : max_postings(max_word_postings) {}
+
+/**
+ * @brief Function to add a keyframe
+ *
+ * @param bow
+ * @return size_t
+ */
+size_t lc::KeyframeDatabase::add(const BowVector& bow) {
+  const uint32_t keyframe = static_cast<uint32_t>(keyframe_count++);
+  for (const auto& entry : bow) {
+    if (entry.first >= inverted_file.size())
+      inverted_file.resize(entry.first + 1);
+    inverted_file[entry.first].push_back(
+        {keyframe, static_cast<float>(entry.second)});
+  }
+  scores.push_back(0.0);
+  return keyframe;
+}
+
+/**
+ * @brief Function to find the keyframes most similar to a query
+ *
+ * @param bow
+ * @param max_results
+ * @param end
+ * @param results
+ */
+void lc::KeyframeDatabase::query(const BowVector& bow, size_t max_results,
+                                 size_t end,
+                                 std::vector<QueryResult>& results) {
+  results.clear();
+  end = std::min(end, keyframe_count);
+
+  // Accumulate the L1 score, the sum of the smaller weight of every shared
+  // word, over the occurrences of the query words only
+  touched.clear();
+  for (const auto& entry : bow) {
+    if (entry.first >= inverted_file.size()) continue;
+    const std::vector<Posting>& postings = inverted_file[entry.first];
+    if (postings.size() > max_postings) continue;
+
+    // Postings are sorted by keyframe, so the ones past the end are a suffix
+    for (const Posting& posting : postings) {
+      if (posting.keyframe >= end) break;
+      if (scores[posting.keyframe] == 0.0) touched.push_back(posting.keyframe);
+      scores[posting.keyframe] +=
+          std::min(entry.second, static_cast<double>(posting.weight));
+    }
+  }
+
+  results.reserve(touched.size());
+  for (uint32_t keyframe : touched) {
+    results.push_back({keyframe, scores[keyframe]});
+    scores[keyframe] = 0.0;
+  }
+
+  const size_t count = std::min(max_results, results.size());
+  std::partial_sort(results.begin(), results.begin() + count, results.end(),
+                    [](const QueryResult& a, const QueryResult& b) {
+                      return a.score > b.score;
+                    });
+  results.resize(count);
+}
+
+/**
+ * @brief Function to get the number of keyframes
+ *
+ * @return size_t
+ */
+size_t lc::KeyframeDatabase::size() const { return keyframe_count; }
+
+/**
+ * @brief Function to remove all keyframes
+ *
+ */
+void lc::KeyframeDatabase::clear() {
+  inverted_file.clear();
+  scores.clear();
+  touched.clear();
+  keyframe_count = 0;
+}
@@ -0,0 +1,130 @@
+/**
+ * @file keyframe_database.hpp
+ * @author Apoorv Thapliyal
+ * @brief C++ header file for the inverted-file keyframe database
+ * @version 0.1
+ * @date 2024-11-24
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "vocabulary.hpp"
+
+namespace lc {
+
+/**
+ * @brief Keyframe returned by a database query
+ *
+ */
+struct QueryResult {
+  /**
+   * @brief Index of the keyframe, in insertion order
+   *
+   */
+  size_t keyframe;
+
+  /**
+   * @brief L1 score against the query, in [0, 1]
+   *
+   */
+  double score;
+};
+
+/**
+ * @brief Database of keyframe bag-of-words vectors indexed by word. A query
+ * only visits the keyframes sharing a word with it, and skips the words so
+ * common that their lists grew beyond a fixed length, so its cost is bounded
+ * by the query size rather than by the number of keyframes.
+ *
+ */
+class KeyframeDatabase {
+ private:
+  /**
+   * @brief Keyframe and weight of a word occurrence
+   *
+   */
+  struct Posting {
+    uint32_t keyframe;
+    float weight;
+  };
+
+  /**
+   * @brief Occurrences of every word, in insertion order
+   *
+   */
+  std::vector<std::vector<Posting>> inverted_file;
+
+  /**
+   * @brief Number of keyframes added
+   *
+   */
+  size_t keyframe_count = 0;
+
+  /**
+   * @brief Words with more occurrences than this are skipped by queries
+   *
+   */
+  size_t max_postings;
+
+  /**
+   * @brief Score accumulator of every keyframe, reused across queries
+   *
+   */
+  std::vector<double> scores;
+
+  /**
+   * @brief Keyframes with a non-zero score in the current query
+   *
+   */
+  std::vector<uint32_t> touched;
+
+ public:
+  /**
+   * @brief Construct a new Keyframe Database object
+   *
+   * @param max_word_postings: words with more occurrences than this carry
+   * little information and are skipped by queries
+   */
+  explicit KeyframeDatabase(size_t max_word_postings = 1000);
+
+  /**
+   * @brief Function to add a keyframe
+   *
+   * @param bow
+   * @return size_t: index of the keyframe
+   */
+  size_t add(const BowVector& bow);
+
+  /**
+   * @brief Function to find the keyframes most similar to a query
+   *
+   * @param bow: query
+   * @param max_results: number of keyframes returned at most
+   * @param end: only keyframes with a lower index are considered, e.g. to
+   * skip the most recent ones
+   * @param results: output, best score first
+   */
+  void query(const BowVector& bow, size_t max_results, size_t end,
+             std::vector<QueryResult>& results);
+
+  /**
+   * @brief Function to get the number of keyframes
+   *
+   * @return size_t
+   */
+  size_t size() const;
+
+  /**
+   * @brief Function to remove all keyframes
+   *
+   */
+  void clear();
+};
+
+}  // namespace lc
@@ -0,0 +1,374 @@
+/**
+ * @file loop_closure.cpp
+ * @author Apoorv Thapliyal
+ * @brief C++ source file for the loop detection and correction
+ * @version 0.1
+ * @date 2024-11-24
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "loop_closure.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <opencv2/calib3d.hpp>
+
+namespace {
+
+/**
+ * @brief Function to triangulate a point seen by two cameras with the linear
+ * method, and check that it lies in front of both and reprojects well
+ *
+ * @param R_a: camera to world rotation of the first camera
+ * @param p_a: position of the first camera
+ * @param a: normalized image point in the first camera
+ * @param R_b: camera to world rotation of the second camera
+ * @param p_b: position of the second camera
+ * @param b: normalized image point in the second camera
+ * @param threshold: maximum reprojection error in normalized units
+ * @param X: output world point
+ * @return true if the point is valid
+ */
+bool triangulate(const Eigen::Matrix3d& R_a, const Eigen::Vector3d& p_a,
+                 const cv::Point2f& a, const Eigen::Matrix3d& R_b,
+                 const Eigen::Vector3d& p_b, const cv::Point2f& b,
+                 double threshold, Eigen::Vector3d& X) {
+  // World to camera projections
+  Eigen::Matrix<double, 3, 4> P_a, P_b;
+  P_a << R_a.transpose(), -R_a.transpose() * p_a;
+  P_b << R_b.transpose(), -R_b.transpose() * p_b;
+
+  Eigen::Matrix4d A;
+  A.row(0) = a.x * P_a.row(2) - P_a.row(0);
+  A.row(1) = a.y * P_a.row(2) - P_a.row(1);
+  A.row(2) = b.x * P_b.row(2) - P_b.row(0);
+  A.row(3) = b.y * P_b.row(2) - P_b.row(1);
+  Eigen::JacobiSVD<Eigen::Matrix4d> svd(A, Eigen::ComputeFullV);
+  Eigen::Vector4d homogeneous = svd.matrixV().col(3);
+  if (std::abs(homogeneous(3)) < 1e-12) return false;
+  X = homogeneous.head<3>() / homogeneous(3);
+
+  for (int view = 0; view < 2; view++) {
+    const Eigen::Matrix<double, 3, 4>& P = view == 0 ? P_a : P_b;
+    const cv::Point2f& observed = view == 0 ? a : b;
+    Eigen::Vector3d X_camera = P.leftCols<3>() * X + P.col(3);
+    if (X_camera(2) <= 0.0) return false;
+    if (std::hypot(X_camera(0) / X_camera(2) - observed.x,
+                   X_camera(1) / X_camera(2) - observed.y) > threshold)
+      return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+/**
+ * @brief Construct a new lc::Loop Closure::Loop Closure object
+ *
+ * @param trained_vocabulary
+ * @param loop_config
+ */
+lc::LoopClosure::LoopClosure(
+    std::shared_ptr<const Vocabulary> trained_vocabulary,
+    const LoopClosureConfig& loop_config)
+    : vocabulary(std::move(trained_vocabulary)), config(loop_config) {}
+
+/**
+ * @brief Function to match the descriptors of two keyframes that fall into
+ * the same vocabulary node
+ *
+ * @param query
+ * @param train
+ * @param matches
+ */
+void lc::LoopClosure::match_features(
+    const Keyframe& query, const Keyframe& train,
+    std::vector<std::pair<int, int>>& matches) const {
+  matches.clear();
+  const int bytes = query.descriptors.cols;
+
+  // Keep the closest query descriptor of every train descriptor
+  std::vector<int> owner(train.descriptors.rows, -1);
+  std::vector<int> owner_distance(train.descriptors.rows,
+                                  std::numeric_limits<int>::max());
+
+  auto it_query = query.features.begin();
+  auto it_train = train.features.begin();
+  while (it_query != query.features.end() &&
+         it_train != train.features.end()) {
+    if (it_query->first < it_train->first) {
+      ++it_query;
+      continue;
+    }
+    if (it_train->first < it_query->first) {
+      ++it_train;
+      continue;
+    }
+
+    for (int q : it_query->second) {
+      int best = std::numeric_limits<int>::max();
+      int second = std::numeric_limits<int>::max();
+      int best_index = -1;
+      for (int t : it_train->second) {
+        const int d = Vocabulary::distance(query.descriptors.ptr<uint8_t>(q),
+                                           train.descriptors.ptr<uint8_t>(t),
+                                           bytes);
+        if (d < best) {
+          second = best;
+          best = d;
+          best_index = t;
+        } else if (d < second) {
+          second = d;
+        }
+      }
+
+      // Lowe's ratio test
+      if (best_index < 0 || best > config.max_descriptor_distance ||
+          best >= config.ratio * second)
+        continue;
+      if (best < owner_distance[best_index]) {
+        owner[best_index] = q;
+        owner_distance[best_index] = best;
+      }
+    }
+    ++it_query;
+    ++it_train;
+  }
+
+  for (int t = 0; t < static_cast<int>(owner.size()); t++)
+    if (owner[t] >= 0) matches.emplace_back(owner[t], t);
+}
+
+/**
+ * @brief Function to check a candidate by localizing a keyframe against the
+ * points the candidate and the keyframe after it see
+ *
+ * @param candidate
+ * @param keyframe
+ * @param loop
+ * @return true if the candidate is accepted
+ */
+bool lc::LoopClosure::verify(size_t candidate, const Keyframe& keyframe,
+                             LoopConstraint& loop) const {
+  const Keyframe& old = keyframes[candidate];
+  const Keyframe& next = keyframes[candidate + 1];
+
+  // Triangulate the candidate's points from its own odometry baseline, so the
+  // loop pose comes out in the local scale of the odometry
+  std::vector<std::pair<int, int>> matches;
+  match_features(old, next, matches);
+
+  const double max_cos = std::cos(config.min_parallax);
+  std::vector<int> landmark(old.points.size(), -1);
+  std::vector<cv::Point3f> landmarks;
+  for (const auto& match : matches) {
+    const cv::Point2f& a = old.points[match.first];
+    const cv::Point2f& b = next.points[match.second];
+    Eigen::Vector3d ray_a = old.R * Eigen::Vector3d(a.x, a.y, 1.0);
+    Eigen::Vector3d ray_b = next.R * Eigen::Vector3d(b.x, b.y, 1.0);
+    if (ray_a.dot(ray_b) > max_cos * ray_a.norm() * ray_b.norm()) continue;
+
+    Eigen::Vector3d X;
+    if (!triangulate(old.R, old.p, a, next.R, next.p, b,
+                     config.reprojection_threshold, X))
+      continue;
+    landmark[match.first] = static_cast<int>(landmarks.size());
+    landmarks.emplace_back(static_cast<float>(X(0)), static_cast<float>(X(1)),
+                           static_cast<float>(X(2)));
+  }
+  if (static_cast<int>(landmarks.size()) < config.min_inliers) return false;
+
+  // 2D-3D correspondences of the keyframe
+  match_features(keyframe, old, matches);
+  std::vector<cv::Point3f> object_points;
+  std::vector<cv::Point2f> image_points;
+  for (const auto& match : matches) {
+    if (landmark[match.second] < 0) continue;
+    object_points.push_back(landmarks[landmark[match.second]]);
+    image_points.push_back(keyframe.points[match.first]);
+  }
+  if (static_cast<int>(object_points.size()) < config.min_inliers)
+    return false;
+
+  // Points are normalized, so the camera matrix is the identity
+  cv::Mat rvec, tvec;
+  std::vector<int> inliers;
+  if (!cv::solvePnPRansac(object_points, image_points,
+                          cv::Mat::eye(3, 3, CV_64F), cv::Mat(), rvec, tvec,
+                          false, 100,
+                          static_cast<float>(config.reprojection_threshold),
+                          0.99, inliers) ||
+      static_cast<int>(inliers.size()) < config.min_inliers)
+    return false;
+
+  // PnP gives the world to camera transform
+  cv::Mat R_cw;
+  cv::Rodrigues(rvec, R_cw);
+  Eigen::Matrix3d R;
+  Eigen::Vector3d t;
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) R(i, j) = R_cw.at<double>(i, j);
+    t(i) = tvec.at<double>(i);
+  }
+
+  loop.match = candidate;
+  loop.pose = Eigen::Matrix4d::Identity();
+  loop.pose.block<3, 3>(0, 0) = R.transpose();
+  loop.pose.block<3, 1>(0, 3) = -R.transpose() * t;
+  loop.inliers = static_cast<int>(inliers.size());
+  return true;
+}
+
+/**
+ * @brief Function to add a keyframe and search the older ones for a loop
+ *
+ * @param pose
+ * @param points
+ * @param descriptors
+ * @param loop
+ * @return true if the keyframe closes a loop
+ */
+bool lc::LoopClosure::add_keyframe(const Eigen::Matrix4d& pose,
+                                   const std::vector<cv::Point2f>& points,
+                                   const cv::Mat& descriptors,
+                                   LoopConstraint& loop) {
+  if (!vocabulary || vocabulary->empty()) return false;
+  if (static_cast<int>(points.size()) != descriptors.rows) {
+    std::cerr << "Keyframe has " << points.size() << " points for "
+              << descriptors.rows << " descriptors" << std::endl;
+    return false;
+  }
+
+  Keyframe keyframe;
+  keyframe.R = pose.block<3, 3>(0, 0);
+  keyframe.p = pose.block<3, 1>(0, 3);
+  keyframe.points = points;
+  keyframe.descriptors = descriptors.clone();
+  vocabulary->transform(keyframe.descriptors, keyframe.bow, &keyframe.features,
+                        config.levels_up);
+
+  // Candidates must score well relative to the previous keyframe, which
+  // tells how distinctive the current view is. The most recent keyframes are
+  // never candidates, and every candidate has a successor to triangulate
+  // with.
+  bool found = false;
+  const size_t recent = std::max<size_t>(config.recent_keyframes, 1);
+  if (keyframes.size() > recent) {
+    const double previous_score =
+        Vocabulary::score(keyframe.bow, keyframes.back().bow);
+    std::vector<QueryResult> candidates;
+    if (previous_score > 0.0)
+      database.query(keyframe.bow, config.max_candidates,
+                     keyframes.size() - recent, candidates);
+
+    for (const QueryResult& candidate : candidates) {
+      if (candidate.score < config.min_relative_score * previous_score) break;
+      if (verify(candidate.keyframe, keyframe, loop)) {
+        loop.score = candidate.score;
+        found = true;
+        break;
+      }
+    }
+  }
+
+  database.add(keyframe.bow);
+  keyframes.push_back(std::move(keyframe));
+  if (found) {
+    loop.current = keyframes.size() - 1;
+    loop_count++;
+  }
+  return found;
+}
+
+/**
+ * @brief Function to move the newest keyframe of a loop to the loop pose and
+ * spread the correction over the keyframes since the old one
+ *
+ * @param loop
+ */
+void lc::LoopClosure::correct(const LoopConstraint& loop) {
+  if (loop.current >= keyframes.size() || loop.match >= loop.current) {
+    std::cerr << "Loop " << loop.match << " -> " << loop.current
+              << " does not fit " << keyframes.size() << " keyframes"
+              << std::endl;
+    return;
+  }
+
+  // World frame correction that takes the current keyframe to the loop pose
+  const Keyframe& current = keyframes[loop.current];
+  Eigen::Matrix3d R_correction =
+      loop.pose.block<3, 3>(0, 0) * current.R.transpose();
+  Eigen::Vector3d t_correction =
+      loop.pose.block<3, 1>(0, 3) - R_correction * current.p;
+  Eigen::AngleAxisd rotation(R_correction);
+
+  // The drift accumulated along the loop, so every keyframe gets the share
+  // of the correction matching its position in it
+  const double length = static_cast<double>(loop.current - loop.match);
+  for (size_t k = loop.match + 1; k <= loop.current; k++) {
+    const double fraction = (k - loop.match) / length;
+    Eigen::Matrix3d R_share =
+        Eigen::AngleAxisd(fraction * rotation.angle(), rotation.axis())
+            .toRotationMatrix();
+    keyframes[k].R = R_share * keyframes[k].R;
+    keyframes[k].p = R_share * keyframes[k].p + fraction * t_correction;
+  }
+}
+
+/**
+ * @brief Function to get the pose of a keyframe
+ *
+ * @param index
+ * @return Eigen::Matrix4d
+ */
+Eigen::Matrix4d lc::LoopClosure::get_pose(size_t index) const {
+  Eigen::Matrix4d pose = Eigen::Matrix4d::Identity();
+  if (index >= keyframes.size()) return pose;
+  pose.block<3, 3>(0, 0) = keyframes[index].R;
+  pose.block<3, 1>(0, 3) = keyframes[index].p;
+  return pose;
+}
+
+/**
+ * @brief Function to replace the pose of a keyframe
+ *
+ * @param index
+ * @param pose
+ */
+void lc::LoopClosure::set_pose(size_t index, const Eigen::Matrix4d& pose) {
+  if (index >= keyframes.size()) {
+    std::cerr << "Keyframe " << index << " is not in the database"
+              << std::endl;
+    return;
+  }
+  keyframes[index].R = pose.block<3, 3>(0, 0);
+  keyframes[index].p = pose.block<3, 1>(0, 3);
+}
+
+/**
+ * @brief Function to get the number of keyframes
+ *
+ * @return size_t
+ */
+size_t lc::LoopClosure::size() const { return keyframes.size(); }
+
+/**
+ * @brief Function to get the number of loops found
+ *
+ * @return size_t
+ */
+size_t lc::LoopClosure::get_loop_count() const { return loop_count; }
+
+/**
+ * @brief Function to drop all keyframes
+ *
+ */
+void lc::LoopClosure::reset() {
+  database.clear();
+  keyframes.clear();
+  loop_count = 0;
+}
@@ -0,0 +1,306 @@
+/**
+ * @file loop_closure.hpp
+ * @author Apoorv Thapliyal
+ * @brief C++ header file for the loop detection and correction
+ * @version 0.1
+ * @date 2024-11-24
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <eigen3/Eigen/Core>
+#include <eigen3/Eigen/Dense>
+#include <memory>
+#include <opencv2/core.hpp>
+#include <utility>
+#include <vector>
+
+#include "keyframe_database.hpp"
+#include "vocabulary.hpp"
+
+namespace lc {
+
+/**
+ * @brief Thresholds of the loop detection
+ *
+ */
+struct LoopClosureConfig {
+  /**
+   * @brief Number of most recent keyframes never searched for loops
+   *
+   */
+  size_t recent_keyframes = 20;
+
+  /**
+   * @brief Minimum score of a candidate relative to the score between the
+   * current and the previous keyframe
+   *
+   */
+  double min_relative_score = 0.3;
+
+  /**
+   * @brief Number of best candidates geometrically verified per keyframe
+   *
+   */
+  size_t max_candidates = 3;
+
+  /**
+   * @brief Maximum Hamming distance of a descriptor match
+   *
+   */
+  int max_descriptor_distance = 50;
+
+  /**
+   * @brief Lowe's ratio between the best and second best match distance
+   *
+   */
+  double ratio = 0.75;
+
+  /**
+   * @brief Minimum number of PnP inliers to accept a loop
+   *
+   */
+  int min_inliers = 25;
+
+  /**
+   * @brief Reprojection error in normalized units of a PnP inlier and of a
+   * triangulated point
+   *
+   */
+  double reprojection_threshold = 0.01;
+
+  /**
+   * @brief Minimum angle in radians between two rays to triangulate them
+   *
+   */
+  double min_parallax = 0.02;
+
+  /**
+   * @brief Levels above the vocabulary leaves descriptors are grouped at for
+   * matching
+   *
+   */
+  int levels_up = 2;
+};
+
+/**
+ * @brief Verified loop between the newest keyframe and an old one
+ *
+ */
+struct LoopConstraint {
+  /**
+   * @brief Index of the old keyframe
+   *
+   */
+  size_t match = 0;
+
+  /**
+   * @brief Index of the newest keyframe
+   *
+   */
+  size_t current = 0;
+
+  /**
+   * @brief Camera to world pose of the newest keyframe that agrees with the
+   * map of the old keyframe
+   *
+   */
+  Eigen::Matrix4d pose = Eigen::Matrix4d::Identity();
+
+  /**
+   * @brief Number of PnP inliers
+   *
+   */
+  int inliers = 0;
+
+  /**
+   * @brief Bag-of-words score of the old keyframe
+   *
+   */
+  double score = 0.0;
+};
+
+/**
+ * @brief Place recognition over the keyframes of a run, and correction of
+ * the drift a loop reveals. Candidates come from an inverted-file database
+ * of bag-of-words vectors. A candidate is accepted when the newest keyframe
+ * can be localized with PnP against points triangulated from the candidate
+ * and the keyframe after it, which also gives the loop pose in the scale of
+ * the odometry. The correction is then spread over the keyframes of the loop.
+ *
+ */
+class LoopClosure {
+ private:
+  /**
+   * @brief Keyframe stored for place recognition
+   *
+   */
+  struct Keyframe {
+    /**
+     * @brief Camera to world rotation
+     *
+     */
+    Eigen::Matrix3d R;
+
+    /**
+     * @brief Camera position in the world
+     *
+     */
+    Eigen::Vector3d p;
+
+    /**
+     * @brief Normalized image point of every descriptor
+     *
+     */
+    std::vector<cv::Point2f> points;
+
+    /**
+     * @brief Binary descriptors, one per row
+     *
+     */
+    cv::Mat descriptors;
+
+    /**
+     * @brief Bag-of-words vector
+     *
+     */
+    BowVector bow;
+
+    /**
+     * @brief Descriptor indices grouped by vocabulary node
+     *
+     */
+    FeatureVector features;
+  };
+
+  /**
+   * @brief Vocabulary the descriptors are quantized with
+   *
+   */
+  std::shared_ptr<const Vocabulary> vocabulary;
+
+  /**
+   * @brief Thresholds of the loop detection
+   *
+   */
+  LoopClosureConfig config;
+
+  /**
+   * @brief Inverted file over the keyframes
+   *
+   */
+  KeyframeDatabase database;
+
+  /**
+   * @brief Keyframes, oldest first
+   *
+   */
+  std::vector<Keyframe> keyframes;
+
+  /**
+   * @brief Number of loops found
+   *
+   */
+  size_t loop_count = 0;
+
+  /**
+   * @brief Function to match the descriptors of two keyframes that fall into
+   * the same vocabulary node
+   *
+   * @param query
+   * @param train
+   * @param matches: output (query index, train index) pairs, one per train
+   * descriptor at most
+   */
+  void match_features(const Keyframe& query, const Keyframe& train,
+                      std::vector<std::pair<int, int>>& matches) const;
+
+  /**
+   * @brief Function to check a candidate by localizing a keyframe against
+   * the points the candidate and the keyframe after it see
+   *
+   * @param candidate: index of the candidate
+   * @param keyframe: keyframe to localize
+   * @param loop: output, filled when the candidate is accepted
+   * @return true if the candidate is accepted
+   */
+  bool verify(size_t candidate, const Keyframe& keyframe,
+              LoopConstraint& loop) const;
+
+ public:
+  /**
+   * @brief Construct a new Loop Closure object
+   *
+   * @param trained_vocabulary: no loop is ever found without one
+   * @param loop_config: thresholds of the loop detection
+   */
+  LoopClosure(std::shared_ptr<const Vocabulary> trained_vocabulary = nullptr,
+              const LoopClosureConfig& loop_config = LoopClosureConfig());
+
+  /**
+   * @brief Function to add a keyframe and search the older ones for a loop
+   *
+   * @param pose: camera to world pose
+   * @param points: normalized image point (z = 1) of every descriptor
+   * @param descriptors: binary descriptors, one per row
+   * @param loop: output, filled when a loop is found
+   * @return true if the keyframe closes a loop
+   */
+  bool add_keyframe(const Eigen::Matrix4d& pose,
+                    const std::vector<cv::Point2f>& points,
+                    const cv::Mat& descriptors, LoopConstraint& loop);
+
+  /**
+   * @brief Function to move the newest keyframe of a loop to the loop pose
+   * and spread the correction linearly over the keyframes since the old one.
+   * This is the lightweight correction for using the detector on its own,
+   * without a pose graph. VisualOdometry does not call it: it solves its
+   * pose graph instead and writes the result back with set_pose.
+   *
+   * @param loop
+   */
+  void correct(const LoopConstraint& loop);
+
+  /**
+   * @brief Function to get the pose of a keyframe, corrected by the loops
+   * found since it was added
+   *
+   * @param index: 0 is the first keyframe
+   * @return Eigen::Matrix4d
+   */
+  Eigen::Matrix4d get_pose(size_t index) const;
+
+  /**
+   * @brief Function to replace the pose of a keyframe, e.g. with the one a
+   * pose graph optimized
+   *
+   * @param index: 0 is the first keyframe
+   * @param pose: camera to world pose
+   */
+  void set_pose(size_t index, const Eigen::Matrix4d& pose);
+
+  /**
+   * @brief Function to get the number of keyframes
+   *
+   * @return size_t
+   */
+  size_t size() const;
+
+  /**
+   * @brief Function to get the number of loops found
+   *
+   * @return size_t
+   */
+  size_t get_loop_count() const;
+
+  /**
+   * @brief Function to drop all keyframes
+   *
+   */
+  void reset();
+};
+
+}  // namespace lc
@@ -0,0 +1,541 @@
+/**
+ * @file vocabulary.cpp
+ * @author Apoorv Thapliyal
+ * @brief C++ source file for the binary bag-of-words vocabulary tree
+ * @version 0.1
+ * @date 2024-11-24
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "vocabulary.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+namespace {
+
+/**
+ * @brief Tag at the start of a vocabulary file
+ *
+ */
+constexpr char kMagic[8] = "LCVOCAB";
+
+/**
+ * @brief Maximum k-majority iterations per node
+ *
+ */
+constexpr int kMaxIterations = 10;
+
+/**
+ * @brief Portable population count of a 64 bit word
+ *
+ * @param x
+ * @return int
+ */
+inline int popcount64(uint64_t x) {
+#if defined(__GNUC__)
+  return __builtin_popcountll(x);
+#else
+  x = x - ((x >> 1) & 0x5555555555555555ULL);
+  x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+  x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+  return static_cast<int>((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+/**
+ * @brief Function to write a vector to a binary stream
+ *
+ * @tparam T
+ * @param file
+ * @param values
+ */
+template <typename T>
+void write_vector(std::ofstream& file, const std::vector<T>& values) {
+  file.write(reinterpret_cast<const char*>(values.data()),
+             static_cast<std::streamsize>(values.size() * sizeof(T)));
+}
+
+/**
+ * @brief Function to read a vector of known size from a binary stream
+ *
+ * @tparam T
+ * @param file
+ * @param size
+ * @param values
+ */
+template <typename T>
+void read_vector(std::ifstream& file, size_t size, std::vector<T>& values) {
+  values.resize(size);
+  file.read(reinterpret_cast<char*>(values.data()),
+            static_cast<std::streamsize>(size * sizeof(T)));
+}
+
+}  // namespace
+
+/**
+ * @brief Function to compute the Hamming distance between two descriptors
+ *
+ * @param a
+ * @param b
+ * @param bytes
+ * @return int
+ */
+int lc::Vocabulary::distance(const uint8_t* a, const uint8_t* b, int bytes) {
+  int result = 0;
+  int i = 0;
+  for (; i + 8 <= bytes; i += 8) {
+    uint64_t x, y;
+    std::memcpy(&x, a + i, 8);
+    std::memcpy(&y, b + i, 8);
+    result += popcount64(x ^ y);
+  }
+  for (; i < bytes; i++) result += popcount64(a[i] ^ b[i]);
+  return result;
+}
+
+/**
+ * @brief Function to append a node
+ *
+ * @param descriptor
+ * @return uint32_t
+ */
+uint32_t lc::Vocabulary::add_node(const uint8_t* descriptor) {
+  node_descriptors.insert(node_descriptors.end(), descriptor,
+                          descriptor + descriptor_bytes);
+  first_child.push_back(0);
+  child_count.push_back(0);
+  node_word.push_back(0);
+  return static_cast<uint32_t>(first_child.size() - 1);
+}
+
+/**
+ * @brief Function to split the descriptors of a node into its children,
+ * recursively
+ *
+ * @param descriptors
+ * @param node
+ * @param level
+ * @param generator
+ */
+void lc::Vocabulary::cluster(const std::vector<const uint8_t*>& descriptors,
+                             uint32_t node, int level,
+                             std::mt19937& generator) {
+  // Leaves become words
+  if (level == depth || descriptors.size() <= 1) {
+    node_word[node] = static_cast<uint32_t>(word_weights.size());
+    word_weights.push_back(0.0);
+    return;
+  }
+
+  const size_t n = descriptors.size();
+  const size_t bytes = static_cast<size_t>(descriptor_bytes);
+  std::vector<uint8_t> centroids;
+  std::vector<int> assignment(n, -1);
+  size_t k = 0;
+
+  if (n <= static_cast<size_t>(branching)) {
+    // Few descriptors: every one is its own cluster
+    k = n;
+    for (size_t i = 0; i < n; i++) {
+      centroids.insert(centroids.end(), descriptors[i], descriptors[i] + bytes);
+      assignment[i] = static_cast<int>(i);
+    }
+  } else {
+    // k-means++ seeding: pick every new centroid with a probability
+    // proportional to its squared distance to the closest one so far
+    std::vector<double> nearest(n, std::numeric_limits<double>::max());
+    size_t pick = std::uniform_int_distribution<size_t>(0, n - 1)(generator);
+    while (true) {
+      centroids.insert(centroids.end(), descriptors[pick],
+                       descriptors[pick] + bytes);
+      k++;
+      if (k == static_cast<size_t>(branching)) break;
+
+      double total = 0.0;
+      for (size_t i = 0; i < n; i++) {
+        const double d = distance(descriptors[i], &centroids[(k - 1) * bytes],
+                                  descriptor_bytes);
+        nearest[i] = std::min(nearest[i], d * d);
+        total += nearest[i];
+      }
+      // All remaining descriptors coincide with a centroid
+      if (total <= 0.0) break;
+
+      double target =
+          std::uniform_real_distribution<double>(0.0, total)(generator);
+      pick = n - 1;
+      for (size_t i = 0; i < n; i++) {
+        target -= nearest[i];
+        if (target <= 0.0 && nearest[i] > 0.0) {
+          pick = i;
+          break;
+        }
+      }
+    }
+
+    // k-majority: assign to the closest centroid, then set every centroid
+    // bit to the majority of its cluster
+    std::vector<int> bit_counts(k * bytes * 8);
+    std::vector<int> sizes(k);
+    for (int iteration = 0;; iteration++) {
+      bool changed = false;
+      for (size_t i = 0; i < n; i++) {
+        int best = 0, best_distance = std::numeric_limits<int>::max();
+        for (size_t c = 0; c < k; c++) {
+          const int d =
+              distance(descriptors[i], &centroids[c * bytes], descriptor_bytes);
+          if (d < best_distance) {
+            best_distance = d;
+            best = static_cast<int>(c);
+          }
+        }
+        if (assignment[i] != best) {
+          assignment[i] = best;
+          changed = true;
+        }
+      }
+      if (!changed || iteration == kMaxIterations) break;
+
+      std::fill(bit_counts.begin(), bit_counts.end(), 0);
+      std::fill(sizes.begin(), sizes.end(), 0);
+      for (size_t i = 0; i < n; i++) {
+        int* counts = &bit_counts[assignment[i] * bytes * 8];
+        sizes[assignment[i]]++;
+        for (size_t b = 0; b < bytes; b++)
+          for (int bit = 0; bit < 8; bit++)
+            counts[8 * b + bit] += (descriptors[i][b] >> bit) & 1;
+      }
+      for (size_t c = 0; c < k; c++) {
+        // Empty clusters keep their centroid
+        if (sizes[c] == 0) continue;
+        const int* counts = &bit_counts[c * bytes * 8];
+        for (size_t b = 0; b < bytes; b++) {
+          uint8_t value = 0;
+          for (int bit = 0; bit < 8; bit++)
+            if (2 * counts[8 * b + bit] > sizes[c]) value |= 1 << bit;
+          centroids[c * bytes + b] = value;
+        }
+      }
+    }
+  }
+
+  // Children are stored next to each other
+  const uint32_t first = static_cast<uint32_t>(first_child.size());
+  first_child[node] = first;
+  child_count[node] = static_cast<uint32_t>(k);
+  for (size_t c = 0; c < k; c++) add_node(&centroids[c * bytes]);
+
+  std::vector<std::vector<const uint8_t*>> groups(k);
+  for (size_t i = 0; i < n; i++) groups[assignment[i]].push_back(descriptors[i]);
+  for (size_t c = 0; c < k; c++)
+    cluster(groups[c], first + static_cast<uint32_t>(c), level + 1, generator);
+}
+
+/**
+ * @brief Function to train the vocabulary
+ *
+ * @param descriptors
+ * @param branching_factor
+ * @param levels
+ * @return true if the vocabulary was trained
+ */
+bool lc::Vocabulary::train(const std::vector<cv::Mat>& descriptors,
+                           int branching_factor, int levels) {
+  if (branching_factor < 2 || levels < 1) {
+    std::cerr << "Vocabulary needs a branching factor of 2 or more and at "
+                 "least one level"
+              << std::endl;
+    return false;
+  }
+
+  int bytes = 0;
+  std::vector<const uint8_t*> features;
+  for (const cv::Mat& image_descriptors : descriptors) {
+    if (image_descriptors.empty()) continue;
+    if (image_descriptors.type() != CV_8U ||
+        (bytes != 0 && image_descriptors.cols != bytes)) {
+      std::cerr << "Vocabulary needs binary descriptors of one length"
+                << std::endl;
+      return false;
+    }
+    bytes = image_descriptors.cols;
+    for (int row = 0; row < image_descriptors.rows; row++)
+      features.push_back(image_descriptors.ptr<uint8_t>(row));
+  }
+  if (features.empty()) {
+    std::cerr << "No descriptors to train the vocabulary on" << std::endl;
+    return false;
+  }
+
+  branching = branching_factor;
+  depth = levels;
+  descriptor_bytes = bytes;
+  node_descriptors.clear();
+  first_child.clear();
+  child_count.clear();
+  node_word.clear();
+  word_weights.clear();
+
+  // Fixed seed, so the same training set gives the same vocabulary
+  std::mt19937 generator(0);
+  std::vector<uint8_t> root(bytes, 0);
+  cluster(features, add_node(root.data()), 0, generator);
+
+  // Inverse document frequency: words seen in fewer images weigh more
+  std::vector<int> images_per_word(word_weights.size(), 0);
+  std::vector<int> last_image(word_weights.size(), -1);
+  int images = 0;
+  for (const cv::Mat& image_descriptors : descriptors) {
+    if (image_descriptors.empty()) continue;
+    for (int row = 0; row < image_descriptors.rows; row++) {
+      uint32_t ancestor;
+      uint32_t word = lookup(image_descriptors.ptr<uint8_t>(row), depth,
+                             ancestor);
+      if (last_image[word] != images) {
+        last_image[word] = images;
+        images_per_word[word]++;
+      }
+    }
+    images++;
+  }
+  for (size_t word = 0; word < word_weights.size(); word++)
+    if (images_per_word[word] > 0)
+      word_weights[word] =
+          std::log(static_cast<double>(images) / images_per_word[word]);
+
+  return true;
+}
+
+/**
+ * @brief Function to find the leaf a descriptor falls into
+ *
+ * @param descriptor
+ * @param level
+ * @param ancestor
+ * @return uint32_t
+ */
+uint32_t lc::Vocabulary::lookup(const uint8_t* descriptor, int level,
+                                uint32_t& ancestor) const {
+  uint32_t node = 0;
+  ancestor = 0;
+  int current_level = 0;
+  while (child_count[node] > 0) {
+    const uint32_t first = first_child[node];
+    uint32_t best = first;
+    int best_distance = std::numeric_limits<int>::max();
+    for (uint32_t c = first; c < first + child_count[node]; c++) {
+      const int d = distance(descriptor, &node_descriptors[c * descriptor_bytes],
+                             descriptor_bytes);
+      if (d < best_distance) {
+        best_distance = d;
+        best = c;
+      }
+    }
+    node = best;
+    if (++current_level <= level) ancestor = node;
+  }
+  return node_word[node];
+}
+
+/**
+ * @brief Function to convert descriptors to a bag-of-words vector
+ *
+ * @param descriptors
+ * @param bow
+ * @param features
+ * @param levels_up
+ */
+void lc::Vocabulary::transform(const cv::Mat& descriptors, BowVector& bow,
+                               FeatureVector* features, int levels_up) const {
+  bow.clear();
+  if (features) features->clear();
+  if (empty() || descriptors.empty()) return;
+  if (descriptors.type() != CV_8U || descriptors.cols != descriptor_bytes) {
+    std::cerr << "Descriptors of " << descriptors.cols
+              << " bytes do not fit a vocabulary of " << descriptor_bytes
+              << " bytes" << std::endl;
+    return;
+  }
+
+  const int level = std::max(depth - levels_up, 1);
+  std::vector<uint32_t> words(descriptors.rows);
+  std::vector<std::pair<uint32_t, int>> nodes;
+  if (features) nodes.reserve(descriptors.rows);
+  for (int row = 0; row < descriptors.rows; row++) {
+    uint32_t ancestor;
+    words[row] = lookup(descriptors.ptr<uint8_t>(row), level, ancestor);
+    if (features) nodes.emplace_back(ancestor, row);
+  }
+
+  // Term frequency times inverse document frequency, normalized to sum to 1
+  std::sort(words.begin(), words.end());
+  double total = 0.0;
+  for (size_t i = 0; i < words.size();) {
+    size_t j = i;
+    while (j < words.size() && words[j] == words[i]) j++;
+    const double weight = (j - i) * word_weights[words[i]];
+    if (weight > 0.0) {
+      bow.emplace_back(words[i], weight);
+      total += weight;
+    }
+    i = j;
+  }
+  for (auto& entry : bow) entry.second /= total;
+
+  if (features) {
+    std::sort(nodes.begin(), nodes.end());
+    for (const auto& node : nodes) {
+      if (features->empty() || features->back().first != node.first)
+        features->emplace_back(node.first, std::vector<int>());
+      features->back().second.push_back(node.second);
+    }
+  }
+}
+
+/**
+ * @brief Function to compare two bag-of-words vectors with the L1 score
+ *
+ * @param a
+ * @param b
+ * @return double
+ */
+double lc::Vocabulary::score(const BowVector& a, const BowVector& b) {
+  // With both vectors summing to 1, 1 - |a - b|_1 / 2 is the sum of the
+  // smaller weight of every shared word
+  double result = 0.0;
+  auto it_a = a.begin();
+  auto it_b = b.begin();
+  while (it_a != a.end() && it_b != b.end()) {
+    if (it_a->first < it_b->first) {
+      ++it_a;
+    } else if (it_b->first < it_a->first) {
+      ++it_b;
+    } else {
+      result += std::min(it_a->second, it_b->second);
+      ++it_a;
+      ++it_b;
+    }
+  }
+  return result;
+}
+
+/**
+ * @brief Function to save the vocabulary to a binary file
+ *
+ * @param path
+ * @return true if the file was written
+ */
+bool lc::Vocabulary::save(const std::string& path) const {
+  std::ofstream file(path, std::ios::binary);
+  if (!file) {
+    std::cerr << "Could not create vocabulary file " << path << std::endl;
+    return false;
+  }
+
+  const int32_t header[3] = {branching, depth, descriptor_bytes};
+  const uint32_t counts[2] = {static_cast<uint32_t>(first_child.size()),
+                              static_cast<uint32_t>(word_weights.size())};
+  file.write(kMagic, sizeof(kMagic));
+  file.write(reinterpret_cast<const char*>(header), sizeof(header));
+  file.write(reinterpret_cast<const char*>(counts), sizeof(counts));
+  write_vector(file, node_descriptors);
+  write_vector(file, first_child);
+  write_vector(file, child_count);
+  write_vector(file, node_word);
+  write_vector(file, word_weights);
+
+  if (!file) {
+    std::cerr << "Could not write vocabulary file " << path << std::endl;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Function to load a vocabulary saved with save
+ *
+ * @param path
+ * @return true if the file was read
+ */
+bool lc::Vocabulary::load(const std::string& path) {
+  *this = Vocabulary();
+
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    std::cerr << "Could not open vocabulary file " << path << std::endl;
+    return false;
+  }
+
+  char magic[sizeof(kMagic)];
+  int32_t header[3];
+  uint32_t counts[2];
+  file.read(magic, sizeof(magic));
+  file.read(reinterpret_cast<char*>(header), sizeof(header));
+  file.read(reinterpret_cast<char*>(counts), sizeof(counts));
+  if (!file || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0 ||
+      header[2] <= 0 || counts[0] == 0) {
+    std::cerr << path << " is not a vocabulary file" << std::endl;
+    return false;
+  }
+
+  Vocabulary loaded;
+  loaded.branching = header[0];
+  loaded.depth = header[1];
+  loaded.descriptor_bytes = header[2];
+  read_vector(file, static_cast<size_t>(counts[0]) * header[2],
+              loaded.node_descriptors);
+  read_vector(file, counts[0], loaded.first_child);
+  read_vector(file, counts[0], loaded.child_count);
+  read_vector(file, counts[0], loaded.node_word);
+  read_vector(file, counts[1], loaded.word_weights);
+  if (!file) {
+    std::cerr << "Vocabulary file " << path << " is truncated" << std::endl;
+    return false;
+  }
+
+  // Every child and word index must stay inside the arrays
+  for (uint32_t node = 0; node < counts[0]; node++) {
+    const bool valid =
+        loaded.child_count[node] > 0
+            ? loaded.first_child[node] > node &&
+                  static_cast<uint64_t>(loaded.first_child[node]) +
+                          loaded.child_count[node] <=
+                      counts[0]
+            : loaded.node_word[node] < counts[1];
+    if (!valid) {
+      std::cerr << "Vocabulary file " << path << " is corrupted" << std::endl;
+      return false;
+    }
+  }
+
+  *this = std::move(loaded);
+  return true;
+}
+
+/**
+ * @brief Function to get the number of words
+ *
+ * @return size_t
+ */
+size_t lc::Vocabulary::size() const { return word_weights.size(); }
+
+/**
+ * @brief Function to check whether the vocabulary has no words
+ *
+ * @return true if it was neither trained nor loaded
+ */
+bool lc::Vocabulary::empty() const { return word_weights.empty(); }
+
+/**
+ * @brief Function to get the descriptor length in bytes
+ *
+ * @return int
+ */
+int lc::Vocabulary::get_descriptor_bytes() const { return descriptor_bytes; }
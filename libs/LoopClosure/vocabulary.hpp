@@ -0,0 +1,216 @@
+/**
+ * @file vocabulary.hpp
+ * @author Apoorv Thapliyal
+ * @brief C++ header file for the binary bag-of-words vocabulary tree
+ * @version 0.1
+ * @date 2024-11-24
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <opencv2/core.hpp>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Loop closure namespace
+ *
+ */
+namespace lc {
+
+/**
+ * @brief Sparse bag-of-words vector: (word, weight) pairs sorted by word,
+ * with weights summing to 1
+ *
+ */
+using BowVector = std::vector<std::pair<uint32_t, double>>;
+
+/**
+ * @brief Descriptor indices grouped by the vocabulary node they fall into at
+ * a fixed level, sorted by node. Only descriptors sharing a node need to be
+ * compared when matching two frames.
+ *
+ */
+using FeatureVector = std::vector<std::pair<uint32_t, std::vector<int>>>;
+
+/**
+ * @brief Vocabulary tree over binary descriptors (e.g. ORB), trained offline
+ * with hierarchical k-majority clustering. The leaves are the words, weighted
+ * by their inverse document frequency. Nodes are stored in flat arrays with
+ * the children of a node next to each other, so a lookup compares a
+ * descriptor with branching * depth contiguous centroids.
+ *
+ */
+class Vocabulary {
+ private:
+  /**
+   * @brief Number of children of every inner node
+   *
+   */
+  int branching = 0;
+
+  /**
+   * @brief Number of levels below the root
+   *
+   */
+  int depth = 0;
+
+  /**
+   * @brief Descriptor length in bytes
+   *
+   */
+  int descriptor_bytes = 0;
+
+  /**
+   * @brief Centroid of every node, descriptor_bytes each
+   *
+   */
+  std::vector<uint8_t> node_descriptors;
+
+  /**
+   * @brief Index of the first child of every node
+   *
+   */
+  std::vector<uint32_t> first_child;
+
+  /**
+   * @brief Number of children of every node, 0 for the leaves
+   *
+   */
+  std::vector<uint32_t> child_count;
+
+  /**
+   * @brief Word of every leaf
+   *
+   */
+  std::vector<uint32_t> node_word;
+
+  /**
+   * @brief Inverse document frequency of every word
+   *
+   */
+  std::vector<double> word_weights;
+
+  /**
+   * @brief Function to append a node
+   *
+   * @param descriptor: centroid, descriptor_bytes long
+   * @return uint32_t: index of the node
+   */
+  uint32_t add_node(const uint8_t* descriptor);
+
+  /**
+   * @brief Function to split the descriptors of a node into its children
+   * with k-majority clustering, recursively
+   *
+   * @param descriptors: descriptors of the node
+   * @param node
+   * @param level: level of the node, 0 for the root
+   * @param generator: source of the k-means++ seeding
+   */
+  void cluster(const std::vector<const uint8_t*>& descriptors, uint32_t node,
+               int level, std::mt19937& generator);
+
+  /**
+   * @brief Function to find the leaf a descriptor falls into
+   *
+   * @param descriptor
+   * @param level: level of the returned ancestor node
+   * @param ancestor: output, node on the path at the given level, or the leaf
+   * when the path is shorter
+   * @return uint32_t: word of the leaf
+   */
+  uint32_t lookup(const uint8_t* descriptor, int level,
+                  uint32_t& ancestor) const;
+
+ public:
+  /**
+   * @brief Function to train the vocabulary. Replaces the current one.
+   *
+   * @param descriptors: one CV_8U matrix per training image, one descriptor
+   * per row
+   * @param branching_factor: number of children of every inner node
+   * @param levels: number of levels below the root, giving up to
+   * branching_factor^levels words
+   * @return true if the vocabulary was trained
+   */
+  bool train(const std::vector<cv::Mat>& descriptors, int branching_factor = 10,
+             int levels = 5);
+
+  /**
+   * @brief Function to convert descriptors to a bag-of-words vector with
+   * tf-idf weights
+   *
+   * @param descriptors: one descriptor per row
+   * @param bow: output, empty when the vocabulary is empty
+   * @param features: optional output, descriptor indices grouped by node
+   * @param levels_up: levels above the leaves the features are grouped at
+   */
+  void transform(const cv::Mat& descriptors, BowVector& bow,
+                 FeatureVector* features = nullptr, int levels_up = 2) const;
+
+  /**
+   * @brief Function to compare two bag-of-words vectors with the L1 score,
+   * 1 for identical vectors and 0 for vectors sharing no word
+   *
+   * @param a
+   * @param b
+   * @return double
+   */
+  static double score(const BowVector& a, const BowVector& b);
+
+  /**
+   * @brief Function to compute the Hamming distance between two descriptors
+   *
+   * @param a
+   * @param b
+   * @param bytes: descriptor length in bytes
+   * @return int
+   */
+  static int distance(const uint8_t* a, const uint8_t* b, int bytes);
+
+  /**
+   * @brief Function to save the vocabulary to a binary file
+   *
+   * @param path
+   * @return true if the file was written
+   */
+  bool save(const std::string& path) const;
+
+  /**
+   * @brief Function to load a vocabulary saved with save
+   *
+   * @param path
+   * @return true if the file was read, the vocabulary is left empty otherwise
+   */
+  bool load(const std::string& path);
+
+  /**
+   * @brief Function to get the number of words
+   *
+   * @return size_t
+   */
+  size_t size() const;
+
+  /**
+   * @brief Function to check whether the vocabulary has no words
+   *
+   * @return true if it was neither trained nor loaded
+   */
+  bool empty() const;
+
+  /**
+   * @brief Function to get the descriptor length in bytes
+   *
+   * @return int
+   */
+  int get_descriptor_bytes() const;
+};
+
+}  // namespace lc
@@ -0,0 +1,164 @@
+/**
+ * @file bounded_queue.hpp
+ * @author Kshitij Aggarwal
+ * @brief C++ header file for the lock-free bounded queue between pipeline
+ * stages
+ * @version 0.1
+ * @date 2024-11-10
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+/**
+ * @brief Pipeline namespace
+ *
+ */
+namespace pl {
+
+/**
+ * @brief Lock-free bounded multi-producer multi-consumer queue (Vyukov's
+ * sequence-numbered ring). A full queue rejects pushes, which is how the
+ * pipeline applies back-pressure to the upstream stage.
+ *
+ * @tparam T: element type, must be default constructible and movable
+ */
+template <typename T>
+class BoundedQueue {
+ private:
+  /**
+   * @brief Ring slot with the sequence number that orders its use
+   *
+   */
+  struct Cell {
+    std::atomic<size_t> sequence;
+    T data;
+  };
+
+  /**
+   * @brief Ring of slots, the size is a power of two
+   *
+   */
+  std::unique_ptr<Cell[]> buffer;
+
+  /**
+   * @brief Ring size minus one
+   *
+   */
+  size_t mask;
+
+  /**
+   * @brief Position of the next push, on its own cache line
+   *
+   */
+  alignas(64) std::atomic<size_t> enqueue_position;
+
+  /**
+   * @brief Position of the next pop, on its own cache line
+   *
+   */
+  alignas(64) std::atomic<size_t> dequeue_position;
+
+ public:
+  /**
+   * @brief Construct a new Bounded Queue object
+   *
+   * @param capacity: minimum capacity, rounded up to a power of two
+   */
+  explicit BoundedQueue(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) size <<= 1;
+
+    buffer.reset(new Cell[size]);
+    mask = size - 1;
+    for (size_t i = 0; i < size; i++)
+      buffer[i].sequence.store(i, std::memory_order_relaxed);
+
+    enqueue_position.store(0, std::memory_order_relaxed);
+    dequeue_position.store(0, std::memory_order_relaxed);
+  }
+
+  BoundedQueue(const BoundedQueue&) = delete;
+  BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+  /**
+   * @brief Function to push an element if there is room
+   *
+   * @param item: moved from only when the push succeeds
+   * @return true if the element was queued
+   */
+  bool try_push(T& item) {
+    Cell* cell;
+    size_t position = enqueue_position.load(std::memory_order_relaxed);
+
+    for (;;) {
+      cell = &buffer[position & mask];
+      size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      intptr_t difference =
+          static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+
+      if (difference == 0) {
+        if (enqueue_position.compare_exchange_weak(
+                position, position + 1, std::memory_order_relaxed))
+          break;
+      } else if (difference < 0) {
+        return false;
+      } else {
+        position = enqueue_position.load(std::memory_order_relaxed);
+      }
+    }
+
+    cell->data = std::move(item);
+    cell->sequence.store(position + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Function to pop an element if one is available
+   *
+   * @param item: receives the element
+   * @return true if an element was popped
+   */
+  bool try_pop(T& item) {
+    Cell* cell;
+    size_t position = dequeue_position.load(std::memory_order_relaxed);
+
+    for (;;) {
+      cell = &buffer[position & mask];
+      size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      intptr_t difference = static_cast<intptr_t>(sequence) -
+                            static_cast<intptr_t>(position + 1);
+
+      if (difference == 0) {
+        if (dequeue_position.compare_exchange_weak(
+                position, position + 1, std::memory_order_relaxed))
+          break;
+      } else if (difference < 0) {
+        return false;
+      } else {
+        position = dequeue_position.load(std::memory_order_relaxed);
+      }
+    }
+
+    item = std::move(cell->data);
+    cell->sequence.store(position + mask + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Function to get the number of slots
+   *
+   * @return size_t
+   */
+  size_t capacity() const { return mask + 1; }
+};
+
+}  // namespace pl
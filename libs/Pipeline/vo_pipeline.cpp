@@ -0,0 +1,377 @@
+/**
+ * @file vo_pipeline.cpp
+ * @author Kshitij Aggarwal
+ * @brief C++ source file for the multithreaded visual odometry pipeline
+ * @version 0.1
+ * @date 2024-11-10
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "vo_pipeline.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "bounded_queue.hpp"
+
+namespace {
+
+/**
+ * @brief Image list entry waiting to be decoded
+ *
+ */
+struct DecodeJob {
+  size_t index;
+  double timestamp;
+  std::string image_path;
+  bool decoded;
+  cv::Mat image;
+};
+
+/**
+ * @brief Decoded image waiting for feature extraction
+ *
+ */
+struct DecodedFrame {
+  size_t index;
+  double timestamp;
+  std::string image_path;
+  cv::Mat image;
+};
+
+/**
+ * @brief Extracted frame waiting for pose estimation
+ *
+ */
+struct ExtractedFrame {
+  size_t index;
+  double timestamp;
+  std::string image_path;
+  bool valid;
+  vo::FrameFeatures features;
+};
+
+/**
+ * @brief Wake-up signal shared by the stages. Every push, pop, finished stage
+ * and failure advances a counter; a stage that found nothing to do reads the
+ * counter before looking and sleeps until it moves on, so no wake-up is lost
+ * between the look and the wait.
+ *
+ */
+class StageSignal {
+ private:
+  /**
+   * @brief Number of events so far
+   *
+   */
+  std::atomic<size_t> events{0};
+
+  /**
+   * @brief Mutex the sleeping stages wait on
+   *
+   */
+  std::mutex mutex;
+
+  /**
+   * @brief Condition the sleeping stages wait on
+   *
+   */
+  std::condition_variable condition;
+
+ public:
+  /**
+   * @brief Function to read the event counter before looking for work
+   *
+   * @return size_t
+   */
+  size_t observe() const { return events.load(std::memory_order_acquire); }
+
+  /**
+   * @brief Function to record an event and wake the sleeping stages
+   *
+   */
+  void notify() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      events.fetch_add(1, std::memory_order_release);
+    }
+    condition.notify_all();
+  }
+
+  /**
+   * @brief Function to sleep until an event after the observed one
+   *
+   * @param observed: counter read before looking for work
+   */
+  void wait(size_t observed) {
+    std::unique_lock<std::mutex> lock(mutex);
+    condition.wait(lock, [&]() {
+      return events.load(std::memory_order_acquire) != observed;
+    });
+  }
+};
+
+/**
+ * @brief Push into a queue, sleeping while the downstream stage is behind
+ *
+ * @tparam T
+ * @param queue
+ * @param item
+ * @param signal
+ * @param failed: set when a stage failed, which abandons the push
+ * @return true if the item was queued
+ */
+template <typename T>
+bool push_blocking(pl::BoundedQueue<T>& queue, T& item, StageSignal& signal,
+                   const std::atomic<bool>& failed) {
+  for (;;) {
+    const size_t observed = signal.observe();
+    if (queue.try_push(item)) {
+      signal.notify();
+      return true;
+    }
+    if (failed.load(std::memory_order_acquire)) return false;
+    signal.wait(observed);
+  }
+}
+
+}  // namespace
+
+/**
+ * @brief Construct a new pl::Vo Pipeline::Vo Pipeline object
+ *
+ * @param data_loader
+ * @param visual_odometry
+ * @param config
+ */
+pl::VoPipeline::VoPipeline(dl::DataLoader& data_loader,
+                           vo::VisualOdometry& visual_odometry,
+                           const PipelineConfig& config)
+    : data_loader(data_loader),
+      visual_odometry(visual_odometry),
+      config(config) {
+  // Every stage needs at least one thread and some slack to overlap
+  this->config.decode_threads = std::max<size_t>(1, config.decode_threads);
+  this->config.extract_threads = std::max<size_t>(1, config.extract_threads);
+  this->config.queue_capacity = std::max<size_t>(2, config.queue_capacity);
+  this->config.max_frames_in_flight =
+      std::max<size_t>(1, config.max_frames_in_flight);
+}
+
+/**
+ * @brief Function to process the remaining images of the dataset
+ *
+ * @param on_pose
+ * @param before_pose
+ * @return pl::PipelineStats
+ */
+pl::PipelineStats pl::VoPipeline::run(
+    const std::function<void(const PoseResult&)>& on_pose,
+    const std::function<void(size_t, double)>& before_pose) {
+  BoundedQueue<DecodeJob> decode_queue(config.queue_capacity);
+  BoundedQueue<DecodedFrame> extract_queue(config.queue_capacity);
+  BoundedQueue<ExtractedFrame> estimate_queue(config.queue_capacity);
+
+  std::atomic<bool> reading_done(false);
+  std::atomic<size_t> decoders_running(config.decode_threads);
+  std::atomic<size_t> extractors_running(config.extract_threads);
+  std::atomic<size_t> frames_done(0);
+  StageSignal signal;
+
+  // The first exception of any stage stops all of them and is rethrown once
+  // every thread has joined
+  std::atomic<bool> failed(false);
+  std::exception_ptr error;
+  std::mutex error_mutex;
+  auto fail = [&](std::exception_ptr exception) {
+    {
+      std::lock_guard<std::mutex> lock(error_mutex);
+      if (!error) error = exception;
+    }
+    failed.store(true, std::memory_order_release);
+    signal.notify();
+  };
+
+  auto start = std::chrono::steady_clock::now();
+
+  // Stage 1: read the image list in order. A prefetching loader has already
+  // taken the upcoming entries off the list and decodes them itself, so its
+  // frames are read decoded and passed through the decode stage.
+  std::thread reader([&]() {
+    try {
+      size_t index = 0;
+      const bool prefetched = data_loader.is_prefetching();
+      dl::ImageFrame frame;
+
+      while (prefetched ? data_loader.read_image(frame)
+                        : data_loader.read_image_entry(frame.timestamp,
+                                                       frame.image_path)) {
+        if (frame.timestamp == -1.0) break;
+        if (frame.timestamp < config.start_time) continue;
+        if (frame.timestamp > config.finish_time) break;
+
+        // Limit the frames in flight, so the reorder buffer stays bounded
+        for (;;) {
+          const size_t observed = signal.observe();
+          if (failed.load(std::memory_order_acquire) ||
+              index - frames_done.load(std::memory_order_acquire) <
+                  config.max_frames_in_flight)
+            break;
+          signal.wait(observed);
+        }
+
+        // The next read hands the frame's buffer back to the prefetcher, so
+        // the image moves on with the job
+        DecodeJob job{index++, frame.timestamp, frame.image_path, prefetched,
+                      frame.image};
+        frame.image.release();
+        if (!push_blocking(decode_queue, job, signal, failed)) break;
+      }
+    } catch (...) {
+      fail(std::current_exception());
+    }
+
+    reading_done.store(true, std::memory_order_release);
+    signal.notify();
+  });
+
+  // Stage 2: decode images. Each stage reads its upstream done flag before
+  // trying to pop, so an empty queue after the flag is set is final.
+  std::vector<std::thread> decoders;
+  for (size_t i = 0; i < config.decode_threads; i++) {
+    decoders.emplace_back([&]() {
+      try {
+        DecodeJob job;
+        for (;;) {
+          const size_t observed = signal.observe();
+          bool upstream_done = reading_done.load(std::memory_order_acquire);
+          if (failed.load(std::memory_order_acquire)) break;
+          if (!decode_queue.try_pop(job)) {
+            if (upstream_done) break;
+            signal.wait(observed);
+            continue;
+          }
+          signal.notify();
+
+          if (!job.decoded)
+            data_loader.load_image(job.image_path, job.image);
+          DecodedFrame frame{job.index, job.timestamp,
+                             std::move(job.image_path), job.image};
+          if (!push_blocking(extract_queue, frame, signal, failed)) break;
+        }
+      } catch (...) {
+        fail(std::current_exception());
+      }
+      decoders_running.fetch_sub(1, std::memory_order_release);
+      signal.notify();
+    });
+  }
+
+  // Stage 3: undistort and extract features, one detector per thread
+  std::vector<std::thread> extractors;
+  for (size_t i = 0; i < config.extract_threads; i++) {
+    extractors.emplace_back([&]() {
+      try {
+        cv::Ptr<cv::ORB> detector = visual_odometry.create_feature_detector();
+        DecodedFrame frame;
+        for (;;) {
+          const size_t observed = signal.observe();
+          bool upstream_done =
+              decoders_running.load(std::memory_order_acquire) == 0;
+          if (failed.load(std::memory_order_acquire)) break;
+          if (!extract_queue.try_pop(frame)) {
+            if (upstream_done) break;
+            signal.wait(observed);
+            continue;
+          }
+          signal.notify();
+
+          ExtractedFrame extracted{frame.index, frame.timestamp,
+                                   std::move(frame.image_path),
+                                   !frame.image.empty(), vo::FrameFeatures()};
+          if (extracted.valid)
+            visual_odometry.extract_features(frame.image, detector,
+                                             extracted.features);
+          extracted.features.timestamp = frame.timestamp;
+          if (!push_blocking(estimate_queue, extracted, signal, failed)) break;
+        }
+      } catch (...) {
+        fail(std::current_exception());
+      }
+      extractors_running.fetch_sub(1, std::memory_order_release);
+      signal.notify();
+    });
+  }
+
+  // Stage 4: estimate poses on the calling thread, restoring capture order
+  std::map<size_t, ExtractedFrame> reorder_buffer;
+  size_t next_index = 0;
+  PoseResult result;
+
+  try {
+    for (;;) {
+      const size_t observed = signal.observe();
+      bool upstream_done =
+          extractors_running.load(std::memory_order_acquire) == 0;
+      if (failed.load(std::memory_order_acquire)) break;
+      ExtractedFrame extracted;
+      if (!estimate_queue.try_pop(extracted)) {
+        if (upstream_done) break;
+        signal.wait(observed);
+        continue;
+      }
+      signal.notify();
+
+      size_t index = extracted.index;
+      reorder_buffer.emplace(index, std::move(extracted));
+
+      auto it = reorder_buffer.find(next_index);
+      while (it != reorder_buffer.end()) {
+        ExtractedFrame& frame = it->second;
+
+        if (before_pose) before_pose(frame.index, frame.timestamp);
+
+        // Frames that failed to decode leave the pose unchanged
+        result.motion_estimated =
+            frame.valid && visual_odometry.update_pose(frame.features);
+
+        result.index = frame.index;
+        result.timestamp = frame.timestamp;
+        result.image_path = std::move(frame.image_path);
+        result.pose = visual_odometry.get_pose();
+        result.keyframe = frame.valid && visual_odometry.is_keyframe();
+        on_pose(result);
+
+        reorder_buffer.erase(it);
+        frames_done.store(++next_index, std::memory_order_release);
+        signal.notify();
+        it = reorder_buffer.find(next_index);
+      }
+    }
+  } catch (...) {
+    fail(std::current_exception());
+  }
+
+  reader.join();
+  for (std::thread& decoder : decoders) decoder.join();
+  for (std::thread& extractor : extractors) extractor.join();
+  if (error) std::rethrow_exception(error);
+
+  PipelineStats stats;
+  stats.frames = next_index;
+  stats.seconds = std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+  if (stats.seconds > 0) stats.frames_per_second = stats.frames / stats.seconds;
+
+  return stats;
+}
@@ -0,0 +1,194 @@
+/**
+ * @file vo_pipeline.hpp
+ * @author Kshitij Aggarwal
+ * @brief C++ header file for the multithreaded visual odometry pipeline
+ * @version 0.1
+ * @date 2024-11-10
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <eigen3/Eigen/Dense>
+#include <functional>
+#include <limits>
+#include <string>
+
+#include "data_loader.hpp"
+#include "visual_odometry.hpp"
+
+namespace pl {
+
+/**
+ * @brief Configuration of the VO pipeline
+ *
+ */
+struct PipelineConfig {
+  /**
+   * @brief Number of threads decoding images
+   *
+   */
+  size_t decode_threads = 1;
+
+  /**
+   * @brief Number of threads undistorting images and extracting features
+   *
+   */
+  size_t extract_threads = 1;
+
+  /**
+   * @brief Capacity of each queue between stages
+   *
+   */
+  size_t queue_capacity = 8;
+
+  /**
+   * @brief Maximum number of frames read but not yet estimated. Bounds the
+   * reorder buffer in front of the estimation stage.
+   *
+   */
+  size_t max_frames_in_flight = 32;
+
+  /**
+   * @brief Images before this timestamp are skipped without decoding
+   *
+   */
+  double start_time = std::numeric_limits<double>::lowest();
+
+  /**
+   * @brief Reading stops at the first image after this timestamp
+   *
+   */
+  double finish_time = std::numeric_limits<double>::max();
+};
+
+/**
+ * @brief Pose estimated for one frame
+ *
+ */
+struct PoseResult {
+  /**
+   * @brief Position of the frame in the processed sequence
+   *
+   */
+  size_t index;
+
+  /**
+   * @brief Image timestamp
+   *
+   */
+  double timestamp;
+
+  /**
+   * @brief Image path relative to the dataset
+   *
+   */
+  std::string image_path;
+
+  /**
+   * @brief VO pose after this frame
+   *
+   */
+  Eigen::Matrix4d pose;
+
+  /**
+   * @brief Flag set when the motion was estimated on this frame, see
+   * vo::VisualOdometry::set_keyframe_selection
+   *
+   */
+  bool keyframe;
+
+  /**
+   * @brief Flag set when VO estimated the motion on this frame. Without it
+   * the pose is the one of the previous frame and carries no measurement.
+   *
+   */
+  bool motion_estimated;
+};
+
+/**
+ * @brief Summary of a pipeline run
+ *
+ */
+struct PipelineStats {
+  /**
+   * @brief Number of frames estimated
+   *
+   */
+  size_t frames = 0;
+
+  /**
+   * @brief Wall time of the run in seconds
+   *
+   */
+  double seconds = 0.0;
+
+  /**
+   * @brief Throughput of the run
+   *
+   */
+  double frames_per_second = 0.0;
+};
+
+/**
+ * @brief Runs visual odometry as a pipeline of stages connected by bounded
+ * lock-free queues: image list reading, decoding, feature extraction and pose
+ * estimation. Decoding and extraction of later frames overlap estimation of
+ * the current one; estimation consumes frames strictly in capture order.
+ * Stages with nothing to do sleep on a condition variable until a queue
+ * moves.
+ *
+ */
+class VoPipeline {
+ private:
+  /**
+   * @brief Dataset the images are read from
+   *
+   */
+  dl::DataLoader& data_loader;
+
+  /**
+   * @brief Odometry the frames are fed to
+   *
+   */
+  vo::VisualOdometry& visual_odometry;
+
+  /**
+   * @brief Pipeline configuration
+   *
+   */
+  PipelineConfig config;
+
+ public:
+  /**
+   * @brief Construct a new VO Pipeline object
+   *
+   * @param data_loader: dataset to read, its image list is consumed by run().
+   * If it prefetches, its workers decode the images and the decode stage
+   * passes them through. Images before the start time are then decoded too,
+   * unless the loader skips them with set_image_start_time.
+   * @param visual_odometry: odometry to update, configure it before run()
+   * @param config: pipeline configuration
+   */
+  VoPipeline(dl::DataLoader& data_loader, vo::VisualOdometry& visual_odometry,
+             const PipelineConfig& config = PipelineConfig());
+
+  /**
+   * @brief Function to process the remaining images of the dataset
+   *
+   * @param on_pose: called on the calling thread for every frame, in order
+   * @param before_pose: optional, called on the calling thread with the index
+   * and timestamp of every frame right before its pose is estimated, e.g. to
+   * supply a rotation prior
+   * @return PipelineStats
+   * @throws the first exception thrown by a stage or a callback, once every
+   * stage has stopped
+   */
+  PipelineStats run(
+      const std::function<void(const PoseResult&)>& on_pose,
+      const std::function<void(size_t, double)>& before_pose = nullptr);
+};
+
+}  // namespace pl
@@ -0,0 +1,252 @@
+/**
+ * @file tracer.cpp
+ * @author Apoorv Thapliyal
+ * @brief C++ source file for the per-stage latency tracer
+ * @version 0.1
+ * @date 2024-11-28
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "tracer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+
+/**
+ * @brief Construct a new pf::Tracer::Tracer object
+ *
+ */
+pf::Tracer::Tracer() : epoch(std::chrono::steady_clock::now()) {}
+
+/**
+ * @brief Get the shared tracer instance
+ *
+ * @return pf::Tracer&
+ */
+pf::Tracer& pf::Tracer::instance() {
+  static Tracer tracer;
+  return tracer;
+}
+
+/**
+ * @brief Function to get the current time
+ *
+ * @return int64_t
+ */
+int64_t pf::Tracer::now() const {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - epoch)
+      .count();
+}
+
+/**
+ * @brief Function to get the index of the calling thread
+ *
+ * @return int
+ */
+int pf::Tracer::thread_index() {
+  auto inserted = threads.emplace(std::this_thread::get_id(),
+                                  static_cast<int>(threads.size()));
+  return inserted.first->second;
+}
+
+/**
+ * @brief Function to record a stage that ran on the calling thread
+ *
+ * @param name
+ * @param start
+ * @param finish
+ */
+void pf::Tracer::record_duration(const char* name, int64_t start,
+                                 int64_t finish) {
+  std::lock_guard<std::mutex> lock(events_mutex);
+  events.push_back({name, start, finish - start, 0.0, thread_index(), false});
+}
+
+/**
+ * @brief Function to record a count
+ *
+ * @param name
+ * @param value
+ */
+void pf::Tracer::record_count(const char* name, double value) {
+  const int64_t time = now();
+  std::lock_guard<std::mutex> lock(events_mutex);
+  events.push_back({name, time, 0, value, thread_index(), true});
+}
+
+/**
+ * @brief Function to summarize the stage durations or the counts
+ *
+ * @param counts
+ * @return std::vector<pf::TraceStatistics>
+ */
+std::vector<pf::TraceStatistics> pf::Tracer::summarize(bool counts) const {
+  // Equal literals from different translation units may not share a
+  // pointer, so events are grouped by their text
+  std::map<std::string, std::vector<double>> samples;
+  {
+    std::lock_guard<std::mutex> lock(events_mutex);
+    for (const Event& event : events)
+      if (event.is_count == counts)
+        samples[event.name].push_back(counts ? event.value
+                                             : event.duration * 1e-3);
+  }
+
+  std::vector<TraceStatistics> statistics;
+  statistics.reserve(samples.size());
+  for (auto& entry : samples) {
+    std::vector<double>& values = entry.second;
+    TraceStatistics stage;
+    stage.name = entry.first;
+    stage.count = values.size();
+
+    double sum = 0.0;
+    for (double value : values) sum += value;
+    stage.mean = sum / values.size();
+    stage.max = *std::max_element(values.begin(), values.end());
+
+    // Nearest-rank percentiles, without sorting the whole set
+    auto percentile = [&values](double fraction) {
+      const size_t rank = static_cast<size_t>(
+          std::ceil(fraction * static_cast<double>(values.size())));
+      auto nth = values.begin() + (rank > 0 ? rank - 1 : 0);
+      std::nth_element(values.begin(), nth, values.end());
+      return *nth;
+    };
+    stage.p50 = percentile(0.50);
+    stage.p99 = percentile(0.99);
+    statistics.push_back(stage);
+  }
+  return statistics;
+}
+
+/**
+ * @brief Function to get the p50/p99/max of every stage duration
+ *
+ * @return std::vector<pf::TraceStatistics>
+ */
+std::vector<pf::TraceStatistics> pf::Tracer::get_stage_statistics() const {
+  return summarize(false);
+}
+
+/**
+ * @brief Function to get the p50/p99/max of every count
+ *
+ * @return std::vector<pf::TraceStatistics>
+ */
+std::vector<pf::TraceStatistics> pf::Tracer::get_count_statistics() const {
+  return summarize(true);
+}
+
+/**
+ * @brief Function to print the stage and count statistics as a table
+ *
+ * @param stream
+ */
+void pf::Tracer::print_summary(std::ostream& stream) const {
+  const std::ios::fmtflags flags = stream.flags();
+  const std::streamsize precision = stream.precision();
+  stream << std::fixed << std::setprecision(1);
+
+  stream << std::left << std::setw(24) << "stage [us]" << std::right
+         << std::setw(10) << "count" << std::setw(12) << "p50"
+         << std::setw(12) << "p99" << std::setw(12) << "max" << '\n';
+  for (const TraceStatistics& stage : get_stage_statistics())
+    stream << std::left << std::setw(24) << stage.name << std::right
+           << std::setw(10) << stage.count << std::setw(12) << stage.p50
+           << std::setw(12) << stage.p99 << std::setw(12) << stage.max
+           << '\n';
+
+  stream << std::left << std::setw(24) << "count" << std::right
+         << std::setw(10) << "frames" << std::setw(12) << "p50"
+         << std::setw(12) << "p99" << std::setw(12) << "max" << '\n';
+  for (const TraceStatistics& count : get_count_statistics())
+    stream << std::left << std::setw(24) << count.name << std::right
+           << std::setw(10) << count.count << std::setw(12) << count.p50
+           << std::setw(12) << count.p99 << std::setw(12) << count.max
+           << '\n';
+
+  stream.flags(flags);
+  stream.precision(precision);
+}
+
+/**
+ * @brief Function to write the events in the Chrome trace event format
+ *
+ * @param path
+ * @return true if the file was written
+ */
+bool pf::Tracer::write_chrome_trace(const std::string& path) const {
+  std::ofstream file(path);
+  if (!file) {
+    std::cerr << "Could not open trace file " << path << std::endl;
+    return false;
+  }
+
+  // Times are in microseconds; the category is the prefix of the name, e.g.
+  // "vo" for "vo.ransac"
+  file << "{\"traceEvents\":[\n" << std::fixed << std::setprecision(3);
+  std::lock_guard<std::mutex> lock(events_mutex);
+  for (size_t i = 0; i < events.size(); i++) {
+    const Event& event = events[i];
+    const char* dot = std::strchr(event.name, '.');
+    const std::string category =
+        dot ? std::string(event.name, dot - event.name) : "default";
+
+    file << "{\"name\":\"" << event.name << "\",\"cat\":\"" << category
+         << "\",\"ph\":\"" << (event.is_count ? 'C' : 'X')
+         << "\",\"ts\":" << event.start * 1e-3 << ",\"pid\":1,\"tid\":"
+         << event.thread;
+    if (event.is_count)
+      file << ",\"args\":{\"value\":" << event.value << "}}";
+    else
+      file << ",\"dur\":" << event.duration * 1e-3 << "}";
+    file << (i + 1 < events.size() ? ",\n" : "\n");
+  }
+  file << "],\"displayTimeUnit\":\"ms\"}\n";
+  return static_cast<bool>(file);
+}
+
+/**
+ * @brief Function to get the number of recorded events
+ *
+ * @return size_t
+ */
+size_t pf::Tracer::size() const {
+  std::lock_guard<std::mutex> lock(events_mutex);
+  return events.size();
+}
+
+/**
+ * @brief Function to drop all recorded events
+ *
+ */
+void pf::Tracer::reset() {
+  std::lock_guard<std::mutex> lock(events_mutex);
+  events.clear();
+}
+
+/**
+ * @brief Construct a new pf::ScopedTimer::ScopedTimer object
+ *
+ * @param stage_name
+ */
+pf::ScopedTimer::ScopedTimer(const char* stage_name)
+    : name(stage_name), start(Tracer::instance().now()) {}
+
+/**
+ * @brief Destroy the pf::ScopedTimer::ScopedTimer object
+ *
+ */
+pf::ScopedTimer::~ScopedTimer() {
+  Tracer& tracer = Tracer::instance();
+  tracer.record_duration(name, start, tracer.now());
+}
@@ -0,0 +1,249 @@
+/**
+ * @file tracer.hpp
+ * @author Apoorv Thapliyal
+ * @brief C++ header file for the per-stage latency tracer
+ * @version 0.1
+ * @date 2024-11-28
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace pf {
+
+/**
+ * @brief Distribution of the samples recorded under one name: durations in
+ * microseconds for stages, raw values for counts
+ *
+ */
+struct TraceStatistics {
+  std::string name;
+  size_t count = 0;
+  double p50 = 0.0;
+  double p99 = 0.0;
+  double max = 0.0;
+  double mean = 0.0;
+};
+
+/**
+ * @brief Process-wide recorder of stage durations (e.g. decode, undistort,
+ * ORB, matching, RANSAC) and per-frame counts (e.g. matches, inliers). Every
+ * event is kept with its thread, so a run can be summarized per stage or
+ * dumped as a Chrome trace (chrome://tracing, Perfetto). Recording takes a
+ * lock, so it belongs around stages of a frame, not around per-sample work.
+ *
+ */
+class Tracer {
+ private:
+  /**
+   * @brief Recorded event, a stage duration or a count
+   *
+   */
+  struct Event {
+    const char* name;
+    int64_t start;
+    int64_t duration;
+    double value;
+    int thread;
+    bool is_count;
+  };
+
+  /**
+   * @brief Events in recording order
+   *
+   */
+  std::vector<Event> events;
+
+  /**
+   * @brief Small index of every thread that recorded an event
+   *
+   */
+  std::unordered_map<std::thread::id, int> threads;
+
+  /**
+   * @brief Mutex guarding the events and the thread indices
+   *
+   */
+  mutable std::mutex events_mutex;
+
+  /**
+   * @brief Time all event times are relative to
+   *
+   */
+  const std::chrono::steady_clock::time_point epoch;
+
+  /**
+   * @brief Construct a new Tracer object
+   *
+   */
+  Tracer();
+
+  /**
+   * @brief Function to get the index of the calling thread, with the lock
+   * held
+   *
+   * @return int
+   */
+  int thread_index();
+
+  /**
+   * @brief Function to summarize the stage durations or the counts
+   *
+   * @param counts: true for the counts
+   * @return std::vector<TraceStatistics>: sorted by name
+   */
+  std::vector<TraceStatistics> summarize(bool counts) const;
+
+ public:
+  /**
+   * @brief Get the shared tracer instance
+   *
+   * @return Tracer&
+   */
+  static Tracer& instance();
+
+  /**
+   * @brief Function to get the current time
+   *
+   * @return int64_t: nanoseconds since the tracer was created
+   */
+  int64_t now() const;
+
+  /**
+   * @brief Function to record a stage that ran on the calling thread
+   *
+   * @param name: string literal, kept by pointer
+   * @param start: start time from now()
+   * @param finish: finish time from now()
+   */
+  void record_duration(const char* name, int64_t start, int64_t finish);
+
+  /**
+   * @brief Function to record a count, e.g. the matches of a frame
+   *
+   * @param name: string literal, kept by pointer
+   * @param value
+   */
+  void record_count(const char* name, double value);
+
+  /**
+   * @brief Function to get the p50/p99/max of every stage duration
+   *
+   * @return std::vector<TraceStatistics>: in microseconds, sorted by name
+   */
+  std::vector<TraceStatistics> get_stage_statistics() const;
+
+  /**
+   * @brief Function to get the p50/p99/max of every count
+   *
+   * @return std::vector<TraceStatistics>: sorted by name
+   */
+  std::vector<TraceStatistics> get_count_statistics() const;
+
+  /**
+   * @brief Function to print the stage and count statistics as a table
+   *
+   * @param stream
+   */
+  void print_summary(std::ostream& stream) const;
+
+  /**
+   * @brief Function to write the events in the Chrome trace event format.
+   * Stages become complete ("X") events and counts counter ("C") events.
+   *
+   * @param path
+   * @return true if the file was written
+   */
+  bool write_chrome_trace(const std::string& path) const;
+
+  /**
+   * @brief Function to get the number of recorded events
+   *
+   * @return size_t
+   */
+  size_t size() const;
+
+  /**
+   * @brief Function to drop all recorded events
+   *
+   */
+  void reset();
+};
+
+/**
+ * @brief Timer recording the duration of the enclosing scope as a stage
+ *
+ */
+class ScopedTimer {
+ private:
+  /**
+   * @brief Name of the stage
+   *
+   */
+  const char* name;
+
+  /**
+   * @brief Time the scope was entered
+   *
+   */
+  int64_t start;
+
+ public:
+  /**
+   * @brief Construct a new Scoped Timer object and start timing
+   *
+   * @param stage_name: string literal, kept by pointer
+   */
+  explicit ScopedTimer(const char* stage_name);
+
+  /**
+   * @brief Destroy the Scoped Timer object and record the stage
+   *
+   */
+  ~ScopedTimer();
+
+  ScopedTimer(const ScopedTimer&) = delete;
+  ScopedTimer& operator=(const ScopedTimer&) = delete;
+};
+
+/**
+ * @brief Whether the instrumented libraries were built with tracing
+ * (-D ENABLE_TRACING=ON)
+ *
+ */
+#ifdef VIO_TRACING
+constexpr bool kTracingEnabled = true;
+#else
+constexpr bool kTracingEnabled = false;
+#endif
+
+}  // namespace pf
+
+// Instrumentation points. Without VIO_TRACING they expand to nothing and
+// their arguments are not evaluated.
+#ifdef VIO_TRACING
+#define PF_CONCAT_INNER(a, b) a##b
+#define PF_CONCAT(a, b) PF_CONCAT_INNER(a, b)
+#define PF_TRACE_SCOPE(name) \
+  pf::ScopedTimer PF_CONCAT(pf_scoped_timer_, __COUNTER__)(name)
+#define PF_TRACE_COUNT(name, value) \
+  pf::Tracer::instance().record_count(name, static_cast<double>(value))
+#else
+#define PF_TRACE_SCOPE(name) \
+  do {                       \
+  } while (0)
+#define PF_TRACE_COUNT(name, value) \
+  do {                              \
+  } while (0)
+#endif
@@ -0,0 +1,491 @@
+/**
+ * @file binary_matcher.cpp
+ * @author Apoorv Thapliyal
+ * @brief C++ source file for the Hamming-distance binary descriptor matcher
+ * @version 0.1
+ * @date 2024-11-04
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "binary_matcher.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <numeric>
+#include <random>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define VO_X86_DISPATCH 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+/**
+ * @brief Signature of a Hamming distance kernel
+ *
+ */
+using HammingKernel = int (*)(const uint8_t*, const uint8_t*, int);
+
+/**
+ * @brief Portable population count of a 64 bit word
+ *
+ * @param x
+ * @return int
+ */
+inline int popcount64(uint64_t x) {
+#if defined(__GNUC__)
+  return __builtin_popcountll(x);
+#else
+  x = x - ((x >> 1) & 0x5555555555555555ULL);
+  x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+  x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+  return static_cast<int>((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+/**
+ * @brief Scalar Hamming distance over 64 bit words
+ *
+ * @param a
+ * @param b
+ * @param bytes
+ * @return int
+ */
+int hamming_scalar(const uint8_t* a, const uint8_t* b, int bytes) {
+  int distance = 0;
+  int i = 0;
+  for (; i + 8 <= bytes; i += 8) {
+    uint64_t x, y;
+    std::memcpy(&x, a + i, 8);
+    std::memcpy(&y, b + i, 8);
+    distance += popcount64(x ^ y);
+  }
+  for (; i < bytes; i++) distance += popcount64(a[i] ^ b[i]);
+  return distance;
+}
+
+#ifdef VO_X86_DISPATCH
+
+/**
+ * @brief Hamming distance using the hardware popcnt instruction
+ *
+ * @param a
+ * @param b
+ * @param bytes
+ * @return int
+ */
+__attribute__((target("popcnt"))) int hamming_popcnt(const uint8_t* a,
+                                                     const uint8_t* b,
+                                                     int bytes) {
+  int distance = 0;
+  int i = 0;
+  for (; i + 8 <= bytes; i += 8) {
+    uint64_t x, y;
+    std::memcpy(&x, a + i, 8);
+    std::memcpy(&y, b + i, 8);
+    distance += __builtin_popcountll(x ^ y);
+  }
+  for (; i < bytes; i++) distance += __builtin_popcount(a[i] ^ b[i]);
+  return distance;
+}
+
+/**
+ * @brief Hamming distance with a 4 bit lookup table in SSSE3 registers
+ *
+ * @param a
+ * @param b
+ * @param bytes
+ * @return int
+ */
+__attribute__((target("ssse3"))) int hamming_ssse3(const uint8_t* a,
+                                                   const uint8_t* b,
+                                                   int bytes) {
+  const __m128i lookup =
+      _mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m128i low_mask = _mm_set1_epi8(0x0f);
+  __m128i sum = _mm_setzero_si128();
+
+  int i = 0;
+  for (; i + 16 <= bytes; i += 16) {
+    __m128i x = _mm_xor_si128(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+    __m128i low = _mm_and_si128(x, low_mask);
+    __m128i high = _mm_and_si128(_mm_srli_epi16(x, 4), low_mask);
+    __m128i count = _mm_add_epi8(_mm_shuffle_epi8(lookup, low),
+                                 _mm_shuffle_epi8(lookup, high));
+    sum = _mm_add_epi64(sum, _mm_sad_epu8(count, _mm_setzero_si128()));
+  }
+
+  alignas(16) uint64_t lanes[2];
+  _mm_store_si128(reinterpret_cast<__m128i*>(lanes), sum);
+  return static_cast<int>(lanes[0] + lanes[1]) +
+         hamming_scalar(a + i, b + i, bytes - i);
+}
+
+/**
+ * @brief Hamming distance with a 4 bit lookup table in AVX2 registers, one
+ * 256 bit ORB descriptor per iteration
+ *
+ * @param a
+ * @param b
+ * @param bytes
+ * @return int
+ */
+__attribute__((target("avx2"))) int hamming_avx2(const uint8_t* a,
+                                                 const uint8_t* b, int bytes) {
+  const __m256i lookup = _mm256_setr_epi8(
+      0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1,
+      2, 2, 3, 2, 3, 3, 4);
+  const __m256i low_mask = _mm256_set1_epi8(0x0f);
+  __m256i sum = _mm256_setzero_si256();
+
+  int i = 0;
+  for (; i + 32 <= bytes; i += 32) {
+    __m256i x = _mm256_xor_si256(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)),
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)));
+    __m256i low = _mm256_and_si256(x, low_mask);
+    __m256i high = _mm256_and_si256(_mm256_srli_epi16(x, 4), low_mask);
+    __m256i count = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, low),
+                                    _mm256_shuffle_epi8(lookup, high));
+    sum = _mm256_add_epi64(sum, _mm256_sad_epu8(count, _mm256_setzero_si256()));
+  }
+
+  alignas(32) uint64_t lanes[4];
+  _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), sum);
+
+  // Clear the upper register halves before returning to SSE code, which
+  // otherwise pays a state transition penalty on every call
+  _mm256_zeroupper();
+
+  return static_cast<int>(lanes[0] + lanes[1] + lanes[2] + lanes[3]) +
+         hamming_popcnt(a + i, b + i, bytes - i);
+}
+
+#endif  // VO_X86_DISPATCH
+
+/**
+ * @brief Pick the fastest kernel the running CPU supports
+ *
+ * @return HammingKernel
+ */
+HammingKernel select_hamming_kernel() {
+#ifdef VO_X86_DISPATCH
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return hamming_avx2;
+  if (__builtin_cpu_supports("popcnt")) return hamming_popcnt;
+  if (__builtin_cpu_supports("ssse3")) return hamming_ssse3;
+#endif
+  return hamming_scalar;
+}
+
+/**
+ * @brief Get the kernel of an implementation
+ *
+ * @param implementation
+ * @return HammingKernel: nullptr if the running CPU cannot execute it
+ */
+HammingKernel find_hamming_kernel(vo::HammingImplementation implementation) {
+  switch (implementation) {
+    case vo::HammingImplementation::kAuto:
+      return select_hamming_kernel();
+    case vo::HammingImplementation::kScalar:
+      return hamming_scalar;
+#ifdef VO_X86_DISPATCH
+    case vo::HammingImplementation::kPopcnt:
+      __builtin_cpu_init();
+      return __builtin_cpu_supports("popcnt") ? hamming_popcnt : nullptr;
+    case vo::HammingImplementation::kSsse3:
+      __builtin_cpu_init();
+      return __builtin_cpu_supports("ssse3") ? hamming_ssse3 : nullptr;
+    case vo::HammingImplementation::kAvx2:
+      // The AVX2 kernel finishes the tail with popcnt
+      __builtin_cpu_init();
+      return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")
+                 ? hamming_avx2
+                 : nullptr;
+#endif
+    default:
+      return nullptr;
+  }
+}
+
+/**
+ * @brief Insert a candidate into a distance-sorted list of at most k matches
+ *
+ * @param best
+ * @param k
+ * @param candidate
+ */
+inline void push_candidate(std::vector<cv::DMatch>& best, int k,
+                           const cv::DMatch& candidate) {
+  if (static_cast<int>(best.size()) == k &&
+      candidate.distance >= best.back().distance)
+    return;
+
+  auto position = std::upper_bound(
+      best.begin(), best.end(), candidate,
+      [](const cv::DMatch& a, const cv::DMatch& b) {
+        return a.distance < b.distance;
+      });
+  best.insert(position, candidate);
+  if (static_cast<int>(best.size()) > k) best.pop_back();
+}
+
+}  // namespace
+
+/**
+ * @brief Construct a new vo::Binary Matcher::Binary Matcher object
+ *
+ * @param index
+ * @param params
+ */
+vo::BinaryMatcher::BinaryMatcher(MatcherIndex index, const LshParams& params)
+    : index(index), lsh_params(params) {}
+
+/**
+ * @brief Function to change the search structure
+ *
+ * @param new_index
+ */
+void vo::BinaryMatcher::set_index(MatcherIndex new_index) {
+  index = new_index;
+  if (index == MatcherIndex::kLsh && !train_descriptors.empty()) build_lsh();
+}
+
+/**
+ * @brief Function to get the search structure in use
+ *
+ * @return vo::MatcherIndex
+ */
+vo::MatcherIndex vo::BinaryMatcher::get_index() const { return index; }
+
+/**
+ * @brief Function to compute the Hamming distance between two descriptors
+ *
+ * @param a
+ * @param b
+ * @param bytes
+ * @return int
+ */
+int vo::BinaryMatcher::hamming_distance(const uint8_t* a, const uint8_t* b,
+                                        int bytes) {
+  static const HammingKernel kernel = select_hamming_kernel();
+  return kernel(a, b, bytes);
+}
+
+/**
+ * @brief Function to compute the Hamming distance with a given kernel
+ *
+ * @param a
+ * @param b
+ * @param bytes
+ * @param implementation
+ * @return int
+ */
+int vo::BinaryMatcher::hamming_distance(const uint8_t* a, const uint8_t* b,
+                                        int bytes,
+                                        HammingImplementation implementation) {
+  HammingKernel kernel = find_hamming_kernel(implementation);
+  return kernel ? kernel(a, b, bytes) : -1;
+}
+
+/**
+ * @brief Function to hash a descriptor row for one table
+ *
+ * @param descriptor
+ * @param table
+ * @return uint32_t
+ */
+uint32_t vo::BinaryMatcher::lsh_key(const uint8_t* descriptor,
+                                    int table) const {
+  uint32_t key = 0;
+  for (int bit : lsh_bits[table])
+    key = (key << 1) | ((descriptor[bit >> 3] >> (bit & 7)) & 1u);
+  return key;
+}
+
+/**
+ * @brief Function to map a hash key to its bucket
+ *
+ * @param key
+ * @return uint32_t
+ */
+uint32_t vo::BinaryMatcher::lsh_bucket(uint32_t key) const {
+  if (lsh_bucket_bits == static_cast<int>(lsh_bits[0].size())) return key;
+
+  // Fibonacci hashing keeps the top bits of the product, which mix all bits
+  // of the key
+  return (key * 2654435769u) >> (32 - lsh_bucket_bits);
+}
+
+/**
+ * @brief Function to build the LSH tables over the train descriptors
+ *
+ */
+void vo::BinaryMatcher::build_lsh() {
+  const int descriptor_bits = train_descriptors.cols * 8;
+  const int key_bits =
+      std::max(1, std::min({lsh_params.key_bits, descriptor_bits, 24}));
+
+  // Sample the hashed bit positions once per descriptor width, with a fixed
+  // seed so matching is reproducible between runs
+  bool resample = static_cast<int>(lsh_bits.size()) != lsh_params.table_count;
+  for (const auto& bits : lsh_bits)
+    if (static_cast<int>(bits.size()) != key_bits ||
+        bits.back() >= descriptor_bits)
+      resample = true;
+
+  if (resample) {
+    std::mt19937 rng(0x5eed);
+    std::vector<int> positions(descriptor_bits);
+    std::iota(positions.begin(), positions.end(), 0);
+
+    lsh_bits.assign(lsh_params.table_count, std::vector<int>());
+    for (auto& bits : lsh_bits) {
+      std::shuffle(positions.begin(), positions.end(), rng);
+      bits.assign(positions.begin(), positions.begin() + key_bits);
+    }
+  }
+
+  // Size the bucket table to about twice the train rows rather than to every
+  // possible key, which for 24 bit keys would be 16M buckets per table
+  int row_bits = 1;
+  while ((1 << row_bits) < 2 * train_descriptors.rows) row_bits++;
+  lsh_bucket_bits = std::min(key_bits, row_bits);
+
+  // Counting sort of the train rows by bucket, per table
+  const size_t bucket_count = size_t(1) << lsh_bucket_bits;
+  lsh_bucket_start.resize(lsh_params.table_count);
+  lsh_entries.resize(lsh_params.table_count);
+
+  std::vector<uint32_t> buckets(train_descriptors.rows);
+  for (int table = 0; table < lsh_params.table_count; table++) {
+    std::vector<int>& start = lsh_bucket_start[table];
+    std::vector<int>& entries = lsh_entries[table];
+    start.assign(bucket_count + 1, 0);
+    entries.resize(train_descriptors.rows);
+
+    for (int row = 0; row < train_descriptors.rows; row++) {
+      buckets[row] =
+          lsh_bucket(lsh_key(train_descriptors.ptr<uint8_t>(row), table));
+      start[buckets[row] + 1]++;
+    }
+    for (size_t bucket = 0; bucket < bucket_count; bucket++)
+      start[bucket + 1] += start[bucket];
+
+    std::vector<int> fill(start.begin(), start.end() - 1);
+    for (int row = 0; row < train_descriptors.rows; row++)
+      entries[fill[buckets[row]]++] = row;
+  }
+}
+
+/**
+ * @brief Function to set the descriptors the queries are matched against
+ *
+ * @param descriptors
+ */
+void vo::BinaryMatcher::train(const cv::Mat& descriptors) {
+  if (!descriptors.empty() && descriptors.type() != CV_8U) {
+    std::cerr << "BinaryMatcher expects CV_8U descriptors.\n";
+    train_descriptors.release();
+    return;
+  }
+
+  train_descriptors = descriptors;
+  if (index == MatcherIndex::kLsh && !train_descriptors.empty()) build_lsh();
+}
+
+/**
+ * @brief Function to find the k nearest train descriptors of every query
+ *
+ * @param query_descriptors
+ * @param matches
+ * @param k
+ */
+void vo::BinaryMatcher::knn_match(
+    const cv::Mat& query_descriptors,
+    std::vector<std::vector<cv::DMatch>>& matches, int k) const {
+  matches.clear();
+  if (query_descriptors.empty() || train_descriptors.empty() || k <= 0)
+    return;
+
+  if (query_descriptors.type() != CV_8U ||
+      query_descriptors.cols != train_descriptors.cols) {
+    std::cerr << "BinaryMatcher query descriptors do not match the train "
+                 "descriptors.\n";
+    return;
+  }
+
+  const int bytes = query_descriptors.cols;
+  matches.resize(query_descriptors.rows);
+
+  if (index == MatcherIndex::kBruteForce) {
+    for (int query = 0; query < query_descriptors.rows; query++) {
+      const uint8_t* query_row = query_descriptors.ptr<uint8_t>(query);
+      std::vector<cv::DMatch>& best = matches[query];
+      best.reserve(k + 1);
+
+      for (int row = 0; row < train_descriptors.rows; row++) {
+        int distance = hamming_distance(
+            query_row, train_descriptors.ptr<uint8_t>(row), bytes);
+        push_candidate(best, k,
+                       cv::DMatch(query, row, static_cast<float>(distance)));
+      }
+    }
+    return;
+  }
+
+  // LSH: only score train rows that share a (probed) bucket with the query,
+  // each at most once per query
+  std::vector<int> last_query(train_descriptors.rows, -1);
+  const int key_bits = lsh_bits.empty() ? 0 : lsh_bits[0].size();
+  const int probes = lsh_params.multi_probe_level > 0 ? key_bits : 0;
+
+  for (int query = 0; query < query_descriptors.rows; query++) {
+    const uint8_t* query_row = query_descriptors.ptr<uint8_t>(query);
+    std::vector<cv::DMatch>& best = matches[query];
+    best.reserve(k + 1);
+
+    for (int table = 0; table < static_cast<int>(lsh_bits.size()); table++) {
+      const uint32_t key = lsh_key(query_row, table);
+      const std::vector<int>& start = lsh_bucket_start[table];
+      const std::vector<int>& entries = lsh_entries[table];
+
+      for (int probe = -1; probe < probes; probe++) {
+        const uint32_t bucket =
+            lsh_bucket(probe < 0 ? key : key ^ (1u << probe));
+        for (int e = start[bucket]; e < start[bucket + 1]; e++) {
+          const int row = entries[e];
+          if (last_query[row] == query) continue;
+          last_query[row] = query;
+
+          int distance = hamming_distance(
+              query_row, train_descriptors.ptr<uint8_t>(row), bytes);
+          push_candidate(best, k,
+                         cv::DMatch(query, row, static_cast<float>(distance)));
+        }
+      }
+    }
+  }
+}
+
+/**
+ * @brief Function to train on a descriptor set and match queries against it
+ *
+ * @param query_descriptors
+ * @param train_descriptors
+ * @param matches
+ * @param k
+ */
+void vo::BinaryMatcher::knn_match(
+    const cv::Mat& query_descriptors, const cv::Mat& train_descriptors,
+    std::vector<std::vector<cv::DMatch>>& matches, int k) {
+  train(train_descriptors);
+  knn_match(query_descriptors, matches, k);
+}
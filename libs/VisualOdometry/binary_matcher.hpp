@@ -0,0 +1,244 @@
+/**
+ * @file binary_matcher.hpp
+ * @author Apoorv Thapliyal
+ * @brief C++ header file for the Hamming-distance binary descriptor matcher
+ * @version 0.1
+ * @date 2024-11-04
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <opencv2/core.hpp>
+#include <opencv2/features2d.hpp>
+#include <vector>
+
+namespace vo {
+
+/**
+ * @brief Search structure used by the binary matcher
+ *
+ */
+enum class MatcherIndex {
+  /**
+   * @brief Exhaustive SIMD popcount search over all train descriptors
+   *
+   */
+  kBruteForce,
+
+  /**
+   * @brief Bit-sampling locality sensitive hashing over the train descriptors
+   *
+   */
+  kLsh
+};
+
+/**
+ * @brief Hamming distance kernels of the binary matcher
+ *
+ */
+enum class HammingImplementation {
+  /**
+   * @brief Fastest kernel the running CPU supports
+   *
+   */
+  kAuto,
+
+  /**
+   * @brief Portable 64 bit word kernel
+   *
+   */
+  kScalar,
+
+  /**
+   * @brief Hardware popcnt kernel
+   *
+   */
+  kPopcnt,
+
+  /**
+   * @brief SSSE3 lookup table kernel
+   *
+   */
+  kSsse3,
+
+  /**
+   * @brief AVX2 lookup table kernel
+   *
+   */
+  kAvx2
+};
+
+/**
+ * @brief Parameters of the bit-sampling LSH index
+ *
+ */
+struct LshParams {
+  /**
+   * @brief Number of hash tables
+   *
+   */
+  int table_count = 6;
+
+  /**
+   * @brief Number of sampled descriptor bits per hash key, at most 24. Keys
+   * wider than the bucket table of a train set are hashed into it.
+   *
+   */
+  int key_bits = 12;
+
+  /**
+   * @brief Also probe the buckets whose key differs in one bit (0 or 1)
+   *
+   */
+  int multi_probe_level = 1;
+};
+
+/**
+ * @brief KNN matcher for binary descriptors (CV_8U rows) under the Hamming
+ * distance
+ *
+ */
+class BinaryMatcher {
+ private:
+  /**
+   * @brief Search structure in use
+   *
+   */
+  MatcherIndex index;
+
+  /**
+   * @brief LSH parameters
+   *
+   */
+  LshParams lsh_params;
+
+  /**
+   * @brief Descriptors the queries are matched against
+   *
+   */
+  cv::Mat train_descriptors;
+
+  /**
+   * @brief Sampled bit positions of each hash table
+   *
+   */
+  std::vector<std::vector<int>> lsh_bits;
+
+  /**
+   * @brief Number of bits indexing the bucket table, at most the key width
+   *
+   */
+  int lsh_bucket_bits = 0;
+
+  /**
+   * @brief Start offset of every bucket in lsh_entries, per table
+   *
+   */
+  std::vector<std::vector<int>> lsh_bucket_start;
+
+  /**
+   * @brief Train descriptor indices sorted by bucket, per table
+   *
+   */
+  std::vector<std::vector<int>> lsh_entries;
+
+  /**
+   * @brief Function to hash a descriptor row for one table
+   *
+   */
+  uint32_t lsh_key(const uint8_t* descriptor, int table) const;
+
+  /**
+   * @brief Function to map a hash key to its bucket
+   *
+   */
+  uint32_t lsh_bucket(uint32_t key) const;
+
+  /**
+   * @brief Function to build the LSH tables over the train descriptors
+   *
+   */
+  void build_lsh();
+
+ public:
+  /**
+   * @brief Construct a new Binary Matcher object
+   *
+   * @param index: search structure to use
+   * @param params: LSH parameters, used when index is kLsh
+   */
+  explicit BinaryMatcher(MatcherIndex index = MatcherIndex::kBruteForce,
+                         const LshParams& params = LshParams());
+
+  /**
+   * @brief Function to change the search structure
+   *
+   * @param new_index
+   */
+  void set_index(MatcherIndex new_index);
+
+  /**
+   * @brief Function to get the search structure in use
+   *
+   * @return MatcherIndex
+   */
+  MatcherIndex get_index() const;
+
+  /**
+   * @brief Function to set the descriptors the queries are matched against
+   *
+   * @param descriptors: CV_8U matrix, one descriptor per row
+   */
+  void train(const cv::Mat& descriptors);
+
+  /**
+   * @brief Function to find the k nearest train descriptors of every query
+   *
+   * @param query_descriptors: CV_8U matrix, one descriptor per row
+   * @param matches: per query, up to k matches sorted by distance
+   * @param k: number of neighbours
+   */
+  void knn_match(const cv::Mat& query_descriptors,
+                 std::vector<std::vector<cv::DMatch>>& matches, int k) const;
+
+  /**
+   * @brief Function to train on a descriptor set and match queries against it
+   *
+   * @param query_descriptors: CV_8U matrix, one descriptor per row
+   * @param train_descriptors: CV_8U matrix, one descriptor per row
+   * @param matches: per query, up to k matches sorted by distance
+   * @param k: number of neighbours
+   */
+  void knn_match(const cv::Mat& query_descriptors,
+                 const cv::Mat& train_descriptors,
+                 std::vector<std::vector<cv::DMatch>>& matches, int k);
+
+  /**
+   * @brief Function to compute the Hamming distance between two descriptors
+   *
+   * @param a: first descriptor
+   * @param b: second descriptor
+   * @param bytes: descriptor length in bytes
+   * @return int
+   */
+  static int hamming_distance(const uint8_t* a, const uint8_t* b, int bytes);
+
+  /**
+   * @brief Function to compute the Hamming distance with a given kernel, e.g.
+   * to check the SIMD kernels against the scalar one
+   *
+   * @param a: first descriptor
+   * @param b: second descriptor
+   * @param bytes: descriptor length in bytes
+   * @param implementation: kernel to use
+   * @return int: -1 if the running CPU cannot execute the kernel
+   */
+  static int hamming_distance(const uint8_t* a, const uint8_t* b, int bytes,
+                              HammingImplementation implementation);
+};
+
+}  // namespace vo
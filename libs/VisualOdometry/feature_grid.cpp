@@ -0,0 +1,184 @@
+/**
+ * @file feature_grid.cpp
+ * @author Apoorv Thapliyal
+ * @brief C++ source file for the spatial grid index and guided matcher
+ * @version 0.1
+ * @date 2024-11-06
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "feature_grid.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "binary_matcher.hpp"
+
+/**
+ * @brief Construct a new vo::Feature Grid::Feature Grid object
+ *
+ * @param image_width
+ * @param image_height
+ * @param cell_size
+ */
+vo::FeatureGrid::FeatureGrid(int image_width, int image_height, int cell_size)
+    : cell_size(std::max(1, cell_size)) {
+  grid_cols = std::max(1, (image_width + this->cell_size - 1) / this->cell_size);
+  grid_rows =
+      std::max(1, (image_height + this->cell_size - 1) / this->cell_size);
+  cell_start.assign(grid_cols * grid_rows + 1, 0);
+}
+
+/**
+ * @brief Function to get the cell column or row of a coordinate
+ *
+ * @param value
+ * @param cell_count
+ * @return int
+ */
+int vo::FeatureGrid::cell_coordinate(float value, int cell_count) const {
+  // Clamp before the cast, a prediction with a tiny depth can be far outside
+  // the int range. NaN lands in the first cell.
+  const float cell = std::floor(value / cell_size);
+  if (!(cell > 0.0f)) return 0;
+  if (cell >= static_cast<float>(cell_count - 1)) return cell_count - 1;
+  return static_cast<int>(cell);
+}
+
+/**
+ * @brief Function to index a set of keypoints
+ *
+ * @param keypoints
+ */
+void vo::FeatureGrid::build(const std::vector<cv::KeyPoint>& keypoints) {
+  // Counting sort of the points by cell
+  std::fill(cell_start.begin(), cell_start.end(), 0);
+  point_cells.resize(keypoints.size());
+
+  for (size_t i = 0; i < keypoints.size(); i++) {
+    int cell = cell_coordinate(keypoints[i].pt.y, grid_rows) * grid_cols +
+               cell_coordinate(keypoints[i].pt.x, grid_cols);
+    point_cells[i] = cell;
+    cell_start[cell + 1]++;
+  }
+  for (size_t cell = 0; cell + 1 < cell_start.size(); cell++)
+    cell_start[cell + 1] += cell_start[cell];
+
+  cell_entries.resize(keypoints.size());
+  std::vector<int> fill(cell_start.begin(), cell_start.end() - 1);
+  for (size_t i = 0; i < keypoints.size(); i++)
+    cell_entries[fill[point_cells[i]]++] = static_cast<int>(i);
+}
+
+/**
+ * @brief Function to get the indices of the points in the cells overlapping a
+ * square window
+ *
+ * @param center
+ * @param radius
+ * @param indices
+ */
+void vo::FeatureGrid::query(const cv::Point2f& center, float radius,
+                            std::vector<int>& indices) const {
+  indices.clear();
+
+  const int col_begin = cell_coordinate(center.x - radius, grid_cols);
+  const int col_end = cell_coordinate(center.x + radius, grid_cols);
+  const int row_begin = cell_coordinate(center.y - radius, grid_rows);
+  const int row_end = cell_coordinate(center.y + radius, grid_rows);
+
+  for (int row = row_begin; row <= row_end; row++) {
+    const int first = row * grid_cols;
+    indices.insert(indices.end(),
+                   cell_entries.begin() + cell_start[first + col_begin],
+                   cell_entries.begin() + cell_start[first + col_end + 1]);
+  }
+}
+
+/**
+ * @brief Construct a new vo::Guided Matcher::Guided Matcher object
+ *
+ * @param image_width
+ * @param image_height
+ * @param search_radius
+ */
+vo::GuidedMatcher::GuidedMatcher(int image_width, int image_height,
+                                 float search_radius)
+    : grid(image_width, image_height), search_radius(search_radius) {}
+
+/**
+ * @brief Function to set the search window size
+ *
+ * @param radius
+ */
+void vo::GuidedMatcher::set_search_radius(float radius) {
+  search_radius = radius;
+}
+
+/**
+ * @brief Function to find the k nearest train descriptors of every query
+ * within the search window around its predicted location
+ *
+ * @param predicted_points
+ * @param query_descriptors
+ * @param train_keypoints
+ * @param train_descriptors
+ * @param matches
+ * @param k
+ */
+void vo::GuidedMatcher::knn_match(
+    const std::vector<cv::Point2f>& predicted_points,
+    const cv::Mat& query_descriptors,
+    const std::vector<cv::KeyPoint>& train_keypoints,
+    const cv::Mat& train_descriptors,
+    std::vector<std::vector<cv::DMatch>>& matches, int k) {
+  matches.clear();
+  if (query_descriptors.empty() || train_descriptors.empty() || k <= 0) return;
+
+  if (query_descriptors.type() != CV_8U ||
+      train_descriptors.type() != CV_8U ||
+      query_descriptors.cols != train_descriptors.cols ||
+      static_cast<int>(predicted_points.size()) != query_descriptors.rows) {
+    std::cerr << "GuidedMatcher inputs are inconsistent.\n";
+    return;
+  }
+
+  grid.build(train_keypoints);
+
+  const int bytes = query_descriptors.cols;
+  std::vector<int> candidates;
+  matches.resize(query_descriptors.rows);
+
+  for (int query = 0; query < query_descriptors.rows; query++) {
+    const cv::Point2f& predicted = predicted_points[query];
+    grid.query(predicted, search_radius, candidates);
+
+    const uint8_t* query_row = query_descriptors.ptr<uint8_t>(query);
+    std::vector<cv::DMatch>& best = matches[query];
+
+    for (int row : candidates) {
+      // The grid returns whole cells, so trim to the exact window
+      const cv::Point2f& pt = train_keypoints[row].pt;
+      if (std::abs(pt.x - predicted.x) > search_radius ||
+          std::abs(pt.y - predicted.y) > search_radius)
+        continue;
+
+      float distance = static_cast<float>(BinaryMatcher::hamming_distance(
+          query_row, train_descriptors.ptr<uint8_t>(row), bytes));
+      if (static_cast<int>(best.size()) == k &&
+          distance >= best.back().distance)
+        continue;
+
+      auto position = std::upper_bound(
+          best.begin(), best.end(), distance,
+          [](float value, const cv::DMatch& match) {
+            return value < match.distance;
+          });
+      best.insert(position, cv::DMatch(query, row, distance));
+      if (static_cast<int>(best.size()) > k) best.pop_back();
+    }
+  }
+}
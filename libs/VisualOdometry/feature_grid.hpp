@@ -0,0 +1,153 @@
+/**
+ * @file feature_grid.hpp
+ * @author Apoorv Thapliyal
+ * @brief C++ header file for the spatial grid index and guided matcher
+ * @version 0.1
+ * @date 2024-11-06
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <opencv2/features2d.hpp>
+#include <vector>
+
+namespace vo {
+
+/**
+ * @brief Grid-bucketed index of image points for fixed-radius lookups
+ *
+ */
+class FeatureGrid {
+ private:
+  /**
+   * @brief Side length of a cell in pixels
+   *
+   */
+  int cell_size;
+
+  /**
+   * @brief Number of cell columns
+   *
+   */
+  int grid_cols;
+
+  /**
+   * @brief Number of cell rows
+   *
+   */
+  int grid_rows;
+
+  /**
+   * @brief Start offset of every cell in cell_entries
+   *
+   */
+  std::vector<int> cell_start;
+
+  /**
+   * @brief Point indices sorted by cell
+   *
+   */
+  std::vector<int> cell_entries;
+
+  /**
+   * @brief Scratch buffer holding the cell of every point
+   *
+   */
+  std::vector<int> point_cells;
+
+  /**
+   * @brief Function to get the cell column or row of a coordinate, clamped
+   * to the grid for any float value
+   *
+   */
+  int cell_coordinate(float value, int cell_count) const;
+
+ public:
+  /**
+   * @brief Construct a new Feature Grid object
+   *
+   * @param image_width: width of the indexed image
+   * @param image_height: height of the indexed image
+   * @param cell_size: side length of a cell in pixels
+   */
+  FeatureGrid(int image_width, int image_height, int cell_size = 16);
+
+  /**
+   * @brief Function to index a set of keypoints
+   *
+   * @param keypoints
+   */
+  void build(const std::vector<cv::KeyPoint>& keypoints);
+
+  /**
+   * @brief Function to get the indices of the points in the cells overlapping
+   * a square window
+   *
+   * @param center: window center
+   * @param radius: half side length of the window in pixels
+   * @param indices: output point indices, cleared first
+   */
+  void query(const cv::Point2f& center, float radius,
+             std::vector<int>& indices) const;
+};
+
+/**
+ * @brief Descriptor matcher that only compares each query against the train
+ * keypoints near its predicted location
+ *
+ */
+class GuidedMatcher {
+ private:
+  /**
+   * @brief Grid index over the train keypoints
+   *
+   */
+  FeatureGrid grid;
+
+  /**
+   * @brief Half side length of the search window in pixels
+   *
+   */
+  float search_radius;
+
+ public:
+  /**
+   * @brief Construct a new Guided Matcher object
+   *
+   * @param image_width: width of the images being matched
+   * @param image_height: height of the images being matched
+   * @param search_radius: half side length of the search window in pixels
+   */
+  GuidedMatcher(int image_width = 0, int image_height = 0,
+                float search_radius = 30.0f);
+
+  /**
+   * @brief Function to set the search window size
+   *
+   * @param radius: half side length of the search window in pixels
+   */
+  void set_search_radius(float radius);
+
+  /**
+   * @brief Function to find the k nearest train descriptors of every query
+   * within the search window around its predicted location
+   *
+   * @param predicted_points: predicted location of every query keypoint
+   * @param query_descriptors: CV_8U matrix, one descriptor per row
+   * @param train_keypoints: keypoints of the train image
+   * @param train_descriptors: CV_8U matrix, one descriptor per row
+   * @param matches: per query, up to k matches sorted by distance
+   * @param k: number of neighbours
+   */
+  void knn_match(const std::vector<cv::Point2f>& predicted_points,
+                 const cv::Mat& query_descriptors,
+                 const std::vector<cv::KeyPoint>& train_keypoints,
+                 const cv::Mat& train_descriptors,
+                 std::vector<std::vector<cv::DMatch>>& matches, int k);
+};
+
+}  // namespace vo
@@ -0,0 +1,867 @@
+/**
+ * @file five_point_ransac.cpp
+ * @author Apoorv Thapliyal
+ * @brief C++ source file for the five-point essential matrix RANSAC
+ * @version 0.1
+ * @date 2024-11-21
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "five_point_ransac.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define VO_X86_DISPATCH 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+/**
+ * @brief Signature of a Sampson error kernel. E is row-major, the points are
+ * in structure-of-arrays layout and the mask pointer may be null.
+ *
+ */
+using SampsonKernel = size_t (*)(const double*, const double*, const double*,
+                                 const double*, const double*, size_t, size_t,
+                                 double, unsigned char*);
+
+/**
+ * @brief Scalar Sampson error kernel
+ *
+ * @param e
+ * @param px
+ * @param py
+ * @param cx
+ * @param cy
+ * @param begin
+ * @param end
+ * @param threshold_sq
+ * @param mask
+ * @return size_t
+ */
+size_t sampson_scalar(const double* e, const double* px, const double* py,
+                      const double* cx, const double* cy, size_t begin,
+                      size_t end, double threshold_sq, unsigned char* mask) {
+  size_t count = 0;
+  for (size_t i = begin; i < end; i++) {
+    double ef0 = e[0] * cx[i] + e[1] * cy[i] + e[2];
+    double ef1 = e[3] * cx[i] + e[4] * cy[i] + e[5];
+    double ef2 = e[6] * cx[i] + e[7] * cy[i] + e[8];
+    double et0 = e[0] * px[i] + e[3] * py[i] + e[6];
+    double et1 = e[1] * px[i] + e[4] * py[i] + e[7];
+    double epipolar = px[i] * ef0 + py[i] * ef1 + ef2;
+    double gradient = ef0 * ef0 + ef1 * ef1 + et0 * et0 + et1 * et1;
+
+    // Compare without dividing, so a zero gradient is never an inlier
+    bool inlier = epipolar * epipolar < threshold_sq * gradient;
+    count += inlier;
+    if (mask) mask[i] = inlier;
+  }
+  return count;
+}
+
+#ifdef VO_X86_DISPATCH
+
+/**
+ * @brief Sampson error kernel evaluating four correspondences per iteration
+ * in AVX2 registers
+ *
+ * @param e
+ * @param px
+ * @param py
+ * @param cx
+ * @param cy
+ * @param begin
+ * @param end
+ * @param threshold_sq
+ * @param mask
+ * @return size_t
+ */
+__attribute__((target("avx2,fma"))) size_t sampson_avx2(
+    const double* e, const double* px, const double* py, const double* cx,
+    const double* cy, size_t begin, size_t end, double threshold_sq,
+    unsigned char* mask) {
+  const __m256d e00 = _mm256_set1_pd(e[0]), e01 = _mm256_set1_pd(e[1]),
+                e02 = _mm256_set1_pd(e[2]), e10 = _mm256_set1_pd(e[3]),
+                e11 = _mm256_set1_pd(e[4]), e12 = _mm256_set1_pd(e[5]),
+                e20 = _mm256_set1_pd(e[6]), e21 = _mm256_set1_pd(e[7]),
+                e22 = _mm256_set1_pd(e[8]);
+  const __m256d threshold = _mm256_set1_pd(threshold_sq);
+
+  size_t count = 0;
+  size_t i = begin;
+  for (; i + 4 <= end; i += 4) {
+    __m256d x_prev = _mm256_loadu_pd(px + i), y_prev = _mm256_loadu_pd(py + i);
+    __m256d x_curr = _mm256_loadu_pd(cx + i), y_curr = _mm256_loadu_pd(cy + i);
+
+    __m256d ef0 = _mm256_fmadd_pd(e00, x_curr, _mm256_fmadd_pd(e01, y_curr, e02));
+    __m256d ef1 = _mm256_fmadd_pd(e10, x_curr, _mm256_fmadd_pd(e11, y_curr, e12));
+    __m256d ef2 = _mm256_fmadd_pd(e20, x_curr, _mm256_fmadd_pd(e21, y_curr, e22));
+    __m256d et0 = _mm256_fmadd_pd(e00, x_prev, _mm256_fmadd_pd(e10, y_prev, e20));
+    __m256d et1 = _mm256_fmadd_pd(e01, x_prev, _mm256_fmadd_pd(e11, y_prev, e21));
+
+    __m256d epipolar =
+        _mm256_fmadd_pd(x_prev, ef0, _mm256_fmadd_pd(y_prev, ef1, ef2));
+    __m256d gradient = _mm256_mul_pd(ef0, ef0);
+    gradient = _mm256_fmadd_pd(ef1, ef1, gradient);
+    gradient = _mm256_fmadd_pd(et0, et0, gradient);
+    gradient = _mm256_fmadd_pd(et1, et1, gradient);
+
+    int bits = _mm256_movemask_pd(
+        _mm256_cmp_pd(_mm256_mul_pd(epipolar, epipolar),
+                      _mm256_mul_pd(threshold, gradient), _CMP_LT_OQ));
+    count += __builtin_popcount(bits);
+    if (mask)
+      for (int k = 0; k < 4; k++) mask[i + k] = (bits >> k) & 1;
+  }
+
+  // Clear the upper register halves before returning to SSE code, which
+  // otherwise pays a state transition penalty on every call
+  _mm256_zeroupper();
+
+  return count + sampson_scalar(e, px, py, cx, cy, i, end, threshold_sq, mask);
+}
+
+#endif  // VO_X86_DISPATCH
+
+/**
+ * @brief Pick the fastest kernel the running CPU supports
+ *
+ * @return SampsonKernel
+ */
+SampsonKernel select_sampson_kernel() {
+#ifdef VO_X86_DISPATCH
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    return sampson_avx2;
+#endif
+  return sampson_scalar;
+}
+
+/**
+ * @brief Polynomials in the unknowns x, y, z of E = x X + y Y + z Z + W.
+ * Linear terms are ordered x, y, z, 1 and quadratic ones x^2, xy, xz, y^2,
+ * yz, z^2, x, y, z, 1. Cubic terms follow Nister's ordering, so the ten
+ * monomials eliminated by Gauss-Jordan come first.
+ *
+ */
+typedef std::array<double, 4> Linear;
+typedef std::array<double, 10> Quadratic;
+typedef std::array<double, 20> Cubic;
+
+/**
+ * @brief Product index tables of the monomial orderings
+ *
+ */
+struct MonomialTables {
+  /**
+   * @brief Index of the product of two linear monomials in the quadratics
+   *
+   */
+  int linear_linear[4][4];
+
+  /**
+   * @brief Index of the product of a quadratic and a linear monomial in the
+   * cubics
+   *
+   */
+  int quadratic_linear[10][4];
+
+  /**
+   * @brief Construct a new Monomial Tables object
+   *
+   */
+  MonomialTables() {
+    const int linear[4][3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}, {0, 0, 0}};
+    const int quadratic[10][3] = {{2, 0, 0}, {1, 1, 0}, {1, 0, 1}, {0, 2, 0},
+                                  {0, 1, 1}, {0, 0, 2}, {1, 0, 0}, {0, 1, 0},
+                                  {0, 0, 1}, {0, 0, 0}};
+    const int cubic[20][3] = {
+        {3, 0, 0}, {0, 3, 0}, {2, 1, 0}, {1, 2, 0}, {2, 0, 1},
+        {2, 0, 0}, {0, 2, 1}, {0, 2, 0}, {1, 1, 1}, {1, 1, 0},
+        {1, 0, 2}, {1, 0, 1}, {1, 0, 0}, {0, 1, 2}, {0, 1, 1},
+        {0, 1, 0}, {0, 0, 3}, {0, 0, 2}, {0, 0, 1}, {0, 0, 0}};
+
+    for (int a = 0; a < 4; a++)
+      for (int b = 0; b < 4; b++)
+        for (int q = 0; q < 10; q++)
+          if (quadratic[q][0] == linear[a][0] + linear[b][0] &&
+              quadratic[q][1] == linear[a][1] + linear[b][1] &&
+              quadratic[q][2] == linear[a][2] + linear[b][2])
+            linear_linear[a][b] = q;
+
+    for (int q = 0; q < 10; q++)
+      for (int b = 0; b < 4; b++)
+        for (int c = 0; c < 20; c++)
+          if (cubic[c][0] == quadratic[q][0] + linear[b][0] &&
+              cubic[c][1] == quadratic[q][1] + linear[b][1] &&
+              cubic[c][2] == quadratic[q][2] + linear[b][2])
+            quadratic_linear[q][b] = c;
+  }
+};
+
+/**
+ * @brief Function to get the product index tables
+ *
+ * @return const MonomialTables&
+ */
+const MonomialTables& monomial_tables() {
+  static const MonomialTables tables;
+  return tables;
+}
+
+/**
+ * @brief Function to accumulate the product of two linear polynomials
+ *
+ * @param a
+ * @param b
+ * @param scale
+ * @param result
+ */
+void multiply_add(const Linear& a, const Linear& b, double scale,
+                  Quadratic& result) {
+  const MonomialTables& tables = monomial_tables();
+  for (int i = 0; i < 4; i++)
+    for (int j = 0; j < 4; j++)
+      result[tables.linear_linear[i][j]] += scale * a[i] * b[j];
+}
+
+/**
+ * @brief Function to accumulate the product of a quadratic and a linear
+ * polynomial
+ *
+ * @param a
+ * @param b
+ * @param scale
+ * @param result
+ */
+void multiply_add(const Quadratic& a, const Linear& b, double scale,
+                  Cubic& result) {
+  const MonomialTables& tables = monomial_tables();
+  for (int i = 0; i < 10; i++)
+    for (int j = 0; j < 4; j++)
+      result[tables.quadratic_linear[i][j]] += scale * a[i] * b[j];
+}
+
+/**
+ * @brief Polynomial in z with ascending coefficients, up to degree 10
+ *
+ */
+typedef std::array<double, 11> PolynomialZ;
+
+/**
+ * @brief Function to multiply two polynomials in z
+ *
+ * @param a
+ * @param b
+ * @return PolynomialZ
+ */
+PolynomialZ multiply(const PolynomialZ& a, const PolynomialZ& b) {
+  PolynomialZ result;
+  result.fill(0.0);
+  for (int i = 0; i < 11; i++) {
+    if (a[i] == 0.0) continue;
+    for (int j = 0; i + j < 11; j++) result[i + j] += a[i] * b[j];
+  }
+  return result;
+}
+
+/**
+ * @brief Function to evaluate a polynomial in z
+ *
+ * @param p
+ * @param z
+ * @return double
+ */
+double evaluate(const PolynomialZ& p, double z) {
+  double value = 0.0;
+  for (int i = 10; i >= 0; i--) value = value * z + p[i];
+  return value;
+}
+
+/**
+ * @brief Function to find the root of a polynomial inside a bracket where it
+ * is monotonic, with Newton steps that fall back to bisection whenever a step
+ * leaves the bracket or converges too slowly
+ *
+ * @param p: ascending coefficients
+ * @param degree
+ * @param low
+ * @param high
+ * @param value_low: p(low), of opposite sign to p(high)
+ * @param tolerance: relative accuracy of the root
+ * @return double
+ */
+double bracketed_root(const double* p, int degree, double low, double high,
+                      double value_low, double tolerance) {
+  double z = 0.5 * (low + high);
+  double previous_step = high - low;
+  for (int iteration = 0; iteration < 100; iteration++) {
+    double value = 0.0, derivative = 0.0;
+    for (int k = degree; k >= 0; k--) {
+      derivative = derivative * z + value;
+      value = value * z + p[k];
+    }
+    if (value == 0.0) break;
+    if ((value > 0.0) == (value_low > 0.0))
+      low = z;
+    else
+      high = z;
+
+    double next = derivative != 0.0 ? z - value / derivative : low;
+    double step = std::abs(next - z);
+    if (!(next > low && next < high) || step > 0.5 * previous_step) {
+      next = 0.5 * (low + high);
+      step = 0.5 * (high - low);
+    }
+    previous_step = step;
+    z = next;
+    if (step <= tolerance * (1.0 + std::abs(z))) break;
+  }
+  return z;
+}
+
+/**
+ * @brief Function to find the real roots of a polynomial in ascending order.
+ * The roots of the derivative split the bound into intervals where the
+ * polynomial is monotonic, so each holds at most one root.
+ *
+ * @param p: ascending coefficients
+ * @param degree: degree of p, with a non-zero leading coefficient
+ * @param bound: magnitude bound of the roots
+ * @param tolerance: relative accuracy of the roots
+ * @param roots: output, room for degree values
+ * @return int: number of roots
+ */
+int real_roots(const double* p, int degree, double bound, double tolerance,
+               double* roots) {
+  if (degree == 1) {
+    double root = -p[0] / p[1];
+    if (std::abs(root) > bound) return 0;
+    roots[0] = root;
+    return 1;
+  }
+
+  double derivative[10] = {0.0};
+  for (int k = 1; k <= degree; k++) derivative[k - 1] = k * p[k];
+  double critical[11];
+
+  // Critical points only delimit the intervals, they need less accuracy
+  int critical_count =
+      real_roots(derivative, degree - 1, bound, 1e-8, critical + 1);
+  critical[0] = -bound;
+  critical[critical_count + 1] = bound;
+
+  int count = 0;
+  double low = critical[0];
+  double value_low = 0.0;
+  for (int k = degree; k >= 0; k--) value_low = value_low * low + p[k];
+  for (int i = 1; i <= critical_count + 1; i++) {
+    double high = critical[i];
+    double value_high = 0.0;
+    for (int k = degree; k >= 0; k--) value_high = value_high * high + p[k];
+
+    if (value_low == 0.0)
+      roots[count++] = low;
+    else if ((value_low > 0.0) != (value_high > 0.0) && value_high != 0.0)
+      roots[count++] =
+          bracketed_root(p, degree, low, high, value_low, tolerance);
+
+    low = high;
+    value_low = value_high;
+  }
+  if (value_low == 0.0 && count < degree) roots[count++] = low;
+
+  return count;
+}
+
+/**
+ * @brief Function to compute a row of Nister's 3x3 matrix from two rows of
+ * the Gauss-Jordan reduced system, <upper> - z <lower>
+ *
+ * @param B: reduced system, row r reads monomial_r + B.row(r) * tail = 0
+ * @param upper
+ * @param lower
+ * @param row: output x, y and constant coefficients as polynomials in z
+ */
+void nister_row(const Eigen::Matrix<double, 10, 10>& B, int upper, int lower,
+                PolynomialZ row[3]) {
+  for (int k = 0; k < 3; k++) row[k].fill(0.0);
+
+  // Tail monomials: xz^2, xz, x, yz^2, yz, y, z^3, z^2, z, 1
+  for (int v = 0; v < 2; v++) {
+    int o = 3 * v;
+    row[v][0] = B(upper, o + 2);
+    row[v][1] = B(upper, o + 1) - B(lower, o + 2);
+    row[v][2] = B(upper, o) - B(lower, o + 1);
+    row[v][3] = -B(lower, o);
+  }
+  row[2][0] = B(upper, 9);
+  row[2][1] = B(upper, 8) - B(lower, 9);
+  row[2][2] = B(upper, 7) - B(lower, 8);
+  row[2][3] = B(upper, 6) - B(lower, 7);
+  row[2][4] = -B(lower, 6);
+}
+
+/**
+ * @brief Function to compute the SPRT decision threshold A, the fixed point
+ * of A = t_M C / m_S + 1 + ln(A) (Chum and Matas)
+ *
+ * @param epsilon: inlier ratio of a good model
+ * @param delta: inlier ratio of a bad model
+ * @return double: log(A), infinite when the test cannot discriminate
+ */
+double sprt_log_threshold(double epsilon, double delta) {
+  if (delta >= epsilon) return std::numeric_limits<double>::infinity();
+
+  // Hypothesis cost in point evaluations and solutions per sample
+  const double t_M = 200.0;
+  const double m_S = 2.5;
+  double C = (1.0 - delta) * std::log((1.0 - delta) / (1.0 - epsilon)) +
+             delta * std::log(delta / epsilon);
+  double K = t_M * C / m_S;
+  double A = K + 1.0;
+  for (int i = 0; i < 10; i++) A = K + 1.0 + std::log(A);
+  return std::log(A);
+}
+
+/**
+ * @brief Points scored per SPRT decision
+ *
+ */
+const size_t kSprtBlock = 32;
+
+}  // namespace
+
+/**
+ * @brief Construct a new vo::Five Point Ransac::Five Point Ransac object
+ *
+ * @param ransac_confidence
+ * @param ransac_max_iterations
+ */
+vo::FivePointRansac::FivePointRansac(double ransac_confidence,
+                                     int ransac_max_iterations)
+    : confidence(ransac_confidence),
+      max_iterations(ransac_max_iterations),
+      generator(42) {}
+
+/**
+ * @brief Function to count the correspondences whose Sampson error is below
+ * the threshold
+ *
+ * @param E
+ * @param begin
+ * @param end
+ * @param threshold_sq
+ * @param inlier_mask
+ * @return size_t
+ */
+size_t vo::FivePointRansac::count_inliers(const Eigen::Matrix3d& E,
+                                          size_t begin, size_t end,
+                                          double threshold_sq,
+                                          unsigned char* inlier_mask) const {
+  static const SampsonKernel kernel = select_sampson_kernel();
+
+  double e[9];
+  for (int i = 0; i < 3; i++)
+    for (int j = 0; j < 3; j++) e[3 * i + j] = E(i, j);
+
+  return kernel(e, prev_x.data(), prev_y.data(), curr_x.data(), curr_y.data(),
+                begin, end, threshold_sq, inlier_mask);
+}
+
+/**
+ * @brief Function to flag the correspondences whose Sampson error is below
+ * the threshold, with the dispatched or the scalar kernel
+ *
+ * @param E
+ * @param points_prev
+ * @param points_curr
+ * @param threshold
+ * @param vectorized
+ * @param inlier_mask
+ * @return size_t
+ */
+size_t vo::FivePointRansac::sampson_inliers(
+    const Eigen::Matrix3d& E, const std::vector<Eigen::Vector3d>& points_prev,
+    const std::vector<Eigen::Vector3d>& points_curr, double threshold,
+    bool vectorized, std::vector<unsigned char>& inlier_mask) {
+  static const SampsonKernel kernel = select_sampson_kernel();
+
+  const size_t count = points_curr.size();
+  inlier_mask.assign(count, 0);
+  if (points_prev.size() != count) return 0;
+
+  double e[9];
+  for (int i = 0; i < 3; i++)
+    for (int j = 0; j < 3; j++) e[3 * i + j] = E(i, j);
+
+  std::vector<double> px(count), py(count), cx(count), cy(count);
+  for (size_t i = 0; i < count; i++) {
+    px[i] = points_prev[i](0);
+    py[i] = points_prev[i](1);
+    cx[i] = points_curr[i](0);
+    cy[i] = points_curr[i](1);
+  }
+
+  return (vectorized ? kernel : sampson_scalar)(
+      e, px.data(), py.data(), cx.data(), cy.data(), 0, count,
+      threshold * threshold, inlier_mask.data());
+}
+
+/**
+ * @brief Function to compute the essential matrices consistent with five
+ * correspondences
+ *
+ * @param points_prev
+ * @param points_curr
+ * @param essentials
+ * @return int
+ */
+int vo::FivePointRansac::solve_minimal(const Eigen::Vector3d* points_prev,
+                                       const Eigen::Vector3d* points_curr,
+                                       Eigen::Matrix3d* essentials) {
+  // Epipolar constraints on the row-major entries of E
+  Eigen::Matrix<double, 9, 5> constraints;
+  for (int n = 0; n < 5; n++)
+    for (int i = 0; i < 3; i++)
+      for (int j = 0; j < 3; j++)
+        constraints(3 * i + j, n) = points_prev[n](i) * points_curr[n](j);
+
+  // E lies in the four-dimensional null space of the constraints
+  Eigen::HouseholderQR<Eigen::Matrix<double, 9, 5>> qr(constraints);
+  Eigen::Matrix<double, 9, 9> Q = qr.householderQ();
+  const Eigen::Matrix<double, 9, 4> basis = Q.rightCols<4>();
+
+  // Entries of E as linear polynomials in x, y, z
+  Linear E[3][3];
+  for (int i = 0; i < 3; i++)
+    for (int j = 0; j < 3; j++)
+      for (int k = 0; k < 4; k++) E[i][j][k] = basis(3 * i + j, k);
+
+  Eigen::Matrix<double, 10, 20> M;
+
+  // det(E) = 0
+  Cubic determinant;
+  determinant.fill(0.0);
+  for (int j = 0; j < 3; j++) {
+    int j1 = (j + 1) % 3, j2 = (j + 2) % 3;
+    Quadratic minor;
+    minor.fill(0.0);
+    multiply_add(E[1][j1], E[2][j2], 1.0, minor);
+    multiply_add(E[1][j2], E[2][j1], -1.0, minor);
+    multiply_add(minor, E[0][j], 1.0, determinant);
+  }
+  for (int c = 0; c < 20; c++) M(0, c) = determinant[c];
+
+  // 2 E E^T E - trace(E E^T) E = 0
+  Quadratic EEt[3][3];
+  for (int i = 0; i < 3; i++)
+    for (int j = 0; j < 3; j++) {
+      EEt[i][j].fill(0.0);
+      for (int k = 0; k < 3; k++)
+        multiply_add(E[i][k], E[j][k], 1.0, EEt[i][j]);
+    }
+  Quadratic trace;
+  for (int q = 0; q < 10; q++)
+    trace[q] = EEt[0][0][q] + EEt[1][1][q] + EEt[2][2][q];
+
+  for (int i = 0; i < 3; i++)
+    for (int j = 0; j < 3; j++) {
+      Cubic entry;
+      entry.fill(0.0);
+      for (int k = 0; k < 3; k++) multiply_add(EEt[i][k], E[k][j], 2.0, entry);
+      multiply_add(trace, E[i][j], -1.0, entry);
+      for (int c = 0; c < 20; c++) M(1 + 3 * i + j, c) = entry[c];
+    }
+
+  // Gauss-Jordan elimination of the ten leading monomials
+  Eigen::PartialPivLU<Eigen::Matrix<double, 10, 10>> lu(M.leftCols<10>());
+  const Eigen::Matrix<double, 10, 10> B = lu.solve(M.rightCols<10>());
+
+  // Rows <e> - z<f>, <g> - z<h>, <i> - z<j> are linear in x and y
+  PolynomialZ rows[3][3];
+  nister_row(B, 4, 5, rows[0]);
+  nister_row(B, 6, 7, rows[1]);
+  nister_row(B, 8, 9, rows[2]);
+
+  // Their determinant is the tenth degree polynomial in z
+  PolynomialZ polynomial;
+  polynomial.fill(0.0);
+  for (int j = 0; j < 3; j++) {
+    int j1 = (j + 1) % 3, j2 = (j + 2) % 3;
+    PolynomialZ minor = multiply(rows[1][j1], rows[2][j2]);
+    PolynomialZ other = multiply(rows[1][j2], rows[2][j1]);
+    for (int k = 0; k < 11; k++) minor[k] -= other[k];
+    PolynomialZ term = multiply(rows[0][j], minor);
+    for (int k = 0; k < 11; k++) polynomial[k] += term[k];
+  }
+
+  // Drop vanishing leading coefficients
+  double largest = 0.0;
+  for (int k = 0; k < 11; k++)
+    largest = std::max(largest, std::abs(polynomial[k]));
+  if (largest == 0.0) return 0;
+  int degree = 10;
+  while (degree > 0 && std::abs(polynomial[degree]) < 1e-12 * largest)
+    degree--;
+  if (degree == 0) return 0;
+
+  // Fujiwara bound on the magnitude of the roots
+  double bound = 0.0;
+  for (int k = 0; k < degree; k++) {
+    double ratio = std::abs(polynomial[k] / polynomial[degree]);
+    if (k == 0) ratio *= 0.5;
+    bound = std::max(bound, std::pow(ratio, 1.0 / (degree - k)));
+  }
+  bound = 2.0 * bound + 1e-9;
+
+  double roots[10];
+  int root_count = real_roots(polynomial.data(), degree, bound, 1e-14, roots);
+
+  int solutions = 0;
+  for (int r = 0; r < root_count; r++) {
+    double z = roots[r];
+
+    // x and y span the null space of the 3x3 matrix at z
+    Eigen::Matrix3d Bz;
+    for (int i = 0; i < 3; i++)
+      for (int j = 0; j < 3; j++) Bz(i, j) = evaluate(rows[i][j], z);
+    Eigen::Vector3d candidates[3] = {Bz.row(0).cross(Bz.row(1)),
+                                     Bz.row(0).cross(Bz.row(2)),
+                                     Bz.row(1).cross(Bz.row(2))};
+    int best = 0;
+    for (int k = 1; k < 3; k++)
+      if (candidates[k].squaredNorm() > candidates[best].squaredNorm())
+        best = k;
+    const Eigen::Vector3d& v = candidates[best];
+    if (std::abs(v(2)) < 1e-12 * v.norm()) continue;
+
+    Eigen::Matrix<double, 9, 1> e =
+        basis * Eigen::Vector4d(v(0) / v(2), v(1) / v(2), z, 1.0);
+    Eigen::Matrix3d& solution = essentials[solutions++];
+    for (int i = 0; i < 3; i++)
+      for (int j = 0; j < 3; j++) solution(i, j) = e(3 * i + j);
+    solution.normalize();
+  }
+
+  return solutions;
+}
+
+/**
+ * @brief Function to estimate the essential matrix
+ *
+ * @param points_prev
+ * @param points_curr
+ * @param threshold
+ * @param E
+ * @param inlier_mask
+ * @return size_t
+ */
+size_t vo::FivePointRansac::estimate(
+    const std::vector<Eigen::Vector3d>& points_prev,
+    const std::vector<Eigen::Vector3d>& points_curr, double threshold,
+    Eigen::Matrix3d& E, std::vector<unsigned char>& inlier_mask) {
+  const size_t count = points_curr.size();
+  last_iterations = 0;
+  last_rejected = 0;
+  inlier_mask.assign(count, 0);
+  if (count < 5 || points_prev.size() != count) return 0;
+
+  prev_x.resize(count);
+  prev_y.resize(count);
+  curr_x.resize(count);
+  curr_y.resize(count);
+  for (size_t i = 0; i < count; i++) {
+    prev_x[i] = points_prev[i](0);
+    prev_y[i] = points_prev[i](1);
+    curr_x[i] = points_curr[i](0);
+    curr_y[i] = points_curr[i](1);
+  }
+
+  const double threshold_sq = threshold * threshold;
+  std::uniform_int_distribution<size_t> pick(0, count - 1);
+
+  // SPRT state: inlier ratio of good and bad models
+  double epsilon = 0.1;
+  double delta = 0.05;
+  double log_A = sprt_log_threshold(epsilon, delta);
+
+  size_t best_inliers = 0;
+  Eigen::Matrix3d best_E = Eigen::Matrix3d::Zero();
+  Eigen::Matrix3d essentials[10];
+  Eigen::Vector3d sample_prev[5], sample_curr[5];
+  int required = max_iterations;
+
+  for (int iteration = 0; iteration < required; iteration++) {
+    last_iterations++;
+
+    size_t indices[5];
+    for (int k = 0; k < 5; k++) {
+      bool repeated;
+      do {
+        indices[k] = pick(generator);
+        repeated = std::find(indices, indices + k, indices[k]) != indices + k;
+      } while (repeated);
+      sample_prev[k] = points_prev[indices[k]];
+      sample_curr[k] = points_curr[indices[k]];
+    }
+
+    int solutions = solve_minimal(sample_prev, sample_curr, essentials);
+    for (int s = 0; s < solutions; s++) {
+      size_t inliers = 0;
+      if (sprt) {
+        // Score block by block and stop once the likelihood ratio favours a
+        // bad model
+        const double log_inlier = std::log(delta / epsilon);
+        const double log_outlier = std::log((1.0 - delta) / (1.0 - epsilon));
+        double log_lambda = 0.0;
+        size_t scored = 0;
+        bool rejected = false;
+        for (size_t begin = 0; begin < count; begin += kSprtBlock) {
+          size_t end = std::min(count, begin + kSprtBlock);
+          size_t block = count_inliers(essentials[s], begin, end,
+                                       threshold_sq, nullptr);
+          inliers += block;
+          scored = end;
+          log_lambda += block * log_inlier + (end - begin - block) * log_outlier;
+          if (log_lambda > log_A) {
+            rejected = true;
+            break;
+          }
+        }
+
+        if (rejected) {
+          last_rejected++;
+          delta = std::min(0.5, std::max(1e-4, 0.95 * delta +
+                                                   0.05 * inliers / scored));
+          log_A = sprt_log_threshold(epsilon, delta);
+          continue;
+        }
+      } else {
+        inliers = count_inliers(essentials[s], 0, count, threshold_sq, nullptr);
+      }
+
+      if (inliers <= best_inliers) continue;
+      best_inliers = inliers;
+      best_E = essentials[s];
+
+      // Adaptive number of samples; the SPRT loses a fraction 1/A of the
+      // good models
+      epsilon = static_cast<double>(inliers) / count;
+      log_A = sprt_log_threshold(epsilon, delta);
+      double good_sample = std::pow(epsilon, 5);
+      if (sprt && std::isfinite(log_A)) good_sample *= 1.0 - std::exp(-log_A);
+      if (good_sample >= 1.0) {
+        required = iteration + 1;
+      } else if (good_sample > 0.0) {
+        double needed =
+            std::log(1.0 - confidence) / std::log(1.0 - good_sample);
+        if (needed < required) required = static_cast<int>(std::ceil(needed));
+      }
+    }
+  }
+
+  if (best_inliers < 5) return 0;
+
+  E = best_E;
+  return count_inliers(E, 0, count, threshold_sq, inlier_mask.data());
+}
+
+/**
+ * @brief Function to pick the rotation and translation of an essential matrix
+ * that puts the most inliers in front of both cameras
+ *
+ * @param E
+ * @param points_prev
+ * @param points_curr
+ * @param inlier_mask
+ * @param R
+ * @param t
+ * @return size_t
+ */
+size_t vo::FivePointRansac::recover_pose(
+    const Eigen::Matrix3d& E, const std::vector<Eigen::Vector3d>& points_prev,
+    const std::vector<Eigen::Vector3d>& points_curr,
+    const std::vector<unsigned char>& inlier_mask, Eigen::Matrix3d& R,
+    Eigen::Vector3d& t) {
+  Eigen::JacobiSVD<Eigen::Matrix3d> svd(E,
+                                        Eigen::ComputeFullU | Eigen::ComputeFullV);
+  Eigen::Matrix3d U = svd.matrixU();
+  Eigen::Matrix3d V = svd.matrixV();
+  if (U.determinant() < 0.0) U = -U;
+  if (V.determinant() < 0.0) V = -V;
+
+  Eigen::Matrix3d W;
+  W << 0.0, -1.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, 1.0;
+  const Eigen::Matrix3d rotations[2] = {U * W * V.transpose(),
+                                        U * W.transpose() * V.transpose()};
+  const Eigen::Vector3d translation = U.col(2);
+
+  // Points further than this many baselines are too ill-conditioned to vote
+  const double max_depth = 50.0;
+
+  size_t best_count = 0;
+  R = rotations[0];
+  t = translation;
+  for (int candidate = 0; candidate < 4; candidate++) {
+    const Eigen::Matrix3d& R_candidate = rotations[candidate / 2];
+    const Eigen::Vector3d t_candidate =
+        candidate % 2 == 0 ? translation : Eigen::Vector3d(-translation);
+
+    size_t in_front = 0;
+    for (size_t i = 0; i < points_curr.size(); i++) {
+      if (!inlier_mask[i]) continue;
+
+      // Depths along both rays: d_prev f_prev = d_curr R f_curr + t
+      Eigen::Vector3d a = R_candidate * points_curr[i];
+      const Eigen::Vector3d& b = points_prev[i];
+      double aa = a.dot(a), ab = a.dot(b), bb = b.dot(b);
+      double det = aa * bb - ab * ab;
+      if (det < 1e-12 * aa * bb) continue;
+      double at = a.dot(t_candidate), bt = b.dot(t_candidate);
+      double depth_curr = (ab * bt - bb * at) / det;
+      double depth_prev = (aa * bt - ab * at) / det;
+      if (depth_curr > 0.0 && depth_prev > 0.0 && depth_curr < max_depth &&
+          depth_prev < max_depth)
+        in_front++;
+    }
+
+    if (in_front > best_count) {
+      best_count = in_front;
+      R = R_candidate;
+      t = t_candidate;
+    }
+  }
+
+  return best_count;
+}
+
+/**
+ * @brief Function to enable or disable the SPRT early rejection
+ *
+ * @param enabled
+ */
+void vo::FivePointRansac::set_sprt(bool enabled) { sprt = enabled; }
+
+/**
+ * @brief Function to get the number of samples the last call drew
+ *
+ * @return int
+ */
+int vo::FivePointRansac::get_last_iterations() const { return last_iterations; }
+
+/**
+ * @brief Function to get the number of hypotheses the SPRT rejected in the
+ * last call
+ *
+ * @return int
+ */
+int vo::FivePointRansac::get_last_rejected() const { return last_rejected; }
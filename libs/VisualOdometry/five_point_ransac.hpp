@@ -0,0 +1,188 @@
+/**
+ * @file five_point_ransac.hpp
+ * @author Apoorv Thapliyal
+ * @brief C++ header file for the five-point essential matrix RANSAC
+ * @version 0.1
+ * @date 2024-11-21
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <eigen3/Eigen/Core>
+#include <eigen3/Eigen/Dense>
+#include <random>
+#include <vector>
+
+namespace vo {
+
+/**
+ * @brief Essential matrix RANSAC on normalized image points. Hypotheses come
+ * from Nister's five-point solver, are scored with a vectorized Sampson error
+ * and are abandoned early by a sequential probability ratio test (SPRT) once
+ * they are unlikely to beat the best model. Points follow the pose update
+ * convention X_prev = R * X_curr + t, so f_prev^T * E * f_curr = 0.
+ *
+ */
+class FivePointRansac {
+ private:
+  /**
+   * @brief Probability that at least one sample is outlier free
+   *
+   */
+  double confidence;
+
+  /**
+   * @brief Upper bound on the number of samples
+   *
+   */
+  int max_iterations;
+
+  /**
+   * @brief Flag to enable the SPRT early rejection of hypotheses
+   *
+   */
+  bool sprt = true;
+
+  /**
+   * @brief Samples drawn by the last estimate call
+   *
+   */
+  int last_iterations = 0;
+
+  /**
+   * @brief Hypotheses the SPRT rejected in the last estimate call
+   *
+   */
+  int last_rejected = 0;
+
+  /**
+   * @brief Random generator for the samples, seeded for repeatable runs
+   *
+   */
+  std::mt19937 generator;
+
+  /**
+   * @brief Normalized coordinates in structure-of-arrays layout, so the
+   * Sampson error can be evaluated on several correspondences at once
+   *
+   */
+  std::vector<double> prev_x, prev_y, curr_x, curr_y;
+
+  /**
+   * @brief Function to count the correspondences of [begin, end) whose
+   * Sampson error is below the threshold
+   *
+   * @param E
+   * @param begin
+   * @param end
+   * @param threshold_sq: squared Sampson error threshold
+   * @param inlier_mask: per-correspondence output flags, may be null
+   * @return size_t
+   */
+  size_t count_inliers(const Eigen::Matrix3d& E, size_t begin, size_t end,
+                       double threshold_sq, unsigned char* inlier_mask) const;
+
+ public:
+  /**
+   * @brief Construct a new Five Point Ransac object
+   *
+   * @param ransac_confidence
+   * @param ransac_max_iterations
+   */
+  FivePointRansac(double ransac_confidence = 0.999,
+                  int ransac_max_iterations = 1000);
+
+  /**
+   * @brief Function to compute the essential matrices consistent with five
+   * correspondences
+   *
+   * @param points_prev: five normalized points (z = 1) in the previous image
+   * @param points_curr: five normalized points (z = 1) in the current image
+   * @param essentials: output, room for 10 unit-norm solutions
+   * @return int: number of solutions
+   */
+  static int solve_minimal(const Eigen::Vector3d* points_prev,
+                           const Eigen::Vector3d* points_curr,
+                           Eigen::Matrix3d* essentials);
+
+  /**
+   * @brief Function to estimate the essential matrix
+   *
+   * @param points_prev: normalized image points (z = 1) in the previous image
+   * @param points_curr: normalized image points (z = 1) in the current image
+   * @param threshold: Sampson error threshold in normalized units, e.g.
+   * pixels divided by the focal length
+   * @param E: output essential matrix
+   * @param inlier_mask: output inlier flag of every correspondence
+   * @return size_t: number of inliers, 0 if no model was found
+   */
+  size_t estimate(const std::vector<Eigen::Vector3d>& points_prev,
+                  const std::vector<Eigen::Vector3d>& points_curr,
+                  double threshold, Eigen::Matrix3d& E,
+                  std::vector<unsigned char>& inlier_mask);
+
+  /**
+   * @brief Function to pick the rotation and translation of an essential
+   * matrix that puts the most inliers in front of both cameras
+   *
+   * @param E
+   * @param points_prev: normalized image points (z = 1) in the previous image
+   * @param points_curr: normalized image points (z = 1) in the current image
+   * @param inlier_mask: correspondences to test, e.g. from estimate
+   * @param R: output rotation, X_prev = R * X_curr + t
+   * @param t: output unit translation
+   * @return size_t: number of inliers in front of both cameras
+   */
+  static size_t recover_pose(const Eigen::Matrix3d& E,
+                             const std::vector<Eigen::Vector3d>& points_prev,
+                             const std::vector<Eigen::Vector3d>& points_curr,
+                             const std::vector<unsigned char>& inlier_mask,
+                             Eigen::Matrix3d& R, Eigen::Vector3d& t);
+
+  /**
+   * @brief Function to flag the correspondences whose Sampson error is below
+   * the threshold, with the kernel estimate dispatches to or with the scalar
+   * one, e.g. to check the two against each other
+   *
+   * @param E
+   * @param points_prev: normalized image points (z = 1) in the previous image
+   * @param points_curr: normalized image points (z = 1) in the current image
+   * @param threshold: Sampson error threshold in normalized units
+   * @param vectorized: false for the scalar kernel. Without AVX2 both are the
+   * scalar one.
+   * @param inlier_mask: output inlier flag of every correspondence
+   * @return size_t: number of inliers
+   */
+  static size_t sampson_inliers(const Eigen::Matrix3d& E,
+                                const std::vector<Eigen::Vector3d>& points_prev,
+                                const std::vector<Eigen::Vector3d>& points_curr,
+                                double threshold, bool vectorized,
+                                std::vector<unsigned char>& inlier_mask);
+
+  /**
+   * @brief Function to enable or disable the SPRT early rejection
+   *
+   * @param enabled
+   */
+  void set_sprt(bool enabled);
+
+  /**
+   * @brief Function to get the number of samples the last call drew
+   *
+   * @return int
+   */
+  int get_last_iterations() const;
+
+  /**
+   * @brief Function to get the number of hypotheses the SPRT rejected in the
+   * last call
+   *
+   * @return int
+   */
+  int get_last_rejected() const;
+};
+
+}  // namespace vo
@@ -0,0 +1,149 @@
+/**
+ * @file track_store.cpp
+ * @author Apoorv Thapliyal
+ * @brief C++ source file for the feature track store
+ * @version 0.1
+ * @date 2024-11-08
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "track_store.hpp"
+
+#include <algorithm>
+
+/**
+ * @brief Function to drop all tracks while keeping the buffers allocated
+ *
+ */
+void vo::TrackFrame::clear() {
+  points.clear();
+  ids.clear();
+  ages.clear();
+  inliers.clear();
+
+  // The descriptor matrix is left allocated: the next extraction overwrites
+  // it in place when the feature count is unchanged
+}
+
+/**
+ * @brief Construct a new vo::Track Store::Track Store object
+ *
+ * @param history_length
+ */
+vo::TrackStore::TrackStore(size_t history_length)
+    : frames(std::max<size_t>(2, history_length)),
+      head(0),
+      stored(0),
+      next_id(0) {}
+
+/**
+ * @brief Function to start a new current frame
+ *
+ */
+void vo::TrackStore::advance() {
+  head = (head + 1) % frames.size();
+  frames[head].clear();
+  stored = std::min(stored + 1, frames.size());
+}
+
+/**
+ * @brief Function to drop all frames and restart track ids
+ *
+ */
+void vo::TrackStore::reset() {
+  for (TrackFrame& track_frame : frames) track_frame.clear();
+  head = 0;
+  stored = 0;
+  next_id = 0;
+}
+
+/**
+ * @brief Function to get the current frame
+ *
+ * @return vo::TrackFrame&
+ */
+vo::TrackFrame& vo::TrackStore::current() { return frames[head]; }
+
+/**
+ * @brief Function to get the current frame
+ *
+ * @return const vo::TrackFrame&
+ */
+const vo::TrackFrame& vo::TrackStore::current() const { return frames[head]; }
+
+/**
+ * @brief Function to get the previous frame
+ *
+ * @return vo::TrackFrame&
+ */
+vo::TrackFrame& vo::TrackStore::previous() {
+  return frames[(head + frames.size() - 1) % frames.size()];
+}
+
+/**
+ * @brief Function to get the previous frame
+ *
+ * @return const vo::TrackFrame&
+ */
+const vo::TrackFrame& vo::TrackStore::previous() const { return frame(1); }
+
+/**
+ * @brief Function to get a frame by age
+ *
+ * @param age
+ * @return const vo::TrackFrame&
+ */
+const vo::TrackFrame& vo::TrackStore::frame(size_t age) const {
+  age = std::min(age, frames.size() - 1);
+  return frames[(head + frames.size() - age) % frames.size()];
+}
+
+/**
+ * @brief Function to get the number of frames held
+ *
+ * @return size_t
+ */
+size_t vo::TrackStore::frames_stored() const { return stored; }
+
+/**
+ * @brief Function to get the number of frames the ring can hold
+ *
+ * @return size_t
+ */
+size_t vo::TrackStore::history_length() const { return frames.size(); }
+
+/**
+ * @brief Function to start a new track in the current frame
+ *
+ * @param point
+ * @return size_t
+ */
+size_t vo::TrackStore::add_track(const cv::Point2f& point) {
+  TrackFrame& track_frame = current();
+  track_frame.points.push_back(point);
+  track_frame.ids.push_back(next_id++);
+  track_frame.ages.push_back(0);
+  track_frame.inliers.push_back(0);
+  return track_frame.size() - 1;
+}
+
+/**
+ * @brief Function to continue a track of the previous frame in the current
+ * frame
+ *
+ * @param previous_index
+ * @param point
+ * @return size_t
+ */
+size_t vo::TrackStore::continue_track(size_t previous_index,
+                                      const cv::Point2f& point) {
+  const TrackFrame& previous_frame = previous();
+  TrackFrame& track_frame = current();
+  track_frame.points.push_back(point);
+  track_frame.ids.push_back(previous_frame.ids[previous_index]);
+  track_frame.ages.push_back(previous_frame.ages[previous_index] + 1);
+  track_frame.inliers.push_back(0);
+  return track_frame.size() - 1;
+}
@@ -0,0 +1,194 @@
+/**
+ * @file track_store.hpp
+ * @author Apoorv Thapliyal
+ * @brief C++ header file for the feature track store
+ * @version 0.1
+ * @date 2024-11-08
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <opencv2/core.hpp>
+#include <vector>
+
+namespace vo {
+
+/**
+ * @brief Feature tracks observed in one frame, stored as one contiguous
+ * buffer per field. Entry i of every buffer belongs to the same track.
+ *
+ */
+struct TrackFrame {
+  /**
+   * @brief Pixel position of every track
+   *
+   */
+  std::vector<cv::Point2f> points;
+
+  /**
+   * @brief Descriptor of every track, one CV_8U row each. Empty for
+   * front-ends that do not describe features.
+   *
+   */
+  cv::Mat descriptors;
+
+  /**
+   * @brief Persistent id of every track
+   *
+   */
+  std::vector<uint64_t> ids;
+
+  /**
+   * @brief Number of frames every track has been followed for
+   *
+   */
+  std::vector<uint32_t> ages;
+
+  /**
+   * @brief Whether every track was a pose estimation inlier in this frame
+   *
+   */
+  std::vector<uint8_t> inliers;
+
+  /**
+   * @brief Function to get the number of tracks in the frame
+   *
+   * @return size_t
+   */
+  size_t size() const { return ids.size(); }
+
+  /**
+   * @brief Function to drop all tracks while keeping the buffers allocated.
+   * The descriptor matrix keeps its old rows until it is next written.
+   *
+   */
+  void clear();
+};
+
+/**
+ * @brief Ring of per-frame track buffers. Advancing to a new frame rotates
+ * the ring instead of copying, and recycles the oldest frame's buffers.
+ *
+ */
+class TrackStore {
+ private:
+  /**
+   * @brief Per-frame buffers, used as a ring
+   *
+   */
+  std::vector<TrackFrame> frames;
+
+  /**
+   * @brief Ring index of the current frame
+   *
+   */
+  size_t head;
+
+  /**
+   * @brief Number of frames stored so far, capped at the ring size
+   *
+   */
+  size_t stored;
+
+  /**
+   * @brief Id handed to the next new track
+   *
+   */
+  uint64_t next_id;
+
+ public:
+  /**
+   * @brief Construct a new Track Store object
+   *
+   * @param history_length: number of frames kept, at least 2
+   */
+  explicit TrackStore(size_t history_length = 2);
+
+  /**
+   * @brief Function to start a new current frame. The previous current frame
+   * becomes frame 1 and the oldest frame's buffers are cleared for reuse.
+   *
+   */
+  void advance();
+
+  /**
+   * @brief Function to drop all frames and restart track ids
+   *
+   */
+  void reset();
+
+  /**
+   * @brief Function to get the current frame
+   *
+   * @return TrackFrame&
+   */
+  TrackFrame& current();
+
+  /**
+   * @brief Function to get the current frame
+   *
+   * @return const TrackFrame&
+   */
+  const TrackFrame& current() const;
+
+  /**
+   * @brief Function to get the previous frame
+   *
+   * @return TrackFrame&
+   */
+  TrackFrame& previous();
+
+  /**
+   * @brief Function to get the previous frame
+   *
+   * @return const TrackFrame&
+   */
+  const TrackFrame& previous() const;
+
+  /**
+   * @brief Function to get a frame by age
+   *
+   * @param age: 0 for the current frame, 1 for the previous one, ...
+   * @return const TrackFrame&
+   */
+  const TrackFrame& frame(size_t age) const;
+
+  /**
+   * @brief Function to get the number of frames held, at most the history
+   * length
+   *
+   * @return size_t
+   */
+  size_t frames_stored() const;
+
+  /**
+   * @brief Function to get the number of frames the ring can hold
+   *
+   * @return size_t
+   */
+  size_t history_length() const;
+
+  /**
+   * @brief Function to start a new track in the current frame
+   *
+   * @param point: pixel position
+   * @return size_t: index of the track in the current frame
+   */
+  size_t add_track(const cv::Point2f& point);
+
+  /**
+   * @brief Function to continue a track of the previous frame in the current
+   * frame
+   *
+   * @param previous_index: index of the track in the previous frame
+   * @param point: pixel position in the current frame
+   * @return size_t: index of the track in the current frame
+   */
+  size_t continue_track(size_t previous_index, const cv::Point2f& point);
+};
+
+}  // namespace vo
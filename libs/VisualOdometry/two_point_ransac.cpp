@@ -0,0 +1,144 @@
+/**
+ * @file two_point_ransac.cpp
+ * @author Apoorv Thapliyal
+ * @brief C++ source file for the rotation-aided translation RANSAC
+ * @version 0.1
+ * @date 2024-11-20
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "two_point_ransac.hpp"
+
+#include <cmath>
+
+/**
+ * @brief Construct a new vo::Two Point Ransac::Two Point Ransac object
+ *
+ * @param ransac_confidence
+ * @param ransac_max_iterations
+ */
+vo::TwoPointRansac::TwoPointRansac(double ransac_confidence,
+                                   int ransac_max_iterations)
+    : confidence(ransac_confidence),
+      max_iterations(ransac_max_iterations),
+      generator(42) {}
+
+/**
+ * @brief Function to compute the Sampson error of a correspondence
+ *
+ * @param E
+ * @param f_prev
+ * @param f_curr
+ * @return double
+ */
+double vo::TwoPointRansac::sampson_error(const Eigen::Matrix3d& E,
+                                         const Eigen::Vector3d& f_prev,
+                                         const Eigen::Vector3d& f_curr) {
+  Eigen::Vector3d Ef = E * f_curr;
+  Eigen::Vector3d Etf = E.transpose() * f_prev;
+  double epipolar = f_prev.dot(Ef);
+  double gradient = Ef(0) * Ef(0) + Ef(1) * Ef(1) + Etf(0) * Etf(0) +
+                    Etf(1) * Etf(1);
+  if (gradient <= 0.0) return 0.0;
+  return epipolar * epipolar / gradient;
+}
+
+/**
+ * @brief Function to estimate the translation direction
+ *
+ * @param points_prev
+ * @param points_curr
+ * @param R_prev_curr
+ * @param threshold
+ * @param t
+ * @param inlier_mask
+ * @return size_t
+ */
+size_t vo::TwoPointRansac::estimate(
+    const std::vector<Eigen::Vector3d>& points_prev,
+    const std::vector<Eigen::Vector3d>& points_curr,
+    const Eigen::Matrix3d& R_prev_curr, double threshold, Eigen::Vector3d& t,
+    std::vector<unsigned char>& inlier_mask) {
+  const size_t count = points_curr.size();
+  last_iterations = 0;
+  inlier_mask.assign(count, 0);
+  if (count < 2 || points_prev.size() != count) return 0;
+
+  // f_prev^T [t]x R f_curr = 0 is t . ((R f_curr) x f_prev) = 0
+  normals.resize(count);
+  for (size_t i = 0; i < count; i++)
+    normals[i] = (R_prev_curr * points_curr[i]).cross(points_prev[i]);
+
+  const double threshold_sq = threshold * threshold;
+  std::uniform_int_distribution<size_t> pick(0, count - 1);
+  size_t best_inliers = 0;
+  Eigen::Vector3d best_t = Eigen::Vector3d::Zero();
+  int required = max_iterations;
+
+  for (int iteration = 0; iteration < required; iteration++) {
+    last_iterations++;
+
+    size_t a = pick(generator), b = pick(generator);
+    if (a == b) continue;
+
+    // t is orthogonal to both constraint normals
+    Eigen::Vector3d hypothesis = normals[a].cross(normals[b]);
+    double norm = hypothesis.norm();
+    if (norm < 1e-12) continue;
+    hypothesis /= norm;
+
+    Eigen::Matrix3d E;
+    E << 0.0, -hypothesis(2), hypothesis(1), hypothesis(2), 0.0,
+        -hypothesis(0), -hypothesis(1), hypothesis(0), 0.0;
+    E = E * R_prev_curr;
+
+    size_t inliers = 0;
+    for (size_t i = 0; i < count; i++)
+      if (sampson_error(E, points_prev[i], points_curr[i]) < threshold_sq)
+        inliers++;
+
+    if (inliers > best_inliers) {
+      best_inliers = inliers;
+      best_t = hypothesis;
+
+      // Stop as soon as an outlier-free sample is likely to have been drawn
+      double inlier_ratio = static_cast<double>(inliers) / count;
+      double outlier_free = inlier_ratio * inlier_ratio;
+      if (outlier_free >= 1.0) break;
+      double needed =
+          std::log(1.0 - confidence) / std::log(1.0 - outlier_free);
+      if (needed < required) required = static_cast<int>(std::ceil(needed));
+    }
+  }
+
+  if (best_inliers < 2) return 0;
+
+  // Refine on all inliers: t is the normal direction least constrained by
+  // the inlier normals
+  Eigen::Matrix3d E;
+  E << 0.0, -best_t(2), best_t(1), best_t(2), 0.0, -best_t(0), -best_t(1),
+      best_t(0), 0.0;
+  E = E * R_prev_curr;
+  Eigen::Matrix3d scatter = Eigen::Matrix3d::Zero();
+  for (size_t i = 0; i < count; i++) {
+    if (sampson_error(E, points_prev[i], points_curr[i]) >= threshold_sq)
+      continue;
+    inlier_mask[i] = 1;
+    scatter += normals[i] * normals[i].transpose();
+  }
+
+  Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver(scatter);
+  t = solver.eigenvectors().col(0);
+  if (t.dot(best_t) < 0.0) t = -t;
+
+  return best_inliers;
+}
+
+/**
+ * @brief Function to get the number of hypotheses the last call evaluated
+ *
+ * @return int
+ */
+int vo::TwoPointRansac::get_last_iterations() const { return last_iterations; }
@@ -0,0 +1,107 @@
+/**
+ * @file two_point_ransac.hpp
+ * @author Apoorv Thapliyal
+ * @brief C++ header file for the rotation-aided translation RANSAC
+ * @version 0.1
+ * @date 2024-11-20
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <eigen3/Eigen/Core>
+#include <eigen3/Eigen/Dense>
+#include <random>
+#include <vector>
+
+namespace vo {
+
+/**
+ * @brief RANSAC over the translation direction for a known relative rotation.
+ * With X_prev = R * X_curr + t fixed up to t, every correspondence gives one
+ * linear constraint on t, so two points form a minimal sample instead of the
+ * five the essential matrix needs.
+ *
+ */
+class TwoPointRansac {
+ private:
+  /**
+   * @brief Probability that at least one sample is outlier free
+   *
+   */
+  double confidence;
+
+  /**
+   * @brief Upper bound on the number of hypotheses
+   *
+   */
+  int max_iterations;
+
+  /**
+   * @brief Hypotheses evaluated by the last estimate call
+   *
+   */
+  int last_iterations = 0;
+
+  /**
+   * @brief Random generator for the samples, seeded for repeatable runs
+   *
+   */
+  std::mt19937 generator;
+
+  /**
+   * @brief Scratch constraint normals (R * f_curr) x f_prev
+   *
+   */
+  std::vector<Eigen::Vector3d> normals;
+
+  /**
+   * @brief Function to compute the Sampson error of a correspondence
+   *
+   * @param E: essential matrix [t]x R
+   * @param f_prev: normalized point in the previous image
+   * @param f_curr: normalized point in the current image
+   * @return double
+   */
+  static double sampson_error(const Eigen::Matrix3d& E,
+                              const Eigen::Vector3d& f_prev,
+                              const Eigen::Vector3d& f_curr);
+
+ public:
+  /**
+   * @brief Construct a new Two Point Ransac object
+   *
+   * @param ransac_confidence
+   * @param ransac_max_iterations
+   */
+  TwoPointRansac(double ransac_confidence = 0.999,
+                 int ransac_max_iterations = 1000);
+
+  /**
+   * @brief Function to estimate the translation direction
+   *
+   * @param points_prev: normalized image points (z = 1) in the previous image
+   * @param points_curr: normalized image points (z = 1) in the current image
+   * @param R_prev_curr: known rotation, X_prev = R * X_curr + t
+   * @param threshold: Sampson error threshold in normalized units, e.g.
+   * pixels divided by the focal length
+   * @param t: output unit translation, sign not resolved
+   * @param inlier_mask: output inlier flag of every correspondence
+   * @return size_t: number of inliers, 0 if no hypothesis was found
+   */
+  size_t estimate(const std::vector<Eigen::Vector3d>& points_prev,
+                  const std::vector<Eigen::Vector3d>& points_curr,
+                  const Eigen::Matrix3d& R_prev_curr, double threshold,
+                  Eigen::Vector3d& t, std::vector<unsigned char>& inlier_mask);
+
+  /**
+   * @brief Function to get the number of hypotheses the last call evaluated
+   *
+   * @return int
+   */
+  int get_last_iterations() const;
+};
+
+}  // namespace vo
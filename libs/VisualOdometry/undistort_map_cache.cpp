@@ -0,0 +1,108 @@
+/**
+ * @file undistort_map_cache.cpp
+ * @author Apoorv Thapliyal
+ * @brief C++ source file for the undistortion lookup-map cache
+ * @version 0.1
+ * @date 2024-11-02
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "undistort_map_cache.hpp"
+
+/**
+ * @brief Function to flatten a camera configuration into a cache key
+ *
+ * @param camera_intrinsics
+ * @param distortion_coefficients
+ * @param new_camera_matrix
+ * @param image_size
+ * @return std::vector<double>
+ */
+std::vector<double> vo::UndistortMapCache::make_key(
+    const cv::Mat& camera_intrinsics, const cv::Mat& distortion_coefficients,
+    const cv::Mat& new_camera_matrix, cv::Size image_size) {
+  std::vector<double> key;
+  key.reserve(camera_intrinsics.total() + distortion_coefficients.total() +
+              new_camera_matrix.total() + 2);
+
+  // Matrices are stored as CV_64F throughout the VO code
+  cv::Mat params[] = {camera_intrinsics, distortion_coefficients,
+                      new_camera_matrix};
+  for (const cv::Mat& param : params) {
+    cv::Mat param_64f;
+    param.convertTo(param_64f, CV_64F);
+    for (int i = 0; i < param_64f.rows; i++)
+      for (int j = 0; j < param_64f.cols; j++)
+        key.push_back(param_64f.at<double>(i, j));
+  }
+
+  key.push_back(image_size.width);
+  key.push_back(image_size.height);
+
+  return key;
+}
+
+/**
+ * @brief Get the shared cache instance
+ *
+ * @return vo::UndistortMapCache&
+ */
+vo::UndistortMapCache& vo::UndistortMapCache::instance() {
+  static UndistortMapCache cache;
+  return cache;
+}
+
+/**
+ * @brief Function to get the maps for a camera configuration, building them
+ * on first use
+ *
+ * @param camera_intrinsics
+ * @param distortion_coefficients
+ * @param new_camera_matrix
+ * @param image_size
+ * @return std::shared_ptr<const vo::UndistortMaps>
+ */
+std::shared_ptr<const vo::UndistortMaps> vo::UndistortMapCache::get(
+    const cv::Mat& camera_intrinsics, const cv::Mat& distortion_coefficients,
+    const cv::Mat& new_camera_matrix, cv::Size image_size) {
+  std::vector<double> key = make_key(camera_intrinsics,
+                                     distortion_coefficients,
+                                     new_camera_matrix, image_size);
+
+  std::lock_guard<std::mutex> lock(cache_mutex);
+
+  auto it = maps.find(key);
+  if (it != maps.end()) return it->second;
+
+  // Build the maps in the same fixed-point form cv::undistort uses internally
+  auto undistort_maps = std::make_shared<UndistortMaps>();
+  cv::initUndistortRectifyMap(camera_intrinsics, distortion_coefficients,
+                              cv::Mat(), new_camera_matrix, image_size,
+                              CV_16SC2, undistort_maps->map1,
+                              undistort_maps->map2);
+  undistort_maps->image_size = image_size;
+
+  maps.emplace(key, undistort_maps);
+  return undistort_maps;
+}
+
+/**
+ * @brief Function to get the number of cached camera configurations
+ *
+ * @return size_t
+ */
+size_t vo::UndistortMapCache::size() const {
+  std::lock_guard<std::mutex> lock(cache_mutex);
+  return maps.size();
+}
+
+/**
+ * @brief Function to drop all cached maps
+ *
+ */
+void vo::UndistortMapCache::clear() {
+  std::lock_guard<std::mutex> lock(cache_mutex);
+  maps.clear();
+}
@@ -0,0 +1,110 @@
+/**
+ * @file undistort_map_cache.hpp
+ * @author Apoorv Thapliyal
+ * @brief C++ header file for the undistortion lookup-map cache
+ * @version 0.1
+ * @date 2024-11-02
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+namespace vo {
+
+/**
+ * @brief Precomputed undistort/rectify lookup maps in fixed-point form
+ *
+ */
+struct UndistortMaps {
+  /**
+   * @brief Integer pixel coordinates of the source pixel (CV_16SC2)
+   *
+   */
+  cv::Mat map1;
+
+  /**
+   * @brief Interpolation table indices (CV_16UC1)
+   *
+   */
+  cv::Mat map2;
+
+  /**
+   * @brief Size of the images the maps were built for
+   *
+   */
+  cv::Size image_size;
+};
+
+/**
+ * @brief Process-wide cache of undistortion maps, keyed by the camera
+ * intrinsics, distortion coefficients, target camera matrix and image size
+ *
+ */
+class UndistortMapCache {
+ private:
+  /**
+   * @brief Cached maps, keyed by the flattened camera configuration
+   *
+   */
+  std::map<std::vector<double>, std::shared_ptr<const UndistortMaps>> maps;
+
+  /**
+   * @brief Mutex guarding the cache
+   *
+   */
+  mutable std::mutex cache_mutex;
+
+  /**
+   * @brief Function to flatten a camera configuration into a cache key
+   *
+   */
+  static std::vector<double> make_key(const cv::Mat& camera_intrinsics,
+                                      const cv::Mat& distortion_coefficients,
+                                      const cv::Mat& new_camera_matrix,
+                                      cv::Size image_size);
+
+ public:
+  /**
+   * @brief Get the shared cache instance
+   *
+   * @return UndistortMapCache&
+   */
+  static UndistortMapCache& instance();
+
+  /**
+   * @brief Function to get the maps for a camera configuration, building
+   * them on first use
+   *
+   * @param camera_intrinsics: 3x3 camera matrix
+   * @param distortion_coefficients: distortion coefficients
+   * @param new_camera_matrix: camera matrix of the undistorted image
+   * @param image_size: size of the images to undistort
+   * @return std::shared_ptr<const UndistortMaps>
+   */
+  std::shared_ptr<const UndistortMaps> get(
+      const cv::Mat& camera_intrinsics, const cv::Mat& distortion_coefficients,
+      const cv::Mat& new_camera_matrix, cv::Size image_size);
+
+  /**
+   * @brief Function to get the number of cached camera configurations
+   *
+   * @return size_t
+   */
+  size_t size() const;
+
+  /**
+   * @brief Function to drop all cached maps
+   *
+   */
+  void clear();
+};
+
+}  // namespace vo
@@ -9,8 +9,13 @@
  *
  */
 
+#include <algorithm>
+#include <cmath>
+
 #include "visual_odometry.hpp"
 
+#include "tracer.hpp"
+
 /**
  * @brief Construct a new vo::Visual Odometry::Visual Odometry object
  *
@@ -39,11 +44,19 @@ vo::VisualOdometry::VisualOdometry(Eigen::Matrix4d initial_pose) {
   image_width = 346;
   image_height = 260;
 
+  // Initialize the guided matcher's grid over the image
+  guided_matcher = GuidedMatcher(image_width, image_height);
+
   // Initialize optimal camera matrix
   new_camera_matrix =
       cv::getOptimalNewCameraMatrix(camera_intrinsics, distortion_coefficients,
                                     cv::Size(image_width, image_height), 1,
                                     cv::Size(image_width, image_height), 0);
+
+  // Build the undistortion maps once, so each frame only needs a remap
+  undistort_maps = UndistortMapCache::instance().get(
+      camera_intrinsics, distortion_coefficients, new_camera_matrix,
+      cv::Size(image_width, image_height));
 }
 
 /**
@@ -61,65 +74,355 @@ vo::VisualOdometry::~VisualOdometry() {
 Eigen::Matrix4d vo::VisualOdometry::get_pose() { return vo_pose; }
 
 /**
- * @brief Function to update the pose using visual odometry
+ * @brief Function to get the camera matrix of the undistorted image
+ *
+ * @return const cv::Mat&
+ */
+const cv::Mat& vo::VisualOdometry::get_camera_matrix() const {
+  return new_camera_matrix;
+}
+
+/**
+ * @brief Function to set how lens distortion is removed
+ *
+ * @param mode
+ */
+void vo::VisualOdometry::set_undistortion_mode(UndistortionMode mode) {
+  undistortion_mode = mode;
+}
+
+/**
+ * @brief Function to get how lens distortion is removed
+ *
+ * @return vo::UndistortionMode
+ */
+vo::UndistortionMode vo::VisualOdometry::get_undistortion_mode() const {
+  return undistortion_mode;
+}
+
+/**
+ * @brief Function to choose the search structure of the descriptor matcher
+ *
+ * @param index
+ */
+void vo::VisualOdometry::set_matcher_index(MatcherIndex index) {
+  binary_matcher.set_index(index);
+}
+
+/**
+ * @brief Function to enable or disable guided matching
+ *
+ * @param enabled
+ * @param search_radius
+ */
+void vo::VisualOdometry::set_guided_matching(bool enabled,
+                                             float search_radius) {
+  guided_matching = enabled;
+  guided_matcher.set_search_radius(search_radius);
+}
+
+/**
+ * @brief Function to supply the rotation of the next frame relative to the
+ * current one
+ *
+ * @param R_prev_curr
+ */
+void vo::VisualOdometry::set_rotation_prior(
+    const Eigen::Matrix3d& R_prev_curr) {
+  rotation_prior = R_prev_curr;
+  has_rotation_prior = true;
+}
+
+/**
+ * @brief Function to enable or disable rotation-aided RANSAC
+ *
+ * @param enabled
+ */
+void vo::VisualOdometry::set_prior_ransac(bool enabled) {
+  prior_ransac = enabled;
+}
+
+/**
+ * @brief Function to get the number of RANSAC hypotheses evaluated for the
+ * last frame pair
+ *
+ * @return int
+ */
+int vo::VisualOdometry::get_last_ransac_iterations() const {
+  return last_ransac_iterations;
+}
+
+/**
+ * @brief Function to get the number of points the last motion prediction
+ * left at their previous position
+ *
+ * @return size_t
+ */
+size_t vo::VisualOdometry::get_last_unpredicted_points() const {
+  return last_unpredicted_points;
+}
+
+/**
+ * @brief Function to check if the last guided matching fell back to global
+ * matching
+ *
+ * @return true if global matching was used after guided matching
+ */
+bool vo::VisualOdometry::get_last_guided_fallback() const {
+  return last_guided_fallback;
+}
+
+/**
+ * @brief Function to choose the estimator of the relative motion
+ *
+ * @param solver
+ */
+void vo::VisualOdometry::set_motion_solver(MotionSolver solver) {
+  motion_solver = solver;
+}
+
+/**
+ * @brief Function to get the estimator of the relative motion
+ *
+ * @return vo::MotionSolver
+ */
+vo::MotionSolver vo::VisualOdometry::get_motion_solver() const {
+  return motion_solver;
+}
+
+/**
+ * @brief Function to set the number of ORB features extracted per frame
+ *
+ * @param max_features
+ */
+void vo::VisualOdometry::set_max_features(int max_features) {
+  orb_descriptor->setMaxFeatures(max_features);
+}
+
+/**
+ * @brief Function to prepare an input image for feature extraction
  *
  * @param image
+ * @param processed_image
  */
-void vo::VisualOdometry::update_pose(cv::Mat image) {
-  // Undistort the image
-  cv::Mat undistorted_image;
-  cv::undistort(image, undistorted_image, camera_intrinsics,
-                distortion_coefficients, new_camera_matrix);
+void vo::VisualOdometry::preprocess_image(const cv::Mat& image,
+                                          cv::Mat& processed_image) const {
+  if (undistortion_mode == UndistortionMode::kFullImage) {
+    // Undistort the image using the precomputed maps
+    cv::remap(image, processed_image, undistort_maps->map1,
+              undistort_maps->map2, cv::INTER_LINEAR, cv::BORDER_CONSTANT);
+  } else if (image.channels() == 3) {
+    // Features are extracted on the raw grayscale frame
+    cv::cvtColor(image, processed_image, cv::COLOR_BGR2GRAY);
+  } else {
+    processed_image = image;
+  }
+}
 
-  // Get keypoints and descriptors for the current image
-  orb_descriptor->detectAndCompute(undistorted_image, cv::noArray(), kp_curr,
-                                   des_curr);
+/**
+ * @brief Function to undistort keypoint coordinates in place
+ *
+ * @param points
+ */
+void vo::VisualOdometry::undistort_points(
+    std::vector<cv::Point2f>& points) const {
+  if (points.empty()) return;
+  PF_TRACE_SCOPE("vo.undistort_points");
 
-  if (kp_prev.size() == 0) {
-    kp_prev = kp_curr;
-    des_prev = des_curr;
-    return;
+  // Map onto the same camera matrix the full-image path remaps to, so both
+  // modes hand identical coordinates to the pose estimation
+  cv::undistortPoints(points, points, camera_intrinsics,
+                      distortion_coefficients, cv::noArray(),
+                      new_camera_matrix);
+}
+
+/**
+ * @brief Function to predict where points of the previous image appear in the
+ * current image
+ *
+ * @param points
+ * @return std::vector<cv::Point2f>
+ */
+std::vector<cv::Point2f> vo::VisualOdometry::predict_points(
+    const std::vector<cv::Point2f>& points) {
+  // Use the gyro rotation when available, otherwise assume the last relative
+  // rotation repeats. Translation is left to the search window.
+  const Eigen::Matrix3d& R =
+      has_rotation_prior ? rotation_prior : last_relative_rotation;
+
+  // Points live in the remapped image in full-image mode and in the raw
+  // image otherwise
+  const cv::Mat& K_cv = undistortion_mode == UndistortionMode::kFullImage
+                            ? new_camera_matrix
+                            : camera_intrinsics;
+  Eigen::Matrix3d K;
+  for (int i = 0; i < 3; i++)
+    for (int j = 0; j < 3; j++) K(i, j) = K_cv.at<double>(i, j);
+
+  // Infinite homography mapping previous pixels into the current image
+  Eigen::Matrix3d H = K * R.transpose() * K.inverse();
+
+  // A bad prior can rotate rays behind the camera or parallel to the image
+  // plane; those points are searched around where they were
+  std::vector<cv::Point2f> predicted;
+  predicted.reserve(points.size());
+  last_unpredicted_points = 0;
+  for (const cv::Point2f& point : points) {
+    Eigen::Vector3d p = H * Eigen::Vector3d(point.x, point.y, 1.0);
+    cv::Point2f prediction(static_cast<float>(p(0) / p(2)),
+                           static_cast<float>(p(1) / p(2)));
+    if (!(p(2) > 0.0) || !std::isfinite(prediction.x) ||
+        !std::isfinite(prediction.y)) {
+      prediction = point;
+      last_unpredicted_points++;
+    }
+    predicted.push_back(prediction);
   }
 
-  // Ensure descriptors are CV_32F before using FLANN matcher
-  if (des_prev.type() != CV_32F) des_prev.convertTo(des_prev, CV_32F);
-  if (des_curr.type() != CV_32F) des_curr.convertTo(des_curr, CV_32F);
+  return predicted;
+}
+
+/**
+ * @brief Function to match the previous and current descriptors and apply the
+ * ratio test
+ *
+ * @param keypoints
+ * @param good_matches
+ */
+void vo::VisualOdometry::match_features(
+    const std::vector<cv::KeyPoint>& keypoints,
+    std::vector<cv::DMatch>& good_matches) {
+  PF_TRACE_SCOPE("vo.match");
 
   // Prepare a vector to hold matches for each descriptor
   std::vector<std::vector<cv::DMatch>> matches;
 
-  // Perform KNN matching
-  flann_matcher.knnMatch(des_prev, des_curr, matches, 2);
+  good_matches.clear();
+  last_guided_fallback = false;
+  if (guided_matching) {
+    guided_matcher.knn_match(predict_points(tracks.previous().points),
+                             tracks.previous().descriptors, keypoints,
+                             tracks.current().descriptors, matches, 2);
+
+    // Find good matches using Lowe's ratio test. A lone candidate in the
+    // search window is accepted as unambiguous.
+    for (size_t i = 0; i < matches.size(); i++) {
+      if (matches[i].empty()) continue;
+      if (matches[i].size() < 2 ||
+          matches[i][0].distance < 0.78 * matches[i][1].distance)
+        good_matches.push_back(matches[i][0]);
+    }
+
+    if (good_matches.size() >= min_guided_matches) return;
+
+    // Too few matches near the prediction, fall back to global matching
+    good_matches.clear();
+    last_guided_fallback = true;
+  }
+
+  // Perform KNN matching on the native binary descriptors
+  binary_matcher.knn_match(tracks.previous().descriptors,
+                           tracks.current().descriptors, matches, 2);
 
   // Find good matches using Lowe's ratio test
-  std::vector<cv::DMatch> good_matches;
-  for (int i = 0; i < matches.size(); i++) {
+  for (size_t i = 0; i < matches.size(); i++) {
+    if (matches[i].size() < 2) continue;
     if (matches[i][0].distance < 0.78 * matches[i][1].distance)
       good_matches.push_back(matches[i][0]);
   }
+}
 
-  // Get matched keypoints
-  std::vector<cv::Point2f> matched_kp_prev, matched_kp_curr;
-  for (int i = 0; i < good_matches.size(); i++) {
-    matched_kp_prev.push_back(kp_prev[good_matches[i].queryIdx].pt);
-    matched_kp_curr.push_back(kp_curr[good_matches[i].trainIdx].pt);
-  }
-
-  // Calculate essential matrix
-  cv::Mat E = cv::findEssentialMat(matched_kp_curr, matched_kp_prev,
-                                   camera_intrinsics, cv::RANSAC, 0.999, 1.0);
+/**
+ * @brief Function to estimate the relative motion between matched points and
+ * update the pose
+ *
+ * @param points_prev
+ * @param points_curr
+ * @param inlier_mask
+ * @return true if the pose was updated
+ */
+bool vo::VisualOdometry::estimate_motion(
+    const std::vector<cv::Point2f>& points_prev,
+    const std::vector<cv::Point2f>& points_curr,
+    std::vector<uchar>& inlier_mask) {
+  // The five-point algorithm needs at least five correspondences
+  if (points_curr.size() < 5) return false;
+  PF_TRACE_SCOPE("vo.ransac");
 
-  // Recover pose from essential matrix
-  cv::Mat R, t;
-  cv::recoverPose(E, matched_kp_curr, matched_kp_prev, camera_intrinsics, R, t);
+  last_ransac_iterations = 0;
 
-  // Convert rotation matrix to Eigen matrix
   Eigen::Matrix3d R_eigen;
   Eigen::Vector3d t_eigen;
+  bool solved = false;
+
+  // Matched points are in the undistorted image of both undistortion modes,
+  // whose camera matrix is new_camera_matrix
+  const bool use_prior = prior_ransac && has_rotation_prior;
+  if (use_prior || motion_solver == MotionSolver::kFivePoint) {
+    const double fx = new_camera_matrix.at<double>(0, 0);
+    const double fy = new_camera_matrix.at<double>(1, 1);
+    const double cx = new_camera_matrix.at<double>(0, 2);
+    const double cy = new_camera_matrix.at<double>(1, 2);
+
+    // The in-house estimators work on normalized image coordinates
+    std::vector<Eigen::Vector3d> normalized_prev, normalized_curr;
+    normalized_prev.reserve(points_prev.size());
+    normalized_curr.reserve(points_curr.size());
+    for (size_t i = 0; i < points_curr.size(); i++) {
+      normalized_prev.emplace_back((points_prev[i].x - cx) / fx,
+                                   (points_prev[i].y - cy) / fy, 1.0);
+      normalized_curr.emplace_back((points_curr[i].x - cx) / fx,
+                                   (points_curr[i].y - cy) / fy, 1.0);
+    }
 
-  for (int i = 0; i < 3; i++) {
-    t_eigen(i) = t.at<double>(i);
-    for (int j = 0; j < 3; j++) R_eigen(i, j) = R.at<double>(i, j);
+    Eigen::Matrix3d E_eigen;
+    size_t inliers = 0;
+
+    // With a known rotation only the translation direction is unknown, which
+    // two points determine
+    if (use_prior) {
+      Eigen::Vector3d t_prior;
+      inliers = two_point_ransac.estimate(normalized_prev, normalized_curr,
+                                          rotation_prior, 1.0 / fx, t_prior,
+                                          inlier_mask);
+      last_ransac_iterations = two_point_ransac.get_last_iterations();
+
+      E_eigen << 0.0, -t_prior(2), t_prior(1), t_prior(2), 0.0, -t_prior(0),
+          -t_prior(1), t_prior(0), 0.0;
+      E_eigen = E_eigen * rotation_prior;
+    }
+
+    // Same minimum support as the five-point solver
+    if (inliers < 5 && motion_solver == MotionSolver::kFivePoint) {
+      inliers = five_point_ransac.estimate(normalized_prev, normalized_curr,
+                                           1.0 / fx, E_eigen, inlier_mask);
+      last_ransac_iterations += five_point_ransac.get_last_iterations();
+    }
+
+    // The cheirality check only triangulates the RANSAC inliers
+    if (inliers >= 5)
+      solved = FivePointRansac::recover_pose(E_eigen, normalized_prev,
+                                             normalized_curr, inlier_mask,
+                                             R_eigen, t_eigen) > 0;
+    if (!solved && motion_solver == MotionSolver::kFivePoint) return false;
+  }
+
+  if (!solved) {
+    // Calculate essential matrix
+    cv::Mat E = cv::findEssentialMat(points_curr, points_prev,
+                                     new_camera_matrix, cv::RANSAC, 0.999, 1.0,
+                                     inlier_mask);
+    if (E.rows != 3 || E.cols != 3) return false;
+
+    // Recover pose from essential matrix
+    cv::Mat R, t;
+    cv::recoverPose(E, points_curr, points_prev, new_camera_matrix, R, t);
+
+    // Convert rotation matrix to Eigen matrix
+    for (int i = 0; i < 3; i++) {
+      t_eigen(i) = t.at<double>(i);
+      for (int j = 0; j < 3; j++) R_eigen(i, j) = R.at<double>(i, j);
+    }
   }
 
   // Make a homogeneous transformation matrix
@@ -129,10 +432,622 @@ void vo::VisualOdometry::update_pose(cv::Mat image) {
 
   // Update the pose
   vo_pose = vo_pose * T;
+  last_relative_rotation = R_eigen;
+
+  return true;
+}
+
+/**
+ * @brief Function to choose the feature front-end
+ *
+ * @param new_front_end
+ */
+void vo::VisualOdometry::set_front_end(FrontEnd new_front_end) {
+  front_end = new_front_end;
+
+  tracks.reset();
+  prev_pyramid.clear();
+}
+
+/**
+ * @brief Function to get the feature front-end in use
+ *
+ * @return vo::FrontEnd
+ */
+vo::FrontEnd vo::VisualOdometry::get_front_end() const { return front_end; }
+
+/**
+ * @brief Function to set the KLT track budget
+ *
+ * @param min_tracks
+ * @param max_tracks
+ */
+void vo::VisualOdometry::set_klt_track_limits(size_t min_tracks,
+                                              int max_tracks) {
+  min_klt_tracks = min_tracks;
+  max_klt_tracks = max_tracks;
+}
+
+/**
+ * @brief Function to set the number of recent frames whose tracks are kept
+ *
+ * @param history_length
+ */
+void vo::VisualOdometry::set_track_history(size_t history_length) {
+  tracks = TrackStore(history_length);
+  prev_pyramid.clear();
+}
+
+/**
+ * @brief Function to access the feature tracks of the recent frames
+ *
+ * @return const vo::TrackStore&
+ */
+const vo::TrackStore& vo::VisualOdometry::get_tracks() const { return tracks; }
+
+/**
+ * @brief Function to only estimate the motion on keyframes
+ *
+ * @param enabled
+ * @param policy
+ */
+void vo::VisualOdometry::set_keyframe_selection(bool enabled,
+                                                const KeyframePolicy& policy) {
+  keyframe_selection = enabled;
+  keyframe_policy = policy;
+
+  // The next frame starts a new reference
+  keyframe_points.clear();
+  keyframe_timestamp = -1.0;
+  frames_since_keyframe = 0;
+  keyframe_rotation_prior.setIdentity();
+  keyframe_has_prior = true;
+  last_frame_keyframe = true;
+}
+
+/**
+ * @brief Function to check whether the last frame was a keyframe
+ *
+ * @return true if the last frame was a keyframe
+ */
+bool vo::VisualOdometry::is_keyframe() const { return last_frame_keyframe; }
+
+/**
+ * @brief Function to get the capture time of the current keyframe
+ *
+ * @return double
+ */
+double vo::VisualOdometry::get_keyframe_timestamp() const {
+  return keyframe_timestamp;
+}
+
+/**
+ * @brief Function to refine the keyframe poses with a local bundle adjustment
+ *
+ * @param enabled
+ * @param window_size
+ */
+void vo::VisualOdometry::set_local_ba(bool enabled, size_t window_size) {
+  local_ba_enabled = enabled;
+
+  // Down-weight reprojection errors beyond two pixels
+  local_ba = ba::SlidingWindowBa(
+      window_size, 2.0 / new_camera_matrix.at<double>(0, 0));
+
+  // Keyframes leaving the window keep constraining it through a prior
+  local_ba.set_marginalization(true);
+
+  // Keep the tracks of at least as many frames as the window spans
+  if (enabled && tracks.history_length() < window_size)
+    set_track_history(window_size);
+}
+
+/**
+ * @brief Function to get the local bundle adjustment
+ *
+ * @return const ba::SlidingWindowBa&
+ */
+const ba::SlidingWindowBa& vo::VisualOdometry::get_local_ba() const {
+  return local_ba;
+}
+
+/**
+ * @brief Function to add the current frame to the local bundle adjustment
+ * and take over its refined pose
+ *
+ */
+void vo::VisualOdometry::refine_pose() {
+  PF_TRACE_SCOPE("vo.local_ba");
+  const TrackFrame& current = tracks.current();
+
+  // RANSAC outliers stay out of the window, new tracks join it
+  std::vector<cv::Point2f> points;
+  std::vector<uint64_t> ids;
+  for (size_t i = 0; i < current.size(); i++) {
+    if (!current.inliers[i] && current.ages[i] > 0) continue;
+    points.push_back(current.points[i]);
+    ids.push_back(current.ids[i]);
+  }
+  if (undistortion_mode == UndistortionMode::kSparseKeypoints)
+    undistort_points(points);
+
+  // Tracked points live in the remapped camera in both modes
+  const double fx = new_camera_matrix.at<double>(0, 0);
+  const double fy = new_camera_matrix.at<double>(1, 1);
+  const double cx = new_camera_matrix.at<double>(0, 2);
+  const double cy = new_camera_matrix.at<double>(1, 2);
+  std::vector<Eigen::Vector3d> normalized;
+  normalized.reserve(points.size());
+  for (const cv::Point2f& point : points)
+    normalized.emplace_back((point.x - cx) / fx, (point.y - cy) / fy, 1.0);
+
+  if (local_ba.add_keyframe(vo_pose, ids, normalized) &&
+      local_ba.optimize() > 0)
+    vo_pose = local_ba.get_latest_pose();
+}
+
+/**
+ * @brief Function to search every keyframe for a loop
+ *
+ * @param enabled
+ * @param vocabulary
+ */
+void vo::VisualOdometry::set_loop_closure(
+    bool enabled, std::shared_ptr<const lc::Vocabulary> vocabulary) {
+  if (enabled && (!vocabulary || vocabulary->empty())) {
+    std::cerr << "Loop closure needs a trained vocabulary" << std::endl;
+    enabled = false;
+  }
+  loop_closure_enabled = enabled;
+
+  // Accept PnP inliers within two pixels
+  lc::LoopClosureConfig loop_config;
+  loop_config.reprojection_threshold =
+      2.0 / new_camera_matrix.at<double>(0, 0);
+  loop_closure = lc::LoopClosure(std::move(vocabulary), loop_config);
+  pose_graph.reset();
+}
+
+/**
+ * @brief Function to access the keyframes searched for loops
+ *
+ * @return const lc::LoopClosure&
+ */
+const lc::LoopClosure& vo::VisualOdometry::get_loop_closure() const {
+  return loop_closure;
+}
+
+/**
+ * @brief Function to access the pose graph of the loop closure keyframes
+ *
+ * @return const ba::PoseGraph&
+ */
+const ba::PoseGraph& vo::VisualOdometry::get_pose_graph() const {
+  return pose_graph;
+}
+
+/**
+ * @brief Function to search the earlier keyframes for the place of the
+ * current frame, add it to the pose graph, and correct the graph and the
+ * pose when it closes a loop
+ *
+ * @param features
+ */
+void vo::VisualOdometry::close_loop(const FrameFeatures& features) {
+  PF_TRACE_SCOPE("vo.loop_closure");
+
+  // The ORB front-end already described the tracked points, the KLT one only
+  // describes keyframes
+  std::vector<cv::Point2f> points;
+  cv::Mat descriptors;
+  if (front_end == FrontEnd::kKlt) {
+    std::vector<cv::KeyPoint> keypoints;
+    orb_descriptor->detectAndCompute(features.image, cv::noArray(), keypoints,
+                                     descriptors);
+    points.reserve(keypoints.size());
+    for (const cv::KeyPoint& keypoint : keypoints) points.push_back(keypoint.pt);
+  } else {
+    points = tracks.current().points;
+    descriptors = tracks.current().descriptors;
+  }
+  if (undistortion_mode == UndistortionMode::kSparseKeypoints)
+    undistort_points(points);
+
+  // Points live in the remapped camera in both modes
+  const double fx = new_camera_matrix.at<double>(0, 0);
+  const double fy = new_camera_matrix.at<double>(1, 1);
+  const double cx = new_camera_matrix.at<double>(0, 2);
+  const double cy = new_camera_matrix.at<double>(1, 2);
+  for (cv::Point2f& point : points)
+    point = cv::Point2f(static_cast<float>((point.x - cx) / fx),
+                        static_cast<float>((point.y - cy) / fy));
+
+  lc::LoopConstraint loop;
+  const bool found =
+      loop_closure.add_keyframe(vo_pose, points, descriptors, loop);
+  if (loop_closure.size() == pose_graph.size()) return;
+
+  // Odometry edge from the previous keyframe, measured before any correction
+  const size_t node = pose_graph.add_node(vo_pose);
+  if (node > 0)
+    pose_graph.add_edge(node - 1, node, last_node_pose.inverse() * vo_pose);
+  last_node_pose = vo_pose;
+  if (!found) return;
+
+  // PnP against a triangulated map is much tighter than the chain of
+  // odometry edges the loop spans, so the drift ends up spread over them.
+  // The map is triangulated at the scale of the old keyframes and the graph
+  // is in SE(3), so scale drift along the loop is not undone.
+  pose_graph.add_edge(
+      loop.match, loop.current,
+      loop_closure.get_pose(loop.match).inverse() * loop.pose,
+      1e3 * Eigen::Matrix<double, 6, 6>::Identity(), ba::EdgeType::kLoop);
+  pose_graph.update();
+
+  // Later loops are verified against the corrected keyframes
+  for (size_t k = 0; k < pose_graph.size(); k++)
+    loop_closure.set_pose(k, pose_graph.get_pose(k));
+  vo_pose = pose_graph.get_pose(node);
+  last_node_pose = vo_pose;
+
+  // The window was optimized around the drifted poses
+  if (local_ba_enabled) local_ba.reset();
+}
+
+/**
+ * @brief Function to decide whether the current frame is a keyframe and
+ * replace the frame-to-frame matches by matches against the last keyframe
+ *
+ * @param timestamp
+ * @param matched_prev
+ * @param matched_curr
+ * @param matched_tracks
+ * @return true if the frame is a keyframe
+ */
+bool vo::VisualOdometry::select_keyframe(
+    double timestamp, std::vector<cv::Point2f>& matched_prev,
+    std::vector<cv::Point2f>& matched_curr,
+    std::vector<size_t>& matched_tracks) {
+  matched_prev.clear();
+  matched_curr.clear();
+  matched_tracks.clear();
+
+  // Without a keyframe there is nothing to track against
+  if (keyframe_points.empty()) return true;
+
+  // Follow the tracks of the current frame back to the keyframe
+  const TrackFrame& current = tracks.current();
+  std::vector<double> displacements;
+  displacements.reserve(current.size());
+  for (size_t i = 0; i < current.size(); i++) {
+    auto it = keyframe_points.find(current.ids[i]);
+    if (it == keyframe_points.end()) continue;
+
+    matched_prev.push_back(it->second);
+    matched_curr.push_back(current.points[i]);
+    matched_tracks.push_back(i);
+    displacements.push_back(std::hypot(current.points[i].x - it->second.x,
+                                       current.points[i].y - it->second.y));
+  }
+
+  // Re-anchor before too few tracks are left to estimate the motion from
+  if (matched_curr.empty() ||
+      matched_curr.size() <
+          keyframe_policy.min_tracked_ratio * keyframe_points.size())
+    return true;
+
+  if (timestamp >= 0.0 && keyframe_timestamp >= 0.0 &&
+      timestamp - keyframe_timestamp >= keyframe_policy.max_interval)
+    return true;
+
+  // Small parallax makes the essential matrix degenerate, keep tracking
+  auto median = displacements.begin() + displacements.size() / 2;
+  std::nth_element(displacements.begin(), median, displacements.end());
+  return *median >= keyframe_policy.min_median_displacement;
+}
+
+/**
+ * @brief Function to make the current frame the keyframe
+ *
+ * @param timestamp
+ */
+void vo::VisualOdometry::set_keyframe(double timestamp) {
+  const TrackFrame& current = tracks.current();
+  keyframe_points.clear();
+  keyframe_points.reserve(current.size());
+  for (size_t i = 0; i < current.size(); i++)
+    keyframe_points.emplace(current.ids[i], current.points[i]);
+
+  keyframe_timestamp = timestamp;
+  frames_since_keyframe = 0;
+  keyframe_rotation_prior.setIdentity();
+  keyframe_has_prior = true;
+}
+
+/**
+ * @brief Function to run the ORB detect-and-match front-end on a frame
+ *
+ * @param features
+ * @param matched_prev
+ * @param matched_curr
+ * @param matched_tracks
+ * @return true if the frame had a predecessor to match against
+ */
+bool vo::VisualOdometry::process_orb(FrameFeatures& features,
+                                     std::vector<cv::Point2f>& matched_prev,
+                                     std::vector<cv::Point2f>& matched_curr,
+                                     std::vector<size_t>& matched_tracks) {
+  // Start a new frame; the previous frame's tracks move back without a copy
+  tracks.advance();
+  TrackFrame& current = tracks.current();
+
+  // Take over the extracted descriptors; the recycled frame's buffer goes
+  // back to the caller for the next extraction
+  std::swap(current.descriptors, features.descriptors);
+  const std::vector<cv::KeyPoint>& keypoints = features.keypoints;
+
+  const TrackFrame& previous = tracks.previous();
+  bool has_previous = tracks.frames_stored() > 1 && previous.size() > 0;
+
+  // Match previous and current features
+  std::vector<cv::DMatch> good_matches;
+  if (has_previous) match_features(keypoints, good_matches);
+
+  // Every keypoint continues the first track it matched, or starts a new one
+  std::vector<int> matched_previous(keypoints.size(), -1);
+  for (const cv::DMatch& match : good_matches)
+    if (matched_previous[match.trainIdx] < 0)
+      matched_previous[match.trainIdx] = match.queryIdx;
+
+  for (size_t i = 0; i < keypoints.size(); i++) {
+    if (matched_previous[i] >= 0)
+      tracks.continue_track(matched_previous[i], keypoints[i].pt);
+    else
+      tracks.add_track(keypoints[i].pt);
+  }
+
+  // Get matched keypoints
+  for (const cv::DMatch& match : good_matches) {
+    matched_prev.push_back(previous.points[match.queryIdx]);
+    matched_curr.push_back(current.points[match.trainIdx]);
+    matched_tracks.push_back(match.trainIdx);
+  }
+
+  return has_previous;
+}
+
+/**
+ * @brief Function to top up the current frame's tracks with Shi-Tomasi
+ * corners away from the existing tracks
+ *
+ * @param gray
+ */
+void vo::VisualOdometry::detect_klt_features(const cv::Mat& gray) {
+  const std::vector<cv::Point2f>& points = tracks.current().points;
+  int wanted = max_klt_tracks - static_cast<int>(points.size());
+  if (wanted <= 0) return;
+
+  // Mask out the neighbourhood of every existing track
+  cv::Mat mask(gray.size(), CV_8U, cv::Scalar(255));
+  for (const cv::Point2f& point : points)
+    cv::circle(mask, cv::Point(cvRound(point.x), cvRound(point.y)),
+               klt_min_distance, cv::Scalar(0), -1);
+
+  std::vector<cv::Point2f> corners;
+  cv::goodFeaturesToTrack(gray, corners, wanted, 0.01, klt_min_distance, mask);
+  for (const cv::Point2f& corner : corners) tracks.add_track(corner);
+}
+
+/**
+ * @brief Function to run the KLT tracking front-end on a frame
+ *
+ * @param features
+ * @param matched_prev
+ * @param matched_curr
+ * @param matched_tracks
+ * @return true if the frame had a predecessor to track from
+ */
+bool vo::VisualOdometry::process_klt(FrameFeatures& features,
+                                     std::vector<cv::Point2f>& matched_prev,
+                                     std::vector<cv::Point2f>& matched_curr,
+                                     std::vector<size_t>& matched_tracks) {
+  const cv::Mat& gray = features.image;
+
+  // Start a new frame; the previous frame's tracks move back without a copy
+  tracks.advance();
+  const TrackFrame& previous = tracks.previous();
+  bool tracked = !prev_pyramid.empty() && tracks.frames_stored() > 1 &&
+                 previous.size() > 0;
+
+  if (tracked) {
+    // Seed the search with the rotation prior when one was supplied
+    int flags = 0;
+    if (has_rotation_prior) {
+      klt_tracked_points = predict_points(previous.points);
+      flags = cv::OPTFLOW_USE_INITIAL_FLOW;
+    }
+
+    PF_TRACE_SCOPE("vo.klt_track");
+    std::vector<uchar> status;
+    std::vector<float> error;
+    cv::calcOpticalFlowPyrLK(
+        prev_pyramid, features.pyramid, previous.points, klt_tracked_points,
+        status, error, klt_window, klt_pyramid_levels,
+        cv::TermCriteria(cv::TermCriteria::COUNT | cv::TermCriteria::EPS, 30,
+                         0.01),
+        flags);
+
+    // Continue the tracks that converged inside the image
+    for (size_t i = 0; i < klt_tracked_points.size(); i++) {
+      const cv::Point2f& point = klt_tracked_points[i];
+      if (!status[i] || point.x < 0 || point.y < 0 ||
+          point.x >= gray.cols || point.y >= gray.rows)
+        continue;
+
+      matched_prev.push_back(previous.points[i]);
+      matched_curr.push_back(point);
+      matched_tracks.push_back(tracks.continue_track(i, point));
+    }
+  }
+
+  // Only re-detect when the surviving tracks run low
+  if (tracks.current().size() < min_klt_tracks) detect_klt_features(gray);
+
+  // The pyramid of this frame becomes the previous pyramid of the next frame,
+  // the old one goes back to the caller for reuse
+  std::swap(prev_pyramid, features.pyramid);
+
+  return tracked;
+}
+
+/**
+ * @brief Function to create an ORB detector with the same settings as the one
+ * used internally
+ *
+ * @return cv::Ptr<cv::ORB>
+ */
+cv::Ptr<cv::ORB> vo::VisualOdometry::create_feature_detector() const {
+  return cv::ORB::create(
+      orb_descriptor->getMaxFeatures(),
+      static_cast<float>(orb_descriptor->getScaleFactor()),
+      orb_descriptor->getNLevels(), orb_descriptor->getEdgeThreshold(),
+      orb_descriptor->getFirstLevel(), orb_descriptor->getWTA_K(),
+      orb_descriptor->getScoreType(), orb_descriptor->getPatchSize(),
+      orb_descriptor->getFastThreshold());
+}
+
+/**
+ * @brief Function to undistort an image and extract the features the
+ * configured front-end needs
+ *
+ * @param image
+ * @param detector
+ * @param features
+ */
+void vo::VisualOdometry::extract_features(const cv::Mat& image,
+                                          const cv::Ptr<cv::ORB>& detector,
+                                          FrameFeatures& features) const {
+  {
+    PF_TRACE_SCOPE("vo.undistort");
+    preprocess_image(image, features.image);
+  }
+
+  if (front_end == FrontEnd::kKlt) {
+    PF_TRACE_SCOPE("vo.klt_pyramid");
+    if (features.image.channels() == 3)
+      cv::cvtColor(features.image, features.image, cv::COLOR_BGR2GRAY);
+
+    features.keypoints.clear();
+    cv::buildOpticalFlowPyramid(features.image, features.pyramid, klt_window,
+                                klt_pyramid_levels);
+    return;
+  }
+
+  // Get keypoints and descriptors for the current image
+  PF_TRACE_SCOPE("vo.orb");
+  detector->detectAndCompute(features.image, cv::noArray(), features.keypoints,
+                             features.descriptors);
+}
+
+/**
+ * @brief Function to update the pose using visual odometry
+ *
+ * @param image
+ * @param timestamp
+ * @return true if the motion was estimated
+ */
+bool vo::VisualOdometry::update_pose(cv::Mat image, double timestamp) {
+  extract_features(image, orb_descriptor, frame_features);
+  frame_features.timestamp = timestamp;
+  return update_pose(frame_features);
+}
+
+/**
+ * @brief Function to update the pose from an already extracted frame
+ *
+ * @param features
+ * @return true if the motion was estimated
+ */
+bool vo::VisualOdometry::update_pose(FrameFeatures& features) {
+  PF_TRACE_SCOPE("vo.update_pose");
+
+  // Associate points between the previous and current frame
+  std::vector<cv::Point2f> matched_prev, matched_curr;
+  std::vector<size_t> matched_tracks;
+  bool has_previous =
+      front_end == FrontEnd::kKlt
+          ? process_klt(features, matched_prev, matched_curr, matched_tracks)
+          : process_orb(features, matched_prev, matched_curr, matched_tracks);
+  bool estimated = false;
+  bool keyframe_lost = false;
+  if (has_previous) PF_TRACE_COUNT("vo.matches", matched_curr.size());
+
+  if (keyframe_selection) {
+    // The rotation prior relates consecutive frames, chain it back to the
+    // keyframe
+    frames_since_keyframe++;
+    keyframe_has_prior = keyframe_has_prior && has_rotation_prior;
+    if (has_rotation_prior)
+      keyframe_rotation_prior = keyframe_rotation_prior * rotation_prior;
+
+    last_frame_keyframe = select_keyframe(features.timestamp, matched_prev,
+                                          matched_curr, matched_tracks);
+    keyframe_lost = matched_curr.empty();
+
+    // Frames between keyframes are only tracked
+    if (!last_frame_keyframe) {
+      has_rotation_prior = false;
+      return false;
+    }
+
+    rotation_prior = keyframe_rotation_prior;
+    has_rotation_prior = keyframe_has_prior;
+  }
+
+  if (has_previous) {
+    // Only the matched points need undistorting in sparse mode
+    if (undistortion_mode == UndistortionMode::kSparseKeypoints) {
+      undistort_points(matched_prev);
+      undistort_points(matched_curr);
+    }
+
+    // Flag the tracks that survived RANSAC
+    std::vector<uchar> inlier_mask;
+    estimated = estimate_motion(matched_prev, matched_curr, inlier_mask);
+    if (estimated) {
+      PF_TRACE_COUNT("vo.inliers", std::count(inlier_mask.begin(),
+                                              inlier_mask.end(), 1));
+      TrackFrame& current = tracks.current();
+      for (size_t i = 0; i < inlier_mask.size(); i++)
+        if (inlier_mask[i]) current.inliers[matched_tracks[i]] = 1;
+
+      // Predicting the next frame needs the rotation of a single frame
+      if (keyframe_selection && frames_since_keyframe > 1) {
+        Eigen::AngleAxisd rotation(last_relative_rotation);
+        rotation.angle() /= frames_since_keyframe;
+        last_relative_rotation = rotation.toRotationMatrix();
+      }
+    }
+  }
+
+  // The first frame anchors the window, later ones join once their motion is
+  // known
+  if (local_ba_enabled && (!has_previous || estimated)) refine_pose();
+
+  // Keyframes with a known pose are searched for loops
+  if (loop_closure_enabled && (!has_previous || estimated)) close_loop(features);
+
+  // Re-anchoring after a failed estimate would drop the motion since the
+  // keyframe, so the old keyframe is kept and tried again on the next frame.
+  // Only once none of its tracks is left can it no longer be matched.
+  if (keyframe_selection) {
+    if (!has_previous || estimated || keyframe_lost)
+      set_keyframe(features.timestamp);
+    else
+      last_frame_keyframe = false;
+  }
 
-  // Update previous keypoints and descriptors
-  kp_prev = kp_curr;
-  des_prev = des_curr;
+  has_rotation_prior = false;
 
-  return;
+  return estimated;
 }
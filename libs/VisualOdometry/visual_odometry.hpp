@@ -18,13 +18,143 @@
 #include <iostream>
 #include <opencv2/core.hpp>
 #include <opencv2/opencv.hpp>
+#include <unordered_map>
 #include <vector>
 
 #include "opencv2/core/mat.hpp"
+#include "binary_matcher.hpp"
+#include "feature_grid.hpp"
+#include "five_point_ransac.hpp"
+#include "loop_closure.hpp"
+#include "pose_graph.hpp"
+#include "sliding_window_ba.hpp"
 #include "opencv2/features2d.hpp"
+#include "track_store.hpp"
+#include "two_point_ransac.hpp"
+#include "undistort_map_cache.hpp"
 
 namespace vo {
 
+/**
+ * @brief How lens distortion is removed before pose estimation
+ *
+ */
+enum class UndistortionMode {
+  /**
+   * @brief Remap the whole image, then extract features on it
+   *
+   */
+  kFullImage,
+
+  /**
+   * @brief Extract features on the raw frame and undistort only the matched
+   * keypoint coordinates
+   *
+   */
+  kSparseKeypoints
+};
+
+/**
+ * @brief Feature front-end used to associate points between frames
+ *
+ */
+enum class FrontEnd {
+  /**
+   * @brief Detect and describe ORB features every frame and match them
+   *
+   */
+  kOrb,
+
+  /**
+   * @brief Track points with pyramidal Lucas-Kanade optical flow and only
+   * re-detect when too few tracks survive
+   *
+   */
+  kKlt
+};
+
+/**
+ * @brief Estimator of the relative motion between two frames
+ *
+ */
+enum class MotionSolver {
+  /**
+   * @brief OpenCV's findEssentialMat RANSAC followed by recoverPose
+   *
+   */
+  kOpenCv,
+
+  /**
+   * @brief In-house five-point RANSAC with SPRT early rejection and
+   * vectorized Sampson scoring; the cheirality check reuses its inlier mask
+   *
+   */
+  kFivePoint
+};
+
+/**
+ * @brief Per-frame output of the feature extraction stage, consumed by the
+ * pose estimation stage
+ *
+ */
+struct FrameFeatures {
+  /**
+   * @brief Processed image: undistorted, or raw grayscale in sparse mode
+   *
+   */
+  cv::Mat image;
+
+  /**
+   * @brief ORB keypoints (ORB front-end)
+   *
+   */
+  std::vector<cv::KeyPoint> keypoints;
+
+  /**
+   * @brief ORB descriptors, one row per keypoint (ORB front-end)
+   *
+   */
+  cv::Mat descriptors;
+
+  /**
+   * @brief Optical flow image pyramid (KLT front-end)
+   *
+   */
+  std::vector<cv::Mat> pyramid;
+
+  /**
+   * @brief Capture time in seconds, negative when unknown
+   *
+   */
+  double timestamp = -1.0;
+};
+
+/**
+ * @brief Thresholds deciding when a frame becomes a keyframe. Crossing any of
+ * them makes the frame a keyframe; the frames in between are only tracked.
+ *
+ */
+struct KeyframePolicy {
+  /**
+   * @brief Median displacement in pixels of the tracks since the last
+   * keyframe
+   *
+   */
+  double min_median_displacement = 15.0;
+
+  /**
+   * @brief Fraction of the last keyframe's tracks that must still be alive
+   *
+   */
+  double min_tracked_ratio = 0.6;
+
+  /**
+   * @brief Seconds since the last keyframe, ignored without timestamps
+   *
+   */
+  double max_interval = 0.5;
+};
+
 /**
  * @brief Visual Odometry class
  *
@@ -32,40 +162,245 @@ namespace vo {
 class VisualOdometry {
  private:
   /**
-   * @brief Current image keypoints
+   * @brief Scratch extraction output of the single-threaded update path
+   *
+   */
+  FrameFeatures frame_features;
+
+  /**
+   * @brief Feature tracks of the recent frames
    *
    */
-  std::vector<cv::KeyPoint> kp_curr;
+  TrackStore tracks;
 
   /**
-   * @brief Current image descriptors
+   * @brief Scratch buffer for the points tracked by the KLT front-end
    *
    */
-  cv::Mat des_curr;
+  std::vector<cv::Point2f> klt_tracked_points;
 
   /**
-   * @brief Previous image keypoints
+   * @brief Create ORB detector
    *
    */
-  std::vector<cv::KeyPoint> kp_prev;
+  cv::Ptr<cv::ORB> orb_descriptor = cv::ORB::create();
 
   /**
-   * @brief Previous image descriptors
+   * @brief Hamming-distance matcher for the ORB descriptors
    *
    */
-  cv::Mat des_prev;
+  BinaryMatcher binary_matcher;
 
   /**
-   * @brief Create ORB detector
+   * @brief Matcher restricted to a window around predicted keypoints
    *
    */
-  cv::Ptr<cv::ORB> orb_descriptor = cv::ORB::create();
+  GuidedMatcher guided_matcher;
+
+  /**
+   * @brief Flag to enable motion-predicted guided matching
+   *
+   */
+  bool guided_matching = false;
+
+  /**
+   * @brief Minimum number of guided matches before falling back to global
+   * matching
+   *
+   */
+  size_t min_guided_matches = 30;
+
+  /**
+   * @brief Points the last prediction left where they were, because the
+   * rotation took them behind the camera or to infinity
+   *
+   */
+  size_t last_unpredicted_points = 0;
+
+  /**
+   * @brief Flag set when the last guided matching found too few matches and
+   * fell back to global matching
+   *
+   */
+  bool last_guided_fallback = false;
+
+  /**
+   * @brief Feature front-end in use
+   *
+   */
+  FrontEnd front_end = FrontEnd::kOrb;
+
+  /**
+   * @brief Image pyramid of the previous frame for KLT tracking
+   *
+   */
+  std::vector<cv::Mat> prev_pyramid;
+
+  /**
+   * @brief Re-detect features when fewer KLT tracks than this survive
+   *
+   */
+  size_t min_klt_tracks = 150;
+
+  /**
+   * @brief Number of KLT tracks to top up to on re-detection
+   *
+   */
+  int max_klt_tracks = 300;
+
+  /**
+   * @brief Minimum distance between KLT tracks in pixels
+   *
+   */
+  int klt_min_distance = 10;
+
+  /**
+   * @brief KLT search window size
+   *
+   */
+  cv::Size klt_window = cv::Size(21, 21);
+
+  /**
+   * @brief Number of KLT pyramid levels above the base image
+   *
+   */
+  int klt_pyramid_levels = 3;
+
+  /**
+   * @brief Relative rotation estimated for the last frame pair
+   *
+   */
+  Eigen::Matrix3d last_relative_rotation = Eigen::Matrix3d::Identity();
+
+  /**
+   * @brief Externally supplied rotation for the next frame pair (e.g. gyro)
+   *
+   */
+  Eigen::Matrix3d rotation_prior = Eigen::Matrix3d::Identity();
+
+  /**
+   * @brief Flag to mark that rotation_prior is valid for the next frame
+   *
+   */
+  bool has_rotation_prior = false;
+
+  /**
+   * @brief Translation-only RANSAC used when a rotation prior is available
+   *
+   */
+  TwoPointRansac two_point_ransac;
+
+  /**
+   * @brief In-house essential matrix RANSAC
+   *
+   */
+  FivePointRansac five_point_ransac;
+
+  /**
+   * @brief Estimator of the relative motion
+   *
+   */
+  MotionSolver motion_solver = MotionSolver::kOpenCv;
+
+  /**
+   * @brief Flag to estimate only the translation when a rotation prior is
+   * supplied, instead of running the five-point RANSAC
+   *
+   */
+  bool prior_ransac = false;
+
+  /**
+   * @brief Hypotheses evaluated for the last frame pair
+   *
+   */
+  int last_ransac_iterations = 0;
+
+  /**
+   * @brief Flag to only estimate the motion on keyframes
+   *
+   */
+  bool keyframe_selection = false;
+
+  /**
+   * @brief Thresholds of the keyframe selection
+   *
+   */
+  KeyframePolicy keyframe_policy;
+
+  /**
+   * @brief Points of the last keyframe by track id
+   *
+   */
+  std::unordered_map<uint64_t, cv::Point2f> keyframe_points;
+
+  /**
+   * @brief Capture time of the last keyframe, negative when unknown
+   *
+   */
+  double keyframe_timestamp = -1.0;
+
+  /**
+   * @brief Frames tracked since the last keyframe
+   *
+   */
+  int frames_since_keyframe = 0;
+
+  /**
+   * @brief Rotation prior accumulated since the last keyframe
+   *
+   */
+  Eigen::Matrix3d keyframe_rotation_prior = Eigen::Matrix3d::Identity();
+
+  /**
+   * @brief Flag set when every frame since the last keyframe had a prior
+   *
+   */
+  bool keyframe_has_prior = true;
+
+  /**
+   * @brief Flag set when the last frame was a keyframe
+   *
+   */
+  bool last_frame_keyframe = true;
 
   /**
-   * @brief Create FLANN matcher
+   * @brief Bundle adjustment over the last keyframes
    *
    */
-  cv::FlannBasedMatcher flann_matcher;
+  ba::SlidingWindowBa local_ba;
+
+  /**
+   * @brief Flag to refine every keyframe pose with the local bundle
+   * adjustment
+   *
+   */
+  bool local_ba_enabled = false;
+
+  /**
+   * @brief Place recognition and drift correction over the keyframes
+   *
+   */
+  lc::LoopClosure loop_closure;
+
+  /**
+   * @brief Flag to search every keyframe for a loop
+   *
+   */
+  bool loop_closure_enabled = false;
+
+  /**
+   * @brief Keyframe poses tied by odometry and loop edges, one node per
+   * loop closure keyframe
+   *
+   */
+  ba::PoseGraph pose_graph;
+
+  /**
+   * @brief Pose of the newest node when it was added, the origin of the next
+   * odometry edge
+   *
+   */
+  Eigen::Matrix4d last_node_pose = Eigen::Matrix4d::Identity();
 
   /**
    * @brief Camera intrinsics matrix
@@ -97,12 +432,152 @@ class VisualOdometry {
    */
   cv::Mat new_camera_matrix;
 
+  /**
+   * @brief Precomputed undistortion maps shared through the map cache
+   *
+   */
+  std::shared_ptr<const UndistortMaps> undistort_maps;
+
   /**
    * @brief Initial pose
    *
    */
   Eigen::Matrix4d vo_pose;
 
+  /**
+   * @brief How lens distortion is removed
+   *
+   */
+  UndistortionMode undistortion_mode = UndistortionMode::kFullImage;
+
+  /**
+   * @brief Function to prepare an input image for feature extraction
+   *
+   * @param image: input BGR or grayscale image
+   * @param processed_image: undistorted image, or raw grayscale image in
+   * sparse mode
+   */
+  void preprocess_image(const cv::Mat& image, cv::Mat& processed_image) const;
+
+  /**
+   * @brief Function to undistort keypoint coordinates in place
+   *
+   * @param points: raw pixel coordinates, replaced by undistorted ones
+   */
+  void undistort_points(std::vector<cv::Point2f>& points) const;
+
+  /**
+   * @brief Function to match the previous and current descriptors and apply
+   * the ratio test
+   *
+   * @param keypoints: keypoints of the current frame
+   * @param good_matches: output matches with queries in the previous frame
+   */
+  void match_features(const std::vector<cv::KeyPoint>& keypoints,
+                      std::vector<cv::DMatch>& good_matches);
+
+  /**
+   * @brief Function to predict where points of the previous image appear in
+   * the current image, given in the coordinates of the processed image.
+   * Points the rotation takes behind the camera or to infinity keep their
+   * previous position.
+   *
+   * @param points: points in the previous image
+   * @return std::vector<cv::Point2f>
+   */
+  std::vector<cv::Point2f> predict_points(
+      const std::vector<cv::Point2f>& points);
+
+  /**
+   * @brief Function to run the ORB detect-and-match front-end on a frame
+   *
+   * @param features: extracted frame; its descriptor buffer is exchanged
+   * for a recycled one
+   * @param matched_prev: matched points in the previous image
+   * @param matched_curr: matched points in the current image
+   * @param matched_tracks: current-frame track index of every match
+   * @return true if the frame had a predecessor to match against
+   */
+  bool process_orb(FrameFeatures& features,
+                   std::vector<cv::Point2f>& matched_prev,
+                   std::vector<cv::Point2f>& matched_curr,
+                   std::vector<size_t>& matched_tracks);
+
+  /**
+   * @brief Function to run the KLT tracking front-end on a frame
+   *
+   * @param features: extracted frame; its pyramid is exchanged for a
+   * recycled one
+   * @param matched_prev: tracked points in the previous image
+   * @param matched_curr: tracked points in the current image
+   * @param matched_tracks: current-frame track index of every match
+   * @return true if the frame had a predecessor to track from
+   */
+  bool process_klt(FrameFeatures& features,
+                   std::vector<cv::Point2f>& matched_prev,
+                   std::vector<cv::Point2f>& matched_curr,
+                   std::vector<size_t>& matched_tracks);
+
+  /**
+   * @brief Function to top up the current frame's tracks with Shi-Tomasi
+   * corners away from the existing tracks
+   *
+   * @param gray: grayscale image the tracks live in
+   */
+  void detect_klt_features(const cv::Mat& gray);
+
+  /**
+   * @brief Function to decide whether the current frame is a keyframe and
+   * replace the frame-to-frame matches by matches against the last keyframe
+   *
+   * @param timestamp: capture time of the current frame, negative when
+   * unknown
+   * @param matched_prev: output, track points in the last keyframe
+   * @param matched_curr: output, track points in the current frame
+   * @param matched_tracks: output, index of every match in the current frame
+   * @return true if the frame is a keyframe
+   */
+  bool select_keyframe(double timestamp,
+                       std::vector<cv::Point2f>& matched_prev,
+                       std::vector<cv::Point2f>& matched_curr,
+                       std::vector<size_t>& matched_tracks);
+
+  /**
+   * @brief Function to make the current frame the keyframe
+   *
+   * @param timestamp
+   */
+  void set_keyframe(double timestamp);
+
+  /**
+   * @brief Function to add the current frame to the local bundle adjustment
+   * and take over its refined pose
+   *
+   */
+  void refine_pose();
+
+  /**
+   * @brief Function to search the earlier keyframes for the place of the
+   * current frame, add it to the pose graph, and correct the graph and the
+   * pose when it closes a loop
+   *
+   * @param features: extracted current frame
+   */
+  void close_loop(const FrameFeatures& features);
+
+  /**
+   * @brief Function to estimate the relative motion between matched points
+   * and update the pose
+   *
+   * @param points_prev: matched points in the previous image
+   * @param points_curr: matched points in the current image
+   * @param inlier_mask: output RANSAC inlier flag of every match
+   * @return true if the pose was updated
+   */
+  bool estimate_motion(const std::vector<cv::Point2f>& points_prev,
+                       const std::vector<cv::Point2f>& points_curr,
+                       std::vector<uchar>& inlier_mask);
+
  public:
   /**
    * @brief Construct a new Visual Odometry object
@@ -119,14 +594,266 @@ class VisualOdometry {
   /**
    * @brief Function to update the pose using visual odometry
    *
+   * @param image
+   * @param timestamp: capture time in seconds, only needed by the keyframe
+   * selection
+   * @return true if the motion since the previous (key)frame was estimated;
+   * otherwise the pose is left unchanged
+   */
+  bool update_pose(cv::Mat image, double timestamp = -1.0);
+
+  /**
+   * @brief Function to update the pose from an already extracted frame.
+   * Frames must be passed in capture order. Buffers of the frame are swapped
+   * with recycled ones, so the object can be reused for the next extraction.
+   *
+   * @param features: output of extract_features
+   * @return true if the motion since the previous (key)frame was estimated;
+   * otherwise the pose is left unchanged
+   */
+  bool update_pose(FrameFeatures& features);
+
+  /**
+   * @brief Function to undistort an image and extract the features the
+   * configured front-end needs. Does not modify the odometry state, so it
+   * may run concurrently on several frames with one detector per thread.
+   *
+   * @param image: input BGR or grayscale image
+   * @param detector: ORB detector used by the calling thread
+   * @param features: output, buffers are reused when already allocated
    */
-  void update_pose(cv::Mat image);
+  void extract_features(const cv::Mat& image, const cv::Ptr<cv::ORB>& detector,
+                        FrameFeatures& features) const;
+
+  /**
+   * @brief Function to create an ORB detector with the same settings as the
+   * one used internally, e.g. one per extraction thread
+   *
+   * @return cv::Ptr<cv::ORB>
+   */
+  cv::Ptr<cv::ORB> create_feature_detector() const;
 
   /**
    * @brief Function to return the current pose
    *
    */
   Eigen::Matrix4d get_pose();
+
+  /**
+   * @brief Function to get the camera matrix of the undistorted image, which
+   * keypoints and the estimated motion refer to
+   *
+   * @return const cv::Mat&
+   */
+  const cv::Mat& get_camera_matrix() const;
+
+  /**
+   * @brief Function to set how lens distortion is removed
+   *
+   * @param mode
+   */
+  void set_undistortion_mode(UndistortionMode mode);
+
+  /**
+   * @brief Function to get how lens distortion is removed
+   *
+   * @return UndistortionMode
+   */
+  UndistortionMode get_undistortion_mode() const;
+
+  /**
+   * @brief Function to choose the search structure of the descriptor matcher
+   *
+   * @param index
+   */
+  void set_matcher_index(MatcherIndex index);
+
+  /**
+   * @brief Function to enable or disable guided matching, where previous
+   * keypoints are only matched against current keypoints near their predicted
+   * location
+   *
+   * @param enabled
+   * @param search_radius: half side length of the search window in pixels
+   */
+  void set_guided_matching(bool enabled, float search_radius = 30.0f);
+
+  /**
+   * @brief Function to supply the rotation of the next frame relative to the
+   * current one, e.g. from integrated gyro data. Follows the pose update
+   * convention X_prev = R * X_curr and is consumed by the next update.
+   *
+   * @param R_prev_curr
+   */
+  void set_rotation_prior(const Eigen::Matrix3d& R_prev_curr);
+
+  /**
+   * @brief Function to enable or disable rotation-aided RANSAC. When enabled,
+   * frames with a rotation prior only estimate the translation direction with
+   * a two-point RANSAC; frames without one, or where it finds too few
+   * inliers, fall back to the five-point RANSAC.
+   *
+   * @param enabled
+   */
+  void set_prior_ransac(bool enabled);
+
+  /**
+   * @brief Function to get the number of RANSAC hypotheses evaluated for the
+   * last frame pair by the in-house estimators (0 when OpenCV's RANSAC was
+   * used)
+   *
+   * @return int
+   */
+  int get_last_ransac_iterations() const;
+
+  /**
+   * @brief Function to get the number of points the last motion prediction
+   * left at their previous position, because the rotation took them behind
+   * the camera or to infinity
+   *
+   * @return size_t
+   */
+  size_t get_last_unpredicted_points() const;
+
+  /**
+   * @brief Function to check if the last guided matching found too few
+   * matches near the predictions and fell back to global matching
+   *
+   * @return true if global matching was used after guided matching
+   */
+  bool get_last_guided_fallback() const;
+
+  /**
+   * @brief Function to choose the estimator of the relative motion
+   *
+   * @param solver
+   */
+  void set_motion_solver(MotionSolver solver);
+
+  /**
+   * @brief Function to get the estimator of the relative motion
+   *
+   * @return MotionSolver
+   */
+  MotionSolver get_motion_solver() const;
+
+  /**
+   * @brief Function to set the number of ORB features extracted per frame
+   *
+   * @param max_features
+   */
+  void set_max_features(int max_features);
+
+  /**
+   * @brief Function to choose the feature front-end. Switching resets the
+   * front-end state, so the next frame starts a new set of tracks.
+   *
+   * @param new_front_end
+   */
+  void set_front_end(FrontEnd new_front_end);
+
+  /**
+   * @brief Function to get the feature front-end in use
+   *
+   * @return FrontEnd
+   */
+  FrontEnd get_front_end() const;
+
+  /**
+   * @brief Function to set the KLT track budget
+   *
+   * @param min_tracks: re-detect when fewer tracks than this survive
+   * @param max_tracks: number of tracks to top up to on re-detection
+   */
+  void set_klt_track_limits(size_t min_tracks, int max_tracks);
+
+  /**
+   * @brief Function to set the number of recent frames whose tracks are
+   * kept. Changing it restarts the tracks, so the next frame starts a new set.
+   *
+   * @param history_length: number of frames, at least 2
+   */
+  void set_track_history(size_t history_length);
+
+  /**
+   * @brief Function to access the feature tracks of the recent frames
+   *
+   * @return const TrackStore&
+   */
+  const TrackStore& get_tracks() const;
+
+  /**
+   * @brief Function to only estimate the motion on keyframes. Frames in
+   * between are tracked against the last keyframe and keep its pose.
+   *
+   * @param enabled
+   * @param policy: thresholds deciding when a frame becomes a keyframe
+   */
+  void set_keyframe_selection(bool enabled,
+                              const KeyframePolicy& policy = KeyframePolicy());
+
+  /**
+   * @brief Function to check whether the last frame was a keyframe. Every
+   * frame is a keyframe while the selection is disabled. A selected frame
+   * whose motion could not be estimated does not replace the keyframe, the
+   * next frame is estimated against the old one again.
+   *
+   * @return true if the last frame was a keyframe
+   */
+  bool is_keyframe() const;
+
+  /**
+   * @brief Function to get the capture time of the current keyframe
+   *
+   * @return double: negative when unknown
+   */
+  double get_keyframe_timestamp() const;
+
+  /**
+   * @brief Function to refine the pose of every keyframe, or every frame
+   * without keyframe selection, with a bundle adjustment of the last
+   * keyframes and the landmarks triangulated from their tracks. The track
+   * history is grown to at least the window size.
+   *
+   * @param enabled
+   * @param window_size: number of keyframes optimized together
+   */
+  void set_local_ba(bool enabled, size_t window_size = 7);
+
+  /**
+   * @brief Function to get the local bundle adjustment, e.g. for the costs
+   * of its last refinement
+   *
+   * @return const ba::SlidingWindowBa&
+   */
+  const ba::SlidingWindowBa& get_local_ba() const;
+
+  /**
+   * @brief Function to search every keyframe, or every frame without
+   * keyframe selection, for a loop with the earlier ones. A loop is added to
+   * a pose graph of the keyframes, whose update moves the pose back onto the
+   * earlier map and corrects the keyframe trajectory.
+   *
+   * @param enabled
+   * @param vocabulary: vocabulary trained offline on ORB descriptors
+   */
+  void set_loop_closure(bool enabled,
+                        std::shared_ptr<const lc::Vocabulary> vocabulary);
+
+  /**
+   * @brief Function to access the keyframes searched for loops, with their
+   * corrected poses
+   *
+   * @return const lc::LoopClosure&
+   */
+  const lc::LoopClosure& get_loop_closure() const;
+
+  /**
+   * @brief Function to access the pose graph of the loop closure keyframes
+   *
+   * @return const ba::PoseGraph&
+   */
+  const ba::PoseGraph& get_pose_graph() const;
 };
 
 }  // namespace vo
@@ -12,10 +12,33 @@
 
 #include <gtest/gtest.h>
 
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include "camera_calibration.hpp"
 #include "data_loader.hpp"
+#include "error_state_ekf.hpp"
 #include "gmock/gmock.h"
+#include "imu_preintegration.hpp"
 #include "inertial_odometry.hpp"
+#include "keyframe_database.hpp"
+#include "loop_closure.hpp"
+#include "pose_graph.hpp"
+#include "sliding_window_ba.hpp"
+#include "so3.hpp"
+#include "tracer.hpp"
+#include "trajectory_evaluation.hpp"
 #include "visual_odometry.hpp"
+#include "vo_pipeline.hpp"
+#include "vocabulary.hpp"
 
 /**
  * @brief Test fixture for Inertial Odometry class
@@ -103,6 +126,75 @@ TEST_F(InertialOdometryTests, TestUpdatePose) {
   }
 }
 
+/**
+ * @brief Construct a test for integrating a block of samples
+ *
+ */
+TEST_F(InertialOdometryTests, TestIntegrateBlock) {
+  dl::ImuLog imu_log;
+  for (int i = 0; i < 1000; ++i) {
+    imu_log.timestamp.push_back(i * 0.001);
+    imu_log.gyro_x.push_back(std::sin(i * 0.01));
+    imu_log.gyro_y.push_back(0.5);
+    imu_log.gyro_z.push_back(i % 7 == 0 ? 0.0 : -0.3);
+    imu_log.accel_x.push_back(0.1 * i);
+    imu_log.accel_y.push_back(0.0);
+    imu_log.accel_z.push_back(9.81);
+  }
+  io::ImuSpan samples = imu_log.span();
+
+  // Reference: one sample per call
+  io::InertialOdometry reference(Eigen::Matrix4d::Identity());
+  for (size_t i = 0; i < samples.size; ++i)
+    reference.update_pose(
+        samples.timestamp[i],
+        Eigen::Vector3d(samples.accel_x[i], samples.accel_y[i],
+                        samples.accel_z[i]),
+        Eigen::Vector3d(samples.gyro_x[i], samples.gyro_y[i],
+                        samples.gyro_z[i]));
+
+  // Split into two blocks, sampling every 100th pose of the first
+  std::vector<Eigen::Matrix4d> trajectory;
+  test_inertial_odometry->integrate(samples.subspan(0, 300), 100, trajectory);
+  Eigen::Matrix4d pose =
+      test_inertial_odometry->integrate(samples.subspan(300, 10000));
+
+  EXPECT_EQ(trajectory.size(), 3u);
+  EXPECT_TRUE(pose.isApprox(reference.get_pose(), 1e-9));
+  EXPECT_TRUE(pose.isApprox(test_inertial_odometry->get_pose()));
+  EXPECT_TRUE(test_inertial_odometry->get_velocity().isApprox(
+      reference.get_velocity(), 1e-9));
+}
+
+/**
+ * @brief Construct a test for integrating translation from timestamps
+ *
+ */
+TEST_F(InertialOdometryTests, TestStrapdownTranslation) {
+  test_inertial_odometry->set_gravity(Eigen::Vector3d(0.0, 0.0, -9.81));
+  test_inertial_odometry->set_biases(Eigen::Vector3d(0.01, 0.0, 0.0),
+                                     Eigen::Vector3d(0.0, 0.2, 0.0));
+
+  // 1 m/s^2 forward for one second at an irregular rate, level and not
+  // rotating once the biases are removed
+  double timestamp = 100.0;
+  for (int i = 0; i <= 800; ++i) {
+    test_inertial_odometry->update_pose(timestamp,
+                                        Eigen::Vector3d(1.0, 0.2, 9.81),
+                                        Eigen::Vector3d(0.01, 0.0, 0.0));
+    timestamp += i % 2 == 0 ? 0.001 : 0.0015;
+  }
+  double duration = timestamp - 100.0 - 0.001;
+
+  Eigen::Matrix4d pose = test_inertial_odometry->get_pose();
+  EXPECT_NEAR(pose(0, 3), 0.5 * duration * duration, 1e-9);
+  EXPECT_NEAR(pose(1, 3), 0.0, 1e-9);
+  EXPECT_NEAR(pose(2, 3), 0.0, 1e-9);
+  EXPECT_NEAR(test_inertial_odometry->get_velocity()(0), duration, 1e-9);
+  Eigen::Matrix3d rotation = pose.block<3, 3>(0, 0);
+  EXPECT_TRUE(rotation.isIdentity(1e-12));
+}
+
 /**
  * @brief Construct a test for the constructor
  *
@@ -118,6 +210,229 @@ TEST_F(InertialOdometryTests, TestConstructor) {
   }
 }
 
+/**
+ * @brief Construct a test for preintegrated prediction and bias correction
+ *
+ */
+TEST(ImuPreintegrationTests, TestPredictAndBiasCorrection) {
+  const int sample_count = 400;
+  const double dt = 0.005;
+  const Eigen::Vector3d gravity(0.0, 0.0, -9.81);
+  const Eigen::Vector3d gyro_bias(0.01, -0.02, 0.03);
+  const Eigen::Vector3d accel_bias(0.1, 0.05, -0.1);
+
+  std::vector<Eigen::Vector3d> accel, gyro;
+  for (int i = 0; i < sample_count; ++i) {
+    accel.emplace_back(std::sin(0.05 * i), std::cos(0.03 * i), 9.81);
+    gyro.emplace_back(0.3 * std::sin(0.02 * i), 0.2, -0.1 * std::cos(0.04 * i));
+  }
+
+  Eigen::Matrix4d pose_i = Eigen::Matrix4d::Identity();
+  pose_i.block<3, 3>(0, 0) = io::so3::exp(Eigen::Vector3d(0.3, -0.2, 0.1));
+  pose_i.block<3, 1>(0, 3) = Eigen::Vector3d(1.0, 2.0, 3.0);
+  const Eigen::Vector3d velocity_i(1.0, -1.0, 0.5);
+
+  // Reference: strapdown integration of the same samples
+  io::InertialOdometry odometry(pose_i);
+  odometry.set_gravity(gravity);
+  odometry.set_biases(gyro_bias, accel_bias);
+  odometry.set_velocity(velocity_i);
+
+  io::ImuPreintegration preintegration(gyro_bias, accel_bias);
+  for (int i = 0; i < sample_count; ++i) {
+    preintegration.integrate(accel[i], gyro[i], dt);
+    odometry.update_pose(i * dt, accel[i], gyro[i]);
+  }
+  odometry.update_pose(sample_count * dt, accel[0], gyro[0]);
+
+  Eigen::Matrix4d pose_j;
+  Eigen::Vector3d velocity_j;
+  preintegration.predict(pose_i, velocity_i, gravity, pose_j, velocity_j);
+  EXPECT_TRUE(pose_j.isApprox(odometry.get_pose(), 1e-9));
+  EXPECT_TRUE(velocity_j.isApprox(odometry.get_velocity(), 1e-9));
+  EXPECT_NEAR(preintegration.get_delta_t(), sample_count * dt, 1e-12);
+
+  // A small bias change is absorbed to first order without re-integration
+  const Eigen::Vector3d new_gyro_bias =
+      gyro_bias + Eigen::Vector3d(0.003, -0.002, 0.001);
+  const Eigen::Vector3d new_accel_bias =
+      accel_bias + Eigen::Vector3d(0.02, -0.01, 0.03);
+  io::ImuPreintegration reintegrated(new_gyro_bias, new_accel_bias);
+  for (int i = 0; i < sample_count; ++i)
+    reintegrated.integrate(accel[i], gyro[i], dt);
+
+  Eigen::Matrix3d rotation_error =
+      preintegration.corrected_delta_R(new_gyro_bias).transpose() *
+      reintegrated.get_delta_R();
+  EXPECT_LT(io::so3::log(rotation_error).norm(), 1e-5);
+  EXPECT_LT((preintegration.corrected_delta_v(new_gyro_bias, new_accel_bias) -
+             reintegrated.get_delta_v())
+                .norm(),
+            1e-3);
+  EXPECT_LT((preintegration.corrected_delta_p(new_gyro_bias, new_accel_bias) -
+             reintegrated.get_delta_p())
+                .norm(),
+            1e-3);
+
+  // The covariance stays symmetric positive definite
+  io::ImuPreintegration::Covariance covariance =
+      preintegration.get_covariance();
+  EXPECT_LT((covariance - covariance.transpose()).norm(), 1e-15);
+  Eigen::SelfAdjointEigenSolver<io::ImuPreintegration::Covariance> solver(
+      covariance);
+  EXPECT_GT(solver.eigenvalues().minCoeff(), 0.0);
+}
+
+/**
+ * @brief Test that fusing relative rotations and translation directions
+ * estimates the gyroscope bias and bounds the drift of biased IMU integration
+ *
+ */
+TEST(ErrorStateEkfTests, TestFusionBoundsDrift) {
+  const double dt = 0.001;
+  const Eigen::Vector3d gravity(0.0, 0.0, -9.81);
+  const Eigen::Vector3d angular_velocity(0.1, -0.2, 0.3);
+  const Eigen::Vector3d gyro_bias(0.02, -0.01, 0.015);
+  const Eigen::Vector3d accel_bias(0.05, 0.03, -0.04);
+
+  vio::ErrorStateEkf filter;
+  vio::ErrorStateEkf imu_only;
+  filter.set_gravity(gravity);
+  imu_only.set_gravity(gravity);
+
+  // Ground truth, with the previous image pose for the VO measurement
+  Eigen::Matrix3d R = Eigen::Matrix3d::Identity();
+  Eigen::Vector3d p = Eigen::Vector3d::Zero();
+  Eigen::Vector3d v(0.5, 0.0, 0.0);
+  Eigen::Matrix3d R_image = R;
+  Eigen::Vector3d p_image = p;
+
+  for (int i = 0; i <= 10000; ++i) {
+    double t = i * dt;
+    Eigen::Vector3d acceleration(std::sin(t), std::cos(0.5 * t),
+                                 0.2 * std::sin(0.3 * t));
+    Eigen::Vector3d a = R.transpose() * (acceleration - gravity) + accel_bias;
+    Eigen::Vector3d w = angular_velocity + gyro_bias;
+    filter.propagate(t, a, w);
+    imu_only.propagate(t, a, w);
+
+    // Monocular VO at 20 Hz: exact rotation, unit-length translation
+    if (i % 50 == 0) {
+      if (i == 0) {
+        filter.clone_pose();
+      } else {
+        Eigen::Matrix4d T = Eigen::Matrix4d::Identity();
+        T.block<3, 3>(0, 0) = R_image.transpose() * R;
+        T.block<3, 1>(0, 3) = (R_image.transpose() * (p - p_image)).normalized();
+        filter.update_relative_pose(T);
+      }
+      R_image = R;
+      p_image = p;
+    }
+
+    p += v * dt + 0.5 * acceleration * dt * dt;
+    v += acceleration * dt;
+    R = R * io::so3::exp(angular_velocity * dt);
+  }
+
+  Eigen::Matrix4d fused = filter.get_pose();
+  Eigen::Matrix4d integrated = imu_only.get_pose();
+  Eigen::Matrix3d fused_rotation = fused.block<3, 3>(0, 0);
+  Eigen::Matrix3d integrated_rotation = integrated.block<3, 3>(0, 0);
+  Eigen::Vector3d fused_position = fused.block<3, 1>(0, 3);
+  Eigen::Vector3d integrated_position = integrated.block<3, 1>(0, 3);
+
+  // Relative measurements leave the heading drifting slowly, but far less
+  // than integrating the biased gyroscope
+  EXPECT_LT(io::so3::log(fused_rotation.transpose() * R).norm(),
+            0.2 * io::so3::log(integrated_rotation.transpose() * R).norm());
+  EXPECT_LT((fused_position - p).norm(),
+            0.1 * (integrated_position - p).norm());
+  EXPECT_LT((filter.get_gyro_bias() - gyro_bias).norm(), 0.005);
+
+  vio::ErrorStateEkf::Covariance covariance = filter.get_covariance();
+  EXPECT_LT((covariance - covariance.transpose()).norm(), 1e-12);
+}
+
+/**
+ * @brief Test that without IMU data the filter follows the VO rotation,
+ * mapped into the body frame, and never adds the unit-length VO translation
+ * to the metric position
+ *
+ */
+TEST(ErrorStateEkfTests, TestFollowsVoRotationWithoutImu) {
+  const Eigen::Matrix3d R_body_camera =
+      io::so3::exp(Eigen::Vector3d(0.0, M_PI / 2, 0.0));
+  vio::ErrorStateEkf filter;
+  filter.set_camera_rotation(R_body_camera);
+  filter.clone_pose();
+
+  Eigen::Matrix3d expected = Eigen::Matrix3d::Identity();
+  for (int k = 0; k < 5; ++k) {
+    Eigen::Matrix4d T = Eigen::Matrix4d::Identity();
+    T.block<3, 3>(0, 0) = io::so3::exp(Eigen::Vector3d(0.01 * k, 0.02, -0.01));
+    T.block<3, 1>(0, 3) = Eigen::Vector3d(1.0, k, 0.0).normalized();
+    EXPECT_FALSE(filter.update_relative_pose(T));
+    expected = expected * R_body_camera * T.block<3, 3>(0, 0) *
+               R_body_camera.transpose();
+  }
+
+  Eigen::Matrix4d pose = filter.get_pose();
+  Eigen::Matrix3d rotation = pose.block<3, 3>(0, 0);
+  Eigen::Vector3d position = pose.block<3, 1>(0, 3);
+  EXPECT_TRUE(rotation.isApprox(expected, 1e-12));
+  EXPECT_EQ(position.norm(), 0.0);
+}
+
+/**
+ * @brief Test reading the camera to body extrinsic as a 3x3 rotation or a 4x4
+ * transform, and rejecting files that do not hold a rotation
+ *
+ */
+TEST(DataLoaderTests, TestLoadCameraRotation) {
+  const Eigen::Matrix3d R = io::so3::exp(Eigen::Vector3d(0.1, -0.2, 0.3));
+  const std::string path = "test_camera_calibration.txt";
+  Eigen::Matrix3d loaded;
+
+  {
+    std::ofstream file(path);
+    file << std::setprecision(17) << "# T_body_camera\n";
+    for (int i = 0; i < 3; i++)
+      file << R(i, 0) << " " << R(i, 1) << " " << R(i, 2) << " 0.05\n";
+    file << "0 0 0 1\n";
+  }
+  ASSERT_TRUE(dl::load_camera_rotation(path, loaded));
+  EXPECT_TRUE(loaded.isApprox(R, 1e-12));
+  Eigen::Vector3d translation;
+  ASSERT_TRUE(dl::load_camera_extrinsic(path, loaded, translation));
+  EXPECT_TRUE(translation.isApprox(Eigen::Vector3d::Constant(0.05), 1e-12));
+
+  {
+    std::ofstream file(path);
+    file << std::setprecision(17);
+    for (int i = 0; i < 3; i++)
+      file << R(i, 0) << " " << R(i, 1) << " " << R(i, 2) << "\n";
+  }
+  ASSERT_TRUE(dl::load_camera_rotation(path, loaded));
+  EXPECT_TRUE(loaded.isApprox(R, 1e-12));
+
+  {
+    std::ofstream file(path);
+    file << "2 0 0\n0 1 0\n0 0 1\n";
+  }
+  EXPECT_FALSE(dl::load_camera_rotation(path, loaded));
+
+  {
+    std::ofstream file(path);
+    file << "1 0 0\n0 1 0\n";
+  }
+  EXPECT_FALSE(dl::load_camera_rotation(path, loaded));
+  EXPECT_TRUE(loaded.isApprox(R, 1e-12));
+  std::remove(path.c_str());
+
+  EXPECT_FALSE(dl::load_camera_rotation("missing_calibration.txt", loaded));
+}
+
 /**
  * @brief Test fixture for DataLoader class
  *
@@ -232,8 +547,15 @@ TEST_F(VisualOdometryTests, TestUpdatePose) {
 
   Eigen::Matrix4d pose = test_visual_odometry->get_pose();
 
-  // Fill in the expected pose
+  // The camera does not move between the two frames (median keypoint
+  // displacement 0 px), so the essential matrix is degenerate and
+  // recoverPose leaves no point in front of both cameras. The pose is the
+  // decomposition OpenCV picks for the undistorted camera matrix: a half turn
+  // about the translation direction. With the raw camera matrix the same
+  // essential matrix used to give the identity rotation.
   Eigen::Matrix4d expected_pose = Eigen::Matrix4d::Identity();
+  expected_pose.block<3, 3>(0, 0) << -1.0 / 3.0, -2.0 / 3.0, 2.0 / 3.0,
+      -2.0 / 3.0, -1.0 / 3.0, -2.0 / 3.0, 2.0 / 3.0, -2.0 / 3.0, -1.0 / 3.0;
   expected_pose(0, 3) = 0.577350;
   expected_pose(1, 3) = -0.577350;
   expected_pose(2, 3) = 0.577350;
@@ -244,3 +566,2219 @@ TEST_F(VisualOdometryTests, TestUpdatePose) {
     }
   }
 }
+
+/**
+ * @brief Construct a test for the estimation flag of update_pose
+ *
+ */
+TEST_F(VisualOdometryTests, TestUpdatePoseReportsEstimation) {
+  cv::Mat image =
+      cv::imread("../../indoor_forward_9_davis_with_gt/img/image_0_1101.png");
+
+  // The first frame has nothing to estimate the motion from
+  EXPECT_FALSE(test_visual_odometry->update_pose(image));
+
+  image =
+      cv::imread("../../indoor_forward_9_davis_with_gt/img/image_0_1102.png");
+  EXPECT_TRUE(test_visual_odometry->update_pose(image));
+  Eigen::Matrix4d estimated_pose = test_visual_odometry->get_pose();
+
+  // A blank frame has no features, the pose stays where it was
+  cv::Mat blank = cv::Mat::zeros(image.size(), image.type());
+  EXPECT_FALSE(test_visual_odometry->update_pose(blank));
+  Eigen::Matrix4d pose = test_visual_odometry->get_pose();
+  for (int i = 0; i < 4; ++i)
+    for (int j = 0; j < 4; ++j) EXPECT_EQ(pose(i, j), estimated_pose(i, j));
+}
+
+/**
+ * @brief Construct a test to check that undistortion maps are shared
+ *
+ */
+TEST_F(VisualOdometryTests, TestUndistortMapCacheReuse) {
+  size_t cached_configs = vo::UndistortMapCache::instance().size();
+  EXPECT_GE(cached_configs, 1u);
+
+  // A second instance with the same camera must not build new maps
+  vo::VisualOdometry second_visual_odometry(Eigen::Matrix4d::Identity());
+  EXPECT_EQ(vo::UndistortMapCache::instance().size(), cached_configs);
+
+  cv::Mat K = (cv::Mat_<double>(3, 3) << 100, 0, 50, 0, 100, 40, 0, 0, 1);
+  cv::Mat D = cv::Mat::zeros(1, 4, CV_64F);
+  auto maps = vo::UndistortMapCache::instance().get(K, D, K, cv::Size(100, 80));
+  auto same_maps =
+      vo::UndistortMapCache::instance().get(K, D, K, cv::Size(100, 80));
+
+  EXPECT_EQ(maps.get(), same_maps.get());
+  EXPECT_EQ(maps->map1.type(), CV_16SC2);
+  EXPECT_EQ(maps->map1.rows, 80);
+  EXPECT_EQ(maps->map1.cols, 100);
+}
+
+/**
+ * @brief Construct a test comparing the sparse keypoint undistortion path
+ * against the full-image path
+ *
+ */
+TEST_F(VisualOdometryTests, TestSparseUndistortionTrajectory) {
+  vo::VisualOdometry sparse_visual_odometry(Eigen::Matrix4d::Identity());
+  sparse_visual_odometry.set_undistortion_mode(
+      vo::UndistortionMode::kSparseKeypoints);
+  EXPECT_EQ(sparse_visual_odometry.get_undistortion_mode(),
+            vo::UndistortionMode::kSparseKeypoints);
+
+  for (int id = 1101; id <= 1105; ++id) {
+    cv::Mat image =
+        cv::imread("../../indoor_forward_9_davis_with_gt/img/image_0_" +
+                   std::to_string(id) + ".png");
+    test_visual_odometry->update_pose(image);
+    sparse_visual_odometry.update_pose(image);
+
+    Eigen::Matrix4d full_pose = test_visual_odometry->get_pose();
+    Eigen::Matrix4d sparse_pose = sparse_visual_odometry.get_pose();
+
+    // Both trajectories must stay on the same orientation track
+    Eigen::Matrix3d R_diff =
+        full_pose.block<3, 3>(0, 0).transpose() * sparse_pose.block<3, 3>(0, 0);
+    double angle = std::acos(std::min(1.0, (R_diff.trace() - 1.0) / 2.0));
+    EXPECT_LT(angle, 0.1);
+
+    EXPECT_TRUE(sparse_pose.allFinite());
+  }
+}
+
+/**
+ * @brief Test that the two-point RANSAC recovers the translation direction
+ * from a known rotation with a third of the matches being outliers
+ *
+ */
+TEST(TwoPointRansacTests, TestTranslationWithOutliers) {
+  const Eigen::Matrix3d R = io::so3::exp(Eigen::Vector3d(0.05, -0.1, 0.02));
+  const Eigen::Vector3d t = Eigen::Vector3d(0.3, -0.1, 1.0).normalized();
+
+  std::mt19937 generator(7);
+  std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+  std::vector<Eigen::Vector3d> points_prev, points_curr;
+  for (int i = 0; i < 150; ++i) {
+    Eigen::Vector3d X_curr(2.0 * uniform(generator), 2.0 * uniform(generator),
+                           4.0 + uniform(generator));
+    Eigen::Vector3d X_prev = R * X_curr + t;
+    points_curr.push_back(X_curr / X_curr(2));
+    points_prev.push_back(X_prev / X_prev(2));
+
+    // Every third match points somewhere else
+    if (i % 3 == 0)
+      points_prev.back() =
+          Eigen::Vector3d(uniform(generator), uniform(generator), 1.0);
+  }
+
+  vo::TwoPointRansac ransac;
+  Eigen::Vector3d estimate;
+  std::vector<unsigned char> inlier_mask;
+  size_t inliers = ransac.estimate(points_prev, points_curr, R, 1e-3, estimate,
+                                   inlier_mask);
+
+  EXPECT_GE(inliers, 100u);
+  EXPECT_EQ(inlier_mask.size(), points_curr.size());
+  EXPECT_LT(std::min((estimate - t).norm(), (estimate + t).norm()), 1e-6);
+
+  // Two-point samples need far fewer hypotheses than the 5-point bound of
+  // log(0.001) / log(1 - (2/3)^5) = 50 at this inlier ratio
+  EXPECT_LT(ransac.get_last_iterations(), 30);
+}
+
+/**
+ * @brief Test that a rotation prior gives the same motion with the two-point
+ * RANSAC as the five-point RANSAC does
+ *
+ */
+TEST_F(VisualOdometryTests, TestPriorRansac) {
+  vo::VisualOdometry prior_visual_odometry(Eigen::Matrix4d::Identity());
+  prior_visual_odometry.set_prior_ransac(true);
+
+  Eigen::Matrix4d previous_pose = test_visual_odometry->get_pose();
+  for (int id = 1101; id <= 1105; ++id) {
+    cv::Mat image =
+        cv::imread("../../indoor_forward_9_davis_with_gt/img/image_0_" +
+                   std::to_string(id) + ".png");
+    test_visual_odometry->update_pose(image);
+    Eigen::Matrix4d pose = test_visual_odometry->get_pose();
+    Eigen::Matrix4d relative = previous_pose.inverse() * pose;
+    previous_pose = pose;
+
+    // Feed the five-point rotation as the prior
+    Eigen::Matrix4d prior_previous = prior_visual_odometry.get_pose();
+    Eigen::Matrix3d relative_rotation = relative.block<3, 3>(0, 0);
+    if (id > 1101) prior_visual_odometry.set_rotation_prior(relative_rotation);
+    prior_visual_odometry.update_pose(image);
+    Eigen::Matrix4d prior_relative =
+        prior_previous.inverse() * prior_visual_odometry.get_pose();
+
+    if (id == 1101) continue;
+    EXPECT_GT(prior_visual_odometry.get_last_ransac_iterations(), 0);
+
+    Eigen::Matrix3d prior_relative_rotation = prior_relative.block<3, 3>(0, 0);
+    EXPECT_LT(io::so3::log(prior_relative_rotation.transpose() *
+                           relative_rotation)
+                  .norm(),
+              1e-6);
+
+    Eigen::Vector3d t = relative.block<3, 1>(0, 3);
+    Eigen::Vector3d prior_t = prior_relative.block<3, 1>(0, 3);
+    EXPECT_GT(t.dot(prior_t), 0.9);
+  }
+}
+
+/**
+ * @brief Test that every motion solver recovers the exact motion from
+ * keypoints projected with the camera matrix of the undistorted image, which
+ * differs from the raw intrinsics
+ *
+ */
+TEST_F(VisualOdometryTests, TestMotionInUndistortedCameraFrame) {
+  const cv::Mat& K_cv = test_visual_odometry->get_camera_matrix();
+  Eigen::Matrix3d K;
+  for (int i = 0; i < 3; i++)
+    for (int j = 0; j < 3; j++) K(i, j) = K_cv.at<double>(i, j);
+
+  // Normalizing with the raw intrinsics would bias the motion
+  ASSERT_GT(std::abs(K(0, 0) - 172.98992850734132) +
+                std::abs(K(0, 2) - 163.33639726024606),
+            1.0);
+
+  const Eigen::Matrix3d R = io::so3::exp(Eigen::Vector3d(0.02, -0.05, 0.03));
+  const Eigen::Vector3d t = Eigen::Vector3d(0.3, -0.2, 1.0).normalized();
+
+  // Points seen by both cameras, each with its own random descriptor
+  std::mt19937 generator(5);
+  std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+  std::vector<cv::KeyPoint> keypoints_prev, keypoints_curr;
+  while (keypoints_curr.size() < 150) {
+    Eigen::Vector3d X_curr(2.0 * uniform(generator), 1.5 * uniform(generator),
+                           5.0 + uniform(generator));
+    Eigen::Vector3d x_curr = K * X_curr;
+    Eigen::Vector3d x_prev = K * (R * X_curr + t);
+    x_curr /= x_curr(2);
+    x_prev /= x_prev(2);
+    if (x_curr(0) < 0 || x_curr(0) > 345 || x_curr(1) < 0 ||
+        x_curr(1) > 259 || x_prev(0) < 0 || x_prev(0) > 345 ||
+        x_prev(1) < 0 || x_prev(1) > 259)
+      continue;
+    keypoints_prev.emplace_back(x_prev(0), x_prev(1), 31.0f);
+    keypoints_curr.emplace_back(x_curr(0), x_curr(1), 31.0f);
+  }
+  cv::Mat descriptors(static_cast<int>(keypoints_curr.size()), 32, CV_8U);
+  for (int i = 0; i < descriptors.rows; i++)
+    for (int j = 0; j < 32; j++)
+      descriptors.at<uchar>(i, j) = static_cast<uchar>(generator());
+
+  const vo::MotionSolver solvers[] = {vo::MotionSolver::kOpenCv,
+                                      vo::MotionSolver::kFivePoint,
+                                      vo::MotionSolver::kFivePoint};
+  for (int k = 0; k < 3; ++k) {
+    vo::VisualOdometry visual_odometry(Eigen::Matrix4d::Identity());
+    visual_odometry.set_motion_solver(solvers[k]);
+
+    vo::FrameFeatures previous;
+    previous.keypoints = keypoints_prev;
+    previous.descriptors = descriptors.clone();
+    visual_odometry.update_pose(previous);
+
+    // The last run estimates only the translation, with the true rotation
+    if (k == 2) {
+      visual_odometry.set_prior_ransac(true);
+      visual_odometry.set_rotation_prior(R);
+    }
+    vo::FrameFeatures current;
+    current.keypoints = keypoints_curr;
+    current.descriptors = descriptors.clone();
+    visual_odometry.update_pose(current);
+
+    Eigen::Matrix4d pose = visual_odometry.get_pose();
+    Eigen::Matrix3d rotation = pose.block<3, 3>(0, 0);
+    Eigen::Vector3d translation = pose.block<3, 1>(0, 3);
+    EXPECT_LT(io::so3::log(rotation.transpose() * R).norm(), 1e-4) << k;
+    EXPECT_GT(translation.normalized().dot(t), 1.0 - 1e-6) << k;
+  }
+}
+
+/**
+ * @brief Test that one of the five-point solutions is the true essential
+ * matrix
+ *
+ */
+TEST(FivePointRansacTests, TestMinimalSolver) {
+  const Eigen::Matrix3d R = io::so3::exp(Eigen::Vector3d(-0.08, 0.12, 0.03));
+  const Eigen::Vector3d t = Eigen::Vector3d(-0.5, 0.2, 1.0).normalized();
+  Eigen::Matrix3d t_skew;
+  t_skew << 0.0, -t(2), t(1), t(2), 0.0, -t(0), -t(1), t(0), 0.0;
+  const Eigen::Matrix3d E_true = (t_skew * R).normalized();
+
+  std::mt19937 generator(11);
+  std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+  Eigen::Vector3d points_prev[5], points_curr[5];
+  for (int i = 0; i < 5; ++i) {
+    Eigen::Vector3d X_curr(uniform(generator), uniform(generator),
+                           4.0 + uniform(generator));
+    Eigen::Vector3d X_prev = R * X_curr + t;
+    points_curr[i] = X_curr / X_curr(2);
+    points_prev[i] = X_prev / X_prev(2);
+  }
+
+  Eigen::Matrix3d essentials[10];
+  int count = vo::FivePointRansac::solve_minimal(points_prev, points_curr,
+                                                 essentials);
+  ASSERT_GT(count, 0);
+
+  // Solutions are only defined up to sign
+  double best = 1.0;
+  for (int i = 0; i < count; ++i)
+    best = std::min(best, std::min((essentials[i] - E_true).norm(),
+                                   (essentials[i] + E_true).norm()));
+  EXPECT_LT(best, 1e-6);
+}
+
+/**
+ * @brief Test that the five-point RANSAC and its pose recovery find the true
+ * motion with a third of the matches being outliers
+ *
+ */
+TEST(FivePointRansacTests, TestPoseWithOutliers) {
+  const Eigen::Matrix3d R = io::so3::exp(Eigen::Vector3d(0.05, -0.1, 0.02));
+  const Eigen::Vector3d t = Eigen::Vector3d(0.3, -0.1, 1.0).normalized();
+
+  std::mt19937 generator(7);
+  std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+  std::vector<Eigen::Vector3d> points_prev, points_curr;
+  for (int i = 0; i < 300; ++i) {
+    Eigen::Vector3d X_curr(2.0 * uniform(generator), 2.0 * uniform(generator),
+                           4.0 + uniform(generator));
+    Eigen::Vector3d X_prev = R * X_curr + t;
+    points_curr.push_back(X_curr / X_curr(2));
+    points_prev.push_back(X_prev / X_prev(2));
+
+    // Every third match points somewhere else
+    if (i % 3 == 0)
+      points_prev.back() =
+          Eigen::Vector3d(uniform(generator), uniform(generator), 1.0);
+  }
+
+  vo::FivePointRansac ransac;
+  Eigen::Matrix3d E;
+  std::vector<unsigned char> inlier_mask;
+  size_t inliers = ransac.estimate(points_prev, points_curr, 1e-3, E,
+                                   inlier_mask);
+
+  EXPECT_GE(inliers, 200u);
+  EXPECT_EQ(inlier_mask.size(), points_curr.size());
+  EXPECT_LE(ransac.get_last_iterations(), 1000);
+
+  Eigen::Matrix3d R_estimate;
+  Eigen::Vector3d t_estimate;
+  size_t in_front = vo::FivePointRansac::recover_pose(
+      E, points_prev, points_curr, inlier_mask, R_estimate, t_estimate);
+
+  EXPECT_GE(in_front, 190u);
+  EXPECT_LT(io::so3::log(R_estimate.transpose() * R).norm(), 1e-6);
+  EXPECT_LT((t_estimate - t).norm(), 1e-6);
+}
+
+/**
+ * @brief Test that the RANSAC recovers the motion of noise-free
+ * correspondences exactly, and that of noisy ones with outliers up to the
+ * accuracy of a minimal sample
+ *
+ */
+TEST(FivePointRansacTests, TestPoseWithNoise) {
+  // The noisy estimate is the best minimal-sample model, not a refit over
+  // all inliers, so it is only as good as five noisy points allow
+  const double noise_free_tolerance = 1e-6;
+  const double noisy_rotation_tolerance = 2e-2;
+  const double noisy_translation_tolerance = 6e-2;
+
+  const Eigen::Matrix3d R = io::so3::exp(Eigen::Vector3d(0.05, -0.1, 0.02));
+  const Eigen::Vector3d t = Eigen::Vector3d(0.3, -0.1, 1.0).normalized();
+
+  std::mt19937 generator(7);
+  std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+  std::normal_distribution<double> noise(0.0, 1e-3);
+  std::vector<Eigen::Vector3d> points_prev, points_curr;
+  std::vector<Eigen::Vector3d> noisy_prev, noisy_curr;
+  for (int i = 0; i < 300; ++i) {
+    Eigen::Vector3d X_curr(2.0 * uniform(generator), 2.0 * uniform(generator),
+                           4.0 + uniform(generator));
+    Eigen::Vector3d X_prev = R * X_curr + t;
+    if (i < 20) {
+      points_curr.push_back(X_curr / X_curr(2));
+      points_prev.push_back(X_prev / X_prev(2));
+    }
+    noisy_curr.push_back(X_curr / X_curr(2) +
+                         Eigen::Vector3d(noise(generator), noise(generator),
+                                         0.0));
+    noisy_prev.push_back(X_prev / X_prev(2) +
+                         Eigen::Vector3d(noise(generator), noise(generator),
+                                         0.0));
+
+    // Every third match points somewhere else
+    if (i % 3 == 0)
+      noisy_prev.back() =
+          Eigen::Vector3d(uniform(generator), uniform(generator), 1.0);
+  }
+
+  vo::FivePointRansac ransac;
+  Eigen::Matrix3d E, R_estimate;
+  Eigen::Vector3d t_estimate;
+  std::vector<unsigned char> inlier_mask;
+  ASSERT_EQ(ransac.estimate(points_prev, points_curr, 1e-3, E, inlier_mask),
+            20u);
+  ASSERT_EQ(vo::FivePointRansac::recover_pose(E, points_prev, points_curr,
+                                              inlier_mask, R_estimate,
+                                              t_estimate),
+            20u);
+  EXPECT_LT(io::so3::log(R_estimate.transpose() * R).norm(),
+            noise_free_tolerance);
+  EXPECT_LT((t_estimate - t).norm(), noise_free_tolerance);
+
+  EXPECT_GE(ransac.estimate(noisy_prev, noisy_curr, 3e-3, E, inlier_mask),
+            180u);
+  EXPECT_GE(vo::FivePointRansac::recover_pose(E, noisy_prev, noisy_curr,
+                                              inlier_mask, R_estimate,
+                                              t_estimate),
+            180u);
+  EXPECT_LT(io::so3::log(R_estimate.transpose() * R).norm(),
+            noisy_rotation_tolerance);
+  EXPECT_LT((t_estimate - t).norm(), noisy_translation_tolerance);
+}
+
+/**
+ * @brief Test that the AVX2 and the scalar Sampson kernels flag the same
+ * inliers, including the tails the vector loop leaves to the scalar one
+ *
+ */
+TEST(FivePointRansacTests, TestSampsonKernelsAgree) {
+  const Eigen::Matrix3d R = io::so3::exp(Eigen::Vector3d(0.05, -0.1, 0.02));
+  const Eigen::Vector3d t = Eigen::Vector3d(0.3, -0.1, 1.0).normalized();
+  Eigen::Matrix3d t_skew;
+  t_skew << 0.0, -t(2), t(1), t(2), 0.0, -t(0), -t(1), t(0), 0.0;
+  const Eigen::Matrix3d E = t_skew * R;
+
+  // Errors spread on both sides of the threshold
+  std::mt19937 generator(3);
+  std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+  std::vector<Eigen::Vector3d> points_prev, points_curr;
+  for (int i = 0; i < 203; ++i) {
+    Eigen::Vector3d X_curr(2.0 * uniform(generator), 2.0 * uniform(generator),
+                           4.0 + uniform(generator));
+    Eigen::Vector3d X_prev = R * X_curr + t;
+    points_curr.push_back(X_curr / X_curr(2));
+    points_prev.push_back(X_prev / X_prev(2) +
+                          Eigen::Vector3d(2e-3 * uniform(generator),
+                                          2e-3 * uniform(generator), 0.0));
+  }
+
+  for (size_t count : {203u, 13u, 8u, 3u}) {
+    std::vector<Eigen::Vector3d> prev(points_prev.begin(),
+                                      points_prev.begin() + count);
+    std::vector<Eigen::Vector3d> curr(points_curr.begin(),
+                                      points_curr.begin() + count);
+    std::vector<unsigned char> scalar_mask, vector_mask;
+    size_t scalar = vo::FivePointRansac::sampson_inliers(
+        E, prev, curr, 1e-3, false, scalar_mask);
+    size_t vectorized = vo::FivePointRansac::sampson_inliers(
+        E, prev, curr, 1e-3, true, vector_mask);
+    EXPECT_EQ(scalar, vectorized) << count;
+    EXPECT_EQ(scalar_mask, vector_mask) << count;
+    EXPECT_EQ(scalar_mask.size(), count);
+    if (count == 203u) {
+      EXPECT_GT(scalar, 20u);
+      EXPECT_LT(scalar, 183u);
+    }
+  }
+}
+
+/**
+ * @brief Test that the in-house five-point RANSAC stays on the orientation
+ * track of the OpenCV estimator
+ *
+ */
+TEST_F(VisualOdometryTests, TestFivePointSolver) {
+  vo::VisualOdometry five_point_visual_odometry(Eigen::Matrix4d::Identity());
+  five_point_visual_odometry.set_motion_solver(vo::MotionSolver::kFivePoint);
+  EXPECT_EQ(five_point_visual_odometry.get_motion_solver(),
+            vo::MotionSolver::kFivePoint);
+
+  // Real frames are noisy and the two estimators sample differently, so they
+  // only agree to the orientation track; exact recovery is checked on
+  // synthetic points in FivePointRansacTests
+  const double noisy_tolerance = 0.1;
+
+  for (int id = 1101; id <= 1105; ++id) {
+    cv::Mat image =
+        cv::imread("../../indoor_forward_9_davis_with_gt/img/image_0_" +
+                   std::to_string(id) + ".png");
+    test_visual_odometry->update_pose(image);
+    five_point_visual_odometry.update_pose(image);
+
+    Eigen::Matrix4d opencv_pose = test_visual_odometry->get_pose();
+    Eigen::Matrix4d five_point_pose = five_point_visual_odometry.get_pose();
+
+    Eigen::Matrix3d R_diff = opencv_pose.block<3, 3>(0, 0).transpose() *
+                             five_point_pose.block<3, 3>(0, 0);
+    double angle = std::acos(std::min(1.0, (R_diff.trace() - 1.0) / 2.0));
+    EXPECT_LT(angle, noisy_tolerance);
+
+    EXPECT_TRUE(five_point_pose.allFinite());
+    if (id > 1101) {
+      EXPECT_GT(five_point_visual_odometry.get_last_ransac_iterations(), 0);
+    }
+  }
+}
+
+/**
+ * @brief Test that frames between keyframes keep the keyframe pose and that
+ * keyframes stay on the orientation track of the every-frame estimate
+ *
+ */
+TEST_F(VisualOdometryTests, TestKeyframeSelection) {
+  vo::VisualOdometry keyframe_visual_odometry(Eigen::Matrix4d::Identity());
+
+  // Unreachable parallax and track thresholds, the interval alone decides
+  vo::KeyframePolicy policy;
+  policy.min_median_displacement = 1e9;
+  policy.min_tracked_ratio = 0.0;
+  policy.max_interval = 0.09;
+  keyframe_visual_odometry.set_keyframe_selection(true, policy);
+
+  for (int id = 1101; id <= 1105; ++id) {
+    cv::Mat image =
+        cv::imread("../../indoor_forward_9_davis_with_gt/img/image_0_" +
+                   std::to_string(id) + ".png");
+    Eigen::Matrix4d previous_pose = keyframe_visual_odometry.get_pose();
+
+    // Frames 50 ms apart, so every other frame is a keyframe
+    keyframe_visual_odometry.update_pose(image, (id - 1101) * 0.05);
+    test_visual_odometry->update_pose(image);
+
+    Eigen::Matrix4d pose = keyframe_visual_odometry.get_pose();
+    EXPECT_TRUE(pose.allFinite());
+    EXPECT_EQ(keyframe_visual_odometry.is_keyframe(), (id - 1101) % 2 == 0);
+    if (!keyframe_visual_odometry.is_keyframe()) {
+      EXPECT_EQ((pose - previous_pose).norm(), 0.0);
+      continue;
+    }
+
+    Eigen::Matrix3d R_diff = test_visual_odometry->get_pose()
+                                 .block<3, 3>(0, 0)
+                                 .transpose() *
+                             pose.block<3, 3>(0, 0);
+    double angle = std::acos(std::min(1.0, (R_diff.trace() - 1.0) / 2.0));
+    EXPECT_LT(angle, 0.1);
+  }
+}
+
+/**
+ * @brief Construct a test for a keyframe forced with too few matches to
+ * estimate the motion
+ *
+ */
+TEST_F(VisualOdometryTests, TestKeyframeKeptOnFailedEstimate) {
+  // At most four tracks, fewer than the five-point solver needs; the
+  // interval alone forces the keyframes
+  test_visual_odometry->set_max_features(4);
+  vo::KeyframePolicy policy;
+  policy.min_tracked_ratio = 0.0;
+  policy.max_interval = 0.5;
+  test_visual_odometry->set_keyframe_selection(true, policy);
+
+  cv::Mat image =
+      cv::imread("../../indoor_forward_9_davis_with_gt/img/image_0_1101.png");
+  EXPECT_FALSE(test_visual_odometry->update_pose(image, 0.0));
+  EXPECT_TRUE(test_visual_odometry->is_keyframe());
+  EXPECT_EQ(test_visual_odometry->get_keyframe_timestamp(), 0.0);
+
+  // The same image matches all of its tracks, but not enough to estimate
+  // the motion, so the first keyframe stays the anchor
+  for (double timestamp : {1.0, 2.0}) {
+    EXPECT_FALSE(test_visual_odometry->update_pose(image, timestamp));
+    EXPECT_FALSE(test_visual_odometry->is_keyframe());
+    EXPECT_EQ(test_visual_odometry->get_keyframe_timestamp(), 0.0);
+    const vo::TrackFrame& frame = test_visual_odometry->get_tracks().current();
+    ASSERT_GT(frame.size(), 0u);
+    EXPECT_GT(*std::max_element(frame.ages.begin(), frame.ages.end()), 0u);
+  }
+  Eigen::Matrix4d pose = test_visual_odometry->get_pose();
+  EXPECT_EQ((pose - Eigen::Matrix4d::Identity()).norm(), 0.0);
+
+  // A blank frame ends every track of the keyframe, which can then no longer
+  // be matched and is replaced
+  cv::Mat blank = cv::Mat::zeros(image.size(), image.type());
+  EXPECT_FALSE(test_visual_odometry->update_pose(blank, 3.0));
+  EXPECT_TRUE(test_visual_odometry->is_keyframe());
+  EXPECT_EQ(test_visual_odometry->get_keyframe_timestamp(), 3.0);
+}
+
+/**
+ * @brief Test that the local bundle adjustment stays on the orientation track
+ * of the frame-to-frame estimate and leaves the window with lower
+ * reprojection errors than the unrefined poses
+ *
+ */
+TEST_F(VisualOdometryTests, TestLocalBa) {
+  vo::VisualOdometry ba_visual_odometry(Eigen::Matrix4d::Identity());
+  ba_visual_odometry.set_local_ba(true, 4);
+
+  bool lowered = false;
+  for (int id = 1101; id <= 1105; ++id) {
+    cv::Mat image =
+        cv::imread("../../indoor_forward_9_davis_with_gt/img/image_0_" +
+                   std::to_string(id) + ".png");
+    test_visual_odometry->update_pose(image);
+    ba_visual_odometry.update_pose(image);
+
+    Eigen::Matrix4d pose = ba_visual_odometry.get_pose();
+    EXPECT_TRUE(pose.allFinite());
+
+    // From the second frame on every frame is refined against the earlier
+    // ones, starting from the frame-to-frame estimate
+    const ba::SlidingWindowBa& local_ba = ba_visual_odometry.get_local_ba();
+    if (id > 1101) {
+      EXPECT_GT(local_ba.get_initial_cost(), 0.0);
+      EXPECT_LE(local_ba.get_last_cost(), local_ba.get_initial_cost());
+      lowered |= local_ba.get_last_cost() < local_ba.get_initial_cost();
+    }
+
+    Eigen::Matrix3d R_diff = test_visual_odometry->get_pose()
+                                 .block<3, 3>(0, 0)
+                                 .transpose() *
+                             pose.block<3, 3>(0, 0);
+    double angle = std::acos(std::min(1.0, (R_diff.trace() - 1.0) / 2.0));
+    EXPECT_LT(angle, 0.1);
+  }
+  EXPECT_TRUE(lowered);
+}
+
+/**
+ * @brief Test fixture for the sliding-window bundle adjustment
+ *
+ */
+class SlidingWindowBaTests : public ::testing::Test {
+ protected:
+  /**
+   * @brief Function to project landmarks into a camera
+   *
+   * @param world: landmark positions
+   * @param first_id: track id of the first landmark
+   * @param pose: camera to world pose
+   * @param generator: noise source
+   * @param ids: output track ids
+   * @param points: output normalized image points with 1e-3 noise
+   */
+  void project_landmarks(const std::vector<Eigen::Vector3d>& world,
+                         uint64_t first_id, const Eigen::Matrix4d& pose,
+                         std::mt19937& generator, std::vector<uint64_t>& ids,
+                         std::vector<Eigen::Vector3d>& points) {
+    std::normal_distribution<double> noise(0.0, 1e-3);
+    const Eigen::Matrix3d R = pose.block<3, 3>(0, 0);
+    const Eigen::Vector3d p = pose.block<3, 1>(0, 3);
+    for (size_t i = 0; i < world.size(); ++i) {
+      Eigen::Vector3d X = R.transpose() * (world[i] - p);
+      ids.push_back(first_id + i);
+      points.push_back(X / X(2) + Eigen::Vector3d(noise(generator),
+                                                  noise(generator), 0.0));
+    }
+  }
+
+  /**
+   * @brief Function to run a window over a long trajectory: 30 keyframes
+   * 0.3 apart, each seeing 200 landmarks of which 40 are new, and every
+   * keyframe after the anchor starting from a rotation almost 9e-3 off
+   *
+   * @param window
+   * @param seed: seed of the landmarks and the noise
+   * @param rotation_error: output largest rotation error of the newest
+   * keyframe
+   * @return double: position error of the last keyframe
+   */
+  double track_long_trajectory(ba::SlidingWindowBa& window, unsigned seed,
+                               double& rotation_error) {
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+    std::vector<Eigen::Vector3d> world;
+    for (int i = 0; i < 1200; ++i)
+      world.emplace_back(0.0075 * i - 0.6 + 3.0 * uniform(generator),
+                         2.5 * uniform(generator),
+                         5.0 + 3.0 * uniform(generator));
+
+    rotation_error = 0.0;
+    Eigen::Matrix4d pose = Eigen::Matrix4d::Identity();
+    for (int k = 0; k < 30; ++k) {
+      pose.block<3, 3>(0, 0) =
+          io::so3::exp(Eigen::Vector3d(0.0, 0.02 * std::sin(0.3 * k), 0.0));
+      pose(0, 3) = 0.3 * k;
+
+      std::vector<Eigen::Vector3d> visible(world.begin() + 40 * k,
+                                           world.begin() + 40 * k + 200);
+      std::vector<uint64_t> ids;
+      std::vector<Eigen::Vector3d> points;
+      project_landmarks(visible, 40 * k, pose, generator, ids, points);
+
+      Eigen::Matrix4d initial = pose;
+      if (k > 0)
+        initial.block<3, 3>(0, 0) *=
+            io::so3::exp(Eigen::Vector3d(0.005, -0.005, 0.005));
+      EXPECT_TRUE(window.add_keyframe(initial, ids, points));
+      window.optimize();
+
+      // A window of 4 sees at most 320 landmarks
+      EXPECT_LE(window.size(), 4u);
+      EXPECT_LE(window.get_prior_size(), 4u);
+      EXPECT_LE(window.landmark_count(), 320u);
+      EXPECT_TRUE(std::isfinite(window.get_last_cost()));
+
+      Eigen::Matrix3d R_error =
+          window.get_latest_pose().block<3, 3>(0, 0).transpose() *
+          pose.block<3, 3>(0, 0);
+      rotation_error =
+          std::max(rotation_error, io::so3::log(R_error).norm());
+    }
+    return (window.get_latest_pose().block<3, 1>(0, 3) -
+            pose.block<3, 1>(0, 3))
+        .norm();
+  }
+};
+
+/**
+ * @brief Test that the window refines perturbed keyframe poses up to the
+ * scale of monocular vision
+ *
+ */
+TEST_F(SlidingWindowBaTests, TestRefinesPerturbedPoses) {
+  std::mt19937 generator(5);
+  std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+  std::vector<Eigen::Vector3d> world;
+  for (int i = 0; i < 300; ++i)
+    world.emplace_back(3.0 * uniform(generator), 2.0 * uniform(generator),
+                       6.0 + 2.0 * uniform(generator));
+
+  const int keyframes = 6;
+  ba::SlidingWindowBa window(keyframes, 0.01);
+  std::vector<Eigen::Matrix4d, Eigen::aligned_allocator<Eigen::Matrix4d>>
+      truth;
+  Eigen::Vector3d first_baseline = Eigen::Vector3d::Zero();
+  for (int k = 0; k < keyframes; ++k) {
+    Eigen::Matrix4d pose = Eigen::Matrix4d::Identity();
+    pose.block<3, 3>(0, 0) =
+        io::so3::exp(Eigen::Vector3d(0.0, 0.03 * k, 0.01 * k));
+    pose.block<3, 1>(0, 3) = Eigen::Vector3d(0.3 * k, 0.05 * k, 0.1 * k);
+    truth.push_back(pose);
+
+    std::vector<uint64_t> ids;
+    std::vector<Eigen::Vector3d> points;
+    project_landmarks(world, 0, pose, generator, ids, points);
+
+    // Every keyframe after the anchor starts from a wrong pose
+    Eigen::Matrix4d initial = pose;
+    if (k > 0) {
+      initial.block<3, 3>(0, 0) *=
+          io::so3::exp(Eigen::Vector3d(0.02, -0.015, 0.01));
+      initial.block<3, 1>(0, 3) += Eigen::Vector3d(0.03, -0.02, 0.04);
+    }
+    if (k == 1) first_baseline = initial.block<3, 1>(0, 3);
+    ASSERT_TRUE(window.add_keyframe(initial, ids, points));
+    EXPECT_EQ(window.optimize() > 0, k > 0);
+  }
+  EXPECT_EQ(window.landmark_count(), world.size());
+
+  // Monocular translations are only known up to a common scale, which the
+  // window keeps at the starting length of the first baseline
+  const Eigen::Vector3d refined_baseline = window.get_pose(1).block<3, 1>(0, 3);
+  EXPECT_NEAR(refined_baseline.norm(), first_baseline.norm(),
+              1e-3 * first_baseline.norm());
+  double numerator = 0.0, denominator = 0.0;
+  for (int k = 0; k < keyframes; ++k) {
+    numerator += window.get_pose(k).block<3, 1>(0, 3).dot(
+        truth[k].block<3, 1>(0, 3));
+    denominator += truth[k].block<3, 1>(0, 3).squaredNorm();
+  }
+  const double scale = numerator / denominator;
+  EXPECT_GT(scale, 0.0);
+
+  for (int k = 0; k < keyframes; ++k) {
+    Eigen::Matrix4d pose = window.get_pose(k);
+    Eigen::Matrix3d R_error =
+        pose.block<3, 3>(0, 0).transpose() * truth[k].block<3, 3>(0, 0);
+    EXPECT_LT(io::so3::log(R_error).norm(), 3e-3);
+    EXPECT_LT((pose.block<3, 1>(0, 3) - scale * truth[k].block<3, 1>(0, 3))
+                  .norm(),
+              0.01 * scale);
+  }
+}
+
+/**
+ * @brief Test that the window keeps a bounded number of keyframes and drops
+ * the landmarks only the removed keyframes saw
+ *
+ */
+TEST_F(SlidingWindowBaTests, TestWindowIsBounded) {
+  std::mt19937 generator(3);
+  std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+  std::vector<Eigen::Vector3d> world;
+  for (int i = 0; i < 1000; ++i)
+    world.emplace_back(3.0 * uniform(generator), 2.0 * uniform(generator),
+                       6.0 + 2.0 * uniform(generator));
+
+  ba::SlidingWindowBa window(3);
+  Eigen::Matrix4d pose = Eigen::Matrix4d::Identity();
+  for (int k = 0; k < 8; ++k) {
+    pose(0, 3) = 0.3 * k;
+
+    // Every keyframe sees 200 landmarks, 20 of them new
+    std::vector<Eigen::Vector3d> visible(world.begin() + 20 * k,
+                                         world.begin() + 20 * k + 200);
+    std::vector<uint64_t> ids;
+    std::vector<Eigen::Vector3d> points;
+    project_landmarks(visible, 20 * k, pose, generator, ids, points);
+    ASSERT_TRUE(window.add_keyframe(pose, ids, points));
+    window.optimize();
+
+    EXPECT_EQ(window.size(), static_cast<size_t>(std::min(k + 1, 3)));
+    EXPECT_LE(window.landmark_count(), 240u);
+  }
+
+  // Mismatched inputs are rejected
+  EXPECT_FALSE(window.add_keyframe(pose, std::vector<uint64_t>(2),
+                                   std::vector<Eigen::Vector3d>(1)));
+  EXPECT_EQ(window.size(), 3u);
+}
+
+/**
+ * @brief Test that marginalization keeps the prior and the window bounded
+ * over a long trajectory while refining the poses
+ *
+ */
+TEST_F(SlidingWindowBaTests, TestMarginalizationIsBounded) {
+  ba::SlidingWindowBa window(4, 0.01);
+  window.set_marginalization(true);
+  double rotation_error = 0.0;
+  track_long_trajectory(window, 1, rotation_error);
+  EXPECT_EQ(window.size(), 4u);
+  EXPECT_GT(window.get_prior_size(), 0u);
+
+  // Every keyframe starts almost 9e-3 off, so an idle window fails this
+  EXPECT_LT(rotation_error, 2e-3);
+
+  // Disabling the marginalization drops the prior
+  window.set_marginalization(false);
+  EXPECT_EQ(window.get_prior_size(), 0u);
+}
+
+/**
+ * @brief Test that the keyframes folded into the prior keep holding the
+ * scale and the position of a long trajectory, which the same window loses
+ * faster when it drops them
+ *
+ */
+TEST_F(SlidingWindowBaTests, TestMarginalizationReducesDrift) {
+  ba::SlidingWindowBa marginalized(4, 0.01);
+  marginalized.set_marginalization(true);
+  ba::SlidingWindowBa dropped(4, 0.01);
+
+  double marginalized_rotation = 0.0, dropped_rotation = 0.0;
+  const double marginalized_error =
+      track_long_trajectory(marginalized, 1, marginalized_rotation);
+  const double dropped_error =
+      track_long_trajectory(dropped, 1, dropped_rotation);
+  EXPECT_GT(dropped_error, 0.0);
+  EXPECT_LT(marginalized_error, dropped_error);
+  EXPECT_LT(marginalized_rotation, 2e-3);
+}
+
+/**
+ * @brief Test fixture for the pose graph, with a camera driving a circle
+ * and an odometry that drifts in yaw
+ *
+ */
+class PoseGraphTests : public ::testing::Test {
+ protected:
+  /**
+   * @brief Function to get the true pose of a node, 6 degrees further along
+   * a circle of radius 5 every node
+   *
+   * @param k: node index
+   * @return Eigen::Matrix4d: camera to world pose
+   */
+  Eigen::Matrix4d true_pose(int k) {
+    const double angle = k * 6.0 * M_PI / 180.0;
+    Eigen::Matrix4d pose = Eigen::Matrix4d::Identity();
+    pose.block<3, 3>(0, 0) = io::so3::exp(Eigen::Vector3d(0.0, angle, 0.0));
+    pose(0, 3) = 5.0 * std::sin(angle);
+    pose(2, 3) = 5.0 * std::cos(angle);
+    return pose;
+  }
+
+  /**
+   * @brief Function to add the nodes of a lap, chained by odometry edges
+   * with a yaw bias and noise
+   *
+   * @param graph
+   * @param nodes: number of nodes
+   */
+  void add_odometry(ba::PoseGraph& graph, int nodes) {
+    std::mt19937 generator(11);
+    std::normal_distribution<double> noise(0.0, 1e-3);
+    graph.add_node(true_pose(0));
+    for (int k = 1; k < nodes; ++k) {
+      Eigen::Matrix4d relative = true_pose(k - 1).inverse() * true_pose(k);
+      relative.block<3, 3>(0, 0) *= io::so3::exp(
+          Eigen::Vector3d(noise(generator), 0.005 + noise(generator), 0.0));
+      relative.block<3, 1>(0, 3) +=
+          Eigen::Vector3d(noise(generator), noise(generator), 0.0);
+      graph.add_node(graph.get_pose(k - 1) * relative);
+      ASSERT_TRUE(graph.add_edge(k - 1, k, relative));
+    }
+  }
+
+  /**
+   * @brief Function to get the position error of a node
+   *
+   * @param graph
+   * @param k: node index
+   * @return double
+   */
+  double position_error(const ba::PoseGraph& graph, int k) {
+    return (graph.get_pose(k).block<3, 1>(0, 3) -
+            true_pose(k).block<3, 1>(0, 3))
+        .norm();
+  }
+};
+
+/**
+ * @brief Test that a loop edge pulls the end of a drifting lap back onto its
+ * start
+ *
+ */
+TEST_F(PoseGraphTests, TestLoopCorrectsDrift) {
+  ba::PoseGraph graph;
+  add_odometry(graph, 60);
+
+  // A chain of odometry edges is already consistent
+  EXPECT_EQ(graph.update(), 1);
+  const double drifted = position_error(graph, 59);
+  EXPECT_GT(drifted, 1.0);
+
+  // The lap closes between the last and the first node
+  const Eigen::Matrix4d loop = true_pose(0).inverse() * true_pose(59);
+  ASSERT_TRUE(graph.add_edge(0, 59, loop,
+                             1e3 * Eigen::Matrix<double, 6, 6>::Identity(),
+                             ba::EdgeType::kLoop));
+  EXPECT_GT(graph.update(), 0);
+  EXPECT_EQ(graph.update(), 0);
+
+  EXPECT_LT(position_error(graph, 59), 0.02 * drifted);
+  for (int k = 0; k < 60; ++k) EXPECT_LT(position_error(graph, k), 0.1);
+  EXPECT_TRUE(graph.get_pose(0).isApprox(true_pose(0)));
+
+  // Edges must link two different nodes of the graph
+  EXPECT_FALSE(graph.add_edge(3, 3, loop));
+  EXPECT_FALSE(graph.add_edge(0, 60, loop));
+  EXPECT_EQ(graph.edge_count(), 60u);
+}
+
+/**
+ * @brief Test that absorbing a loop incrementally, without the nodes before
+ * it, reaches the solution of the full optimization
+ *
+ */
+TEST_F(PoseGraphTests, TestIncrementalMatchesFull) {
+  ba::PoseGraph incremental, full;
+  add_odometry(incremental, 60);
+  add_odometry(full, 60);
+  incremental.update();
+
+  const Eigen::Matrix4d loop = true_pose(20).inverse() * true_pose(59);
+  incremental.add_edge(20, 59, loop);
+  full.add_edge(20, 59, loop);
+  EXPECT_GT(incremental.update(10), 0);
+  EXPECT_GT(full.optimize(10), 0);
+
+  EXPECT_NEAR(incremental.get_last_cost(), full.get_last_cost(), 1e-9);
+  for (int k = 0; k < 60; ++k)
+    EXPECT_TRUE(incremental.get_pose(k).isApprox(full.get_pose(k), 1e-6));
+
+  full.reset();
+  EXPECT_EQ(full.size(), 0u);
+  EXPECT_EQ(full.optimize(), 0);
+}
+
+/**
+ * @brief Test that loops over a lap that drifted far from the truth still
+ * converge, where the full Gauss-Newton steps overshoot and raise the cost
+ *
+ */
+TEST_F(PoseGraphTests, TestLargeDriftConverges) {
+  ba::PoseGraph graph;
+  graph.add_node(true_pose(0));
+  for (int k = 1; k < 60; ++k) {
+    Eigen::Matrix4d relative = true_pose(k - 1).inverse() * true_pose(k);
+    relative.block<3, 3>(0, 0) *=
+        io::so3::exp(Eigen::Vector3d(0.05, 0.05, 0.05));
+    graph.add_node(graph.get_pose(k - 1) * relative);
+    ASSERT_TRUE(graph.add_edge(k - 1, k, relative));
+  }
+  EXPECT_GT(position_error(graph, 59), 10.0);
+
+  // Three nested loops, the inner ones spanning ever shorter parts of the lap
+  for (int k = 0; k < 15; k += 5)
+    ASSERT_TRUE(graph.add_edge(
+        k, 59 - k, true_pose(k).inverse() * true_pose(59 - k),
+        1e3 * Eigen::Matrix<double, 6, 6>::Identity(), ba::EdgeType::kLoop));
+  EXPECT_GT(graph.update(20), 2);
+
+  // Undamped steps stop with a cost above 1e4
+  EXPECT_LT(graph.get_last_cost(), 10.0);
+  EXPECT_LT(position_error(graph, 59), 1e-3);
+}
+
+/**
+ * @brief Construct a test for the Hamming distance kernel
+ *
+ */
+TEST(BinaryMatcherTests, TestHammingDistance) {
+  std::vector<uint8_t> a(32, 0x00), b(32, 0x00);
+  EXPECT_EQ(vo::BinaryMatcher::hamming_distance(a.data(), b.data(), 32), 0);
+
+  b[0] = 0xff;
+  b[31] = 0x01;
+  EXPECT_EQ(vo::BinaryMatcher::hamming_distance(a.data(), b.data(), 32), 9);
+
+  std::fill(b.begin(), b.end(), 0xff);
+  EXPECT_EQ(vo::BinaryMatcher::hamming_distance(a.data(), b.data(), 32), 256);
+}
+
+/**
+ * @brief Construct a test comparing the SIMD Hamming kernels with the scalar
+ * one on random descriptors
+ *
+ */
+TEST(BinaryMatcherTests, TestHammingKernelsAgree) {
+  std::mt19937 rng(7);
+  std::uniform_int_distribution<int> byte(0, 255);
+
+  // Lengths around the 8, 16 and 32 byte blocks exercise every tail, the
+  // offset every load alignment
+  std::vector<uint8_t> a(128), b(128);
+  for (int bytes : {1, 7, 8, 15, 16, 17, 31, 32, 33, 61, 64, 95}) {
+    for (int trial = 0; trial < 20; trial++) {
+      for (size_t i = 0; i < a.size(); i++) {
+        a[i] = static_cast<uint8_t>(byte(rng));
+        b[i] = static_cast<uint8_t>(byte(rng));
+      }
+      const int offset = trial % 8;
+      const int expected = vo::BinaryMatcher::hamming_distance(
+          a.data() + offset, b.data() + offset, bytes,
+          vo::HammingImplementation::kScalar);
+
+      int reference = 0;
+      for (int i = 0; i < bytes; i++)
+        for (int bit = 0; bit < 8; bit++)
+          reference += ((a[offset + i] ^ b[offset + i]) >> bit) & 1;
+      ASSERT_EQ(expected, reference);
+
+      for (vo::HammingImplementation implementation :
+           {vo::HammingImplementation::kAuto,
+            vo::HammingImplementation::kPopcnt,
+            vo::HammingImplementation::kSsse3,
+            vo::HammingImplementation::kAvx2}) {
+        const int distance = vo::BinaryMatcher::hamming_distance(
+            a.data() + offset, b.data() + offset, bytes, implementation);
+        // Kernels the CPU cannot run are skipped
+        if (distance < 0) continue;
+        EXPECT_EQ(distance, expected) << "bytes " << bytes;
+      }
+    }
+  }
+}
+
+/**
+ * @brief Construct a test for LSH with keys wider than the bucket table
+ *
+ */
+TEST(BinaryMatcherTests, TestWideLshKeys) {
+  cv::Mat train_descriptors(200, 32, CV_8U);
+  cv::randu(train_descriptors, cv::Scalar(0), cv::Scalar(256));
+  cv::Mat query_descriptors;
+  for (int row = 0; row < train_descriptors.rows; row += 10)
+    query_descriptors.push_back(train_descriptors.row(row));
+
+  // 24 bit keys are hashed into a table sized to the 200 train rows
+  vo::LshParams params;
+  params.key_bits = 24;
+  vo::BinaryMatcher matcher(vo::MatcherIndex::kLsh, params);
+  std::vector<std::vector<cv::DMatch>> matches;
+  matcher.knn_match(query_descriptors, train_descriptors, matches, 1);
+
+  ASSERT_EQ(matches.size(), static_cast<size_t>(query_descriptors.rows));
+  for (int query = 0; query < query_descriptors.rows; query++) {
+    ASSERT_EQ(matches[query].size(), 1u);
+    EXPECT_EQ(matches[query][0].trainIdx, query * 10);
+    EXPECT_EQ(matches[query][0].distance, 0.0f);
+  }
+}
+
+/**
+ * @brief Construct a test for brute-force and LSH KNN matching
+ *
+ */
+TEST(BinaryMatcherTests, TestKnnMatch) {
+  cv::Mat train_descriptors(200, 32, CV_8U);
+  cv::randu(train_descriptors, cv::Scalar(0), cv::Scalar(256));
+
+  // Queries are exact copies of every tenth train row
+  cv::Mat query_descriptors;
+  for (int row = 0; row < train_descriptors.rows; row += 10)
+    query_descriptors.push_back(train_descriptors.row(row));
+
+  for (vo::MatcherIndex index :
+       {vo::MatcherIndex::kBruteForce, vo::MatcherIndex::kLsh}) {
+    vo::BinaryMatcher matcher(index);
+    std::vector<std::vector<cv::DMatch>> matches;
+    matcher.knn_match(query_descriptors, train_descriptors, matches, 2);
+
+    ASSERT_EQ(matches.size(), static_cast<size_t>(query_descriptors.rows));
+    for (int query = 0; query < query_descriptors.rows; query++) {
+      ASSERT_GE(matches[query].size(), 1u);
+      EXPECT_EQ(matches[query][0].trainIdx, query * 10);
+      EXPECT_EQ(matches[query][0].distance, 0.0f);
+    }
+  }
+}
+
+/**
+ * @brief Construct a test for the spatial grid index
+ *
+ */
+TEST(FeatureGridTests, TestQuery) {
+  std::vector<cv::KeyPoint> keypoints = {
+      cv::KeyPoint(cv::Point2f(10, 10), 1), cv::KeyPoint(cv::Point2f(50, 40), 1),
+      cv::KeyPoint(cv::Point2f(55, 45), 1),
+      cv::KeyPoint(cv::Point2f(300, 200), 1)};
+
+  vo::FeatureGrid grid(346, 260, 16);
+  grid.build(keypoints);
+
+  std::vector<int> indices;
+  grid.query(cv::Point2f(52, 42), 8, indices);
+  std::sort(indices.begin(), indices.end());
+  EXPECT_EQ(indices, std::vector<int>({1, 2}));
+
+  grid.query(cv::Point2f(300, 200), 4, indices);
+  EXPECT_EQ(indices, std::vector<int>({3}));
+
+  // Coordinates far outside the int range clamp to the border cells
+  grid.query(cv::Point2f(1e30f, 1e30f), 8, indices);
+  EXPECT_TRUE(indices.empty());
+  grid.query(cv::Point2f(-1e30f, -1e30f), 8, indices);
+  EXPECT_EQ(indices, std::vector<int>({0}));
+}
+
+/**
+ * @brief Construct a test for guided matching on dataset images
+ *
+ */
+TEST_F(VisualOdometryTests, TestGuidedMatching) {
+  // Share of the global inliers guided matching has to recover; the ratio
+  // test sees different second-best candidates inside the search window, so
+  // the sets may differ by a few borderline matches
+  const double min_overlap = 0.9;
+
+  vo::VisualOdometry global_odometry(Eigen::Matrix4d::Identity());
+  global_odometry.set_max_features(1000);
+  test_visual_odometry->set_guided_matching(true, 40.0f);
+  test_visual_odometry->set_max_features(1000);
+
+  // Current positions of the tracks that passed RANSAC this frame
+  auto inlier_points = [](const vo::VisualOdometry& odometry) {
+    const vo::TrackFrame& frame = odometry.get_tracks().current();
+    std::vector<cv::Point2f> points;
+    for (size_t i = 0; i < frame.size(); i++)
+      if (frame.ages[i] > 0 && frame.inliers[i])
+        points.push_back(frame.points[i]);
+    return points;
+  };
+
+  for (int id = 1101; id <= 1105; ++id) {
+    cv::Mat image =
+        cv::imread("../../indoor_forward_9_davis_with_gt/img/image_0_" +
+                   std::to_string(id) + ".png");
+    // The camera is static over these frames, so the identity is the true
+    // rotation; without a prior VO would predict with the rotation it
+    // estimated last, which is arbitrary for frames without parallax
+    if (id > 1101)
+      test_visual_odometry->set_rotation_prior(Eigen::Matrix3d::Identity());
+    test_visual_odometry->update_pose(image);
+    global_odometry.update_pose(image);
+    if (id == 1101) continue;
+
+    EXPECT_FALSE(test_visual_odometry->get_last_guided_fallback());
+    EXPECT_EQ(test_visual_odometry->get_last_unpredicted_points(), 0u);
+
+    // Both front-ends detect the same keypoints, so a shared inlier sits at
+    // exactly the same position
+    std::vector<cv::Point2f> guided = inlier_points(*test_visual_odometry);
+    std::vector<cv::Point2f> global = inlier_points(global_odometry);
+    ASSERT_FALSE(global.empty());
+    size_t shared = 0;
+    for (const cv::Point2f& point : guided)
+      for (const cv::Point2f& other : global)
+        if (point.x == other.x && point.y == other.y) {
+          shared++;
+          break;
+        }
+    EXPECT_GE(shared, min_overlap * global.size());
+    EXPECT_GE(shared, min_overlap * guided.size());
+  }
+
+  Eigen::Matrix4d pose = test_visual_odometry->get_pose();
+  EXPECT_TRUE(pose.allFinite());
+  Eigen::Matrix3d R = pose.block<3, 3>(0, 0);
+  EXPECT_NEAR(R.determinant(), 1.0, 1e-6);
+}
+
+/**
+ * @brief Construct a test for guided matching under a wrong rotation prior
+ *
+ */
+TEST_F(VisualOdometryTests, TestGuidedMatchingFallback) {
+  test_visual_odometry->set_guided_matching(true, 40.0f);
+  test_visual_odometry->set_max_features(1000);
+
+  // A half turn about y takes every ray behind the camera. A 30 degree turn
+  // about y keeps every ray in front but moves every prediction about 100 px
+  // away from the static scene, outside its search window.
+  const Eigen::Matrix3d behind =
+      Eigen::AngleAxisd(M_PI, Eigen::Vector3d::UnitY()).toRotationMatrix();
+  const Eigen::Matrix3d shifted =
+      Eigen::AngleAxisd(M_PI / 6.0, Eigen::Vector3d::UnitY())
+          .toRotationMatrix();
+
+  for (int id = 1101; id <= 1103; ++id) {
+    cv::Mat image =
+        cv::imread("../../indoor_forward_9_davis_with_gt/img/image_0_" +
+                   std::to_string(id) + ".png");
+    if (id == 1102) test_visual_odometry->set_rotation_prior(behind);
+    if (id == 1103) test_visual_odometry->set_rotation_prior(shifted);
+    test_visual_odometry->update_pose(image);
+
+    if (id == 1102) {
+      EXPECT_EQ(test_visual_odometry->get_last_unpredicted_points(),
+                test_visual_odometry->get_tracks().previous().size());
+    }
+    if (id == 1103) {
+      EXPECT_EQ(test_visual_odometry->get_last_unpredicted_points(), 0u);
+      EXPECT_TRUE(test_visual_odometry->get_last_guided_fallback());
+    }
+  }
+
+  Eigen::Matrix4d pose = test_visual_odometry->get_pose();
+  EXPECT_TRUE(pose.allFinite());
+  Eigen::Matrix3d R = pose.block<3, 3>(0, 0);
+  EXPECT_NEAR(R.determinant(), 1.0, 1e-6);
+}
+
+/**
+ * @brief Construct a test for the KLT tracking front-end
+ *
+ */
+TEST_F(VisualOdometryTests, TestKltFrontEnd) {
+  const size_t min_tracks = 100;
+  const int max_tracks = 200;
+  test_visual_odometry->set_front_end(vo::FrontEnd::kKlt);
+  test_visual_odometry->set_klt_track_limits(min_tracks, max_tracks);
+  EXPECT_EQ(test_visual_odometry->get_front_end(), vo::FrontEnd::kKlt);
+
+  std::vector<uint64_t> previous_ids;
+  std::vector<uint32_t> previous_ages;
+  size_t frames_without_detection = 0;
+  uint32_t oldest_track = 0;
+  for (int id = 1101; id <= 1105; ++id) {
+    // On the last frame the budget lies above every track the previous frame
+    // held, so the tracks have to be topped up
+    size_t budget = min_tracks;
+    if (id == 1105) {
+      budget = max_tracks + 50;
+      test_visual_odometry->set_klt_track_limits(budget, max_tracks + 100);
+    }
+
+    cv::Mat image =
+        cv::imread("../../indoor_forward_9_davis_with_gt/img/image_0_" +
+                   std::to_string(id) + ".png");
+    test_visual_odometry->update_pose(image);
+
+    const vo::TrackFrame& frame = test_visual_odometry->get_tracks().current();
+    ASSERT_GT(frame.size(), 0u);
+    uint64_t max_previous_id = 0;
+    for (uint64_t track_id : previous_ids)
+      max_previous_id = std::max(max_previous_id, track_id);
+
+    size_t continued = 0, detected = 0;
+    for (size_t i = 0; i < frame.size(); i++) {
+      oldest_track = std::max(oldest_track, frame.ages[i]);
+      if (frame.ages[i] == 0) {
+        // A new track gets a fresh id
+        detected++;
+        if (!previous_ids.empty()) {
+          EXPECT_GT(frame.ids[i], max_previous_id);
+        }
+        continue;
+      }
+
+      // A continued track keeps its id and is one frame older
+      continued++;
+      size_t j = 0;
+      while (j < previous_ids.size() && previous_ids[j] != frame.ids[i]) j++;
+      ASSERT_LT(j, previous_ids.size());
+      EXPECT_EQ(frame.ages[i], previous_ages[j] + 1);
+    }
+
+    if (id == 1101) {
+      EXPECT_EQ(continued, 0u);
+      EXPECT_LE(detected, static_cast<size_t>(max_tracks));
+    } else if (continued < budget) {
+      EXPECT_GT(detected, 0u);
+    } else {
+      EXPECT_EQ(detected, 0u);
+      frames_without_detection++;
+    }
+
+    previous_ids = frame.ids;
+    previous_ages = frame.ages;
+  }
+
+  // Consecutive frames keep most tracks, so the budget is met at least once
+  // and some tracks last through the whole sequence
+  EXPECT_GT(frames_without_detection, 0u);
+  EXPECT_EQ(oldest_track, 4u);
+
+  Eigen::Matrix4d pose = test_visual_odometry->get_pose();
+  Eigen::Matrix3d R = pose.block<3, 3>(0, 0);
+  EXPECT_TRUE(pose.allFinite());
+  EXPECT_NEAR(R.determinant(), 1.0, 1e-6);
+}
+
+/**
+ * @brief Construct a test for reading tracks back several frames later
+ *
+ */
+TEST_F(VisualOdometryTests, TestLongTrackHistory) {
+  const size_t history = 4;
+  test_visual_odometry->set_front_end(vo::FrontEnd::kKlt);
+  test_visual_odometry->set_track_history(history);
+  EXPECT_EQ(test_visual_odometry->get_tracks().history_length(), history);
+
+  for (int id = 1101; id <= 1104; ++id) {
+    cv::Mat image =
+        cv::imread("../../indoor_forward_9_davis_with_gt/img/image_0_" +
+                   std::to_string(id) + ".png");
+    test_visual_odometry->update_pose(image);
+  }
+
+  const vo::TrackStore& tracks = test_visual_odometry->get_tracks();
+  ASSERT_EQ(tracks.frames_stored(), history);
+
+  // Tracks followed since the first frame are found there under the same id,
+  // at nearly the same position as the frames are static
+  const vo::TrackFrame& current = tracks.frame(0);
+  const vo::TrackFrame& oldest = tracks.frame(history - 1);
+  size_t read_back = 0;
+  for (size_t i = 0; i < current.size(); i++) {
+    if (current.ages[i] < history - 1) continue;
+
+    size_t j = 0;
+    while (j < oldest.size() && oldest.ids[j] != current.ids[i]) j++;
+    ASSERT_LT(j, oldest.size());
+    EXPECT_EQ(oldest.ages[j], current.ages[i] - (history - 1));
+    EXPECT_NEAR(oldest.points[j].x, current.points[i].x, 1.0);
+    EXPECT_NEAR(oldest.points[j].y, current.points[i].y, 1.0);
+    read_back++;
+  }
+  EXPECT_GT(read_back, 0u);
+
+  // The local bundle adjustment keeps the tracks of its whole window
+  test_visual_odometry->set_local_ba(true, 6);
+  EXPECT_EQ(test_visual_odometry->get_tracks().history_length(), 6u);
+  test_visual_odometry->set_local_ba(true, 3);
+  EXPECT_EQ(test_visual_odometry->get_tracks().history_length(), 6u);
+}
+
+/**
+ * @brief Construct a test for the track store ring and id bookkeeping
+ *
+ */
+TEST(TrackStoreTests, TestAdvanceAndContinue) {
+  vo::TrackStore tracks(3);
+  EXPECT_EQ(tracks.history_length(), 3u);
+
+  tracks.advance();
+  tracks.add_track(cv::Point2f(1, 1));
+  tracks.add_track(cv::Point2f(2, 2));
+  const cv::Point2f* first_buffer = tracks.current().points.data();
+
+  tracks.advance();
+  EXPECT_EQ(tracks.current().size(), 0u);
+  EXPECT_EQ(tracks.previous().points.data(), first_buffer);
+
+  size_t index = tracks.continue_track(1, cv::Point2f(3, 3));
+  tracks.add_track(cv::Point2f(4, 4));
+
+  EXPECT_EQ(tracks.current().ids[index], tracks.previous().ids[1]);
+  EXPECT_EQ(tracks.current().ages[index], 1u);
+  EXPECT_EQ(tracks.current().ids[1], 2u);
+  EXPECT_EQ(tracks.frames_stored(), 2u);
+  EXPECT_EQ(tracks.frame(1).size(), 2u);
+}
+
+/**
+ * @brief Construct a test to check that VO keeps tracks across frames
+ *
+ */
+TEST_F(VisualOdometryTests, TestTrackHistory) {
+  for (int id = 1101; id <= 1103; ++id) {
+    cv::Mat image =
+        cv::imread("../../indoor_forward_9_davis_with_gt/img/image_0_" +
+                   std::to_string(id) + ".png");
+    test_visual_odometry->update_pose(image);
+  }
+
+  const vo::TrackFrame& current = test_visual_odometry->get_tracks().current();
+  ASSERT_GT(current.size(), 0u);
+  EXPECT_EQ(current.points.size(), current.size());
+  EXPECT_EQ(current.inliers.size(), current.size());
+  EXPECT_EQ(current.descriptors.rows, static_cast<int>(current.size()));
+  EXPECT_GT(*std::max_element(current.ages.begin(), current.ages.end()), 0u);
+}
+
+/**
+ * @brief Construct a test checking the pipelined VO against the serial loop
+ *
+ */
+TEST_F(VisualOdometryTests, TestPipelineMatchesSerial) {
+  dl::DataLoader data_loader("../../indoor_forward_9_davis_with_gt");
+
+  // Images 1101 to 1105 are the first frames inside the ground truth window
+  pl::PipelineConfig config;
+  config.decode_threads = 2;
+  config.extract_threads = 2;
+  config.queue_capacity = 2;
+  config.start_time = data_loader.start_gt_time;
+  config.finish_time = 1540822844.62;
+
+  vo::VisualOdometry pipelined_visual_odometry(Eigen::Matrix4d::Identity());
+  pl::VoPipeline pipeline(data_loader, pipelined_visual_odometry, config);
+
+  std::vector<std::string> paths;
+  std::vector<Eigen::Matrix4d, Eigen::aligned_allocator<Eigen::Matrix4d>>
+      poses;
+  pl::PipelineStats stats = pipeline.run([&](const pl::PoseResult& result) {
+    EXPECT_EQ(result.index, paths.size());
+    // Without keyframe selection the motion is estimated on every frame
+    EXPECT_TRUE(result.keyframe);
+    EXPECT_EQ(result.motion_estimated, result.index > 0);
+    paths.push_back(result.image_path);
+    poses.push_back(result.pose);
+  });
+
+  ASSERT_EQ(stats.frames, 5u);
+  for (size_t i = 0; i < paths.size(); i++) {
+    EXPECT_EQ(paths[i], "img/image_0_" + std::to_string(1101 + i) + ".png");
+
+    cv::Mat image =
+        cv::imread("../../indoor_forward_9_davis_with_gt/" + paths[i]);
+    EXPECT_EQ(test_visual_odometry->update_pose(image), i > 0);
+    Eigen::Matrix4d serial_pose = test_visual_odometry->get_pose();
+
+    for (int r = 0; r < 4; ++r)
+      for (int c = 0; c < 4; ++c)
+        EXPECT_NEAR(poses[i](r, c), serial_pose(r, c), 1e-9);
+  }
+}
+
+/**
+ * @brief Construct a test checking that the pipeline reads a prefetching
+ * loader through its prefetcher and estimates the same poses
+ *
+ */
+TEST_F(VisualOdometryTests, TestPipelineReadsPrefetchedImages) {
+  pl::PipelineConfig config;
+  config.decode_threads = 2;
+  config.extract_threads = 2;
+  config.queue_capacity = 2;
+  config.finish_time = 1540822844.62;
+
+  std::vector<std::string> paths[2];
+  std::vector<Eigen::Matrix4d, Eigen::aligned_allocator<Eigen::Matrix4d>>
+      poses[2];
+  for (int prefetch = 0; prefetch < 2; ++prefetch) {
+    dl::DataLoader data_loader("../../indoor_forward_9_davis_with_gt");
+    config.start_time = data_loader.start_gt_time;
+    // Prefetch the way app_vo does, skipping the frames before the window
+    if (prefetch) {
+      data_loader.set_image_start_time(config.start_time);
+      data_loader.enable_prefetch(4, 2);
+    }
+    EXPECT_EQ(data_loader.is_prefetching(), prefetch == 1);
+
+    vo::VisualOdometry pipelined_visual_odometry(Eigen::Matrix4d::Identity());
+    pl::VoPipeline pipeline(data_loader, pipelined_visual_odometry, config);
+    pipeline.run([&](const pl::PoseResult& result) {
+      paths[prefetch].push_back(result.image_path);
+      poses[prefetch].push_back(result.pose);
+    });
+  }
+
+  ASSERT_EQ(paths[0].size(), 5u);
+  ASSERT_EQ(paths[1], paths[0]);
+  for (size_t i = 0; i < paths[0].size(); i++)
+    for (int r = 0; r < 4; ++r)
+      for (int c = 0; c < 4; ++c)
+        EXPECT_NEAR(poses[1][i](r, c), poses[0][i](r, c), 1e-9);
+}
+
+/**
+ * @brief Construct a test checking that an exception in a pipeline callback
+ * stops every stage and reaches the caller of run
+ *
+ */
+TEST_F(VisualOdometryTests, TestPipelinePropagatesExceptions) {
+  dl::DataLoader data_loader("../../indoor_forward_9_davis_with_gt");
+  pl::PipelineConfig config;
+  config.decode_threads = 2;
+  config.extract_threads = 2;
+  config.queue_capacity = 2;
+  config.start_time = data_loader.start_gt_time;
+  config.finish_time = 1540822844.62;
+
+  vo::VisualOdometry pipelined_visual_odometry(Eigen::Matrix4d::Identity());
+  pl::VoPipeline pipeline(data_loader, pipelined_visual_odometry, config);
+
+  size_t frames = 0;
+  auto on_pose = [&](const pl::PoseResult& result) {
+    frames++;
+    if (result.index == 2) throw std::runtime_error("callback failed");
+  };
+  EXPECT_THROW(pipeline.run(on_pose), std::runtime_error);
+  EXPECT_EQ(frames, 3u);
+}
+
+/**
+ * @brief Construct a test for grayscale decoding into reused frame buffers
+ *
+ */
+TEST_F(DataLoaderTests, TestGrayscaleReadImage) {
+  test_data_loader->set_image_color(dl::ImageColor::kGrayscale);
+
+  dl::ImageFrame frame;
+  ASSERT_TRUE(test_data_loader->read_image(frame));
+  EXPECT_NEAR(frame.timestamp, 1540822817.214196681976, 1e-2);
+  EXPECT_EQ(frame.image_path, "img/image_0_0.png");
+  EXPECT_EQ(frame.image.rows, 260);
+  EXPECT_EQ(frame.image.cols, 346);
+  EXPECT_EQ(frame.image.channels(), 1);
+
+  // Skip to the bundled consecutive images
+  while (frame.image_path != "img/image_0_1101.png")
+    ASSERT_TRUE(test_data_loader->read_image(frame));
+  ASSERT_FALSE(frame.image.empty());
+  const uchar* buffer = frame.image.data;
+
+  // The next image is decoded into the same buffer
+  ASSERT_TRUE(test_data_loader->read_image(frame));
+  EXPECT_EQ(frame.image_path, "img/image_0_1102.png");
+  EXPECT_EQ(frame.image.channels(), 1);
+  EXPECT_EQ(frame.image.data, buffer);
+}
+
+/**
+ * @brief Construct a test for skipping the images before a start time, with
+ * and without prefetch
+ *
+ */
+TEST_F(DataLoaderTests, TestImageStartTime) {
+  for (int prefetch = 0; prefetch < 2; ++prefetch) {
+    dl::DataLoader data_loader("../../indoor_forward_9_davis_with_gt");
+    data_loader.set_image_start_time(data_loader.start_gt_time);
+    if (prefetch) data_loader.enable_prefetch(4, 2);
+
+    // The bundled images 1101 onwards are the first inside the ground truth
+    dl::ImageFrame frame;
+    ASSERT_TRUE(data_loader.read_image(frame));
+    EXPECT_GE(frame.timestamp, data_loader.start_gt_time);
+    EXPECT_EQ(frame.image_path, "img/image_0_1101.png");
+    EXPECT_FALSE(frame.image.empty());
+
+    ASSERT_TRUE(data_loader.read_image(frame));
+    EXPECT_EQ(frame.image_path, "img/image_0_1102.png");
+  }
+}
+
+/**
+ * @brief Construct a test for the number scanner of the text parser
+ *
+ */
+TEST(TextParserTests, TestParseNumber) {
+  const std::vector<std::string> inputs = {
+      "0", "-0.5", "1540822844.517587661743", "6.97259757245842",
+      "  -0.847227610346144", "1e-3", "2.5E+2", ".5"};
+  for (const std::string& input : inputs) {
+    const char* cursor = input.data();
+    double value;
+    ASSERT_TRUE(
+        dl::parse_number(cursor, input.data() + input.size(), value));
+    EXPECT_EQ(cursor, input.data() + input.size());
+    double expected = std::strtod(input.c_str(), nullptr);
+    EXPECT_NEAR(value, expected, std::abs(expected) * 1e-15);
+  }
+
+  const std::string invalid = "  x1";
+  const char* cursor = invalid.data();
+  double value;
+  EXPECT_FALSE(
+      dl::parse_number(cursor, invalid.data() + invalid.size(), value));
+  EXPECT_EQ(cursor, invalid.data());
+}
+
+/**
+ * @brief Construct a test for parsing IMU and ground truth logs
+ *
+ */
+TEST(TextParserTests, TestParseFiles) {
+  const std::string imu_path = "test_imu.txt";
+  std::ofstream imu_file(imu_path);
+  imu_file << "# id timestamp wx wy wz ax ay az\n"
+           << "0 10.5 0.1 0.2 0.3 9.8 0 -1\n"
+           << "\n"
+           << "1 10.6 1 2 3 4 5\n"
+           << "2 10.7 1 2 3 4 5 6";
+  imu_file.close();
+
+  // Blank and incomplete lines are skipped, the last line has no newline
+  dl::ImuLog imu_log;
+  ASSERT_TRUE(dl::parse_imu_file(imu_path, imu_log));
+  ASSERT_EQ(imu_log.size(), 2u);
+  EXPECT_DOUBLE_EQ(imu_log.timestamp[1], 10.7);
+  EXPECT_DOUBLE_EQ(imu_log.gyro_y[0], 0.2);
+  EXPECT_DOUBLE_EQ(imu_log.accel_z[0], -1.0);
+  EXPECT_DOUBLE_EQ(imu_log.accel_z[1], 6.0);
+  std::remove(imu_path.c_str());
+
+  dl::GroundTruthLog gt_log;
+  ASSERT_TRUE(dl::parse_gt_file(
+      "../../indoor_forward_9_davis_with_gt/groundtruth.txt", gt_log));
+  ASSERT_EQ(gt_log.size(), 14400u);
+  EXPECT_NEAR(gt_log.timestamp[0], 1540822844.4948, 1e-6);
+  EXPECT_DOUBLE_EQ(gt_log.x[0], 6.97259757245842);
+  EXPECT_DOUBLE_EQ(gt_log.qw[0], 0.239852639755611);
+
+  EXPECT_FALSE(dl::parse_gt_file("missing.txt", gt_log));
+}
+
+/**
+ * @brief Construct a test for reading nanosecond timestamps into doubles and
+ * associating them with a sub-millisecond tolerance
+ *
+ */
+TEST(TextParserTests, TestNanosecondTimestamps) {
+  // 19-digit timestamps in nanoseconds, ground truth at 1 kHz and an
+  // estimate 0.2 ms after every ground truth pose
+  const int64_t start = 1540822844517587661;
+  const int poses = 100;
+  const std::string groundtruth_path = "test_groundtruth_ns.txt";
+  const std::string estimate_path = "test_estimate_ns.txt";
+  {
+    std::ofstream groundtruth_file(groundtruth_path);
+    std::ofstream estimate_file(estimate_path);
+    for (int k = 0; k < poses; ++k) {
+      const int64_t times[2] = {start + k * 1000000LL,
+                                start + k * 1000000LL + 200000LL};
+      std::ofstream* files[2] = {&groundtruth_file, &estimate_file};
+      for (int f = 0; f < 2; ++f) {
+        *files[f] << times[f] / 1000000000LL << '.' << std::setfill('0')
+                  << std::setw(9) << times[f] % 1000000000LL
+                  << " 0 0 0 0 0 0 1\n";
+      }
+    }
+  }
+
+  dl::GroundTruthLog groundtruth, estimate;
+  ASSERT_TRUE(dl::parse_gt_file(groundtruth_path, groundtruth));
+  ASSERT_TRUE(dl::parse_gt_file(estimate_path, estimate));
+  std::remove(groundtruth_path.c_str());
+  std::remove(estimate_path.c_str());
+  ASSERT_EQ(groundtruth.size(), static_cast<size_t>(poses));
+  ASSERT_EQ(estimate.size(), static_cast<size_t>(poses));
+
+  // Every timestamp is within one double ulp, 0.24 us, of the written one
+  for (int k = 0; k < poses; ++k) {
+    const int64_t nanoseconds = start + k * 1000000LL;
+    const long double exact = nanoseconds / 1000000000LL +
+                              (nanoseconds % 1000000000LL) * 1e-9L;
+    EXPECT_LT(std::abs(groundtruth.timestamp[k] - exact), 2.5e-7L);
+  }
+
+  // The rounding does not move a pair across the association tolerance
+  std::vector<std::pair<size_t, size_t>> matches;
+  ASSERT_EQ(ev::associate(estimate.timestamp, groundtruth.timestamp, 3e-4,
+                          matches),
+            static_cast<size_t>(poses));
+  for (int k = 0; k < poses; ++k) {
+    EXPECT_EQ(matches[k].first, static_cast<size_t>(k));
+    EXPECT_EQ(matches[k].second, static_cast<size_t>(k));
+  }
+  EXPECT_EQ(ev::associate(estimate.timestamp, groundtruth.timestamp, 1e-4,
+                          matches),
+            0u);
+}
+
+/**
+ * @brief Construct a test for prefetched image reading
+ *
+ */
+TEST_F(DataLoaderTests, TestPrefetchedImageData) {
+  dl::DataLoader synchronous_loader("../../indoor_forward_9_davis_with_gt");
+  test_data_loader->enable_prefetch(4, 2);
+
+  // Only a few images are bundled, so later entries decode to empty images.
+  // Entries already submitted when prefetch goes off are still handed out,
+  // by both the image and the entry readers.
+  for (int i = 0; i < 16; ++i) {
+    if (i == 4 || i == 12) test_data_loader->disable_prefetch();
+    if (i == 8) test_data_loader->enable_prefetch(4, 2);
+    if (i == 13) {
+      double timestamp;
+      std::string image_path;
+      ASSERT_TRUE(test_data_loader->read_image_entry(timestamp, image_path));
+      auto synchronous = synchronous_loader.get_image_data();
+      EXPECT_EQ(timestamp, std::get<0>(synchronous));
+      EXPECT_EQ(image_path, std::get<2>(synchronous));
+      continue;
+    }
+
+    auto prefetched = test_data_loader->get_image_data();
+    auto synchronous = synchronous_loader.get_image_data();
+
+    EXPECT_EQ(std::get<0>(prefetched), std::get<0>(synchronous)) << i;
+    EXPECT_EQ(std::get<2>(prefetched), std::get<2>(synchronous)) << i;
+    EXPECT_EQ(std::get<1>(prefetched).size(), std::get<1>(synchronous).size());
+  }
+}
+
+/**
+ * @brief Construct a test for reading a packed dataset
+ *
+ */
+TEST_F(DataLoaderTests, TestPackedDataset) {
+  const std::string pack_path = "test_dataset.pack";
+  ASSERT_TRUE(dl::PackedDataset::write("../../indoor_forward_9_davis_with_gt",
+                                       pack_path, dl::ImageColor::kGrayscale));
+
+  dl::DataLoader packed_loader(pack_path);
+  packed_loader.set_image_color(dl::ImageColor::kGrayscale);
+  test_data_loader->set_image_color(dl::ImageColor::kGrayscale);
+
+  // Ground truth is normalized the same way as the text dataset
+  ASSERT_EQ(packed_loader.x_gt.size(), test_data_loader->x_gt.size());
+  EXPECT_NEAR(packed_loader.start_gt_time, test_data_loader->start_gt_time,
+              1e-6);
+  EXPECT_NEAR(packed_loader.finish_gt_time, test_data_loader->finish_gt_time,
+              1e-6);
+  size_t last = packed_loader.x_gt.size() - 1;
+  EXPECT_NEAR(static_cast<double>(packed_loader.x_gt[last]),
+              static_cast<double>(test_data_loader->x_gt[last]), 1e-9);
+  EXPECT_NEAR(static_cast<double>(packed_loader.qw_gt[last]),
+              static_cast<double>(test_data_loader->qw_gt[last]), 1e-9);
+
+  // Images come back bit-exact, in list order
+  dl::ImageFrame packed_frame, text_frame;
+  while (test_data_loader->read_image(text_frame)) {
+    ASSERT_TRUE(packed_loader.read_image(packed_frame));
+    EXPECT_EQ(packed_frame.timestamp, text_frame.timestamp);
+    ASSERT_EQ(packed_frame.image_path, text_frame.image_path);
+    ASSERT_EQ(packed_frame.image.empty(), text_frame.image.empty());
+    if (!text_frame.image.empty()) {
+      EXPECT_EQ(cv::norm(packed_frame.image, text_frame.image, cv::NORM_INF),
+                0.0);
+    }
+  }
+  EXPECT_FALSE(packed_loader.read_image(packed_frame));
+
+  std::remove(pack_path.c_str());
+}
+
+/**
+ * @brief Test fixture for the loop closure, with a camera circling inside a
+ * cylinder of landmarks, each with its own random descriptor
+ *
+ */
+class LoopClosureTests : public ::testing::Test {
+ protected:
+  std::mt19937 generator{7};
+  std::vector<Eigen::Vector3d> world;
+  cv::Mat world_descriptors;
+
+  /**
+   * @brief Set up the landmarks
+   *
+   */
+  void SetUp() override {
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    for (int i = 0; i < 4000; ++i) {
+      const double angle = 2.0 * M_PI * uniform(generator);
+      world.emplace_back(5.0 * std::cos(angle), 2.0 * uniform(generator) - 1.0,
+                         5.0 * std::sin(angle));
+    }
+    world_descriptors = cv::Mat(4000, 32, CV_8U);
+    cv::randu(world_descriptors, cv::Scalar(0), cv::Scalar(256));
+  }
+
+  /**
+   * @brief Function to get the camera pose, 10 degrees further along the
+   * circle every keyframe and looking outwards
+   *
+   * @param k: keyframe index
+   * @return Eigen::Matrix4d: camera to world pose
+   */
+  Eigen::Matrix4d camera_pose(int k) {
+    const double angle = k * 10.0 * M_PI / 180.0;
+    Eigen::Vector3d z(std::cos(angle), 0.0, std::sin(angle));
+    Eigen::Vector3d y(0.0, 1.0, 0.0);
+    Eigen::Matrix4d pose = Eigen::Matrix4d::Identity();
+    pose.block<3, 1>(0, 0) = y.cross(z);
+    pose.block<3, 1>(0, 1) = y;
+    pose.block<3, 1>(0, 2) = z;
+    pose.block<3, 1>(0, 3) = z;
+    return pose;
+  }
+
+  /**
+   * @brief Function to observe the landmarks in view of a camera
+   *
+   * @param pose: camera to world pose
+   * @param points: output normalized image points
+   * @param descriptors: output descriptors with up to 3 flipped bits
+   */
+  void observe(const Eigen::Matrix4d& pose, std::vector<cv::Point2f>& points,
+               cv::Mat& descriptors) {
+    points.clear();
+    descriptors = cv::Mat();
+    const Eigen::Matrix3d R = pose.block<3, 3>(0, 0);
+    const Eigen::Vector3d p = pose.block<3, 1>(0, 3);
+    for (size_t i = 0; i < world.size(); ++i) {
+      Eigen::Vector3d X = R.transpose() * (world[i] - p);
+      if (X(2) < 0.5 || std::abs(X(0) / X(2)) > 0.6 ||
+          std::abs(X(1) / X(2)) > 0.45)
+        continue;
+      points.emplace_back(static_cast<float>(X(0) / X(2)),
+                          static_cast<float>(X(1) / X(2)));
+      cv::Mat descriptor = world_descriptors.row(static_cast<int>(i)).clone();
+      for (int flip = generator() % 4; flip > 0; --flip) {
+        const int bit = generator() % 256;
+        descriptor.data[bit / 8] ^= static_cast<uint8_t>(1 << (bit % 8));
+      }
+      descriptors.push_back(descriptor);
+    }
+  }
+
+  /**
+   * @brief Function to train a vocabulary on every other keyframe of a lap
+   *
+   * @return std::shared_ptr<lc::Vocabulary>
+   */
+  std::shared_ptr<lc::Vocabulary> train_vocabulary() {
+    std::vector<cv::Mat> training;
+    for (int k = 0; k < 36; k += 2) {
+      std::vector<cv::Point2f> points;
+      cv::Mat descriptors;
+      observe(camera_pose(k), points, descriptors);
+      training.push_back(descriptors);
+    }
+    auto vocabulary = std::make_shared<lc::Vocabulary>();
+    vocabulary->train(training, 10, 3);
+    return vocabulary;
+  }
+};
+
+/**
+ * @brief Test that the vocabulary scores views of the same place higher and
+ * survives a save and load
+ *
+ */
+TEST_F(LoopClosureTests, TestVocabulary) {
+  auto vocabulary = train_vocabulary();
+  ASSERT_FALSE(vocabulary->empty());
+  EXPECT_EQ(vocabulary->get_descriptor_bytes(), 32);
+
+  std::vector<cv::Point2f> points;
+  cv::Mat first, again, other;
+  observe(camera_pose(3), points, first);
+  observe(camera_pose(3), points, again);
+  observe(camera_pose(21), points, other);
+  lc::BowVector bow_first, bow_again, bow_other;
+  vocabulary->transform(first, bow_first);
+  vocabulary->transform(again, bow_again);
+  vocabulary->transform(other, bow_other);
+  EXPECT_NEAR(lc::Vocabulary::score(bow_first, bow_first), 1.0, 1e-9);
+  EXPECT_GT(lc::Vocabulary::score(bow_first, bow_again),
+            2.0 * lc::Vocabulary::score(bow_first, bow_other));
+
+  const std::string path = "test_vocabulary.bin";
+  ASSERT_TRUE(vocabulary->save(path));
+  lc::Vocabulary loaded;
+  ASSERT_TRUE(loaded.load(path));
+  EXPECT_EQ(loaded.size(), vocabulary->size());
+  lc::BowVector bow_loaded;
+  loaded.transform(first, bow_loaded);
+  EXPECT_EQ(bow_loaded, bow_first);
+  std::remove(path.c_str());
+
+  EXPECT_FALSE(loaded.load("missing.bin"));
+  EXPECT_TRUE(loaded.empty());
+}
+
+/**
+ * @brief Test that the database returns the most similar keyframe before the
+ * end of the query
+ *
+ */
+TEST_F(LoopClosureTests, TestKeyframeDatabase) {
+  auto vocabulary = train_vocabulary();
+  lc::KeyframeDatabase database;
+  std::vector<cv::Point2f> points;
+  cv::Mat descriptors;
+  lc::BowVector bow;
+  for (int k = 0; k < 36; k += 3) {
+    observe(camera_pose(k), points, descriptors);
+    vocabulary->transform(descriptors, bow);
+    database.add(bow);
+  }
+  ASSERT_EQ(database.size(), 12u);
+
+  observe(camera_pose(15), points, descriptors);
+  vocabulary->transform(descriptors, bow);
+  std::vector<lc::QueryResult> results;
+  database.query(bow, 3, database.size(), results);
+  ASSERT_EQ(results.size(), 3u);
+  EXPECT_EQ(results[0].keyframe, 5u);
+  EXPECT_GE(results[0].score, results[1].score);
+
+  database.query(bow, 3, 5, results);
+  for (const lc::QueryResult& result : results) EXPECT_LT(result.keyframe, 5u);
+
+  database.clear();
+  database.query(bow, 3, 5, results);
+  EXPECT_TRUE(results.empty());
+}
+
+/**
+ * @brief Test that a drifting lap is closed and the loop pose agrees with
+ * the start of the lap
+ *
+ */
+TEST_F(LoopClosureTests, TestDetectsAndCorrectsLoop) {
+  lc::LoopClosure loop_closure(train_vocabulary());
+  Eigen::Matrix4d drift = Eigen::Matrix4d::Identity();
+  Eigen::Matrix4d step = Eigen::Matrix4d::Identity();
+  step.block<3, 3>(0, 0) = io::so3::exp(Eigen::Vector3d(0.0, 0.004, 0.0));
+  step(0, 3) = 0.003;
+
+  std::vector<cv::Point2f> points;
+  cv::Mat descriptors;
+  for (int k = 0; k < 40; ++k) {
+    const Eigen::Matrix4d truth = camera_pose(k);
+    if (k > 0) drift = drift * step;
+    const Eigen::Matrix4d pose = drift * truth;
+    observe(truth, points, descriptors);
+
+    lc::LoopConstraint loop;
+    if (!loop_closure.add_keyframe(pose, points, descriptors, loop)) continue;
+
+    // Only the second lap sees the places of the first one again
+    EXPECT_GE(k, 30);
+    EXPECT_EQ(loop.current, static_cast<size_t>(k));
+    EXPECT_LE(loop.match + 20, loop.current);
+    EXPECT_GE(loop.inliers, 25);
+    if (loop.inliers < 100) continue;
+
+    // The start of the lap has drifted the least
+    EXPECT_LT((loop.pose.block<3, 1>(0, 3) - truth.block<3, 1>(0, 3)).norm(),
+              (pose.block<3, 1>(0, 3) - truth.block<3, 1>(0, 3)).norm());
+    loop_closure.correct(loop);
+    EXPECT_TRUE(loop_closure.get_pose(k).isApprox(loop.pose, 1e-9));
+    drift = loop.pose * truth.inverse();
+  }
+  EXPECT_GT(loop_closure.get_loop_count(), 0u);
+  EXPECT_EQ(loop_closure.size(), 40u);
+}
+
+/**
+ * @brief Test fixture for the trajectory evaluation, with a ground truth
+ * helix sampled at 200 Hz
+ *
+ */
+class EvaluationTests : public ::testing::Test {
+ protected:
+  dl::GroundTruthLog groundtruth;
+
+  /**
+   * @brief Set up 20 seconds of ground truth
+   *
+   */
+  void SetUp() override {
+    for (int k = 0; k < 4000; ++k)
+      ev::append_pose(groundtruth, 0.005 * k, true_pose(0.005 * k));
+  }
+
+  /**
+   * @brief Function to get the true pose at a time
+   *
+   * @param time: seconds
+   * @return Eigen::Matrix4d: body to world pose
+   */
+  Eigen::Matrix4d true_pose(double time) {
+    Eigen::Matrix4d pose = Eigen::Matrix4d::Identity();
+    pose.block<3, 3>(0, 0) =
+        io::so3::exp(Eigen::Vector3d(0.0, 0.5 * time, 0.0));
+    pose(0, 3) = 4.0 * std::sin(0.5 * time);
+    pose(1, 3) = 0.1 * time;
+    pose(2, 3) = 4.0 * std::cos(0.5 * time);
+    return pose;
+  }
+};
+
+/**
+ * @brief Test that poses are paired with the closest ground truth time
+ *
+ */
+TEST_F(EvaluationTests, TestAssociate) {
+  std::vector<double> times = {-1.0, 0.0011, 0.0039, 0.5, 19.996, 30.0};
+  std::vector<std::pair<size_t, size_t>> matches;
+  ASSERT_EQ(ev::associate(times, groundtruth.timestamp, 0.002, matches), 4u);
+  const size_t expected[4][2] = {{1, 0}, {2, 1}, {3, 100}, {4, 3999}};
+  for (int m = 0; m < 4; ++m) {
+    EXPECT_EQ(matches[m].first, expected[m][0]);
+    EXPECT_EQ(matches[m].second, expected[m][1]);
+  }
+
+  std::vector<double> unsorted = {1.0, 0.0};
+  EXPECT_EQ(ev::associate(times, unsorted, 0.002, matches), 0u);
+  EXPECT_EQ(ev::associate(unsorted, groundtruth.timestamp, 0.002, matches),
+            0u);
+}
+
+/**
+ * @brief Test that the alignment removes a similarity transform of the
+ * whole trajectory, and only the scale-aware one removes a scale error
+ *
+ */
+TEST_F(EvaluationTests, TestAlignment) {
+  ev::Similarity offset;
+  offset.R = io::so3::exp(Eigen::Vector3d(0.3, -0.2, 1.0));
+  offset.t = Eigen::Vector3d(1.0, -2.0, 0.5);
+  offset.scale = 0.25;
+
+  // A monocular estimate at 20 Hz, in its own frame and scale
+  dl::GroundTruthLog estimate;
+  for (int k = 0; k < 400; ++k) {
+    Eigen::Matrix4d pose = true_pose(0.05 * k);
+    pose.block<3, 3>(0, 0) = offset.R * pose.block<3, 3>(0, 0);
+    pose.block<3, 1>(0, 3) =
+        offset.scale * offset.R * pose.block<3, 1>(0, 3) + offset.t;
+    ev::append_pose(estimate, 0.05 * k + 1e-4, pose);
+  }
+
+  ev::EvaluationConfig config;
+  ev::EvaluationReport report;
+  ASSERT_TRUE(ev::evaluate(estimate, groundtruth, config, report));
+  EXPECT_EQ(report.matched, 400u);
+  EXPECT_NEAR(report.alignment.scale, 1.0 / offset.scale, 1e-6);
+  EXPECT_LT(report.ate.rmse, 1e-6);
+  ASSERT_EQ(report.rpe.size(), config.segment_lengths.size());
+  for (const ev::RelativeError& rpe : report.rpe) {
+    EXPECT_GT(rpe.translation.count, 0u);
+    EXPECT_LT(rpe.translation.max, 1e-6);
+    EXPECT_LT(rpe.rotation.max, 1e-4);
+  }
+
+  // Without the scale the relative motions are a quarter too long
+  config.alignment = ev::Alignment::kSE3;
+  ASSERT_TRUE(ev::evaluate(estimate, groundtruth, config, report));
+  EXPECT_DOUBLE_EQ(report.alignment.scale, 1.0);
+  EXPECT_GT(report.ate.rmse, 1.0);
+  EXPECT_NEAR(report.rpe[0].translation.median, 0.75, 0.02);
+  EXPECT_LT(report.rpe[0].rotation.max, 1e-4);
+}
+
+/**
+ * @brief Test that a camera trajectory evaluates to zero error against the
+ * body ground truth once the extrinsic is given, and not without it
+ *
+ */
+TEST_F(EvaluationTests, TestCameraExtrinsic) {
+  ev::EvaluationConfig config;
+  config.R_body_camera = io::so3::exp(Eigen::Vector3d(M_PI / 2, 0.0, 0.1));
+  config.t_body_camera = Eigen::Vector3d(0.05, -0.02, 0.1);
+  Eigen::Matrix4d T_body_camera = Eigen::Matrix4d::Identity();
+  T_body_camera.block<3, 3>(0, 0) = config.R_body_camera;
+  T_body_camera.block<3, 1>(0, 3) = config.t_body_camera;
+
+  // A monocular camera trajectory in its own frame and scale
+  const Eigen::Matrix3d R_offset = io::so3::exp(Eigen::Vector3d(0.2, 0.1, -0.4));
+  dl::GroundTruthLog estimate;
+  for (int k = 0; k < 400; ++k) {
+    Eigen::Matrix4d pose = true_pose(0.05 * k) * T_body_camera;
+    pose.block<3, 3>(0, 0) = R_offset * pose.block<3, 3>(0, 0);
+    pose.block<3, 1>(0, 3) = 0.5 * R_offset * pose.block<3, 1>(0, 3);
+    ev::append_pose(estimate, 0.05 * k, pose);
+  }
+
+  ev::EvaluationReport report;
+  ASSERT_TRUE(ev::evaluate(estimate, groundtruth, config, report));
+  EXPECT_NEAR(report.alignment.scale, 2.0, 1e-6);
+  EXPECT_LT(report.ate.rmse, 1e-6);
+  ASSERT_FALSE(report.rpe.empty());
+  for (const ev::RelativeError& rpe : report.rpe) {
+    EXPECT_LT(rpe.translation.max, 1e-6);
+    EXPECT_LT(rpe.rotation.max, 1e-4);
+  }
+
+  // Camera motions compared as body motions are rotated
+  config.R_body_camera.setIdentity();
+  config.t_body_camera.setZero();
+  ASSERT_TRUE(ev::evaluate(estimate, groundtruth, config, report));
+  EXPECT_GT(report.rpe[0].rotation.median, 1.0);
+  EXPECT_GT(report.rpe[0].translation.median, 0.1);
+}
+
+/**
+ * @brief Test that the ground truth of the dataset evaluates to zero error
+ * against itself after a round trip through a trajectory file
+ *
+ */
+TEST(EvaluationFileTests, TestGroundTruthRoundTrip) {
+  dl::GroundTruthLog groundtruth, written;
+  ASSERT_TRUE(dl::parse_gt_file(
+      "../../indoor_forward_9_davis_with_gt/groundtruth.txt", groundtruth));
+
+  const std::string path = "test_trajectory.txt";
+  ASSERT_TRUE(ev::write_trajectory(path, groundtruth));
+  ASSERT_TRUE(dl::parse_gt_file(path, written));
+  ASSERT_EQ(written.size(), groundtruth.size());
+  std::remove(path.c_str());
+
+  ev::EvaluationConfig config;
+  config.alignment = ev::Alignment::kNone;
+  config.max_time_difference = 1e-4;
+  ev::EvaluationReport report;
+  ASSERT_TRUE(ev::evaluate(written, groundtruth, config, report));
+  EXPECT_EQ(report.matched, groundtruth.size());
+  EXPECT_LT(report.ate.max, 1e-6);
+  EXPECT_FALSE(report.rpe.empty());
+  for (const ev::RelativeError& rpe : report.rpe)
+    EXPECT_LT(rpe.translation.max, 1e-6);
+}
+
+/**
+ * @brief Test fixture for the stage tracer, which is shared by the process
+ * and emptied around every test
+ *
+ */
+class TracerTests : public ::testing::Test {
+ protected:
+  void SetUp() override { pf::Tracer::instance().reset(); }
+
+  void TearDown() override { pf::Tracer::instance().reset(); }
+
+  /**
+   * @brief Function to record a stage of a given duration
+   *
+   * @param name: string literal
+   * @param microseconds
+   */
+  void record_stage(const char* name, int64_t microseconds) {
+    pf::Tracer::instance().record_duration(name, 1000,
+                                           1000 + microseconds * 1000);
+  }
+};
+
+/**
+ * @brief Test the percentiles of the stage durations and counts
+ *
+ */
+TEST_F(TracerTests, TestStatistics) {
+  // Out of order, so the percentiles have to select rather than index
+  for (int us = 100; us >= 1; us--) record_stage("vo.ransac", us);
+  record_stage("dl.decode", 7);
+  for (int value = 1; value <= 10; value++)
+    pf::Tracer::instance().record_count("vo.inliers", value);
+  EXPECT_EQ(pf::Tracer::instance().size(), 111u);
+
+  std::vector<pf::TraceStatistics> stages =
+      pf::Tracer::instance().get_stage_statistics();
+  ASSERT_EQ(stages.size(), 2u);
+  EXPECT_EQ(stages[0].name, "dl.decode");
+  EXPECT_EQ(stages[0].count, 1u);
+  EXPECT_DOUBLE_EQ(stages[0].p99, 7.0);
+  EXPECT_EQ(stages[1].name, "vo.ransac");
+  EXPECT_EQ(stages[1].count, 100u);
+  EXPECT_DOUBLE_EQ(stages[1].p50, 50.0);
+  EXPECT_DOUBLE_EQ(stages[1].p99, 99.0);
+  EXPECT_DOUBLE_EQ(stages[1].max, 100.0);
+  EXPECT_DOUBLE_EQ(stages[1].mean, 50.5);
+
+  std::vector<pf::TraceStatistics> counts =
+      pf::Tracer::instance().get_count_statistics();
+  ASSERT_EQ(counts.size(), 1u);
+  EXPECT_EQ(counts[0].name, "vo.inliers");
+  EXPECT_DOUBLE_EQ(counts[0].p50, 5.0);
+  EXPECT_DOUBLE_EQ(counts[0].max, 10.0);
+}
+
+/**
+ * @brief Test that scoped timers from several threads end up in the Chrome
+ * trace
+ *
+ */
+TEST_F(TracerTests, TestChromeTrace) {
+  {
+    pf::ScopedTimer timer("test.sleep");
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+  std::thread worker([] {
+    pf::ScopedTimer timer("test.worker");
+    pf::Tracer::instance().record_count("test.matches", 42);
+  });
+  worker.join();
+
+  std::vector<pf::TraceStatistics> stages =
+      pf::Tracer::instance().get_stage_statistics();
+  ASSERT_EQ(stages.size(), 2u);
+  EXPECT_EQ(stages[0].name, "test.sleep");
+  EXPECT_GE(stages[0].max, 2000.0);
+
+  const std::string path = "test_trace.json";
+  ASSERT_TRUE(pf::Tracer::instance().write_chrome_trace(path));
+  std::ifstream file(path);
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  std::remove(path.c_str());
+
+  const std::string trace = buffer.str();
+  EXPECT_EQ(trace.find("{\"traceEvents\":["), 0u);
+  EXPECT_NE(trace.find("\"name\":\"test.sleep\",\"cat\":\"test\","
+                       "\"ph\":\"X\""),
+            std::string::npos);
+  EXPECT_NE(trace.find("\"ph\":\"C\""), std::string::npos);
+  EXPECT_NE(trace.find("\"args\":{\"value\":42"), std::string::npos);
+
+  // The worker thread gets its own track
+  EXPECT_NE(trace.find("\"tid\":0"), std::string::npos);
+  EXPECT_NE(trace.find("\"tid\":1"), std::string::npos);
+}